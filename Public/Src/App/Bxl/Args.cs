@@ -466,6 +466,14 @@ namespace BuildXL
                             "explicitlyReportDirectoryProbes",
                             sign => sandboxConfiguration.ExplicitlyReportDirectoryProbes = sign
                             ),
+                        OptionHandlerFactory.CreateBoolOption(
+                            "reportSandboxStatistics",
+                            sign => sandboxConfiguration.ReportSandboxStatistics = sign
+                            ),
+                        OptionHandlerFactory.CreateBoolOption(
+                            "hashOutputsOnClose",
+                            sign => sandboxConfiguration.HashOutputsOnClose = sign
+                            ),
                         OptionHandlerFactory.CreateOption(
                             "exportGraph",
                             opt =>
@@ -868,6 +868,18 @@ namespace BuildXL
                 HelpLevel.Verbose
                 );
 
+            hw.WriteOption(
+                "/reportSandboxStatistics[+|-]",
+                Strings.HelpText_DisplayHelp_ReportSandboxStatistics,
+                HelpLevel.Verbose
+                );
+
+            hw.WriteOption(
+                "/hashOutputsOnClose[+|-]",
+                Strings.HelpText_DisplayHelp_HashOutputsOnClose,
+                HelpLevel.Verbose
+                );
+
             #endregion
 
             hw.WriteBanner(
@@ -94,6 +94,7 @@ namespace BuildXL.Processes
             IgnoreCreateProcessReport = false;
             ProbeDirectorySymlinkAsDirectory = false;
             ExplicitlyReportDirectoryProbes = false;
+            ReportSandboxStatistics = false;
         }
 
         private bool GetFlag(FileAccessManifestFlag flag) => (m_fileAccessManifestFlag & flag) != 0;
@@ -463,6 +464,15 @@ namespace BuildXL.Processes
             set => SetExtraFlag(FileAccessManifestExtraFlag.ExplicitlyReportDirectoryProbes, value);
         }
 
+        /// <summary>
+        /// Linux-specific: when enabled, every sandboxed process sends its <see cref="SandboxStatistics"/> right before its exit report.
+        /// </summary>
+        public bool ReportSandboxStatistics
+        {
+            get => GetExtraFlag(FileAccessManifestExtraFlag.ReportSandboxStatistics);
+            set => SetExtraFlag(FileAccessManifestExtraFlag.ReportSandboxStatistics, value);
+        }
+
         /// <summary>
         /// A location for a file where Detours to log failure messages.
         /// </summary>
@@ -1213,7 +1223,8 @@ namespace BuildXL.Processes
         internal enum FileAccessManifestExtraFlag
         {
             NoneExtra = 0,
-            ExplicitlyReportDirectoryProbes = 0x1
+            ExplicitlyReportDirectoryProbes = 0x1,
+            ReportSandboxStatistics = 0x2
         }
 
         private readonly struct FileAccessScope
@@ -104,6 +104,15 @@ namespace BuildXL.Processes
         /// </summary>
         EnableFullReparsePointParsing = 0x1000,
 
+        /// <summary>
+        /// If set, the sandbox hashes the content of files under this scope that were opened for writing when they are closed
+        /// and attaches the digest to the close report.
+        /// </summary>
+        /// <remarks>
+        /// Currently only honored by the Linux sandbox; see <see cref="OutputContentDigest"/>.
+        /// </remarks>
+        ReportContentHashOnClose = 0x2000,
+
         /// <summary>
         /// If set, then we will report attempts to access files under this scope, whether they exist or not (combination of <see cref="ReportAccessIfExistent"/>
         /// and <see cref="ReportAccessIfNonexistent"/>).
@@ -0,0 +1,128 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using System;
+using System.Diagnostics.ContractsLight;
+using System.Globalization;
+
+namespace BuildXL.Processes
+{
+    /// <summary>
+    /// Digest of the content of an output file, computed by the Linux sandbox when the file was closed
+    /// (see <see cref="FileAccessPolicy.ReportContentHashOnClose"/>).
+    /// </summary>
+    /// <remarks>
+    /// The hash is the VSO hash (HashType.Vso0) of the content, so it can be used as the known content hash of the file
+    /// when the engine runs with that (default) hash type instead of hashing the file again.
+    ///
+    /// The digest describes the file only as long as its length and last write time still match the ones recorded
+    /// here; if they don't (e.g., because the file was later written through a file descriptor the sandbox doesn't
+    /// track) the digest must be ignored and the file hashed from disk.
+    ///
+    /// CODESYNC: Public/Src/Sandbox/Linux/bxl_observer.cpp
+    /// </remarks>
+    public readonly struct OutputContentDigest : IEquatable<OutputContentDigest>
+    {
+        /// <summary>Length of <see cref="Hash"/>: a SHA-256 hash.</summary>
+        public const int HashLength = 32;
+
+        /// <summary>The algorithm result of the VSO hash of the file content (i.e., without the trailing algorithm id).</summary>
+        public byte[] Hash { get; }
+
+        /// <summary>Length of the file when it was hashed.</summary>
+        public long Length { get; }
+
+        /// <summary>Seconds part of the file's modification time when it was hashed.</summary>
+        public long LastWriteTimeSeconds { get; }
+
+        /// <summary>Nanoseconds part of the file's modification time when it was hashed.</summary>
+        public long LastWriteTimeNanoseconds { get; }
+
+        /// <nodoc />
+        public OutputContentDigest(byte[] hash, long length, long lastWriteTimeSeconds, long lastWriteTimeNanoseconds)
+        {
+            Contract.Requires(hash != null && hash.Length == HashLength);
+
+            Hash = hash;
+            Length = length;
+            LastWriteTimeSeconds = lastWriteTimeSeconds;
+            LastWriteTimeNanoseconds = lastWriteTimeNanoseconds;
+        }
+
+        /// <summary>
+        /// Whether this digest still describes a file with the given length and modification time.
+        /// </summary>
+        public bool IsValidFor(long length, long lastWriteTimeSeconds, long lastWriteTimeNanoseconds)
+        {
+            return Length == length && LastWriteTimeSeconds == lastWriteTimeSeconds && LastWriteTimeNanoseconds == lastWriteTimeNanoseconds;
+        }
+
+        /// <summary>
+        /// Parses a digest in the format sent by the sandbox: "&lt;hex hash&gt;:&lt;length&gt;:&lt;mtime seconds&gt;.&lt;mtime nanoseconds&gt;".
+        /// </summary>
+        public static bool TryParse(string str, out OutputContentDigest digest)
+        {
+            digest = default;
+            string[] parts = str?.Split(':');
+            if (parts == null || parts.Length != 3)
+            {
+                return false;
+            }
+
+            string[] mtime = parts[2].Split('.');
+            if (mtime.Length != 2
+                || !TryParseHash(parts[0], out byte[] hash)
+                || !long.TryParse(parts[1], NumberStyles.None, CultureInfo.InvariantCulture, out long length)
+                || !long.TryParse(mtime[0], NumberStyles.AllowLeadingSign, CultureInfo.InvariantCulture, out long seconds)
+                || !long.TryParse(mtime[1], NumberStyles.None, CultureInfo.InvariantCulture, out long nanoseconds))
+            {
+                return false;
+            }
+
+            digest = new OutputContentDigest(hash, length, seconds, nanoseconds);
+            return true;
+        }
+
+        private static bool TryParseHash(string str, out byte[] hash)
+        {
+            hash = null;
+            if (str.Length != 2 * HashLength)
+            {
+                return false;
+            }
+
+            var bytes = new byte[HashLength];
+            for (int i = 0; i < HashLength; i++)
+            {
+                if (!byte.TryParse(str.Substring(2 * i, 2), NumberStyles.AllowHexSpecifier, CultureInfo.InvariantCulture, out bytes[i]))
+                {
+                    return false;
+                }
+            }
+
+            hash = bytes;
+            return true;
+        }
+
+        /// <inheritdoc />
+        public bool Equals(OutputContentDigest other)
+        {
+            return Hash.AsSpan().SequenceEqual(other.Hash) && IsValidFor(other.Length, other.LastWriteTimeSeconds, other.LastWriteTimeNanoseconds);
+        }
+
+        /// <inheritdoc />
+        public override bool Equals(object obj) => obj is OutputContentDigest other && Equals(other);
+
+        /// <inheritdoc />
+        public override int GetHashCode() => BitConverter.ToInt32(Hash, 0) ^ Length.GetHashCode() ^ LastWriteTimeNanoseconds.GetHashCode();
+
+        /// <nodoc />
+        public static bool operator ==(OutputContentDigest left, OutputContentDigest right) => left.Equals(right);
+
+        /// <nodoc />
+        public static bool operator !=(OutputContentDigest left, OutputContentDigest right) => !left.Equals(right);
+
+        /// <inheritdoc />
+        public override string ToString() => $"{BitConverter.ToString(Hash).Replace("-", string.Empty).ToLowerInvariant()}:{Length}:{LastWriteTimeSeconds}.{LastWriteTimeNanoseconds:D9}";
+    }
+}
@@ -76,6 +76,59 @@ namespace BuildXL.Processes
             internal string ReportsFifoPath { get; }
             internal string FamPath { get; }
 
+            /// <summary>
+            /// File (created by the sandbox) holding the number of live processes in the pip's process tree.
+            /// </summary>
+            /// <remarks>
+            /// CODESYNC: Public/Src/Sandbox/Linux/bxl_observer.hpp
+            /// </remarks>
+            internal string ProcessTreeCountPath => ReportsFifoPath + ".tree";
+
+            /// <summary>
+            /// Socket (created by the sandbox when asked to aggregate the reports of the process tree) of the report aggregator.
+            /// </summary>
+            /// <remarks>
+            /// CODESYNC: Public/Src/Sandbox/Linux/bxl_aggregator.hpp
+            /// </remarks>
+            internal string ReportAggregatorSocketPath => ReportsFifoPath + ".aggregator";
+
+            /// <summary>
+            /// Search pattern (in the directory of <see cref="ReportsFifoPath"/>) of the files the sandbox spills reports to
+            /// when the FIFO is full.
+            /// </summary>
+            /// <remarks>
+            /// CODESYNC: Public/Src/Sandbox/Linux/bxl_reports.hpp
+            /// </remarks>
+            internal string SpillFileSearchPattern => Path.GetFileName(ReportsFifoPath) + ".*" + SpillFileSuffix;
+
+            /// <remarks>
+            /// CODESYNC: Public/Src/Sandbox/Linux/bxl_reports.hpp (BxlReportsSpillFileSuffix)
+            /// </remarks>
+            private const string SpillFileSuffix = ".spill";
+
+            /// <summary>
+            /// Whether <paramref name="path"/> names a spill file of the pip whose reports FIFO is <paramref name="reportsFifoPath"/>:
+            /// a file in the directory of that FIFO that matches <see cref="SpillFileSearchPattern"/>.
+            /// </summary>
+            /// <remarks>
+            /// Any process of the pip can write to the FIFO, so an announcement of spilled reports must not get the engine to read
+            /// (and then take as reports of the pip) any other file.
+            /// </remarks>
+            internal static bool IsSpillFile(string reportsFifoPath, string path)
+            {
+                if (string.IsNullOrEmpty(path) || !Path.IsPathRooted(path) || path.IndexOf('\0') != -1)
+                {
+                    return false;
+                }
+
+                string prefix = Path.GetFileName(reportsFifoPath) + ".";
+                string name = Path.GetFileName(path);
+                return string.Equals(Path.GetDirectoryName(path), Path.GetDirectoryName(reportsFifoPath), StringComparison.Ordinal)
+                    && name.Length > prefix.Length + SpillFileSuffix.Length
+                    && name.StartsWith(prefix, StringComparison.Ordinal)
+                    && name.EndsWith(SpillFileSuffix, StringComparison.Ordinal);
+            }
+
             internal string DebugLogJailPath { get; }
 
             private readonly Sandbox.ManagedFailureCallback m_failureCallback;
@@ -96,7 +149,7 @@ namespace BuildXL.Processes
             private readonly CancellableTimedAction m_activeProcessesChecker;
             private readonly Lazy<SafeFileHandle> m_lazyWriteHandle;
             private readonly Thread m_workerThread;
-            private readonly ActionBlock<(PooledObjectWrapper<byte[]> wrapper, int length)> m_accessReportProcessingBlock;
+            private readonly ActionBlock<(PooledObjectWrapper<byte[]> wrapper, int length, ulong dequeueTime)> m_accessReportProcessingBlock;
 
             private int m_stopRequestCounter;
             private int m_completeAccessReportProcessingCounter;
@@ -104,7 +157,56 @@ namespace BuildXL.Processes
             private static readonly TimeSpan ActiveProcessesCheckerInterval = TimeSpan.FromSeconds(1);
             private static readonly TimeSpan MaxWaitForReceiveAccessReports = TimeSpan.FromMinutes(1);
 
-            private static ArrayPool<byte> ByteArrayPool { get; } = new ArrayPool<byte>(4096);
+            /// <summary>
+            /// How many bytes <see cref="StartReceivingAccessReports"/> reads from the FIFO at once.  A chunk holds as many
+            /// (length-prefixed) reports as were written to the FIFO by then, the last of which may be incomplete.
+            /// </summary>
+            private const int ReadChunkSize = 64 * 1024;
+
+            /// <summary>
+            /// How many reports <see cref="ParseReports"/> parses at most at once.  A report is about 100 bytes, so this
+            /// is usually enough for a whole chunk.
+            /// </summary>
+            private const int MaxReportsPerParse = 1024;
+
+            private static ArrayPool<byte> ByteArrayPool { get; } = new ArrayPool<byte>(ReadChunkSize);
+
+            /// <summary>
+            /// Only used by <see cref="ProcessBytes"/>, which the action block never runs concurrently: the beginning of
+            /// a report that did not fit in the last chunk, the reports parsed from a chunk, and where their paths and
+            /// digests were copied to.
+            /// </summary>
+            private byte[] m_pendingBytes = new byte[ReadChunkSize];
+            private int m_pendingLength;
+            private readonly ParsedReport[] m_parsedReports = new ParsedReport[MaxReportsPerParse];
+            private readonly byte[] m_parsedReportsArena = new byte[ReadChunkSize];
+
+            /// <summary>
+            /// Same as above, for the reports read from spill files (see <see cref="ProcessSpilledReports"/>), and how far
+            /// every spill file was read (by the same method, or at the very end by <see cref="ProcessUnannouncedSpilledReports"/>).
+            /// </summary>
+            private readonly ParsedReport[] m_spilledReports = new ParsedReport[MaxReportsPerParse];
+            private readonly byte[] m_spilledReportsArena = new byte[ReadChunkSize];
+            private readonly Dictionary<string, long> m_spillFilePositions = new Dictionary<string, long>();
+
+            /// <summary>
+            /// How many bytes <see cref="ProcessSpillFile"/> reads from a spill file at once, however many were announced.
+            /// </summary>
+            private const int SpillReadChunkSize = 1024 * 1024;
+
+            /// <summary>
+            /// The longest report, length prefix included: reports are written to the FIFO (or spilled) with a single write
+            /// of at most PIPE_BUF bytes.
+            /// </summary>
+            /// <remarks>
+            /// CODESYNC: Public/Src/Sandbox/Linux/bxl_observer.cpp (BxlObserver::SendReport)
+            /// </remarks>
+            private const int MaxReportSize = 4096;
+
+            /// <summary>
+            /// Only used by <see cref="ProcessSpillFile"/>: a chunk of a spill file, after the incomplete report the previous one ended with.
+            /// </summary>
+            private readonly byte[] m_spillReadBuffer = new byte[MaxReportSize + SpillReadChunkSize];
 
             internal Info(Sandbox.ManagedFailureCallback failureCallback, SandboxedProcessUnix process, string reportsFifoPath, string famPath, string debugLogPath, bool isInTestMode)
             {
@@ -136,7 +238,7 @@ namespace BuildXL.Processes
                 });
 
                 // action block where parsing and processing of received ActionReport bytes is done
-                m_accessReportProcessingBlock = new ActionBlock<(PooledObjectWrapper<byte[]> wrapper, int length)>(ProcessBytes, new ExecutionDataflowBlockOptions
+                m_accessReportProcessingBlock = new ActionBlock<(PooledObjectWrapper<byte[]> wrapper, int length, ulong dequeueTime)>(ProcessBytes, new ExecutionDataflowBlockOptions
                 {
                     BoundedCapacity = DataflowBlockOptions.Unbounded,
                     MaxDegreeOfParallelism = 1,
@@ -184,6 +286,8 @@ namespace BuildXL.Processes
                 m_accessReportProcessingBlock.Complete();
                 m_accessReportProcessingBlock.Completion.ContinueWith(t =>
                 {
+                    ProcessUnannouncedSpilledReports();
+
                     LogDebug("Posting OpProcessTreeCompleted message");
                     Process.PostAccessReport(new AccessReport
                     {
@@ -302,6 +406,15 @@ namespace BuildXL.Processes
                 m_activeProcesses.Clear();
                 Analysis.IgnoreResult(FileUtilities.TryDeleteFile(ReportsFifoPath, retryOnFailure: false));
                 Analysis.IgnoreResult(FileUtilities.TryDeleteFile(FamPath, retryOnFailure: false));
+
+                // normally deleted by the last process of the process tree (and by the report aggregator), unless some process was
+                // killed before it could report its exit
+                Analysis.IgnoreResult(FileUtilities.TryDeleteFile(ProcessTreeCountPath, retryOnFailure: false));
+                Analysis.IgnoreResult(FileUtilities.TryDeleteFile(ReportAggregatorSocketPath, retryOnFailure: false));
+                foreach (string spillFile in EnumerateSpillFiles())
+                {
+                    Analysis.IgnoreResult(FileUtilities.TryDeleteFile(spillFile, retryOnFailure: false));
+                }
                 if (m_isInTestMode)
                 {
                     // The worker thread should complete in all but most extreme cases.  One such extreme case
@@ -315,92 +428,346 @@ namespace BuildXL.Processes
             }
 
             /// <summary>
-            /// This method is backing <see cref="m_accessReportProcessingBlock"/>.
+            /// This method is backing <see cref="m_accessReportProcessingBlock"/>: it parses and processes every complete
+            /// report of a chunk read from the FIFO, and keeps the incomplete one (if any) for the next chunk.
             /// </summary>
-            private void ProcessBytes((PooledObjectWrapper<byte[]> wrapper, int length) item)
+            private void ProcessBytes((PooledObjectWrapper<byte[]> wrapper, int length, ulong dequeueTime) item)
             {
                 using (item.wrapper)
                 {
-                    // Format:
-                    //   "%s|%d|%d|%d|%d|%d|%d|%s\n", __progname, getpid(), access, status, explicitLogging, err, opcode, reportPath
-                    string message = Encoding.GetString(item.wrapper.Instance, index: 0, count: item.length).TrimEnd('\n');
+                    byte[] buffer = item.wrapper.Instance;
+                    int length = item.length;
+                    if (m_pendingLength > 0)
+                    {
+                        EnsurePendingCapacity(m_pendingLength + length);
+                        Array.Copy(buffer, 0, m_pendingBytes, m_pendingLength, length);
+                        buffer = m_pendingBytes;
+                        length += m_pendingLength;
+                        m_pendingLength = 0;
+                    }
+
+                    int offset = 0;
+                    while (offset < length)
+                    {
+                        int consumed = ParseReports(buffer, offset, length - offset, m_parsedReports, m_parsedReportsArena, out int numReports);
+                        for (int i = 0; i < numReports; i++)
+                        {
+                            if ((m_parsedReports[i].Flags & ParsedReportFlags.Spill) != 0)
+                            {
+                                ProcessSpilledReports(ref m_parsedReports[i], item.dequeueTime);
+                            }
+                            else
+                            {
+                                ProcessReport(ref m_parsedReports[i], m_parsedReportsArena, item.dequeueTime);
+                            }
+                        }
+
+                        offset += consumed;
+                        if (consumed == 0)
+                        {
+                            // the rest is the beginning of a report
+                            break;
+                        }
+                    }
+
+                    if (offset < length)
+                    {
+                        EnsurePendingCapacity(length - offset);
+                        Array.Copy(buffer, offset, m_pendingBytes, 0, length - offset);
+                        m_pendingLength = length - offset;
+                    }
+                }
+            }
+
+            private void EnsurePendingCapacity(int capacity)
+            {
+                if (m_pendingBytes.Length < capacity)
+                {
+                    Array.Resize(ref m_pendingBytes, Math.Max(capacity, 2 * m_pendingBytes.Length));
+                }
+            }
+
+            /// <summary>
+            /// Processes the reports a process spilled to a file while the FIFO was full, which the report parsed by
+            /// <see cref="ParseReports"/> announces: they come right after the reports that process wrote to the FIFO before.
+            /// </summary>
+            private void ProcessSpilledReports(ref ParsedReport announcement, ulong dequeueTime)
+            {
+                // CODESYNC: Public/Src/Sandbox/Linux/utils.h (PARSED_REPORT_SPILL)
+                string spillFile = Encoding.GetString(m_parsedReportsArena, announcement.PathOffset, announcement.PathLength);
+                long offset = (long)announcement.CreationTime;
+                long length = (long)announcement.EnqueueTime;
+                if (!IsSpillFile(ReportsFifoPath, spillFile))
+                {
+                    LogError($"Ignoring the reports process {announcement.Pid} announced in '{spillFile}', which is not a spill file of this pip");
+                    return;
+                }
 
-                    // parse message and create AccessReport
-                    string[] parts = message.Split(new[] { '|' });
-                    Contract.Assert(parts.Length == 8);
-                    RequestedAccess access = (RequestedAccess)AssertInt(parts[2]);
-                    string path = parts[7];
+                try
+                {
+                    using var stream = OpenSpillFile(spillFile);
 
-                    // ignore accesses to libDetours.so, because we injected that library
-                    if (path == DetoursLibFile)
+                    // the announcement comes from the pip: it is only trusted as far as the file backs it
+                    if (offset < 0 || length <= 0 || offset > stream.Length || length > stream.Length - offset)
                     {
+                        LogError($"Ignoring the reports process {announcement.Pid} announced in '{spillFile}': {length} bytes at offset {offset} are not in the file ({stream.Length} bytes)");
                         return;
                     }
 
-                    var report = new AccessReport
+                    long processed = ProcessSpillFile(stream, offset, length, dequeueTime);
+                    if (processed != length)
                     {
-                        Pid = (int)AssertInt(parts[1]),
-                        PipId = Process.PipId,
-                        RequestedAccess = (uint)access,
-                        Status = AssertInt(parts[3]),
-                        ExplicitLogging = AssertInt(parts[4]),
-                        Error = AssertInt(parts[5]),
-                        Operation = (FileOperation) AssertInt(parts[6]),
-                        PathOrPipStats = Encoding.GetBytes(path),
-                    };
+                        LogError($"Only {processed} of the {length} bytes process {announcement.Pid} announced in '{spillFile}' at offset {offset} are reports");
+                    }
 
-                    // update active processes
-                    if (report.Operation == FileOperation.OpProcessStart)
+                    m_spillFilePositions[spillFile] = offset + length;
+                }
+                catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+                {
+                    LogError($"Could not read the reports process {announcement.Pid} spilled to '{spillFile}': {e.Message}");
+                }
+            }
+
+            /// <summary>
+            /// Processes the reports left in spill files past those that were announced, once no more reports can arrive:
+            /// those of processes that were killed while the FIFO was full.
+            /// </summary>
+            private void ProcessUnannouncedSpilledReports()
+            {
+                foreach (string spillFile in EnumerateSpillFiles())
+                {
+                    try
                     {
-                        AddPid(report.Pid);
+                        using var stream = OpenSpillFile(spillFile);
+                        m_spillFilePositions.TryGetValue(spillFile, out long offset);
+                        if (offset >= stream.Length)
+                        {
+                            continue;
+                        }
+
+                        // the file is allocated ahead of the reports: the first zero length ends them (see ReportWriter::Append)
+                        long processed = ProcessSpillFile(stream, offset, stream.Length - offset, GetMonotonicTimeNs());
+                        if (processed > 0)
+                        {
+                            LogDebug($"Processed {processed} bytes of reports that were spilled to '{spillFile}' but not announced");
+                        }
+
+                        m_spillFilePositions[spillFile] = offset + processed;
                     }
-                    else if (report.Operation == FileOperation.OpProcessExit)
+                    catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
                     {
-                        RemovePid(report.Pid);
+                        LogError($"Could not read the reports spilled to '{spillFile}': {e.Message}");
                     }
-                    else
+                }
+            }
+
+            private static FileStream OpenSpillFile(string spillFile)
+            {
+                // the sandbox keeps writing to the file (through a mapping of it) while it is read
+                return new FileStream(spillFile, FileMode.Open, FileAccess.Read, FileShare.ReadWrite | FileShare.Delete);
+            }
+
+            /// <summary>
+            /// Processes the reports in the <paramref name="length"/> bytes of a spill file that start at <paramref name="offset"/>,
+            /// reading <see cref="SpillReadChunkSize"/> bytes at a time, and returns how many bytes of reports there were: the reports
+            /// end early at the first length prefix that is not that of a report of at most <see cref="MaxReportSize"/> bytes.
+            /// </summary>
+            private long ProcessSpillFile(FileStream stream, long offset, long length, ulong dequeueTime)
+            {
+                stream.Seek(offset, SeekOrigin.Begin);
+
+                // a chunk, after the incomplete report the previous one ended with (if any)
+                byte[] buffer = m_spillReadBuffer;
+                int pending = 0;
+                long processed = 0;
+                long remaining = length;
+                while (remaining > 0)
+                {
+                    int toRead = (int)Math.Min(remaining, SpillReadChunkSize);
+                    int read = 0;
+                    while (read < toRead)
                     {
-                        // check the path cache (only when the message is not about process tree)
-                        if (GetOrCreateCacheRecord(path).CheckCacheHitAndUpdate(access))
+                        int n = stream.Read(buffer, pending + read, toRead - read);
+                        if (n == 0)
+                        {
+                            throw new IOException($"Expected {length} bytes at offset {offset}, got {length - remaining + read}");
+                        }
+
+                        read += n;
+                    }
+
+                    remaining -= read;
+                    int available = pending + read;
+
+                    // the complete reports of the chunk
+                    int end = 0;
+                    bool endOfReports = false;
+                    while (end + sizeof(int) <= available)
+                    {
+                        // (the statistics of a process are spilled like its reports are)
+                        int reportLength = BitConverter.ToInt32(buffer, end) & ~ReportsStatistics;
+                        if (reportLength <= 0 || reportLength > MaxReportSize - sizeof(int))
+                        {
+                            endOfReports = true;
+                            break;
+                        }
+
+                        if (available - end - sizeof(int) < reportLength)
                         {
-                            LogDebug("Cache hit for access report: " + message);
-                            return;
+                            break;
                         }
+
+                        end += sizeof(int) + reportLength;
                     }
 
-                    // post the AccessReport
-                    Process.PostAccessReport(report);
+                    ProcessSpilledReports(buffer, end, dequeueTime);
+                    processed += end;
+                    if (endOfReports)
+                    {
+                        return processed;
+                    }
+
+                    pending = available - end;
+                    Array.Copy(buffer, end, buffer, 0, pending);
                 }
+
+                return processed;
             }
 
-            private uint AssertInt(string str)
+            private void ProcessSpilledReports(byte[] buffer, int length, ulong dequeueTime)
             {
-                if (uint.TryParse(str, out uint result))
+                int offset = 0;
+                while (offset < length)
                 {
-                    return result;
+                    int consumed = ParseReports(buffer, offset, length - offset, m_spilledReports, m_spilledReportsArena, out int numReports);
+                    for (int i = 0; i < numReports; i++)
+                    {
+                        ProcessReport(ref m_spilledReports[i], m_spilledReportsArena, dequeueTime);
+                    }
+
+                    offset += consumed;
+                    if (consumed == 0)
+                    {
+                        LogError($"Spilled reports end with an incomplete report ({length - offset} bytes)");
+                        break;
+                    }
+                }
+            }
+
+            private IEnumerable<string> EnumerateSpillFiles()
+            {
+                string directory = Path.GetDirectoryName(ReportsFifoPath);
+                return Directory.Exists(directory)
+                    ? Directory.EnumerateFiles(directory, SpillFileSearchPattern).OrderBy(f => f, StringComparer.Ordinal).ToList()
+                    : Enumerable.Empty<string>();
+            }
+
+            /// <summary>
+            /// Processes a report parsed by <see cref="ParseReports"/>, whose path and digest are in <paramref name="arena"/>.
+            /// </summary>
+            private void ProcessReport(ref ParsedReport parsed, byte[] arena, ulong dequeueTime)
+            {
+                if ((parsed.Flags & ParsedReportFlags.Malformed) != 0)
+                {
+                    LogError($"Could not parse access report '{Encoding.GetString(arena, parsed.PathOffset, parsed.PathLength)}'");
+                    return;
+                }
+
+                if ((parsed.Flags & ParsedReportFlags.Statistics) != 0)
+                {
+                    RecordStatistics(parsed.Pid, Encoding.GetString(arena, parsed.PathOffset, parsed.PathLength));
+                    return;
+                }
+
+                RequestedAccess access = (RequestedAccess)parsed.RequestedAccess;
+                string path = Encoding.GetString(arena, parsed.PathOffset, parsed.PathLength);
+
+                // ignore accesses to libDetours.so, because we injected that library
+                if (path == DetoursLibFile)
+                {
+                    return;
+                }
+
+                var pathBytes = new byte[parsed.PathLength];
+                Array.Copy(arena, parsed.PathOffset, pathBytes, 0, parsed.PathLength);
+
+                var report = new AccessReport
+                {
+                    Pid = (int)parsed.Pid,
+                    PipId = Process.PipId,
+                    RequestedAccess = (uint)access,
+                    Status = parsed.Status,
+                    ExplicitLogging = parsed.ReportExplicitly,
+                    Error = parsed.Error,
+                    Operation = (FileOperation)parsed.Operation,
+                    PathOrPipStats = pathBytes,
+                    Statistics = new AccessReportStatistics
+                    {
+                        CreationTime = parsed.CreationTime,
+                        EnqueueTime = parsed.EnqueueTime,
+                        DequeueTime = dequeueTime,
+                    },
+                };
+
+                if ((parsed.Flags & ParsedReportFlags.HasDigest) != 0)
+                {
+                    RecordDigest(report.Operation, path, Encoding.GetString(arena, parsed.DigestOffset, parsed.DigestLength));
+                }
+
+                // update active processes
+                if (report.Operation == FileOperation.OpProcessStart)
+                {
+                    AddPid(report.Pid);
+                }
+                else if (report.Operation == FileOperation.OpProcessExit)
+                {
+                    RemovePid(report.Pid);
+                }
+                else if (report.Operation == FileOperation.OpProcessTreeCompleted)
+                {
+                    // the last process of the pip's process tree has exited, so there is no need to wait until all the processes
+                    // we know of are found dead (see CheckActiveProcesses).  This report is not posted: OpProcessTreeCompleted
+                    // is posted once all the pending reports are processed (see CompleteAccessReportProcessing).
+                    LogDebug($"Process tree completed (last process: {report.Pid})");
+                    RequestStop();
+                    return;
                 }
                 else
                 {
-                    LogError($"Could not parse int from '{str}'");
-                    return 0;
+                    // check the path cache (only when the message is not about process tree)
+                    if (GetOrCreateCacheRecord(path).CheckCacheHitAndUpdate(access))
+                    {
+                        LogDebug($"Cache hit for access report: {report.Operation} '{path}' (pid: {report.Pid}, access: {access})");
+                        return;
+                    }
                 }
+
+                // post the AccessReport
+                Process.PostAccessReport(report);
             }
 
-            private static int Read(SafeFileHandle handle, byte[] buffer, int offset, int length)
+            private void RecordDigest(FileOperation operation, string path, string digest)
             {
-                Contract.Requires(buffer.Length >= offset + length);
-                int totalRead = 0;
-                while (totalRead < length)
+                if (operation == FileOperation.OpKAuthCloseModified && OutputContentDigest.TryParse(digest, out var contentDigest))
                 {
-                    var numRead = IO.Read(handle, buffer, offset + totalRead, length - totalRead);
-                    if (numRead <= 0)
-                    {
-                        return numRead;
-                    }
-                    totalRead += numRead;
+                    Process.RecordOutputContentDigest(path, contentDigest);
+                }
+                else
+                {
+                    LogError($"Could not parse digest from '{digest}' (operation: {operation})");
                 }
+            }
 
-                return totalRead;
+            private void RecordStatistics(uint pid, string statistics)
+            {
+                if (SandboxStatistics.TryParse(statistics, out var parsed))
+                {
+                    Process.RecordSandboxStatistics(parsed);
+                }
+                else
+                {
+                    LogError($"Could not parse the sandbox statistics of process {pid} from '{statistics}'");
+                }
             }
 
             /// <summary>
@@ -422,38 +789,28 @@ namespace BuildXL.Processes
                 // make sure that m_lazyWriteHandle has been created
                 Analysis.IgnoreResult(m_lazyWriteHandle.Value);
 
-                byte[] messageLengthBytes = new byte[sizeof(int)];
                 while (true)
                 {
-                    // read length
-                    var numRead = Read(readHandle, messageLengthBytes, 0, messageLengthBytes.Length);
+                    // read whatever was written to the FIFO so far (reports are parsed, and put back together when a
+                    // chunk ends in the middle of one, by ProcessBytes)
+                    PooledObjectWrapper<byte[]> chunk = ByteArrayPool.GetInstance(ReadChunkSize);
+                    var numRead = IO.Read(readHandle, chunk.Instance, 0, ReadChunkSize);
                     if (numRead == 0) // EOF
                     {
                         LogDebug("Exiting 'receive reports' loop.");
+                        chunk.Dispose();
                         break;
                     }
 
                     if (numRead < 0) // error
                     {
                         LogError($"Read from FIFO {ReportsFifoPath} failed with return value {numRead}");
+                        chunk.Dispose();
                         break;
                     }
 
-                    // decode length
-                    int messageLength = BitConverter.ToInt32(messageLengthBytes, startIndex: 0);
-
-                    // read a message of that length
-                    PooledObjectWrapper<byte[]> messageBytes = ByteArrayPool.GetInstance(messageLength);
-                    numRead = Read(readHandle, messageBytes.Instance, 0, messageLength);
-                    if (numRead < messageLength)
-                    {
-                        LogError($"Read from FIFO {ReportsFifoPath} failed: read only {numRead} out of {messageLength} bytes");
-                        messageBytes.Dispose();
-                        break;
-                    }
-
-                    // Add message to processing queue
-                    m_accessReportProcessingBlock.Post((messageBytes, messageLength));
+                    // Add chunk to processing queue (the time it was read is the time its reports were dequeued)
+                    m_accessReportProcessingBlock.Post((chunk, numRead, GetMonotonicTimeNs()));
                 }
 
                 CompleteAccessReportProcessing();
@@ -461,7 +818,7 @@ namespace BuildXL.Processes
         }
 
         /// <inheritdoc />
-        public SandboxKind Kind => SandboxKind.LinuxDetours;
+        public SandboxKind Kind => m_useSeccomp ? SandboxKind.LinuxSeccomp : SandboxKind.LinuxDetours;
 
         /// <inheritdoc />
         /// <remarks>Unimportant</remarks>
@@ -476,6 +833,8 @@ namespace BuildXL.Processes
 
         private readonly Sandbox.ManagedFailureCallback m_failureCallback;
 
+        private readonly bool m_useSeccomp;
+
         private static readonly Encoding Encoding = Encoding.UTF8;
 
         /// <inheritdoc />
@@ -483,10 +842,23 @@ namespace BuildXL.Processes
         public TimeSpan CurrentDrought => TimeSpan.FromSeconds(0);
 
         /// <nodoc />
-        public SandboxConnectionLinuxDetours(Sandbox.ManagedFailureCallback failureCallback = null, bool isInTestMode = false)
+        /// <param name="failureCallback">Callback invoked when the connection fails</param>
+        /// <param name="isInTestMode">Whether the connection is used by tests</param>
+        /// <param name="useSeccomp">
+        /// When true, processes are not sandboxed through LD_PRELOAD but run under the 'bxl-seccomp' supervisor
+        /// (see <see cref="GetSeccompSupervisorPath"/>), which also sees the accesses of static and non-glibc binaries.
+        /// </param>
+        public SandboxConnectionLinuxDetours(Sandbox.ManagedFailureCallback failureCallback = null, bool isInTestMode = false, bool useSeccomp = false)
         {
             m_failureCallback = failureCallback;
             IsInTestMode = isInTestMode;
+            m_useSeccomp = useSeccomp;
+
+            // reports are only parsed by libBxlUtils: without it, no access of any pip could be observed
+            if (s_parseReportsUnavailable.Value is Exception e)
+            {
+                throw new BuildXLException($"Cannot parse the reports of the Linux sandbox: 'parse_reports' could not be loaded from libBxlUtils ({e.Message})", e);
+            }
 
 #if DEBUG
             BuildXL.Native.Processes.ProcessUtilities.SetNativeConfiguration(true);
@@ -516,6 +888,158 @@ namespace BuildXL.Processes
 
         private static readonly string DetoursLibFile = EnsureDeploymentFile("libDetours.so");
         private static readonly string AuditLibFile = EnsureDeploymentFile("libBxlAudit.so");
+        private static readonly Lazy<string> SeccompSupervisorFile = new Lazy<string>(() => EnsureDeploymentFile("bxl-seccomp"));
+
+        /// <summary>
+        /// CLOCK_MONOTONIC, in nanoseconds: the clock the sandbox stamps the creation and enqueue times of its reports with.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/utils.h
+        /// </remarks>
+        [DllImport("libBxlUtils", EntryPoint = "monotonic_time_ns")]
+        private static extern ulong MonotonicTimeNs();
+
+        private static readonly Lazy<bool> s_isMonotonicTimeAvailable = new Lazy<bool>(() =>
+        {
+            try
+            {
+                MonotonicTimeNs();
+                return true;
+            }
+            catch (Exception e) when (e is DllNotFoundException || e is EntryPointNotFoundException)
+            {
+                return false;
+            }
+        });
+
+        /// <summary>
+        /// Returns the time to stamp the dequeue time of a report with, or 0 if libBxlUtils is not available
+        /// (in which case the time reports spend in the queue is not measured).
+        /// </summary>
+        internal static ulong GetMonotonicTimeNs() => s_isMonotonicTimeAvailable.Value ? MonotonicTimeNs() : 0;
+
+        /// <summary>
+        /// Flags of a <see cref="ParsedReport"/>.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/utils.h
+        /// </remarks>
+        [Flags]
+        internal enum ParsedReportFlags : uint
+        {
+            /// <nodoc />
+            None = 0,
+
+            /// <summary>The report has a digest</summary>
+            HasDigest = 0x1,
+
+            /// <summary>The report could not be parsed: its whole text is where its path would be</summary>
+            Malformed = 0x2,
+
+            /// <summary>
+            /// The report announces reports spilled to a file (see <see cref="ReportsSpillAnnouncement"/>): its path is the one of that
+            /// file, and its <see cref="ParsedReport.CreationTime"/> and <see cref="ParsedReport.EnqueueTime"/> are the offset and the
+            /// length of the reports in it
+            /// </summary>
+            Spill = 0x4,
+
+            /// <summary>
+            /// The report carries the <see cref="SandboxStatistics"/> of a process (see <see cref="ReportsStatistics"/>): only its
+            /// <see cref="ParsedReport.Pid"/> is set, and the statistics are where its path would be
+            /// </summary>
+            Statistics = 0x8,
+        }
+
+        /// <summary>
+        /// Set in the length prefix of a message that announces reports the sandbox spilled to a file while the FIFO was full.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/utils.h (REPORTS_SPILL_ANNOUNCEMENT)
+        /// </remarks>
+        internal const int ReportsSpillAnnouncement = unchecked((int)0x80000000);
+
+        /// <summary>
+        /// Set in the length prefix of a message that carries the <see cref="SandboxStatistics"/> of a process rather than an access;
+        /// a process sends it right before its exit report when <see cref="FileAccessManifest.ReportSandboxStatistics"/> is set.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/utils.h (REPORTS_STATISTICS)
+        /// </remarks>
+        internal const int ReportsStatistics = 0x40000000;
+        /// <summary>
+        /// A report parsed by <see cref="ParseReports"/>: its numeric fields, and where its path (and digest) are in the arena.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/utils.h (parsed_report)
+        /// </remarks>
+        [StructLayout(LayoutKind.Sequential)]
+        internal struct ParsedReport
+        {
+            /// <nodoc />
+            public uint Pid;
+            /// <nodoc />
+            public uint RequestedAccess;
+            /// <nodoc />
+            public uint Status;
+            /// <nodoc />
+            public uint ReportExplicitly;
+            /// <nodoc />
+            public uint Error;
+            /// <nodoc />
+            public uint Operation;
+            /// <nodoc />
+            public ulong CreationTime;
+            /// <nodoc />
+            public ulong EnqueueTime;
+            /// <nodoc />
+            public int PathOffset;
+            /// <nodoc />
+            public int PathLength;
+            /// <nodoc />
+            public int DigestOffset;
+            /// <nodoc />
+            public int DigestLength;
+            /// <nodoc />
+            public ParsedReportFlags Flags;
+            /// <nodoc />
+            public uint Reserved;
+        }
+
+        /// <summary>
+        /// Parses the length-prefixed reports in a chunk read from a reports FIFO, with a single call.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/utils.h
+        /// </remarks>
+        [DllImport("libBxlUtils", EntryPoint = "parse_reports")]
+        private static extern int ParseReportsNative(byte[] buffer, int offset, int length, [Out] ParsedReport[] reports, int maxReports, [Out] byte[] arena, int arenaSize, out int numReports, out int arenaUsed);
+
+        /// <summary>
+        /// Why <see cref="ParseReportsNative"/> cannot be called, or null if it can.
+        /// </summary>
+        private static readonly Lazy<Exception> s_parseReportsUnavailable = new Lazy<Exception>(() =>
+        {
+            try
+            {
+                ParseReportsNative(new byte[0], 0, 0, new ParsedReport[1], 1, new byte[1], 1, out _, out _);
+                return null;
+            }
+            catch (Exception e) when (e is DllNotFoundException || e is EntryPointNotFoundException)
+            {
+                return e;
+            }
+        });
+
+        /// <summary>
+        /// Parses the complete reports among the <paramref name="length"/> bytes of <paramref name="buffer"/> that start
+        /// at <paramref name="offset"/> into <paramref name="reports"/>, copying their paths and digests to <paramref name="arena"/>.
+        /// Returns how many bytes were consumed: parsing stops at an incomplete report, or when <paramref name="reports"/>
+        /// or <paramref name="arena"/> is full.
+        /// </summary>
+        internal static int ParseReports(byte[] buffer, int offset, int length, ParsedReport[] reports, byte[] arena, out int numReports)
+        {
+            return ParseReportsNative(buffer, offset, length, reports, reports.Length, arena, arena.Length, out numReports, out _);
+        }
 
         private static string EnsureDeploymentFile(string relativePath)
         {
@@ -550,17 +1074,38 @@ namespace BuildXL.Processes
                 yield return ("__BUILDXL_LOG_PATH", info.DebugLogJailPath);
             }
 
-            if (info.Process.RootJailInfo?.DisableSandboxing != true)
+            if (info.Process.RootJailInfo?.DisableSandboxing != true && !m_useSeccomp)
             {
                 yield return ("LD_PRELOAD", detoursLibPath + ":$LD_PRELOAD");
             }
 
-            if (info.Process.RootJailInfo?.DisableAuditing != true)
+            if (info.Process.RootJailInfo?.DisableAuditing != true && !m_useSeccomp)
             {
                 yield return ("LD_AUDIT", CopyToRootJailIfNeeded(info.Process.RootJail, AuditLibFile) + ":$LD_AUDIT");
             }
         }
 
+        /// <summary>
+        /// Returns the path (as seen from inside the root jail, if any) of the program the command line of pip <paramref name="pipId"/>
+        /// must be prefixed with when <see cref="Kind"/> is <see cref="SandboxKind.LinuxSeccomp"/>; null otherwise.
+        /// </summary>
+        public string GetSeccompSupervisorPath(long pipId)
+        {
+            if (!m_useSeccomp)
+            {
+                return null;
+            }
+
+            if (!m_pipProcesses.TryGetValue(pipId, out var info))
+            {
+                throw new BuildXLException($"No info found for pip id {pipId}");
+            }
+
+            return info.Process.RootJailInfo?.DisableSandboxing == true
+                ? null
+                : CopyToRootJailIfNeeded(info.Process.RootJail, SeccompSupervisorFile.Value);
+        }
+
         private static string CopyToRootJailIfNeeded(string rootJailDir, string file)
         {
             if (rootJailDir == null)
@@ -583,10 +1128,11 @@ namespace BuildXL.Processes
             string fifoPath = Path.Combine(rootDir, $"bxl_Pip{process.PipSemiStableHash:X}.{process.ProcessId}.fifo");
             string famPath = Path.ChangeExtension(fifoPath, ".fam");
             string debugLogPath = null;
-            if (IsInTestMode)
+            if (IsInTestMode || process.IsSandboxLogRequested)
             {
                 debugLogPath = process.ToPathInsideRootJail(Path.ChangeExtension(fifoPath, ".log"));
                 fam.AddPath(toAbsPath(debugLogPath), mask: FileAccessPolicy.MaskAll, values: FileAccessPolicy.AllowAll);
+                process.LogDebug($"Sandbox log: '{debugLogPath}'");
             }
 
             // serialize FAM
@@ -0,0 +1,272 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Linq;
+using System.Text;
+using static BuildXL.Interop.Unix.Sandbox;
+
+namespace BuildXL.Processes
+{
+    /// <summary>
+    /// Statistics about where the Linux sandbox spent its time, aggregated over the processes of a pip.
+    /// </summary>
+    /// <remarks>
+    /// Every sandboxed process sends its own statistics, in a message of their own right before its exit report, when
+    /// <see cref="FileAccessManifest.ReportSandboxStatistics"/> is set; see <see cref="TryParse"/> for the format.
+    /// Times are measured with a cycle counter and converted to nanoseconds using the frequency estimated by each process.
+    ///
+    /// CODESYNC: Public/Src/Sandbox/Linux/bxl_stats.hpp
+    /// </remarks>
+    public sealed class SandboxStatistics
+    {
+        /// <summary>
+        /// Number of log2 buckets of <see cref="HookStatistics.Histogram"/>.
+        /// </summary>
+        public const int NumBuckets = 40;
+
+        /// <summary>
+        /// Statistics about the calls to one interposed function.
+        /// </summary>
+        public sealed class HookStatistics
+        {
+            /// <summary>Number of calls.</summary>
+            public long Calls { get; internal set; }
+
+            /// <summary>Total time spent inside the sandbox (i.e., excluding the forwarded real call).</summary>
+            public long TotalNanoseconds { get; internal set; }
+
+            /// <summary>
+            /// Bucket i counts the calls that spent [2^i, 2^(i+1)) nanoseconds inside the sandbox (bucket 0 also counts the faster ones).
+            /// </summary>
+            /// <remarks>
+            /// Approximate: the sandbox buckets calls by ticks, and the lower bound of each of those buckets determines its nanosecond bucket.
+            /// </remarks>
+            public long[] Histogram { get; } = new long[NumBuckets];
+
+            /// <summary>
+            /// Returns the upper bound (in nanoseconds) of the histogram bucket that holds the given percentile (between 0 and 100) of the calls.
+            /// </summary>
+            public long GetPercentileUpperBoundNs(double percentile)
+            {
+                long target = (long)Math.Ceiling(Calls * percentile / 100);
+                long seen = 0;
+                for (int i = 0; i < NumBuckets; i++)
+                {
+                    seen += Histogram[i];
+                    if (seen >= target && seen > 0)
+                    {
+                        return 1L << (i + 1);
+                    }
+                }
+
+                return 0;
+            }
+
+            internal void Record(long nanoseconds)
+            {
+                Calls++;
+                TotalNanoseconds += nanoseconds;
+                int bucket = 0;
+                while (bucket < NumBuckets - 1 && (nanoseconds >> (bucket + 1)) > 0)
+                {
+                    bucket++;
+                }
+
+                Histogram[bucket]++;
+            }
+
+            internal void Merge(HookStatistics other)
+            {
+                Calls += other.Calls;
+                TotalNanoseconds += other.TotalNanoseconds;
+                for (int i = 0; i < NumBuckets; i++)
+                {
+                    Histogram[i] += other.Histogram[i];
+                }
+            }
+        }
+
+        private readonly Dictionary<string, HookStatistics> m_hooks = new Dictionary<string, HookStatistics>();
+
+        /// <summary>Number of processes whose statistics were aggregated.</summary>
+        public int NumProcesses { get; private set; }
+
+        /// <summary>Accesses that were not reported because the same access had already been reported by the same process.</summary>
+        public long CacheHits { get; private set; }
+
+        /// <summary>Accesses looked up in the cache of the sandbox and not found there.</summary>
+        public long CacheMisses { get; private set; }
+
+        /// <summary>Number of reports sent by the sandbox.</summary>
+        public long NumReports { get; private set; }
+
+        /// <summary>Total size of the reports sent by the sandbox.</summary>
+        public long ReportBytes { get; private set; }
+
+        /// <summary>Number of the reports that were spilled to a file because the reports FIFO was full (included in <see cref="NumReports"/>).</summary>
+        public long SpilledReports { get; private set; }
+
+        /// <summary>Total size of the spilled reports.</summary>
+        public long SpilledBytes { get; private set; }
+
+        /// <summary>Statistics of the interposed functions that were called, keyed by function name.</summary>
+        public IReadOnlyDictionary<string, HookStatistics> Hooks => m_hooks;
+
+        /// <summary>
+        /// Time the reports of the sandbox took from their creation (when the sandbox started checking the access they report)
+        /// until the engine read them.
+        /// </summary>
+        /// <remarks>
+        /// Unlike the other statistics, recorded by the engine for every report that carries its timestamps (see <see cref="RecordReportLatency"/>),
+        /// regardless of <see cref="FileAccessManifest.ReportSandboxStatistics"/>.
+        /// </remarks>
+        public HookStatistics ReportLatency { get; } = new HookStatistics();
+
+        /// <summary>
+        /// Parses the statistics of a single process, in the format sent by the sandbox:
+        /// "&lt;ticks per us&gt;;&lt;cache hits&gt;;&lt;cache misses&gt;;&lt;reports&gt;;&lt;report bytes&gt;;&lt;spilled reports&gt;;&lt;spilled bytes&gt;" followed by zero or more
+        /// ";&lt;function&gt;:&lt;calls&gt;:&lt;ticks&gt;:&lt;first bucket&gt;:&lt;count&gt;,&lt;count&gt;,..." entries.
+        /// </summary>
+        public static bool TryParse(string str, out SandboxStatistics statistics)
+        {
+            statistics = null;
+            string[] parts = str?.Split(';');
+            if (parts == null || parts.Length < 7
+                || !TryParseLong(parts[0], out long ticksPerUs) || ticksPerUs <= 0
+                || !TryParseLong(parts[1], out long cacheHits)
+                || !TryParseLong(parts[2], out long cacheMisses)
+                || !TryParseLong(parts[3], out long numReports)
+                || !TryParseLong(parts[4], out long reportBytes)
+                || !TryParseLong(parts[5], out long spilledReports)
+                || !TryParseLong(parts[6], out long spilledBytes))
+            {
+                return false;
+            }
+
+            var result = new SandboxStatistics
+            {
+                NumProcesses = 1,
+                CacheHits = cacheHits,
+                CacheMisses = cacheMisses,
+                NumReports = numReports,
+                ReportBytes = reportBytes,
+                SpilledReports = spilledReports,
+                SpilledBytes = spilledBytes,
+            };
+
+            for (int i = 7; i < parts.Length; i++)
+            {
+                string[] fields = parts[i].Split(':');
+                if (fields.Length != 5
+                    || fields[0].Length == 0
+                    || !TryParseLong(fields[1], out long calls)
+                    || !TryParseLong(fields[2], out long ticks)
+                    || !int.TryParse(fields[3], NumberStyles.None, CultureInfo.InvariantCulture, out int firstBucket))
+                {
+                    return false;
+                }
+
+                var hook = new HookStatistics
+                {
+                    Calls = calls,
+                    TotalNanoseconds = ticks * 1000 / ticksPerUs,
+                };
+
+                string[] counts = fields[4].Split(',');
+                for (int j = 0; j < counts.Length; j++)
+                {
+                    if (!TryParseLong(counts[j], out long count))
+                    {
+                        return false;
+                    }
+
+                    hook.Histogram[ToNanosecondBucket(firstBucket + j, ticksPerUs)] += count;
+                }
+
+                result.AddHook(fields[0], hook);
+            }
+
+            statistics = result;
+            return true;
+        }
+
+        /// <summary>
+        /// Records the latency of a report whose timestamps are given in <paramref name="statistics"/>; reports with missing
+        /// or inconsistent timestamps are ignored.
+        /// </summary>
+        public void RecordReportLatency(AccessReportStatistics statistics)
+        {
+            if (statistics.CreationTime != 0 && statistics.DequeueTime >= statistics.CreationTime)
+            {
+                ReportLatency.Record((long)(statistics.DequeueTime - statistics.CreationTime));
+            }
+        }
+
+        /// <summary>
+        /// Adds the statistics of <paramref name="other"/> to these ones.
+        /// </summary>
+        public void Merge(SandboxStatistics other)
+        {
+            NumProcesses += other.NumProcesses;
+            CacheHits += other.CacheHits;
+            CacheMisses += other.CacheMisses;
+            NumReports += other.NumReports;
+            ReportBytes += other.ReportBytes;
+            SpilledReports += other.SpilledReports;
+            SpilledBytes += other.SpilledBytes;
+            ReportLatency.Merge(other.ReportLatency);
+            foreach (var kvp in other.m_hooks)
+            {
+                AddHook(kvp.Key, kvp.Value);
+            }
+        }
+
+        /// <inheritdoc />
+        public override string ToString()
+        {
+            var sb = new StringBuilder();
+            sb.Append(FormattableString.Invariant($"Processes: {NumProcesses}, cache hits: {CacheHits}, cache misses: {CacheMisses}, reports: {NumReports} ({ReportBytes} bytes)"));
+            if (SpilledReports > 0)
+            {
+                sb.Append(FormattableString.Invariant($", spilled reports: {SpilledReports} ({SpilledBytes} bytes)"));
+            }
+
+            if (ReportLatency.Calls > 0)
+            {
+                sb.Append(FormattableString.Invariant(
+                    $", report latency: avg {ReportLatency.TotalNanoseconds / ReportLatency.Calls / 1000}us, p50 < {ReportLatency.GetPercentileUpperBoundNs(50) / 1000}us, p99 < {ReportLatency.GetPercentileUpperBoundNs(99) / 1000}us"));
+            }
+
+            foreach (var kvp in m_hooks.OrderByDescending(kvp => kvp.Value.TotalNanoseconds))
+            {
+                var hook = kvp.Value;
+                sb.Append(FormattableString.Invariant(
+                    $"; {kvp.Key}: {hook.Calls} calls, {hook.TotalNanoseconds / 1000}us, p50 < {hook.GetPercentileUpperBoundNs(50)}ns, p99 < {hook.GetPercentileUpperBoundNs(99)}ns"));
+            }
+
+            return sb.ToString();
+        }
+
+        private void AddHook(string name, HookStatistics hook)
+        {
+            if (!m_hooks.TryGetValue(name, out var existing))
+            {
+                existing = new HookStatistics();
+                m_hooks.Add(name, existing);
+            }
+
+            existing.Merge(hook);
+        }
+
+        private static int ToNanosecondBucket(int tickBucket, long ticksPerUs)
+        {
+            double lowerBoundNs = Math.Pow(2, tickBucket) * 1000 / ticksPerUs;
+            return lowerBoundNs < 2 ? 0 : Math.Min(NumBuckets - 1, (int)Math.Floor(Math.Log(lowerBoundNs, 2)));
+        }
+
+        private static bool TryParseLong(string str, out long value) => long.TryParse(str, NumberStyles.None, CultureInfo.InvariantCulture, out value);
+    }
+}
@@ -324,6 +324,16 @@ namespace BuildXL.Processes
         /// </summary>
         public long SuspendedDurationMs { get; set; }
 
+        /// <summary>
+        /// Content digests the sandbox computed for output files when they were closed, keyed by output path.
+        /// </summary>
+        /// <remarks>
+        /// Only populated on Linux when <see cref="BuildXL.Utilities.Configuration.ISandboxConfiguration.HashOutputsOnClose"/> is set.
+        /// A digest may be used as the content hash of its output only as long as <see cref="OutputContentDigest.IsValidFor"/> holds for that output,
+        /// and only once the engine checked it against the output: any process of the pip can write reports.
+        /// </remarks>
+        public IReadOnlyDictionary<AbsolutePath, OutputContentDigest> OutputContentDigests { get; set; }
+
         private bool ProcessCompletedExecution(SandboxedProcessPipExecutionStatus status) =>
             status != SandboxedProcessPipExecutionStatus.PreparationFailed && 
             status != SandboxedProcessPipExecutionStatus.Canceled &&
@@ -144,6 +144,11 @@ namespace BuildXL.Processes
 
         private readonly FileAccessPolicy m_excludeReportAccessMask;
 
+        /// <summary>
+        /// Added to the policy of outputs, so that the sandbox hashes them when they are closed (see <see cref="ISandboxConfiguration.HashOutputsOnClose"/>).
+        /// </summary>
+        private readonly FileAccessPolicy m_outputContentHashPolicy;
+
         private readonly SemanticPathExpander m_semanticPathExpander;
 
         private readonly ISandboxedProcessLogger m_logger;
@@ -327,6 +332,7 @@ namespace BuildXL.Processes
                     ProbeDirectorySymlinkAsDirectory = m_sandboxConfig.UnsafeSandboxConfiguration.ProbeDirectorySymlinkAsDirectory,
                     SubstituteProcessExecutionInfo = shimInfo,
                     ExplicitlyReportDirectoryProbes = m_sandboxConfig.ExplicitlyReportDirectoryProbes,
+                    ReportSandboxStatistics = m_sandboxConfig.ReportSandboxStatistics,
                 };
 
             if (!MonitorFileAccesses)
@@ -372,6 +378,11 @@ namespace BuildXL.Processes
                 m_excludeReportAccessMask |= FileAccessPolicy.ReportDirectoryEnumerationAccess;
             }
 
+            // Only the Linux sandbox hashes outputs
+            m_outputContentHashPolicy = m_sandboxConfig.HashOutputsOnClose && OperatingSystemHelper.IsLinuxOS
+                ? FileAccessPolicy.ReportContentHashOnClose
+                : FileAccessPolicy.Deny;
+
             m_buildEngineDirectory = buildEngineDirectory;
             m_validateDistribution = configuration.Distribution.ValidateDistribution;
             m_directoryArtifactContext = directoryArtifactContext;
@@ -2081,7 +2092,29 @@ namespace BuildXL.Processes
                 timedOut: result.TimedOut,
                 hasAzureWatsonDeadProcess: azWatsonDeadProcess != null,
                 retryInfo: retryInfo,
-                createdDirectories: createdDirectories);
+                createdDirectories: createdDirectories)
+            {
+                OutputContentDigests = GetOutputContentDigests(result),
+            };
+        }
+
+        private IReadOnlyDictionary<AbsolutePath, OutputContentDigest> GetOutputContentDigests(SandboxedProcessResult result)
+        {
+            if (result.OutputContentDigests == null || result.OutputContentDigests.Count == 0)
+            {
+                return null;
+            }
+
+            var digests = new Dictionary<AbsolutePath, OutputContentDigest>(result.OutputContentDigests.Count);
+            foreach (var digest in result.OutputContentDigests)
+            {
+                if (AbsolutePath.TryCreate(m_pathTable, digest.Key, out AbsolutePath path))
+                {
+                    digests[path] = digest.Value;
+                }
+            }
+
+            return digests;
         }
 
         private async Task<(bool Success, Dictionary<string, int> PipProperties)> TrySetPipPropertiesAsync(SandboxedProcessResult result)
@@ -2398,7 +2431,7 @@ namespace BuildXL.Processes
                             // We allow the real input timestamps to be seen since if any of these outputs are rewritten, we should block input timestamp faking in favor of output timestamp faking
                             m_fileAccessManifest.AddPath(
                                 output.Path,
-                                values: FileAccessPolicy.AllowAll | FileAccessPolicy.ReportAccess | FileAccessPolicy.AllowRealInputTimestamps, // Always report output file accesses, so we can validate that output was produced.
+                                values: FileAccessPolicy.AllowAll | FileAccessPolicy.ReportAccess | FileAccessPolicy.AllowRealInputTimestamps | m_outputContentHashPolicy, // Always report output file accesses, so we can validate that output was produced.
                                 mask: m_excludeReportAccessMask);
                             outputFiles.Add(output.Path);
 
@@ -2502,7 +2535,8 @@ namespace BuildXL.Processes
                             // TODO: considering configuring this policy for all shared opaques, and not only when AllowedUndeclaredSourceReads is set. The case of a write on an undeclared
                             // input is more likely to happen when undeclared sources are allowed, but also possible otherwise. For now, this is just a conservative way to try this feature
                             // out for a subset of our scenarios.
-                            (m_pip.AllowUndeclaredSourceReads && directory.IsSharedOpaque ? FileAccessPolicy.OverrideAllowWriteForExistingFiles : FileAccessPolicy.Deny);
+                            (m_pip.AllowUndeclaredSourceReads && directory.IsSharedOpaque ? FileAccessPolicy.OverrideAllowWriteForExistingFiles : FileAccessPolicy.Deny) |
+                            (isUnderAnExclusion ? FileAccessPolicy.Deny : m_outputContentHashPolicy);
 
                         // For exclusive opaques, we don't need reporting back and the content is discovered by enumerating the disk
                         var mask = directory.IsSharedOpaque ? FileAccessPolicy.MaskNothing : m_excludeReportAccessMask;
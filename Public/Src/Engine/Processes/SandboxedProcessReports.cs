@@ -114,6 +114,15 @@ namespace BuildXL.Processes
         /// </summary>
         public Failure<string> MessageProcessingFailure { get; internal set; }
 
+        /// <summary>
+        /// Whether the sandbox already applied the directory translations of the manifest to the reported paths, in which case
+        /// they are not translated again here. The Linux sandbox translates every path it reports.
+        /// </summary>
+        /// <remarks>
+        /// CODESYNC: Public/Src/Sandbox/Linux/bxl_observer.cpp (BxlObserver::SendReport)
+        /// </remarks>
+        public bool PathsTranslatedBySandbox { get; internal set; }
+
         public SandboxedProcessReports(
             FileAccessManifest manifest,
             PathTable pathTable,
@@ -701,6 +710,8 @@ namespace BuildXL.Processes
                 path = path.Replace("/\\r", "\r").Replace("/\\n", "\n");
             }
 
+            var directoryTranslator = PathsTranslatedBySandbox ? null : m_manifest.DirectoryTranslator;
+
             // If there is a listener registered and notifications allowed, notify over the interface.
             if (m_detoursEventListener != null && (m_detoursEventListener.GetMessageHandlingFlags() & MessageHandlingFlags.FileAccessNotify) != 0)
             {
@@ -721,7 +732,7 @@ namespace BuildXL.Processes
                     CreationDisposition = creationDisposition,
                     FlagsAndAttributes = flagsAndAttributes,
                     OpenedFileOrDirectoryAttributes = openedFileOrDirectoryAttributes,
-                    Path = m_manifest.DirectoryTranslator?.Translate(path) ?? path,
+                    Path = directoryTranslator?.Translate(path) ?? path,
                     ProcessArgs = processArgs,
                     IsAnAugmentedFileAccess = isAnAugmentedFileAccess
                 });
@@ -733,9 +744,9 @@ namespace BuildXL.Processes
                 return true;
             }
 
-            if (m_manifest.DirectoryTranslator != null)
+            if (directoryTranslator != null)
             {
-                path = m_manifest.DirectoryTranslator.Translate(path);
+                path = directoryTranslator.Translate(path);
             }
 
             // If we are getting a message for ChangedReadWriteToReadAccess operation,
@@ -152,6 +152,14 @@ namespace BuildXL.Processes
         /// </remarks>
         public string DiagnosticMessage { get; set; }
 
+        /// <summary>
+        /// Content digests of output files computed by the sandbox when those files were closed, keyed by path (Linux only).
+        /// </summary>
+        /// <remarks>
+        /// Not serialized: the outputs of processes executed externally are hashed by the engine.
+        /// </remarks>
+        public IReadOnlyDictionary<string, OutputContentDigest> OutputContentDigests { get; set; }
+
         /// <summary>
         /// Serializes this instance to a given <paramref name="stream"/>.
         /// </summary>
@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 using System;
+using System.Collections.Concurrent;
 using System.Collections.Generic;
 using System.Diagnostics.ContractsLight;
 using System.IO;
@@ -39,10 +40,14 @@ namespace BuildXL.Processes
 
         private readonly Dictionary<string, Process.ProcessResourceUsage> m_processResourceUsage = null;
 
+        private readonly ConcurrentDictionary<string, OutputContentDigest> m_outputContentDigests = new ConcurrentDictionary<string, OutputContentDigest>();
+
         private IEnumerable<ReportedProcess> m_survivingChildProcesses = null;
 
         private PipKextStats? m_pipKextStats = null;
 
+        private readonly SandboxStatistics m_sandboxStatistics = new SandboxStatistics();
+
         private long m_processKilledFlag = 0;
 
         private ulong m_processExitTimeNs = ulong.MaxValue;
@@ -114,6 +119,21 @@ namespace BuildXL.Processes
         /// </summary>
         internal string RootJail => RootJailInfo?.RootJail;
 
+        /// <summary>
+        /// Name of the environment variable that sets the level of the debug log of the Linux sandbox.
+        /// </summary>
+        /// <remarks>
+        /// Setting it in the environment of a pip turns that log on for that pip (it is always on in test mode);
+        /// __BUILDXL_LOG_HOOKS can further restrict it to some interposed functions.
+        /// CODESYNC: Public/Src/Sandbox/Linux/bxl_log.hpp
+        /// </remarks>
+        internal const string SandboxLogLevelEnvVar = "__BUILDXL_LOG_LEVEL";
+
+        /// <summary>
+        /// Whether the environment of the pip asks for the debug log of the sandbox (see <see cref="SandboxLogLevelEnvVar"/>).
+        /// </summary>
+        internal bool IsSandboxLogRequested { get; }
+
         private const double NanosecondsToMillisecondsFactor = 1000000d;
 
         /// <summary>
@@ -157,6 +177,7 @@ namespace BuildXL.Processes
             ReportQueueProcessTimeoutForTests = info.ReportQueueProcessTimeoutForTests;
             IgnoreReportedAccesses = ignoreReportedAccesses;
             RootJailInfo = info.RootJailInfo;
+            IsSandboxLogRequested = info.EnvironmentVariables?.ContainsKey(SandboxLogLevelEnvVar) == true;
 
             if (info.MonitoringConfig is not null && info.MonitoringConfig.MonitoringEnabled)
             {
@@ -175,7 +196,10 @@ namespace BuildXL.Processes
                 info.LoggingContext,
                 info.DetoursEventListener,
                 info.SidebandWriter,
-                info.FileSystemView);
+                info.FileSystemView)
+            {
+                PathsTranslatedBySandbox = info.SandboxConnection is SandboxConnectionLinuxDetours,
+            };
 
             var useSingleProducer = !(SandboxConnection.Kind == SandboxKind.MacOsHybrid || SandboxConnection.Kind == SandboxKind.MacOsDetours);
 
@@ -390,6 +414,12 @@ namespace BuildXL.Processes
                 LogProcessState($"Process Kext Stats: {statsJson}");
             }
 
+            var sandboxStatistics = SandboxStatistics;
+            if (sandboxStatistics.NumProcesses > 0 || sandboxStatistics.ReportLatency.Calls > 0)
+            {
+                LogProcessState($"Process Sandbox Stats: {sandboxStatistics}");
+            }
+
             base.Dispose();
         }
 
@@ -442,6 +472,56 @@ namespace BuildXL.Processes
             m_pendingReports.Post(report);
         }
 
+        /// <summary>
+        /// Content digests of output files computed by the sandbox when those files were closed, keyed by path.
+        /// </summary>
+        /// <remarks>
+        /// Only populated for paths whose policy includes <see cref="FileAccessPolicy.ReportContentHashOnClose"/>.
+        /// When a file is closed multiple times, the last received digest wins.
+        /// </remarks>
+        public IReadOnlyDictionary<string, OutputContentDigest> OutputContentDigests => m_outputContentDigests;
+
+        /// <summary>
+        /// Records the content digest the sandbox computed for <paramref name="path"/> when it was closed.
+        /// </summary>
+        internal void RecordOutputContentDigest(string path, OutputContentDigest digest)
+        {
+            m_outputContentDigests[path] = digest;
+        }
+
+        /// <inheritdoc />
+        protected override IReadOnlyDictionary<string, OutputContentDigest> GetOutputContentDigests() => m_outputContentDigests;
+
+        /// <summary>
+        /// Statistics of the sandbox, aggregated over the processes of the process tree that have exited so far.
+        /// </summary>
+        /// <remarks>
+        /// Except for <see cref="SandboxStatistics.ReportLatency"/>, only populated when <see cref="FileAccessManifest.ReportSandboxStatistics"/> is set.
+        /// </remarks>
+        public SandboxStatistics SandboxStatistics
+        {
+            get
+            {
+                lock (m_sandboxStatistics)
+                {
+                    var copy = new SandboxStatistics();
+                    copy.Merge(m_sandboxStatistics);
+                    return copy;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Adds the statistics the sandbox collected in one process to the statistics of the process tree.
+        /// </summary>
+        internal void RecordSandboxStatistics(SandboxStatistics statistics)
+        {
+            lock (m_sandboxStatistics)
+            {
+                m_sandboxStatistics.Merge(statistics);
+            }
+        }
+
         private static string EnsureQuoted(string cmdLineArgs)
         {
 #if NET_CORE
@@ -511,6 +591,15 @@ namespace BuildXL.Processes
                 lines.Add($"export {envKvp.Item1}={envKvp.Item2}");
             }
 
+            if (info.SandboxConnection is SandboxConnectionLinuxDetours linuxConnection)
+            {
+                var supervisorPath = linuxConnection.GetSeccompSupervisorPath(info.FileAccessManifest.PipId);
+                if (supervisorPath != null)
+                {
+                    cmdLine = $"{CommandLineEscaping.EscapeAsCommandLineWord(supervisorPath)} {cmdLine}";
+                }
+            }
+
             lines.Add($"exec {cmdLine}");
             if (info.RootJailInfo != null)
             {
@@ -692,7 +781,15 @@ namespace BuildXL.Processes
         private void UpdateAverageTimeSpentInReportQueue(AccessReportStatistics stats)
         {
             m_sumOfReportCreationTimesUs += (stats.EnqueueTime - stats.CreationTime) / 1000;
-            m_sumOfReportQueueTimesUs += (stats.DequeueTime - stats.EnqueueTime) / 1000;
+            if (stats.DequeueTime >= stats.EnqueueTime)
+            {
+                m_sumOfReportQueueTimesUs += (stats.DequeueTime - stats.EnqueueTime) / 1000;
+            }
+
+            lock (m_sandboxStatistics)
+            {
+                m_sandboxStatistics.RecordReportLatency(stats);
+            }
         }
 
         /// <summary>
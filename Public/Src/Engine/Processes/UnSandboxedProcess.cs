@@ -288,7 +288,8 @@ namespace BuildXL.Processes
                 DumpCreationException               = m_dumpCreationException,
                 DumpFileDirectory                   = TimeoutDumpDirectory,
                 PrimaryProcessTimes                 = GetProcessTimes(),
-                SurvivingChildProcesses             = CoalesceProcesses(GetSurvivingChildProcesses())
+                SurvivingChildProcesses             = CoalesceProcesses(GetSurvivingChildProcesses()),
+                OutputContentDigests                = GetOutputContentDigests()
             };
         }
 
@@ -408,6 +409,11 @@ namespace BuildXL.Processes
         /// </summary>
         protected virtual IEnumerable<ReportedProcess> GetSurvivingChildProcesses() => null;
 
+        /// <summary>
+        /// Content digests of output files computed by the sandbox (if any), keyed by path.
+        /// </summary>
+        protected virtual IReadOnlyDictionary<string, OutputContentDigest> GetOutputContentDigests() => null;
+
         /// <summary>
         /// Returns any collected sandboxed process reports or null.
         /// </summary>
@@ -1534,7 +1534,8 @@ namespace BuildXL.Scheduler
                             processExecutionResult,
                             enableCaching: !skipCaching,
                             fingerprintComputation: fingerprintComputation,
-                            executionResult.ContainerConfiguration);
+                            executionResult.ContainerConfiguration,
+                            executionResult.OutputContentDigests);
                         LogSubPhaseDuration(operationContext, pip, SandboxedProcessCounters.PipExecutorPhaseStoringCacheContent, DateTime.UtcNow.Subtract(start));
                     }
 
@@ -4352,6 +4353,7 @@ namespace BuildXL.Scheduler
         /// <param name="enableCaching">If set, the pip's descriptor and content will be stored to the cache. Otherwise, its outputs will be hashed but not stored or referenced by a new descriptor.</param>
         /// <param name="fingerprintComputation">Stores fingerprint computation information</param>
         /// <param name="containerConfiguration">The configuration used to run the process in a container, if that option was specified</param>
+        /// <param name="outputContentDigests">The digests of the outputs the sandbox hashed when they were closed, if any</param>
         private static async Task<bool> StoreContentForProcessAndCreateCacheEntryAsync(
             OperationContext operationContext,
             IPipExecutionEnvironment environment,
@@ -4365,7 +4367,8 @@ namespace BuildXL.Scheduler
             ExecutionResult processExecutionResult,
             bool enableCaching,
             BoxRef<ProcessFingerprintComputationEventData> fingerprintComputation,
-            ContainerConfiguration containerConfiguration)
+            ContainerConfiguration containerConfiguration,
+            IReadOnlyDictionary<AbsolutePath, OutputContentDigest> outputContentDigests = null)
         {
             Contract.Requires(environment != null);
             Contract.Requires(process != null);
@@ -4590,7 +4593,8 @@ namespace BuildXL.Scheduler
                                                         process,
                                                         dataToStore.artifact,
                                                         dataToStore.data,
-                                                        isProcessCacheable: true);
+                                                        isProcessCacheable: true,
+                                                        outputContentDigests: outputContentDigests);
 
                                 // Observe it is fine to store this in a lock-free manner since we make sure same indexes are not updated concurrently
                                 materializationResults[dataToStore.index] = result;
@@ -4833,7 +4837,8 @@ namespace BuildXL.Scheduler
             Process process,
             FileArtifactWithAttributes output,
             FileOutputData outputData,
-            bool isProcessCacheable)
+            bool isProcessCacheable,
+            IReadOnlyDictionary<AbsolutePath, OutputContentDigest> outputContentDigests = null)
         {
             Contract.Assert(output.CanBeReferencedOrCached());
 
@@ -4895,6 +4900,12 @@ namespace BuildXL.Scheduler
                     && ((environment.Configuration.Schedule.StoreOutputsToCache && !shouldOutputBePreserved) || isRewrittenOutputFile)
                     && !isReparsePoint;
 
+                // The cache hashes the outputs it stores itself, and must not be handed a hash it did not compute or check:
+                // a hash from the sandbox is only used, once checked, for outputs that are just tracked
+                ContentHash? knownContentHash = shouldStoreOutputToCache || isReparsePoint
+                    ? null
+                    : await TryGetVerifiedContentHashFromSandboxAsync(environment, outputArtifact, outputContentDigests);
+
                 Possible<TrackedFileContentInfo> possiblyStoredOutputArtifact = shouldStoreOutputToCache
                     ? await StoreProcessOutputToCacheAsync(operationContext, environment, process, outputArtifact, output.IsUndeclaredFileRewrite, isReparsePoint, isProcessCacheable: isProcessCacheable)
                     : await TrackPipOutputAsync(
@@ -4905,7 +4916,8 @@ namespace BuildXL.Scheduler
                         createHandleWithSequentialScan: environment.ShouldCreateHandleWithSequentialScan(outputArtifact),
                         isReparsePoint: isReparsePoint,
                         shouldOutputBePreserved: shouldOutputBePreserved,
-                        isUndeclaredFileRewrite: output.IsUndeclaredFileRewrite);
+                        isUndeclaredFileRewrite: output.IsUndeclaredFileRewrite,
+                        knownContentHash: knownContentHash);
 
                 if (!possiblyStoredOutputArtifact.Succeeded)
                 {
@@ -4920,6 +4932,56 @@ namespace BuildXL.Scheduler
             return outputArtifactInfo;
         }
 
+        /// <summary>
+        /// Returns the content hash the sandbox computed for the output when it was closed (see <see cref="ISandboxConfiguration.HashOutputsOnClose"/>),
+        /// once the engine checked that it is the hash of the output, or null if there is none, or if it is not a hash of the type the engine uses,
+        /// or if the file changed since it was hashed, or if it is not the hash of the output.
+        /// </summary>
+        /// <remarks>
+        /// Any process of the pip can write reports, so a digest is only a claim of the pip about its output: used as it is, a pip could have
+        /// the engine record an output under the hash of other content. The engine hashes the output itself before using a digest.
+        /// </remarks>
+        private static async Task<ContentHash?> TryGetVerifiedContentHashFromSandboxAsync(
+            IPipExecutionEnvironment environment,
+            FileArtifact output,
+            IReadOnlyDictionary<AbsolutePath, OutputContentDigest> outputContentDigests)
+        {
+            if (outputContentDigests == null
+                || ContentHashingUtilities.HashInfo.HashType != HashType.Vso0
+                || !outputContentDigests.TryGetValue(output.Path, out var digest))
+            {
+                return null;
+            }
+
+            string path = output.Path.ToString(environment.Context.PathTable);
+            var statBuffer = new BuildXL.Interop.Unix.IO.StatBuffer();
+            if (BuildXL.Interop.Unix.IO.StatFile(path, followSymlink: false, ref statBuffer) != 0
+                || !digest.IsValidFor(statBuffer.Size, statBuffer.TimeLastModification, statBuffer.TimeNSecLastModification))
+            {
+                return null;
+            }
+
+            ContentHash hash;
+            try
+            {
+                hash = await ContentHashingUtilities.HashFileAsync(path);
+            }
+            catch (BuildXLException)
+            {
+                // Tracking the output reports the failure
+                return null;
+            }
+
+            if (hash != BlobIdentifier.CreateFromAlgorithmResult(digest.Hash).ToContentHash())
+            {
+                environment.Counters.IncrementCounter(PipExecutorCounter.OutputContentHashesFromSandboxRejected);
+                return null;
+            }
+
+            environment.Counters.IncrementCounter(PipExecutorCounter.OutputContentHashesFromSandbox);
+            return hash;
+        }
+
         private static bool IsProcessPreservingOutputs(IPipExecutionEnvironment environment, Process process)
         {
             Contract.Requires(environment != null);
@@ -5349,7 +5411,8 @@ namespace BuildXL.Scheduler
             bool createHandleWithSequentialScan = false,
             bool isReparsePoint = false,
             bool shouldOutputBePreserved = false,
-            bool isUndeclaredFileRewrite = false)
+            bool isUndeclaredFileRewrite = false,
+            ContentHash? knownContentHash = null)
         {
             Contract.Requires(environment != null);
             Contract.Requires(outputFileArtifact.IsOutputFile);
@@ -5361,6 +5424,7 @@ namespace BuildXL.Scheduler
             var possiblyTracked = await environment.LocalDiskContentStore.TryTrackAsync(
                 outputFileArtifact,
                 tryFlushPageCacheToFileSystem: environment.Configuration.Sandbox.FlushPageCacheToFileSystemOnStoringOutputsToCache,
+                knownContentHash: knownContentHash,
                 // In tracking file, LocalDiskContentStore will call TryDiscoverAsync to compute the content hash of the file.
                 // TryDiscoverAsync uses FileContentTable to avoid re-hashing the file if the hash is already in the FileContentTable.
                 // Moreover, FileContentTable can enable so-called path mapping optimization that allows one to avoid opening handles and by-passing checking
@@ -319,6 +319,16 @@ namespace BuildXL.Scheduler
         [CounterType(CounterType.Stopwatch)]
         ProcessOutputsStoreContentForProcessAndCreateCacheEntryDuration,
 
+        /// <summary>
+        /// The number of outputs whose content hash, computed by the sandbox when they were closed, the engine confirmed and used.
+        /// </summary>
+        OutputContentHashesFromSandbox,
+
+        /// <summary>
+        /// The number of outputs whose content hash, as reported by the sandbox, was not the hash of the output.
+        /// </summary>
+        OutputContentHashesFromSandboxRejected,
+
         /// <summary>
         /// The amount of time it took during outputs processing to hash/serialize and store a pip's output content.
         /// </summary>
@@ -6315,6 +6315,11 @@ namespace BuildXL.Scheduler
                                 sandboxConnection = new SandboxConnectionLinuxDetours(sandboxFailureCallback);
                                 break;
                             }
+                            case SandboxKind.LinuxSeccomp:
+                            {
+                                sandboxConnection = new SandboxConnectionLinuxDetours(sandboxFailureCallback, useSeccomp: true);
+                                break;
+                            }
                             case SandboxKind.MacOsEndpointSecurity:
                             case SandboxKind.MacOsDetours:
                             case SandboxKind.MacOsHybrid:
@@ -0,0 +1,87 @@
+﻿// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+using BuildXL.Processes;
+using static BuildXL.Interop.Unix.Sandbox;
+using Test.BuildXL.TestUtilities.Xunit;
+using Xunit;
+using Xunit.Abstractions;
+
+namespace Test.BuildXL.Processes
+{
+    public sealed class SandboxStatisticsTest : XunitBuildXLTest
+    {
+        public SandboxStatisticsTest(ITestOutputHelper output)
+            : base(output)
+        {
+        }
+
+        [Fact]
+        public void ParseAndMerge()
+        {
+            // 2000 ticks per us: tick bucket 12 starts at 4096 ticks = 2048ns (ns bucket 11), tick bucket 13 at 4096ns (ns bucket 12)
+            XAssert.IsTrue(SandboxStatistics.TryParse("2000;3;7;12;1500;5;600;open:4:20000:12:3,1;stat:1:2000:10:1", out var first));
+            XAssert.IsTrue(SandboxStatistics.TryParse("2000;1;1;2;100;0;0;open:2:8192:12:2", out var second));
+
+            first.Merge(second);
+
+            XAssert.AreEqual(2, first.NumProcesses);
+            XAssert.AreEqual(4, first.CacheHits);
+            XAssert.AreEqual(8, first.CacheMisses);
+            XAssert.AreEqual(14, first.NumReports);
+            XAssert.AreEqual(1600, first.ReportBytes);
+            XAssert.AreEqual(5, first.SpilledReports);
+            XAssert.AreEqual(600, first.SpilledBytes);
+            XAssert.AreEqual(2, first.Hooks.Count);
+
+            var open = first.Hooks["open"];
+            XAssert.AreEqual(6, open.Calls);
+            XAssert.AreEqual(10000 + 4096, open.TotalNanoseconds);
+            XAssert.AreEqual(5, open.Histogram[11]);
+            XAssert.AreEqual(1, open.Histogram[12]);
+            XAssert.AreEqual(1L << 12, open.GetPercentileUpperBoundNs(50));
+            XAssert.AreEqual(1L << 13, open.GetPercentileUpperBoundNs(100));
+
+            XAssert.AreEqual(1, first.Hooks["stat"].Calls);
+            XAssert.AreEqual(1000, first.Hooks["stat"].TotalNanoseconds);
+        }
+
+        [Fact]
+        public void ReportLatency()
+        {
+            var statistics = new SandboxStatistics();
+            statistics.RecordReportLatency(new AccessReportStatistics { CreationTime = 1000, EnqueueTime = 1500, DequeueTime = 1000 + 3000 });
+            statistics.RecordReportLatency(new AccessReportStatistics { CreationTime = 1000, EnqueueTime = 1500, DequeueTime = 1000 + 5000 });
+            statistics.RecordReportLatency(new AccessReportStatistics { CreationTime = 1000, EnqueueTime = 1500, DequeueTime = 1000 + 100000 });
+
+            // missing or inconsistent timestamps are ignored
+            statistics.RecordReportLatency(new AccessReportStatistics { CreationTime = 0, EnqueueTime = 0, DequeueTime = 5000 });
+            statistics.RecordReportLatency(new AccessReportStatistics { CreationTime = 5000, EnqueueTime = 5000, DequeueTime = 0 });
+
+            var copy = new SandboxStatistics();
+            copy.Merge(statistics);
+
+            XAssert.AreEqual(3, copy.ReportLatency.Calls);
+            XAssert.AreEqual(108000, copy.ReportLatency.TotalNanoseconds);
+            XAssert.AreEqual(1, copy.ReportLatency.Histogram[11]);
+            XAssert.AreEqual(1, copy.ReportLatency.Histogram[12]);
+            XAssert.AreEqual(1, copy.ReportLatency.Histogram[16]);
+            XAssert.AreEqual(1L << 13, copy.ReportLatency.GetPercentileUpperBoundNs(50));
+            XAssert.AreEqual(1L << 17, copy.ReportLatency.GetPercentileUpperBoundNs(99));
+        }
+
+        [Theory]
+        [InlineData("")]
+        [InlineData("2000;3;7;12")]
+        [InlineData("2000;3;7;12;1500")]
+        [InlineData("0;3;7;12;1500;0;0")]
+        [InlineData("2000;3;7;12;1500;x;0")]
+        [InlineData("2000;3;7;12;1500;0;0;open:4:20000:12")]
+        [InlineData("2000;3;7;12;1500;0;0;open:4:20000:12:3,x")]
+        [InlineData("2000;3;7;12;1500;0;0;:4:20000:12:3")]
+        public void InvalidStatisticsAreRejected(string str)
+        {
+            XAssert.IsFalse(SandboxStatistics.TryParse(str, out _));
+        }
+    }
+}
@@ -1,8 +1,12 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT License.
+using System;
+using System.Diagnostics;
 using System.Linq;
 using System.Runtime.InteropServices;
 using System.Text;
+using BuildXL.Cache.ContentStore.Hashing;
+using BuildXL.Processes;
 using BuildXL.Utilities;
 using Test.BuildXL.TestUtilities.Xunit;
 using Xunit;
@@ -66,6 +70,21 @@ namespace Test.BuildXL.Processes
             [MarshalAs(UnmanagedType.LPStr)] StringBuilder buf1,
             [MarshalAs(UnmanagedType.LPStr)] StringBuilder buf2);
 
+        [DllImport(LibBxlUtils, EntryPoint = "merge_env_block_for_test")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        private static extern bool MergeEnvBlock(
+            string[] env,
+            string[] block,
+            [MarshalAs(UnmanagedType.LPStr)] string ldPreloadPath,
+            [MarshalAs(UnmanagedType.U1)] bool removeFromLdPreload,
+            [MarshalAs(UnmanagedType.LPStr)] StringBuilder buf);
+
+        [DllImport(LibBxlUtils, EntryPoint = "hash_content_vso0")]
+        private static extern void HashContentVso0(byte[] buf, UIntPtr len, byte[] hash);
+
+        [DllImport(LibBxlUtils, EntryPoint = "monotonic_time_ns")]
+        private static extern ulong MonotonicTimeNs();
+
         [Theory]
         // no 'valueToAdd' specified --> no change
         [InlineData("")]
@@ -253,5 +272,236 @@ namespace Test.BuildXL.Processes
             XAssert.AreEqual(expected[2], buffers[2].ToString());
             XAssert.AreEqual(shouldBeSameEnvp, sameEvnp);
         }
+
+        [Theory]
+        // everything already in place --> no change
+        [InlineData(new[] { "HOME=/User/home", "LD_PRELOAD=/before:/my/lib", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1", null }, false, new[] { "HOME=/User/home", "LD_PRELOAD=/before:/my/lib", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1" }, true)]
+        // variables replaced in place, missing ones appended
+        [InlineData(new[] { "HOME=/User/home", "__BUILDXL_ROOT_PID=2", "LD_PRELOAD=/my/lib", null }, false, new[] { "HOME=/User/home", "__BUILDXL_ROOT_PID=1", "LD_PRELOAD=/my/lib", "__BUILDXL_FAM_PATH=/my/fam" }, false)]
+        // path added to an existing LD_PRELOAD
+        [InlineData(new[] { "LD_PRELOAD=/before", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1", null }, false, new[] { "LD_PRELOAD=/before:/my/lib", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1" }, false)]
+        // LD_PRELOAD added
+        [InlineData(new[] { "HOME=/User/home", null }, false, new[] { "HOME=/User/home", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1", "LD_PRELOAD=/my/lib" }, false)]
+        [InlineData(null, false, new[] { "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1", "LD_PRELOAD=/my/lib" }, false)]
+        // path removed from LD_PRELOAD
+        [InlineData(new[] { "LD_PRELOAD=/before:/my/lib:/after", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1", null }, true, new[] { "LD_PRELOAD=/before:/after", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1" }, false)]
+        [InlineData(new[] { "LD_PRELOAD=/before", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1", null }, true, new[] { "LD_PRELOAD=/before", "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1" }, true)]
+        public void TestMergeEnvBlock(string[] envp, bool removeFromLdPreload, string[] expectedEnvp, bool shouldBeSameEnvp)
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            var block = new[] { "__BUILDXL_FAM_PATH=/my/fam", "__BUILDXL_ROOT_PID=1", null };
+
+            // allocate large enough buffers for each env var
+            var buffer = new StringBuilder(capacity: 1000);
+
+            bool sameEvnp = MergeEnvBlock(envp, block, "/my/lib", removeFromLdPreload, buffer);
+            XAssert.AreEqual(shouldBeSameEnvp, sameEvnp);
+
+            var newEnvp = buffer.ToString().Split(EnvSeparator);
+            XAssert.IsTrue(newEnvp.SequenceEqual(expectedEnvp));
+        }
+
+        [Theory]
+        // around the page (64KB) and block (2MB) boundaries of the VSO hash
+        [InlineData(0)]
+        [InlineData(1)]
+        [InlineData(64 * 1024 - 1)]
+        [InlineData(64 * 1024)]
+        [InlineData(64 * 1024 + 1)]
+        [InlineData(2 * 1024 * 1024 - 1)]
+        [InlineData(2 * 1024 * 1024)]
+        [InlineData(2 * 1024 * 1024 + 1)]
+        [InlineData(5 * 1000 * 1000)]
+        public void TestHashContentVso0MatchesTheEngine(int length)
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            var bytes = new byte[length];
+            new Random(length).NextBytes(bytes);
+
+            var hash = new byte[OutputContentDigest.HashLength];
+            HashContentVso0(bytes, new UIntPtr((uint)bytes.Length), hash);
+            XAssert.AreArraysEqual(VsoHash.CalculateBlobIdentifier(bytes).AlgorithmResultBytes, hash, expectedResult: true);
+        }
+
+        [Fact]
+        public void TestOutputContentDigestParsing()
+        {
+            string hash = string.Concat(Enumerable.Repeat("0123456789abcdef", 4));
+            XAssert.IsTrue(OutputContentDigest.TryParse($"{hash}:42:1700000000.000000007", out var digest));
+            XAssert.AreEqual(42L, digest.Length);
+            XAssert.AreEqual(1700000000L, digest.LastWriteTimeSeconds);
+            XAssert.AreEqual(7L, digest.LastWriteTimeNanoseconds);
+            XAssert.AreEqual($"{hash}:42:1700000000.000000007", digest.ToString());
+            XAssert.IsTrue(digest.IsValidFor(42, 1700000000, 7));
+            XAssert.IsFalse(digest.IsValidFor(43, 1700000000, 7));
+
+            XAssert.IsFalse(OutputContentDigest.TryParse($"{hash.Substring(2)}:42:1.0", out _));
+            XAssert.IsFalse(OutputContentDigest.TryParse($"{hash}:42", out _));
+            XAssert.IsFalse(OutputContentDigest.TryParse($"{hash}:-1:1.0", out _));
+            XAssert.IsFalse(OutputContentDigest.TryParse($"{hash.Replace('a', 'x')}:42:1.0", out _));
+        }
+
+        [Fact]
+        public void TestMonotonicTimeIsTheStopwatchClock()
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            // on Linux, Stopwatch reads CLOCK_MONOTONIC in nanoseconds too, so the engine and the sandbox agree on the time
+            XAssert.AreEqual(1_000_000_000L, Stopwatch.Frequency);
+            long before = Stopwatch.GetTimestamp();
+            ulong now = MonotonicTimeNs();
+            long after = Stopwatch.GetTimestamp();
+            XAssert.IsTrue((ulong)before <= now && now <= (ulong)after, $"{before} <= {now} <= {after}");
+        }
+
+        [Theory]
+        // CODESYNC: BxlObserver::SendReport in Public/Src/Sandbox/Linux/bxl_observer.cpp
+        [InlineData("cat|12|2|1|0|0|5|100|200|/tmp/a b\n", 12u, 5u, 200UL, "/tmp/a b", null)]
+        [InlineData("cat|12|2|1|0|0|5|100|18446744073709551615|/tmp/x|deadbeef\n", 12u, 5u, 18446744073709551615UL, "/tmp/x", "deadbeef")]
+        [InlineData("cat|7|1|1|1|2|3|4|5|/tmp/\u00e9t\u00e9\n", 7u, 3u, 5UL, "/tmp/\u00e9t\u00e9", null)]
+        // malformed: not enough fields, a field that is not a number, a number that does not fit
+        [InlineData("garbage\n", 0u, 0u, 0UL, null, null)]
+        [InlineData("cat|12|2|x|0|0|5|100|200|/tmp/a\n", 0u, 0u, 0UL, null, null)]
+        [InlineData("cat|12|2|1|0|0|99999999999|100|200|/tmp/a\n", 0u, 0u, 0UL, null, null)]
+        public void TestParseReports(string message, uint pid, uint operation, ulong enqueueTime, string path, string digest)
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            // the report after two others, followed by the beginning of another one
+            string last = "cat|3|1|1|0|0|1|1|1|/last\n";
+            var bytes = new[] { "cat|1|1|1|0|0|1|1|1|/first\n", "cat|2|1|1|0|0|1|1|1|/second|0\n", message, last }
+                .SelectMany(m => BitConverter.GetBytes(Encoding.UTF8.GetByteCount(m)).Concat(Encoding.UTF8.GetBytes(m)))
+                .ToArray();
+            int length = bytes.Length - 5;
+
+            var reports = new SandboxConnectionLinuxDetours.ParsedReport[4];
+            var arena = new byte[4096];
+            int consumed = SandboxConnectionLinuxDetours.ParseReports(bytes, 0, length, reports, arena, out int numReports);
+            XAssert.AreEqual(3, numReports);
+
+            // the last report is incomplete, so it is left for the next chunk
+            XAssert.AreEqual(bytes.Length - sizeof(int) - Encoding.UTF8.GetByteCount(last), consumed);
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.HasDigest, reports[1].Flags);
+
+            var report = reports[2];
+            if (path == null)
+            {
+                XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.Malformed, report.Flags);
+                XAssert.AreEqual(message, Encoding.UTF8.GetString(arena, report.PathOffset, report.PathLength));
+            }
+            else
+            {
+                XAssert.AreEqual(pid, report.Pid);
+                XAssert.AreEqual(operation, report.Operation);
+                XAssert.AreEqual(enqueueTime, report.EnqueueTime);
+                XAssert.AreEqual(path, Encoding.UTF8.GetString(arena, report.PathOffset, report.PathLength));
+                XAssert.AreEqual(digest != null, (report.Flags & SandboxConnectionLinuxDetours.ParsedReportFlags.HasDigest) != 0);
+                XAssert.AreEqual(digest ?? string.Empty, Encoding.UTF8.GetString(arena, report.DigestOffset, report.DigestLength));
+            }
+        }
+
+        [Fact]
+        public void TestParseSpillAnnouncements()
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            // CODESYNC: ReportWriter::AnnounceLocked in Public/Src/Sandbox/Linux/bxl_reports.hpp
+            var messages = new[]
+            {
+                ("cat|1|1|1|0|0|1|1|1|/first\n", false),
+                ("42|4096|300|/tmp/reports.42-7.spill\n", true),
+                ("42|x|300|/tmp/reports.42-7.spill\n", true),
+                ("cat|2|1|1|0|0|1|1|1|/last\n", false),
+            };
+            var bytes = messages
+                .SelectMany(m => BitConverter.GetBytes(Encoding.UTF8.GetByteCount(m.Item1) | (m.Item2 ? SandboxConnectionLinuxDetours.ReportsSpillAnnouncement : 0))
+                    .Concat(Encoding.UTF8.GetBytes(m.Item1)))
+                .ToArray();
+
+            var reports = new SandboxConnectionLinuxDetours.ParsedReport[4];
+            var arena = new byte[4096];
+            XAssert.AreEqual(bytes.Length, SandboxConnectionLinuxDetours.ParseReports(bytes, 0, bytes.Length, reports, arena, out int numReports));
+            XAssert.AreEqual(4, numReports);
+
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.Spill, reports[1].Flags);
+            XAssert.AreEqual(42u, reports[1].Pid);
+            XAssert.AreEqual(4096UL, reports[1].CreationTime);
+            XAssert.AreEqual(300UL, reports[1].EnqueueTime);
+            XAssert.AreEqual("/tmp/reports.42-7.spill", Encoding.UTF8.GetString(arena, reports[1].PathOffset, reports[1].PathLength));
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.Malformed, reports[2].Flags);
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.None, reports[3].Flags);
+            XAssert.AreEqual("/last", Encoding.UTF8.GetString(arena, reports[3].PathOffset, reports[3].PathLength));
+        }
+
+        [Fact]
+        public void TestParseStatistics()
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            // CODESYNC: BxlObserver::SendStatistics in Public/Src/Sandbox/Linux/bxl_observer.cpp
+            const int Both = SandboxConnectionLinuxDetours.ReportsStatistics | SandboxConnectionLinuxDetours.ReportsSpillAnnouncement;
+            var messages = new[]
+            {
+                ("42|2000;1;1;2;100;0;0;open:2:8192:12:2\n", SandboxConnectionLinuxDetours.ReportsStatistics),
+                ("cat|42|1|1|0|0|2|1|1|/exit|2000;1;1;2;100;0;0\n", 0),
+                ("42|\n", SandboxConnectionLinuxDetours.ReportsStatistics),
+                ("42|2000;1;1;2;100;0;0\n", Both),
+            };
+            var bytes = messages
+                .SelectMany(m => BitConverter.GetBytes(Encoding.UTF8.GetByteCount(m.Item1) | m.Item2).Concat(Encoding.UTF8.GetBytes(m.Item1)))
+                .ToArray();
+
+            var reports = new SandboxConnectionLinuxDetours.ParsedReport[4];
+            var arena = new byte[4096];
+            XAssert.AreEqual(bytes.Length, SandboxConnectionLinuxDetours.ParseReports(bytes, 0, bytes.Length, reports, arena, out int numReports));
+            XAssert.AreEqual(4, numReports);
+
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.Statistics, reports[0].Flags);
+            XAssert.AreEqual(42u, reports[0].Pid);
+            XAssert.AreEqual("2000;1;1;2;100;0;0;open:2:8192:12:2", Encoding.UTF8.GetString(arena, reports[0].PathOffset, reports[0].PathLength));
+            XAssert.AreEqual(0, reports[0].DigestLength);
+
+            // a trailing field of an access report is a digest, whatever the operation
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.HasDigest, reports[1].Flags);
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.Malformed, reports[2].Flags);
+            XAssert.AreEqual(SandboxConnectionLinuxDetours.ParsedReportFlags.Malformed, reports[3].Flags);
+        }
+
+        [Theory]
+        [InlineData("/tmp/bxl/reports.42-7.spill", true)]
+        [InlineData("/tmp/bxl/reports..spill", false)]
+        [InlineData("/tmp/bxl/reports.42-7.spil", false)]
+        [InlineData("/tmp/bxl/other.42-7.spill", false)]
+        [InlineData("/tmp/bxl/sub/reports.42-7.spill", false)]
+        [InlineData("/tmp/bxl/../bxl/reports.42-7.spill", false)]
+        [InlineData("/tmp/reports.42-7.spill", false)]
+        [InlineData("reports.42-7.spill", false)]
+        [InlineData("/etc/passwd", false)]
+        [InlineData("", false)]
+        public void TestSpillAnnouncementsOnlyNameSpillFiles(string path, bool isSpillFile)
+        {
+            // CODESYNC: ReportWriter::MapSpill in Public/Src/Sandbox/Linux/bxl_reports.hpp
+            XAssert.AreEqual(isSpillFile, SandboxConnectionLinuxDetours.Info.IsSpillFile("/tmp/bxl/reports", path));
+        }
     }
 }
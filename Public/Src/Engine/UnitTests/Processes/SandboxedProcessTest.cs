@@ -11,6 +11,7 @@ using BuildXL.Native.IO;
 using BuildXL.Native.IO.Windows;
 using BuildXL.Processes;
 using BuildXL.Utilities;
+using BuildXL.Utilities.Configuration;
 using Test.BuildXL.Executables.TestProcess;
 using Test.BuildXL.TestUtilities;
 using Test.BuildXL.TestUtilities.Xunit;
@@ -1433,6 +1434,75 @@ namespace Test.BuildXL.Processes
             XAssert.IsTrue(observedAccesses.Contains(grandChildInput.Path), "Input file of grandchild process should have been observed");
         }
 
+        [Fact]
+        public async Task ThreadsCreatedWithCloneAreNotReportedAsProcessesAsync()
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            const int NumThreads = 10000;
+            var info = ToProcessInfo(ToProcess(Operation.CloneThreads(NumThreads)));
+            info.FileAccessManifest.ReportFileAccesses = true;
+
+            var result = await RunProcess(info);
+
+            XAssert.AreEqual(0, result.ExitCode);
+
+            // the child process created after the threads (and only it) must be reported: this shows that the calls went through the sandbox
+            XAssert.AreEqual(2, result.Processes.Count, "Threads should not be reported as child processes");
+
+            // no thread gets a start or an exit report: every such report is about one of the two processes
+            var processIds = result.Processes.Select(process => process.ProcessId).ToHashSet();
+            var processReports = result.FileAccesses
+                .Where(access => access.Operation == ReportedFileOperation.Process || access.Operation == ReportedFileOperation.ProcessExit)
+                .ToList();
+            var threadReports = processReports.Where(access => !processIds.Contains(access.Process.ProcessId)).ToList();
+            XAssert.AreEqual(0, threadReports.Count, $"Threads were reported as processes: {string.Join(", ", threadReports.Select(access => $"{access.Operation} (pid: {access.Process.ProcessId})"))}");
+            foreach (uint processId in processIds)
+            {
+                XAssert.IsTrue(
+                    processReports.Count(access => access.Operation == ReportedFileOperation.Process && access.Process.ProcessId == processId) <= 1,
+                    $"Process {processId} was reported as started more than once");
+            }
+
+            // the number of reports must not grow with the number of created threads
+            XAssert.IsTrue(result.FileAccesses.Count < NumThreads, $"Received {result.FileAccesses.Count} reports for a process that created {NumThreads} threads");
+        }
+
+        [Fact]
+        public async Task SeccompSupervisorObservesTheSameAccessesAsLdPreloadAsync()
+        {
+            if (!OperatingSystemHelper.IsLinuxOS)
+            {
+                return;
+            }
+
+            var input = CreateSourceFile();
+            var operations = new[] { Operation.ReadFile(input), Operation.Probe(input) };
+
+            using (var seccompConnection = new SandboxConnectionLinuxDetours(isInTestMode: true, useSeccomp: true))
+            {
+                foreach (var connection in new[] { GetSandboxConnection(), seccompConnection })
+                {
+                    var info = ToProcessInfo(ToProcess(operations), sandboxConnection: connection);
+                    info.FileAccessManifest.ReportFileAccesses = true;
+
+                    var result = await RunProcess(info);
+
+                    XAssert.AreEqual(0, result.ExitCode);
+                    var inputAccesses = result.FileAccesses.Where(access => access.GetPath(Context.PathTable) == input.Path.ToString(Context.PathTable)).ToList();
+                    XAssert.IsTrue(inputAccesses.Count > 0, $"Input file should have been observed with {connection.Kind}");
+
+                    // the supervisor reports accesses on behalf of the process that made them
+                    XAssert.IsFalse(
+                        inputAccesses.Any(access => access.Process.Path.EndsWith("bxl-seccomp", StringComparison.Ordinal)),
+                        $"Input file accesses should be attributed to the test process with {connection.Kind}");
+                }
+            }
+        }
+
         [FactIfSupported(requiresWindowsBasedOperatingSystem: true)]
         public async Task VerifyOpenedFileOrDirectoryAttributesWithFiles()
         {
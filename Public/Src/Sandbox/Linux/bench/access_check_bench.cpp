@@ -0,0 +1,242 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Compares the two ways 'AccessHandler::CheckAndReport' has applied a checker to a file access: through a 'CheckFunc'
+// pointer that gets a copy of the 'PolicyResult' (after looking for the macOS data partition prefix in the path), as
+// it used to, and through the template argument of 'CheckAndReport<Checker>', which inlines the checker.
+//
+// Usage: access_check_bench <manifest> [rounds]
+//   <manifest>    a FAM written by fam_gen; every path of its tree (and a file under each of them) is accessed
+//   [rounds]      number of times every access is checked (default: 200)
+//
+// Every access is checked with one of the checkers 'IOHandler' uses, picked by the index of the access, the way
+// 'IOHandler' picks them from the type and mode of an event.  Before measuring, checks that both ways give the same
+// result for every access and checker.  Exits with 1 on the first mismatch.
+//
+// Prints one line per step: "<step>\t<function pointer ns per access>\t<template ns per access>", where 'check' only
+// applies the checker to a policy looked up beforehand, and 'search_and_check' also looks the policy up.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "bench_pip.hpp"
+#include "Checkers.hpp"
+#include "PolicyResult.h"
+#include "PolicySearch.h"
+
+namespace
+{
+
+// How AccessHandler applied checkers: copies of the policy, through pointers the compiler cannot see through
+typedef void (*ByValueCheckFunc)(PolicyResult policy, bool isDirectory, AccessCheckResult *result);
+
+template <CheckFunc Checker>
+__attribute__((noinline)) void ByValue(PolicyResult policy, bool isDirectory, AccessCheckResult *result)
+{
+    Checker(policy, isDirectory, result);
+}
+
+ByValueCheckFunc volatile kByValueCheckers[] =
+{
+    ByValue<Checkers::CheckRead>,
+    ByValue<Checkers::CheckWrite>,
+    ByValue<Checkers::CheckProbe>,
+    ByValue<Checkers::CheckLookup>,
+    ByValue<Checkers::CheckEnumerateDir>,
+    ByValue<Checkers::CheckReadWrite>,
+    ByValue<Checkers::CheckCreateDirectory>,
+    ByValue<Checkers::CheckCloseModified>,
+};
+
+const size_t kCheckerCount = sizeof(kByValueCheckers) / sizeof(kByValueCheckers[0]);
+
+// How IOHandler applies checkers now: a branch per event kind, each with the checker inlined
+inline AccessCheckResult CheckInline(const PolicyResult &policy, size_t checker, bool isDirectory)
+{
+    AccessCheckResult result = AccessCheckResult::Invalid();
+    switch (checker)
+    {
+        case 0:  Checkers::CheckRead(policy, isDirectory, &result); break;
+        case 1:  Checkers::CheckWrite(policy, isDirectory, &result); break;
+        case 2:  Checkers::CheckProbe(policy, isDirectory, &result); break;
+        case 3:  Checkers::CheckLookup(policy, isDirectory, &result); break;
+        case 4:  Checkers::CheckEnumerateDir(policy, isDirectory, &result); break;
+        case 5:  Checkers::CheckReadWrite(policy, isDirectory, &result); break;
+        case 6:  Checkers::CheckCreateDirectory(policy, isDirectory, &result); break;
+        default: Checkers::CheckCloseModified(policy, isDirectory, &result); break;
+    }
+
+    return result;
+}
+
+inline AccessCheckResult CheckByValue(const PolicyResult &policy, size_t checker, bool isDirectory)
+{
+    AccessCheckResult result = AccessCheckResult::Invalid();
+    kByValueCheckers[checker](policy, isDirectory, &result);
+    return result;
+}
+
+// The prefix AccessHandler::IgnoreDataPartitionPrefix looked for on every access, on every platform
+const char *IgnoreDataPartitionPrefix(const char *path)
+{
+    const char *prefix = "/System/Volumes/Data/";
+    const char *marker = path;
+    while (*prefix != '\0')
+    {
+        if (*prefix++ != *marker++)
+        {
+            return path;
+        }
+    }
+
+    return path + strlen("/System/Volumes/Data");
+}
+
+struct Access
+{
+    std::string path;
+    size_t checker;
+    bool isDirectory;
+};
+
+uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void Check(bool condition, const std::string &path, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "access_check_bench: '%s': %s\n", path.c_str(), what);
+        exit(1);
+    }
+}
+
+void CollectPaths(PCManifestRecord record, const std::string &path, std::vector<std::string> &paths)
+{
+    paths.push_back(path);
+    paths.push_back(path + "/file.o");
+    for (ManifestRecord::BucketCountType i = 0; i < record->BucketCount; i++)
+    {
+        PCManifestRecord child = record->GetChildRecord(i);
+        if (child != nullptr)
+        {
+            CollectPaths(child, path + "/" + child->GetPartialPath(), paths);
+        }
+    }
+}
+
+bool SameResult(const AccessCheckResult &a, const AccessCheckResult &b)
+{
+    return a.Access == b.Access && a.Result == b.Result && a.Level == b.Level && a.Validity == b.Validity;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: access_check_bench <manifest> [rounds]\n");
+        return 2;
+    }
+
+    int rounds = argc > 2 ? atoi(argv[2]) : 200;
+    if (rounds <= 0)
+    {
+        fprintf(stderr, "access_check_bench: invalid number of rounds\n");
+        return 2;
+    }
+
+    std::shared_ptr<SandboxedPip> pip = LoadBenchPip("access_check_bench", argv[1]);
+    PCManifestRecord root = pip->GetManifestRecord();
+
+    std::vector<std::string> paths;
+    for (ManifestRecord::BucketCountType i = 0; i < root->BucketCount; i++)
+    {
+        PCManifestRecord child = root->GetChildRecord(i);
+        if (child != nullptr)
+        {
+            CollectPaths(child, std::string("/") + child->GetPartialPath(), paths);
+        }
+    }
+
+    std::vector<Access> accesses;
+    std::vector<PolicyResult> policies;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        accesses.push_back({ paths[i], i % kCheckerCount, i % 3 == 0 });
+
+        // as AccessHandler::FindManifestRecord does, without the leading '/'
+        const char *relative = paths[i].c_str() + 1;
+        PolicySearchCursor cursor = FindFileAccessPolicyInTreeEx(PolicySearchCursor(root), relative, strlen(relative));
+        policies.push_back(PolicyResult(pip->GetFamFlags(), pip->GetFamExtraFlags(), accesses[i].path.c_str(), cursor));
+    }
+
+    for (size_t i = 0; i < accesses.size(); i++)
+    {
+        for (size_t checker = 0; checker < kCheckerCount; checker++)
+        {
+            for (bool isDirectory : { false, true })
+            {
+                Check(SameResult(CheckByValue(policies[i], checker, isDirectory), CheckInline(policies[i], checker, isDirectory)),
+                      accesses[i].path, "the inlined checker gives another result");
+            }
+        }
+    }
+
+    size_t n = accesses.size();
+    double ops = (double)n * rounds;
+    uint64_t checkByValue = 0, checkInline = 0, searchByValue = 0, searchInline = 0;
+    unsigned reported = 0;
+
+    for (int r = 0; r < rounds; r++)
+    {
+        uint64_t start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            reported += CheckByValue(policies[i], accesses[i].checker, accesses[i].isDirectory).ShouldReport();
+        }
+        checkByValue += NowNs() - start;
+
+        start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            reported += CheckInline(policies[i], accesses[i].checker, accesses[i].isDirectory).ShouldReport();
+        }
+        checkInline += NowNs() - start;
+
+        start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            const char *path = IgnoreDataPartitionPrefix(accesses[i].path.c_str());
+            PolicySearchCursor cursor = FindFileAccessPolicyInTreeEx(PolicySearchCursor(root), path + 1, accesses[i].path.length() - 1);
+            PolicyResult policy(pip->GetFamFlags(), pip->GetFamExtraFlags(), path, cursor);
+            reported += CheckByValue(policy, accesses[i].checker, accesses[i].isDirectory).ShouldReport();
+        }
+        searchByValue += NowNs() - start;
+
+        start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            const char *path = accesses[i].path.c_str();
+            PolicySearchCursor cursor = FindFileAccessPolicyInTreeEx(PolicySearchCursor(root), path + 1, accesses[i].path.length() - 1);
+            PolicyResult policy(pip->GetFamFlags(), pip->GetFamExtraFlags(), path, cursor);
+            reported += CheckInline(policy, accesses[i].checker, accesses[i].isDirectory).ShouldReport();
+        }
+        searchInline += NowNs() - start;
+    }
+
+    printf("# step\tfunction_pointer_ns\ttemplate_ns\t(%zu accesses, %u reported)\n", n, reported);
+    printf("check\t%.1f\t%.1f\n", checkByValue / ops, checkInline / ops);
+    printf("search_and_check\t%.1f\t%.1f\n", searchByValue / ops, searchInline / ops);
+    return 0;
+}
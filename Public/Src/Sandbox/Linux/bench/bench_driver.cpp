@@ -0,0 +1,282 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Calls one libc function in a tight loop and prints how long a call took on average, so that running it natively
+// and under libDetours.so (see run_bench.sh) gives the overhead of the sandbox for the corresponding hook.
+//
+// Usage: bench_driver <hook> <iterations> <work dir>
+// Prints a single line: "<hook>\t<iterations>\t<ns per call>".
+//
+// The calls are bracketed by the markers of syscall_markers.h, so that syscall_counter can count the syscalls they make.
+//
+// Every hook touches a rotating set of NUM_FILES files under <work dir> (created beforehand, outside of the timed
+// loop), so that the sandbox sees a few distinct paths rather than the very same one over and over again.
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "syscall_markers.h"
+
+#define NUM_FILES 16
+
+static char sFiles[NUM_FILES][PATH_MAX];
+static char sLinks[NUM_FILES][PATH_MAX];
+static const char *sWorkDir;
+static const char *sSelf;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "bench_driver: %s failed: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static void setup()
+{
+    for (int i = 0; i < NUM_FILES; i++)
+    {
+        snprintf(sFiles[i], PATH_MAX, "%s/file%d", sWorkDir, i);
+        snprintf(sLinks[i], PATH_MAX, "%s/link%d", sWorkDir, i);
+
+        int fd = open(sFiles[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1 || close(fd) != 0) fail("creating a file");
+        unlink(sLinks[i]);
+        if (symlink(sFiles[i], sLinks[i]) != 0) fail("creating a symlink");
+    }
+}
+
+// Each function performs a single call of its hook; the result is checked so that a sandbox that silently
+// breaks the call does not go unnoticed (and so that the compiler cannot drop it).
+
+static int sDirFd = -1;
+static int sWriteFd = -1;
+static FILE *sPutcFile = NULL;
+
+static void run_open(int i)
+{
+    int fd = open(sFiles[i % NUM_FILES], O_RDONLY);
+    if (fd == -1) fail("open");
+    close(fd);
+}
+
+static void run_openat(int i)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "file%d", i % NUM_FILES);
+    int fd = openat(sDirFd, name, O_RDONLY);
+    if (fd == -1) fail("openat");
+    close(fd);
+}
+
+// Up to glibc 2.32, stat() is a wrapper (linked statically from libc_nonshared.a) around __xstat(), which is what the
+// sandbox interposes.  From glibc 2.33 on, stat() is a function of libc.so that no longer goes through __xstat(), so
+// calling __xstat() directly (libc still exports it for binaries built against older versions) measures the same hook
+// on every glibc.
+typedef int (*xstat_fn)(int, const char *, struct stat *);
+static xstat_fn sXstat;
+
+static void run_stat(int i)
+{
+    struct stat st;
+    int result = sXstat != NULL
+        ? sXstat(1 /* _STAT_VER on x86_64 */, sFiles[i % NUM_FILES], &st)
+        : stat(sFiles[i % NUM_FILES], &st);
+    if (result != 0) fail("stat");
+}
+
+static void run_access(int i)
+{
+    if (access(sFiles[i % NUM_FILES], R_OK) != 0) fail("access");
+}
+
+static void run_write(int i)
+{
+    if (write(sWriteFd, "x", 1) != 1) fail("write");
+}
+
+static void run_putc(int i)
+{
+    if (putc('x', sPutcFile) == EOF) fail("putc");
+}
+
+static void run_readlink(int i)
+{
+    char target[PATH_MAX];
+    if (readlink(sLinks[i % NUM_FILES], target, sizeof(target)) == -1) fail("readlink");
+}
+
+static void run_opendir(int i)
+{
+    DIR *dir = opendir(sWorkDir);
+    if (dir == NULL) fail("opendir");
+    closedir(dir);
+}
+
+// Runs this image as a child process, with 'mode' (and the work directory) as its arguments, and waits for it.
+static void fork_exec(const char *mode)
+{
+    pid_t pid = fork();
+    if (pid == -1) fail("fork");
+    if (pid == 0)
+    {
+        execl(sSelf, sSelf, mode, sWorkDir, (char *)NULL);
+        _exit(127);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) fail("fork+exec");
+}
+
+static void run_fork_exec(int i)
+{
+    fork_exec("noop");
+}
+
+// Not a hook of its own: a process tree whose processes all access the same files, like the compilers of a build
+// reading the same headers (see bench/check_aggregator.sh)
+static void run_fork_exec_open(int i)
+{
+    fork_exec("open_all");
+}
+
+// A thread created the way pthread_create creates one (without thread-local storage, which 'thread_noop' does not use),
+// but through the exported clone, which is what the sandbox interposes (pthread_create does not call it).  The kernel
+// clears 'sThreadTid' once the thread is gone, and wakes up whoever waits for it to (CLONE_CHILD_CLEARTID), which is how
+// pthread_join waits too.  It is waited for with a single futex call (which fails right away if the thread is already
+// gone), so that how many syscalls a call makes does not depend on how the thread got scheduled.
+static char sThreadStack[64 * 1024] __attribute__((aligned(16)));
+static volatile pid_t sThreadTid;
+
+static int thread_noop(void *)
+{
+    return 0;
+}
+
+static void run_clone_thread(int i)
+{
+    const int flags = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM | CLONE_CHILD_CLEARTID;
+    sThreadTid = -1;
+    if (clone(thread_noop, sThreadStack + sizeof(sThreadStack), flags, NULL, NULL, NULL, (pid_t *)&sThreadTid) == -1) fail("clone");
+    do
+    {
+        syscall(SYS_futex, &sThreadTid, FUTEX_WAIT, -1, NULL, NULL, 0);
+    } while (sThreadTid != 0);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*run)(int);
+} Hook;
+
+static const Hook sHooks[] =
+{
+    { "open",      run_open },
+    { "openat",    run_openat },
+    { "stat",      run_stat },
+    { "access",    run_access },
+    { "write",     run_write },
+    { "putc",      run_putc },
+    { "readlink",  run_readlink },
+    { "opendir",   run_opendir },
+    { "fork_exec", run_fork_exec },
+    { "clone_thread", run_clone_thread },
+    { "fork_exec_open", run_fork_exec_open },
+};
+
+int main(int argc, char **argv)
+{
+    // the images exec'ed by 'fork_exec' and 'fork_exec_open'
+    if (argc == 3 && strcmp(argv[1], "noop") == 0)
+    {
+        return 0;
+    }
+
+    if (argc == 3 && strcmp(argv[1], "open_all") == 0)
+    {
+        sWorkDir = argv[2];
+        for (int i = 0; i < NUM_FILES; i++)
+        {
+            snprintf(sFiles[i], PATH_MAX, "%s/file%d", sWorkDir, i);
+            run_open(i);
+        }
+
+        return 0;
+    }
+
+    if (argc != 4)
+    {
+        fprintf(stderr, "Usage: bench_driver <hook> <iterations> <work dir>\n");
+        return 2;
+    }
+
+    const Hook *hook = NULL;
+    for (size_t i = 0; i < sizeof(sHooks) / sizeof(sHooks[0]); i++)
+    {
+        if (strcmp(argv[1], sHooks[i].name) == 0) hook = &sHooks[i];
+    }
+
+    int iterations = atoi(argv[2]);
+    if (hook == NULL || iterations <= 0)
+    {
+        fprintf(stderr, "bench_driver: unknown hook '%s' or invalid number of iterations '%s'\n", argv[1], argv[2]);
+        return 2;
+    }
+
+    static char self[PATH_MAX];
+    if (realpath("/proc/self/exe", self) == NULL) fail("realpath");
+    sSelf = self;
+    sWorkDir = argv[3];
+    sXstat = (xstat_fn)dlsym(RTLD_DEFAULT, "__xstat");
+    setup();
+
+    char path[PATH_MAX];
+    sDirFd = open(sWorkDir, O_RDONLY | O_DIRECTORY);
+    snprintf(path, sizeof(path), "%s/write.out", sWorkDir);
+    sWriteFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    snprintf(path, sizeof(path), "%s/putc.out", sWorkDir);
+    sPutcFile = fopen(path, "w");
+    if (sDirFd == -1 || sWriteFd == -1 || sPutcFile == NULL) fail("opening the output files");
+
+    // warm up: the first calls pay for the lazy initialization of the sandbox and fill its caches
+    int warmup = iterations / 10 > NUM_FILES ? iterations / 10 : NUM_FILES;
+    for (int i = 0; i < warmup; i++)
+    {
+        hook->run(i);
+    }
+
+    bxl_syscall_marker(BXL_SYSCALL_MARKER_BEGIN);
+    uint64_t start = now_ns();
+    for (int i = 0; i < iterations; i++)
+    {
+        hook->run(i);
+    }
+    uint64_t elapsed = now_ns() - start;
+    bxl_syscall_marker(BXL_SYSCALL_MARKER_END);
+
+    fclose(sPutcFile);
+    close(sWriteFd);
+    close(sDirFd);
+
+    printf("%s\t%d\t%.1f\n", hook->name, iterations, (double)elapsed / iterations);
+    return 0;
+}
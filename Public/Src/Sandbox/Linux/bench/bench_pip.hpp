@@ -0,0 +1,47 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#ifndef BENCH_PIP_HPP
+#define BENCH_PIP_HPP
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <vector>
+
+#include "SandboxedPip.hpp"
+
+// Reads a manifest written by fam_gen; exits if it cannot be read.
+static std::vector<char> ReadBenchManifest(const char *tool, const char *manifest)
+{
+    FILE *file = fopen(manifest, "rb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "%s: cannot open '%s': %s\n", tool, manifest, strerror(errno));
+        exit(1);
+    }
+
+    std::vector<char> payload;
+    char chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        payload.insert(payload.end(), chunk, chunk + read);
+    }
+
+    fclose(file);
+    return payload;
+}
+
+// Creates a pip from a manifest written by fam_gen (the benchmarks of the Interop containers need one to create
+// the SandboxedProcess values they store); exits if the manifest cannot be read.
+static std::shared_ptr<SandboxedPip> LoadBenchPip(const char *tool, const char *manifest)
+{
+    std::vector<char> payload = ReadBenchManifest(tool, manifest);
+    return std::make_shared<SandboxedPip>(getpid(), payload.data(), payload.size());
+}
+
+#endif // BENCH_PIP_HPP
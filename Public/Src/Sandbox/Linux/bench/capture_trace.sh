@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Captures the traces libDetours.so writes when __BUILDXL_TRACE_DIR is set (see bxl_trace.hpp), by running hooks of
+# bench_driver under the sandbox, for trace_replay to replay (see 'make trace-replay').
+#
+# The output directory gets one trace per process, along with the manifest they ran with ('bench.fam').  With -r, the
+# traces are then replayed by trace_replay, with report_sink reading the reports it sends, as it read the live ones.
+
+set -euo pipefail
+
+readonly MY_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+readonly ALL_HOOKS="open openat stat access write putc readlink opendir fork_exec"
+
+config=release
+iterations=2000
+output=
+replay=0
+
+function usage {
+    echo "Usage: $0 [-c debug|release] [-n iterations] [-r] -o <output directory> [hook...]" >&2
+    echo "Hooks: $ALL_HOOKS" >&2
+    exit 2
+}
+
+while getopts "c:n:o:rh" opt; do
+    case $opt in
+        c) config=$OPTARG ;;
+        n) iterations=$OPTARG ;;
+        o) output=$OPTARG ;;
+        r) replay=1 ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+hooks="${*:-$ALL_HOOKS}"
+[[ -n $output ]] || usage
+
+source "$MY_DIR/common.sh"
+bench_init $config
+
+rm -rf "$output"
+mkdir -p "$output"
+output="$(cd "$output" && pwd)"
+cp "$FAM" "$output/bench.fam"
+
+start_sink
+for hook in $hooks; do
+    n=$iterations
+    [[ $hook == fork_exec ]] && n=$(( iterations / 10 > 10 ? iterations / 10 : 10 ))
+    __BUILDXL_TRACE_DIR="$output" "${PRELOADED[@]}" "$BIN/bench_driver" $hook $n "$WORK/files" > /dev/null
+done
+echo "$(stop_sink) reports, $(ls "$output" | grep -c '\.bxltrace$') traces in $output"
+
+if [[ $replay == 1 ]]; then
+    start_sink
+    status=0
+    "$BIN/trace_replay" "$output/bench.fam" "$output" || status=$?
+    echo "$(stop_sink) reports replayed"
+    exit $status
+fi
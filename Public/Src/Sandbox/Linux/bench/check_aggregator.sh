@@ -0,0 +1,91 @@
+#!/bin/bash
+
+# Checks that the report aggregator (see ReportAggregator in bxl_aggregator.hpp) only drops redundant reports.
+#
+# The fork_exec_open hook of bench_driver (every child opens the same files) is run under the sandbox twice: once with every process writing its reports to the FIFO, once with
+# __BUILDXL_REPORT_AGGREGATOR=1.  The check fails (exit code 1) unless the aggregated stream has fewer reports, but the
+# same distinct accesses (everything but the pid and the timestamps of a report) and the same process starts and exits.
+
+set -euo pipefail
+
+readonly MY_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+
+config=release
+iterations=100
+
+function usage {
+    echo "Usage: $0 [-c debug|release] [-n iterations]" >&2
+    exit 2
+}
+
+while getopts "c:n:h" opt; do
+    case $opt in
+        c) config=$OPTARG ;;
+        n) iterations=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+
+source "$MY_DIR/common.sh"
+bench_init $config
+
+# CODESYNC: BxlObserver::SendReport ("prog|pid|access|status|explicit|error|op|creation|enqueue|path[|digest]"),
+# OpNames.hpp (kOpProcessStart = 0, kOpProcessExit = 1, kOpProcessTreeCompleted = 2)
+readonly DISTINCT='{ print $1 "|" $3 "|" $4 "|" $5 "|" $6 "|" $7 "|" $10 }'
+readonly LIFECYCLE='$7 <= 2 { print $2 "|" $7 "|" $10 }'
+readonly ROOT_EXITED='NR == 1 { root = $2 } $2 == root && $7 == 1 { found = 1 } END { exit !found }'
+
+# usage: run_preloaded <name> [env assignments] -- dumps the reports to "$WORK/<name>.reports" and prints
+# "<reports>\t<bytes>\t<ms spent in bench_driver>"
+function run_preloaded {
+    local name=$1
+    shift
+
+    # both runs start from the same (empty) files, and as the first process of their tree (which is the one that starts
+    # the aggregator): the tree of bench_driver never gets its count back to zero, as 'execl' is not interposed
+    rm -rf "$WORK/files" "$FIFO.tree" && mkdir "$WORK/files"
+    start_sink --dump "$WORK/$name.reports"
+    local start=$(date +%s%N)
+    env "$@" "${PRELOADED[@]}" "$BIN/bench_driver" fork_exec_open $iterations "$WORK/files" > /dev/null
+    local elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+
+    # the aggregator may still be forwarding the last reports of the tree, the last of which is the exit of its root
+    for _ in $(seq 100); do
+        awk -F'|' "$ROOT_EXITED" "$WORK/$name.reports" && break
+        sleep 0.05
+    done
+
+    stop_sink > /dev/null
+    echo -e "$(cut -f1,2 "$WORK/sink.stats")\t$elapsed"
+}
+
+IFS=$'\t' read -r directReports directBytes directMs <<< "$(run_preloaded direct)"
+IFS=$'\t' read -r aggregatedReports aggregatedBytes aggregatedMs <<< "$(run_preloaded aggregated __BUILDXL_REPORT_AGGREGATOR=1)"
+
+echo "mode        reports  bytes  ms"
+echo "direct      $directReports  $directBytes  $directMs"
+echo "aggregated  $aggregatedReports  $aggregatedBytes  $aggregatedMs"
+
+failed=0
+for name in direct aggregated; do
+    awk -F'|' "$DISTINCT" "$WORK/$name.reports" | sort -u > "$WORK/$name.distinct"
+    awk -F'|' "$LIFECYCLE" "$WORK/$name.reports" | sort > "$WORK/$name.lifecycle"
+done
+
+if ! diff -q "$WORK/direct.distinct" "$WORK/aggregated.distinct" > /dev/null; then
+    echo "FAIL: the aggregated stream does not have the same distinct accesses:" >&2
+    diff "$WORK/direct.distinct" "$WORK/aggregated.distinct" | head -20 >&2
+    failed=1
+fi
+
+if [[ $(wc -l < "$WORK/direct.lifecycle") -ne $(wc -l < "$WORK/aggregated.lifecycle") ]]; then
+    echo "FAIL: the aggregated stream does not have as many process starts and exits" >&2
+    failed=1
+fi
+
+if [[ $aggregatedReports -ge $directReports ]]; then
+    echo "FAIL: the aggregator did not drop any report" >&2
+    failed=1
+fi
+
+exit $failed
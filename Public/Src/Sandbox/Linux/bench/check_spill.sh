@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Checks that reports survive a reader that cannot keep up with them.
+#
+# The fork_exec hook of bench_driver is run under the sandbox twice: once with report_sink reading the reports as fast
+# as it can, once with report_sink waiting after every report it reads from a small FIFO.  The latter fills the FIFO,
+# so the sandbox has to spill reports to files instead of blocking on it (see ReportWriter in bxl_reports.hpp).  The
+# check fails (exit code 1) unless reports were spilled and the slow reader got as many reports as the fast one.
+
+set -euo pipefail
+
+readonly MY_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+
+config=release
+iterations=200
+delay=2000
+
+function usage {
+    echo "Usage: $0 [-c debug|release] [-n iterations] [-d delay per report (us)]" >&2
+    exit 2
+}
+
+while getopts "c:n:d:h" opt; do
+    case $opt in
+        c) config=$OPTARG ;;
+        n) iterations=$OPTARG ;;
+        d) delay=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+
+source "$MY_DIR/common.sh"
+bench_init $config
+
+# usage: run_preloaded [report_sink options] -- prints "<reports>\t<bytes>\t<spilled reports>\t<ms spent in bench_driver>"
+function run_preloaded {
+    start_sink "$@"
+    local start=$(date +%s%N)
+    "${PRELOADED[@]}" "$BIN/bench_driver" fork_exec $iterations "$WORK/files" > /dev/null
+    local elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+    stop_sink > /dev/null
+    echo -e "$(cat "$WORK/sink.stats")\t$elapsed"
+}
+
+IFS=$'\t' read -r fastReports _ fastSpilled fastMs <<< "$(run_preloaded)"
+IFS=$'\t' read -r slowReports _ slowSpilled slowMs <<< "$(run_preloaded --delay-us $delay --pipe-size 4096)"
+
+echo "reader  reports  spilled  ms"
+echo "fast    $fastReports  $fastSpilled  $fastMs"
+echo "slow    $slowReports  $slowSpilled  $slowMs"
+
+if [[ $slowSpilled -eq 0 ]]; then
+    echo "FAIL: no report was spilled; the reader was not slow enough" >&2
+    exit 1
+fi
+
+if [[ $slowReports -ne $fastReports ]]; then
+    echo "FAIL: the slow reader got $slowReports reports instead of $fastReports" >&2
+    exit 1
+fi
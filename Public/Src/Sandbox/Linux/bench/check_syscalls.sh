@@ -0,0 +1,97 @@
+#!/bin/bash
+
+# Checks how many syscalls libDetours.so makes per intercepted call, in steady state, against a budget.
+#
+# Every hook of bench_driver is run natively and under LD_PRELOAD, both times under syscall_counter, and the
+# difference in syscalls per call (counting those of child processes too) is compared with the budget of the hook in
+# syscall_budget.tsv.  A hook over budget fails the check (exit code 1) and shows which syscalls it added.
+#
+# With -u, writes the measured counts to the budget file instead (see 'make syscall-budget-update'); do that only
+# along with the change that deliberately makes the sandbox cheaper (or more expensive).
+
+set -euo pipefail
+
+readonly MY_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+readonly ALL_HOOKS="open openat stat access write putc readlink opendir fork_exec clone_thread"
+
+config=release
+iterations=200
+budget="$MY_DIR/syscall_budget.tsv"
+update=0
+
+function usage {
+    echo "Usage: $0 [-c debug|release] [-n iterations] [-b budget file] [-u] [hook...]" >&2
+    echo "Hooks: $ALL_HOOKS" >&2
+    exit 2
+}
+
+while getopts "c:n:b:uh" opt; do
+    case $opt in
+        c) config=$OPTARG ;;
+        n) iterations=$OPTARG ;;
+        b) budget=$OPTARG ;;
+        u) update=1 ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+hooks="${*:-$ALL_HOOKS}"
+
+source "$MY_DIR/common.sh"
+bench_init $config
+readonly COUNTER="$BIN/syscall_counter"
+
+# usage: count <output file> <hook> <iterations> [preloaded]
+function count {
+    local out=$1 hook=$2 n=$3
+    local cmd=("$BIN/bench_driver" $hook $n "$WORK/files")
+    if [[ ${4:-} == preloaded ]]; then
+        start_sink
+        "$COUNTER" "$out" "${PRELOADED[@]}" "${cmd[@]}" > /dev/null
+        stop_sink > /dev/null
+    else
+        "$COUNTER" "$out" "${cmd[@]}" > /dev/null
+    fi
+}
+
+results="$WORK/results.tsv"
+echo -e "# hook\tsyscalls_per_call" > "$results"
+failed=0
+printf "%-10s %8s %8s  %s\n" "hook" "budget" "measured" "extra syscalls per call"
+for hook in $hooks; do
+    n=$iterations
+    [[ $hook == fork_exec ]] && n=$(( iterations / 10 > 10 ? iterations / 10 : 10 ))
+
+    count "$WORK/native.counts" $hook $n
+    count "$WORK/preloaded.counts" $hook $n preloaded
+
+    # per syscall, the (rounded) number of extra calls per intercepted call
+    breakdown=$(awk -F'\t' -v n=$n '
+        NR == FNR { native[$1] = $2; next }
+        $1 != "total" { extra = ($2 - native[$1]) / n; if (extra >= 0.05) printf "%s:%.1f ", $1, extra }' \
+        "$WORK/native.counts" "$WORK/preloaded.counts")
+    measured=$(awk -F'\t' -v n=$n '
+        NR == FNR && $1 == "total" { native = $2; next }
+        $1 == "total" { extra = ($2 - native) / n; printf "%.1f", (extra > 0 ? extra : 0) }' \
+        "$WORK/native.counts" "$WORK/preloaded.counts")
+    echo -e "$hook\t$measured" >> "$results"
+
+    allowed=$(awk -F'\t' -v h=$hook '$1 == h { print $2 }' "$budget" 2>/dev/null || true)
+    status=""
+    if [[ -z $allowed ]]; then
+        status="(no budget)"
+    elif awk -v m=$measured -v a=$allowed 'BEGIN { exit !(m > a) }'; then
+        status="OVER BUDGET"
+        failed=1
+    fi
+
+    printf "%-10s %8s %8s  %s%s\n" $hook "${allowed:--}" $measured "$breakdown" "${status:+ $status}"
+done
+
+if [[ $update == 1 ]]; then
+    cp "$results" "$budget"
+    echo "Updated $budget"
+    exit 0
+fi
+
+exit $failed
@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# Shared by run_bench.sh and check_syscalls.sh: locates the binaries of a configuration and sets up a work directory
+# with a manifest (reporting every access) and the FIFO the sandbox reports to.
+
+# usage: bench_init <config>
+function bench_init {
+    BIN="$MY_DIR/bin/$1"
+    DETOURS="$(cd "$MY_DIR/../bin/$1" && pwd)/libDetours.so"
+    for f in "$BIN/fam_gen" "$BIN/bench_driver" "$BIN/report_sink" "$DETOURS"; do
+        if [[ ! -f "$f" ]]; then
+            echo "Missing '$f'; build it with 'make bench' first" >&2
+            exit 1
+        fi
+    done
+
+    WORK="$(mktemp -d -t bxl-bench.XXXXXX)"
+    trap 'rm -rf "$WORK"' EXIT
+    mkdir -p "$WORK/files"
+
+    FIFO="$WORK/reports.fifo"
+    FAM="$WORK/bench.fam"
+    "$BIN/fam_gen" --report "$FIFO" --synthetic-scopes 1000 "$FAM"
+
+    # prefix of a command line that runs its remaining arguments under the sandbox (with the same environment
+    # SandboxConnectionLinuxDetours.cs sets up)
+    PRELOADED=(env __BUILDXL_FAM_PATH="$FAM" __BUILDXL_DETOURS_PATH="$DETOURS"
+               bash -c 'export __BUILDXL_ROOT_PID=$$; LD_PRELOAD="$__BUILDXL_DETOURS_PATH" exec "$0" "$@"')
+}
+
+# usage: start_sink [report_sink options]; ...; stop_sink -- prints the number of reports received in between
+function start_sink {
+    rm -f "$WORK/sink.stats"
+    "$BIN/report_sink" "$@" "$FIFO" "$WORK/sink.stats" &
+    SINK_PID=$!
+    while [[ ! -p "$FIFO" ]]; do sleep 0.01; done
+}
+
+function stop_sink {
+    kill -TERM $SINK_PID
+    wait $SINK_PID
+    cut -f1 "$WORK/sink.stats"
+}
+
+function median {
+    sort -g | awk '{ v[NR] = $1 } END { print (NR % 2 == 1) ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
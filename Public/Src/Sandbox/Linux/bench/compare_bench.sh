@@ -0,0 +1,49 @@
+#!/bin/bash
+
+# Compares the per-hook overhead measured by run_bench.sh against a baseline.
+#
+# The baseline is usually measured on another machine, so absolute times are not comparable; what is compared is the
+# slowdown of every hook, i.e., its sandboxed time divided by its native time measured in the same run.  A hook
+# regresses when its slowdown grew by more than the tolerance (a percentage of the baseline slowdown) AND the overhead
+# that growth adds on this machine (in ns/call) is above the minimum, so that hooks with a tiny overhead do not fail
+# on noise.  Exits with 1 if any hook regressed, 0 otherwise.
+
+set -euo pipefail
+
+tolerance=50
+min_ns=250
+
+function usage {
+    echo "Usage: $0 [-t tolerance %] [-m minimum ns] <baseline.tsv> <results.tsv>" >&2
+    exit 2
+}
+
+while getopts "t:m:h" opt; do
+    case $opt in
+        t) tolerance=$OPTARG ;;
+        m) min_ns=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+[[ $# -eq 2 ]] || usage
+
+awk -F'\t' -v tol=$tolerance -v min=$min_ns '
+    function slowdown(native, sandboxed) { return native > 0 ? sandboxed / native : 0 }
+    BEGIN { printf "%-10s %10s %10s %9s %12s\n", "hook", "baseline", "current", "delta", "extra ns" }
+    /^#/ { next }
+    NR == FNR { base[$1] = slowdown($3, $4); next }
+    {
+        seen[$1] = 1
+        current = slowdown($3, $4)
+        if (!($1 in base)) { printf "%-10s %10s %9.2fx  (new)\n", $1, "-", current; next }
+        delta = current - base[$1]
+        extra_ns = delta * $3
+        regressed = extra_ns > min && delta > base[$1] * tol / 100
+        printf "%-10s %9.2fx %9.2fx %+8.2fx %12.1f%s\n", $1, base[$1], current, delta, extra_ns, regressed ? "  REGRESSED" : ""
+        failed = failed || regressed
+    }
+    END {
+        for (h in base) if (!(h in seen)) { printf "%-10s %9.2fx %10s  (not measured)\n", h, base[h], "-" }
+        exit failed ? 1 : 0
+    }' "$1" "$2"
@@ -0,0 +1,395 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Writes a synthetic file access manifest (FAM), in the format produced by FileAccessManifest.cs and consumed by
+// FileAccessManifestParser.cpp, for running programs under libDetours.so outside of BuildXL (see run_bench.sh).
+//
+// Usage: fam_gen [options] <output file>
+//   --report <path>           file (usually a FIFO) the sandbox sends its reports to (required)
+//   --flags <hex>             FileAccessManifestFlag (default: MonitorChildProcesses | ReportAllFileAccesses)
+//   --extra-flags <hex>       FileAccessManifestExtraFlag (default: 0)
+//   --policy <hex>            cone policy of '/' (default: AllowAll | ReportAccess)
+//   --scope <path>=<hex>      cone policy of <path> (may be repeated)
+//   --translate <from>=<to>   path translation (see ManifestTranslatePathsStrings; may be repeated)
+//   --synthetic-scopes <n>    adds <n> read-only scopes under /__bxl_bench_synthetic, to get a manifest tree of a realistic size
+//   --print                   prints the resulting tree
+//
+// The manifest is parsed back before it is written, so a generator out of sync with the parser fails right away.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FileAccessManifestParser.hpp"
+
+#ifdef _DEBUG
+    #define WRITE_TAG(buf, tag) Append<uint32_t>(buf, tag)
+#else
+    #define WRITE_TAG(buf, tag)
+#endif
+
+namespace
+{
+
+struct Node
+{
+    bool hasPolicy = false;
+    uint32_t conePolicy = 0;
+    uint32_t nodePolicy = 0;
+    uint32_t pathId = 0;
+    std::map<std::string, Node> children;
+};
+
+template <typename T> void Append(std::vector<BYTE> &buf, T value)
+{
+    const BYTE *bytes = reinterpret_cast<const BYTE *>(&value);
+    buf.insert(buf.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T> void Patch(std::vector<BYTE> &buf, size_t offset, T value)
+{
+    memcpy(&buf[offset], &value, sizeof(T));
+}
+
+// Null-terminated and zero-padded to a multiple of 4 bytes (see PaddedByteString and NormalizedPathString in FileAccessManifest.cs)
+void AppendPaddedString(std::vector<BYTE> &buf, const std::string &str)
+{
+    buf.insert(buf.end(), str.begin(), str.end());
+    size_t padding = 4 - (str.length() & 3);
+    buf.insert(buf.end(), padding, 0);
+}
+
+// An empty 'WriteChars' string: just its (zero) length
+void AppendEmptyChars(std::vector<BYTE> &buf)
+{
+    Append<uint32_t>(buf, 0);
+}
+
+// A 'WriteChars' string: its length followed by its UTF-16 chars (converted from UTF-8)
+void AppendChars(std::vector<BYTE> &buf, const std::string &str)
+{
+    std::vector<char16_t> chars;
+    for (size_t i = 0; i < str.length();)
+    {
+        unsigned char c = str[i];
+        size_t length = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        uint32_t codePoint = length == 1 ? c : c & (0x7F >> length);
+        for (size_t j = 1; j < length && i + j < str.length(); j++)
+        {
+            codePoint = (codePoint << 6) | (str[i + j] & 0x3F);
+        }
+
+        if (codePoint >= 0x10000)
+        {
+            chars.push_back((char16_t)(0xD800 + ((codePoint - 0x10000) >> 10)));
+            chars.push_back((char16_t)(0xDC00 + ((codePoint - 0x10000) & 0x3FF)));
+        }
+        else
+        {
+            chars.push_back((char16_t)codePoint);
+        }
+
+        i += length;
+    }
+
+    Append<uint32_t>(buf, (uint32_t)chars.size());
+    for (char16_t c : chars)
+    {
+        Append<char16_t>(buf, c);
+    }
+}
+
+void AddScope(Node &unixRoot, const std::string &path, uint32_t policy, uint32_t &nextPathId)
+{
+    Node *node = &unixRoot;
+    size_t start = 0;
+    while (start < path.length())
+    {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) end = path.length();
+        if (end > start)
+        {
+            node = &node->children[path.substr(start, end - start)];
+        }
+
+        start = end + 1;
+    }
+
+    node->hasPolicy = true;
+    node->conePolicy = policy;
+    node->nodePolicy = policy;
+    node->pathId = ++nextPathId;
+}
+
+// Nodes without a scope of their own get the cone policy of their parent (like FinalizePolicies in FileAccessManifest.cs)
+void FinalizePolicies(Node &node, uint32_t parentConePolicy)
+{
+    if (!node.hasPolicy)
+    {
+        node.conePolicy = parentConePolicy;
+        node.nodePolicy = parentConePolicy;
+    }
+
+    for (auto &child : node.children)
+    {
+        FinalizePolicies(child.second, node.conePolicy);
+    }
+}
+
+// Mirrors Node.InternalSerialize in FileAccessManifest.cs: the children go into a hash table with linear probing,
+// whose buckets hold their offsets relative to the start of this record
+void SerializeNode(std::vector<BYTE> &buf, const Node &node, const std::string *fragment)
+{
+    size_t start = buf.size();
+    WRITE_TAG(buf, 0xF00DCAFE);
+    Append<uint32_t>(buf, fragment != nullptr ? HashPath(fragment->c_str(), fragment->length()) : 0);
+    Append<uint32_t>(buf, node.conePolicy);
+    Append<uint32_t>(buf, node.nodePolicy);
+    Append<uint32_t>(buf, node.pathId);
+    Append<uint32_t>(buf, 0); // expected USN (low)
+    Append<uint32_t>(buf, 0); // expected USN (high)
+
+    uint32_t childCount = (uint32_t)node.children.size();
+    uint32_t bucketCount = childCount == 0 ? 0 : (uint32_t)(childCount / 0.7);
+    Append<uint32_t>(buf, bucketCount);
+
+    size_t bucketsStart = buf.size();
+    buf.insert(buf.end(), bucketCount * sizeof(uint32_t), 0);
+
+    if (fragment != nullptr)
+    {
+        AppendPaddedString(buf, *fragment);
+    }
+    else
+    {
+        Append<uint32_t>(buf, 0);
+    }
+
+    std::vector<uint32_t> offsets(bucketCount, 0);
+    for (auto &child : node.children)
+    {
+        uint32_t index = HashPath(child.first.c_str(), child.first.length()) % bucketCount;
+        if (offsets[index] != 0)
+        {
+            offsets[index] |= FileAccessBucketOffsetFlag::ChainStart;
+            index = (index + 1) % bucketCount;
+            while (offsets[index] != 0)
+            {
+                offsets[index] |= FileAccessBucketOffsetFlag::ChainContinuation;
+                index = (index + 1) % bucketCount;
+            }
+        }
+
+        offsets[index] = (uint32_t)(buf.size() - start);
+        SerializeNode(buf, child.second, &child.first);
+    }
+
+    for (uint32_t i = 0; i < bucketCount; i++)
+    {
+        Patch<uint32_t>(buf, bucketsStart + i * sizeof(uint32_t), offsets[i]);
+    }
+}
+
+void Serialize(std::vector<BYTE> &buf, const std::string &reportPath, uint32_t flags, uint32_t extraFlags,
+               const std::vector<std::pair<std::string, std::string>> &translations, const Node &unixRoot)
+{
+    // debug flag and injection timeout
+#ifdef _DEBUG
+    Append<uint32_t>(buf, 0xDB600001);
+#else
+    Append<uint32_t>(buf, 0xDB600000);
+#endif
+    Append<uint32_t>(buf, 10);
+
+    // no child processes breaking away
+    WRITE_TAG(buf, 0xABCDEF05);
+    Append<uint32_t>(buf, 0);
+
+    WRITE_TAG(buf, 0xABCDEF02);
+    Append<uint32_t>(buf, (uint32_t)translations.size());
+    for (auto &translation : translations)
+    {
+        AppendChars(buf, translation.first);
+        AppendChars(buf, translation.second);
+    }
+
+    // no error dump location
+    WRITE_TAG(buf, 0xABCDEF03);
+    AppendEmptyChars(buf);
+
+    WRITE_TAG(buf, 0xF1A6B10C);
+    Append<uint32_t>(buf, flags);
+    WRITE_TAG(buf, 0xF1A6B10D);
+    Append<uint32_t>(buf, extraFlags);
+#ifdef _DEBUG
+    Append<uint32_t>(buf, 0xF1A6B10E);
+    Append<uint32_t>(buf, 0);
+#endif
+    Append<uint64_t>(buf, 0xBE4C4B1DULL);
+
+    // report path (its size is always even: a set low bit would denote a handle)
+    WRITE_TAG(buf, 0xFEEDF00D);
+    Append<uint32_t>(buf, (uint32_t)((reportPath.length() + 4) & ~3));
+    AppendPaddedString(buf, reportPath);
+
+    // no dlls to inject, no process substitution shim
+    WRITE_TAG(buf, 0xD11B10CC);
+    Append<uint32_t>(buf, 0);
+    Append<uint32_t>(buf, 0);
+    WRITE_TAG(buf, 0xABCDEF04);
+    Append<uint32_t>(buf, 0);
+    AppendEmptyChars(buf);
+
+    // the root record has a single child: the unix root sentinel (an empty fragment), under which are the scopes
+    Node root;
+    root.conePolicy = unixRoot.conePolicy;
+    root.nodePolicy = unixRoot.nodePolicy;
+    root.children.emplace("", unixRoot);
+    SerializeNode(buf, root, nullptr);
+}
+
+bool ParseHex(const char *str, uint32_t &value)
+{
+    char *end;
+    errno = 0;
+    unsigned long parsed = strtoul(str, &end, 16);
+    if (errno != 0 || end == str || *end != '\0' || parsed > UINT32_MAX)
+    {
+        return false;
+    }
+
+    value = (uint32_t)parsed;
+    return true;
+}
+
+int Usage(const char *error)
+{
+    fprintf(stderr, "fam_gen: %s\n", error);
+    fprintf(stderr, "Usage: fam_gen --report <path> [--flags <hex>] [--extra-flags <hex>] [--policy <hex>] "
+                    "[--scope <path>=<hex>]* [--translate <from>=<to>]* [--synthetic-scopes <n>] [--print] <output file>\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string reportPath;
+    std::string outputPath;
+    uint32_t flags = (uint32_t)(FileAccessManifestFlag::MonitorChildProcesses | FileAccessManifestFlag::ReportAllFileAccesses);
+    uint32_t extraFlags = 0;
+    uint32_t nextPathId = 0;
+    bool print = false;
+    std::vector<std::pair<std::string, std::string>> translations;
+
+    Node unixRoot;
+    unixRoot.hasPolicy = true;
+    unixRoot.conePolicy = unixRoot.nodePolicy = FileAccessPolicy_AllowAll | FileAccessPolicy_ReportAccess;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--print") == 0)
+        {
+            print = true;
+            continue;
+        }
+
+        if (arg[0] != '-')
+        {
+            outputPath = arg;
+            continue;
+        }
+
+        if (value == nullptr)
+        {
+            return Usage("missing option value");
+        }
+
+        i++;
+        uint32_t number;
+        if (strcmp(arg, "--report") == 0)
+        {
+            reportPath = value;
+        }
+        else if (strcmp(arg, "--flags") == 0 && ParseHex(value, number))
+        {
+            flags = number;
+        }
+        else if (strcmp(arg, "--extra-flags") == 0 && ParseHex(value, number))
+        {
+            extraFlags = number;
+        }
+        else if (strcmp(arg, "--policy") == 0 && ParseHex(value, number))
+        {
+            unixRoot.conePolicy = unixRoot.nodePolicy = number;
+        }
+        else if (strcmp(arg, "--scope") == 0 && strchr(value, '=') != nullptr && ParseHex(strchr(value, '=') + 1, number))
+        {
+            AddScope(unixRoot, std::string(value, strchr(value, '=') - value), number, nextPathId);
+        }
+        else if (strcmp(arg, "--translate") == 0 && strchr(value, '=') != nullptr)
+        {
+            translations.emplace_back(std::string(value, strchr(value, '=') - value), std::string(strchr(value, '=') + 1));
+        }
+        else if (strcmp(arg, "--synthetic-scopes") == 0)
+        {
+            int count = atoi(value);
+            for (int n = 0; n < count; n++)
+            {
+                char path[PATH_MAX];
+                snprintf(path, sizeof(path), "/__bxl_bench_synthetic/d%d/d%d/s%d", n % 16, n % 256, n);
+                AddScope(unixRoot, path, FileAccessPolicy_AllowRead | FileAccessPolicy_AllowReadIfNonExistent, nextPathId);
+            }
+        }
+        else
+        {
+            return Usage("invalid option");
+        }
+    }
+
+    if (reportPath.empty() || outputPath.empty())
+    {
+        return Usage("both --report and an output file are required");
+    }
+
+    FinalizePolicies(unixRoot, unixRoot.conePolicy);
+
+    std::vector<BYTE> payload;
+    Serialize(payload, reportPath, flags, extraFlags, translations, unixRoot);
+
+    FileAccessManifestParseResult parsed;
+    if (!parsed.init(payload.data(), payload.size()))
+    {
+        fprintf(stderr, "fam_gen: the generated manifest does not parse: %s\n", parsed.Error());
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, std::string>> parsedTranslations;
+    parsed.GetTranslatePaths(parsedTranslations);
+    if (parsedTranslations != translations)
+    {
+        fprintf(stderr, "fam_gen: the translations of the generated manifest do not parse back\n");
+        return 1;
+    }
+
+    if (print)
+    {
+        FileAccessManifestParseResult::PrintManifestTree(parsed.GetManifestRootNode());
+    }
+
+    FILE *out = fopen(outputPath.c_str(), "wb");
+    if (out == nullptr || fwrite(payload.data(), 1, payload.size(), out) != payload.size() || fclose(out) != 0)
+    {
+        fprintf(stderr, "fam_gen: could not write '%s': %s\n", outputPath.c_str(), strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
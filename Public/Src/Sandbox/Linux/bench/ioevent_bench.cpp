@@ -0,0 +1,242 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Compares the two wire formats of 'IOEvent': the '|'-delimited text written and parsed with iostreams that the
+// interposing library and the sandbox used to exchange, and the binary format of 'IOEvent::Serialize'.
+//
+// Usage: ioevent_bench [events] [rounds]
+//   [events]      number of distinct events (default: 10000)
+//   [rounds]      number of times every event is encoded and decoded (default: 50)
+//
+// Before measuring, checks that every field of every event survives a binary round trip, including paths with
+// spaces, '|' and new lines, which the text format cannot carry.  Exits with 1 on the first mismatch.
+//
+// Prints one line per step: "<step>\t<text events per second>\t<binary events per second>".
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <istream>
+#include <locale>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "IOEvent.hpp"
+#include "MemoryStreams.hpp"
+
+namespace
+{
+
+const char *kNames[] =
+{
+    "Engine", "Cache", "Sandbox", "Linux", "bin", "obj", "Release", "netcoreapp3.1", "include", "lib",
+    "My Documents", "a|b", "line\nbreak", "Out Dir",
+};
+
+uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void Check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "ioevent_bench: %s\n", what);
+        exit(1);
+    }
+}
+
+std::string GeneratePath(std::mt19937_64 &rng, bool textSafe)
+{
+    std::string path = "/home/builder/src";
+    int depth = 2 + rng() % 6;
+    for (int i = 0; i < depth; i++)
+    {
+        const char *name;
+        do
+        {
+            name = kNames[rng() % (sizeof(kNames) / sizeof(kNames[0]))];
+        } while (textSafe && strpbrk(name, "|\n") != nullptr);
+
+        path += '/';
+        path += name;
+    }
+
+    return path + std::to_string(rng() % 1000) + ".o";
+}
+
+// 'textSafe' events only have paths the text format can carry (no '|' nor new line), and always a destination path
+// (the text format drops empty strings, so an empty one would shift the fields that follow it)
+std::vector<IOEvent> GenerateEvents(std::mt19937_64 &rng, int count, bool textSafe)
+{
+    std::vector<IOEvent> events;
+    for (int i = 0; i < count; i++)
+    {
+        pid_t pid = 2 + rng() % 4194302;
+        bool hasDst = textSafe || rng() % 4 == 0;
+        events.emplace_back(pid,
+                            rng() % 2 == 0 ? 0 : pid + 1,
+                            pid - 1,
+                            (es_event_type_t)(rng() % ES_EVENT_TYPE_LAST),
+                            rng() % 2 == 0 ? ES_ACTION_TYPE_NOTIFY : ES_ACTION_TYPE_AUTH,
+                            GeneratePath(rng, textSafe),
+                            hasDst ? GeneratePath(rng, textSafe) : std::string(),
+                            "/usr/bin/clang++",
+                            (mode_t)(rng() % 2 == 0 ? S_IFREG | 0644 : S_IFDIR | 0755),
+                            rng() % 2 == 0);
+    }
+
+    return events;
+}
+
+bool SameEvent(const IOEvent &a, const IOEvent &b)
+{
+    return
+        a.GetPid() == b.GetPid() &&
+        a.GetChildPid() == b.GetChildPid() &&
+        a.GetParentPid() == b.GetParentPid() &&
+        a.GetOriginalParentPid() == b.GetOriginalParentPid() &&
+        a.GetEventType() == b.GetEventType() &&
+        a.GetActionType() == b.GetActionType() &&
+        a.GetMode() == b.GetMode() &&
+        a.FSEntryModified() == b.FSEntryModified() &&
+        strcmp(a.GetExecutablePath(), b.GetExecutablePath()) == 0 &&
+        a.GetSrcPath() == b.GetSrcPath() &&
+        a.GetDstPath() == b.GetDstPath();
+}
+
+// The text format, as the interposing library wrote it and the sandbox parsed it
+size_t WriteText(const IOEvent &event, char *buffer, size_t size)
+{
+    omemorystream oms(buffer, size);
+    oms
+    << event.GetPid()              << "|"
+    << event.GetChildPid()         << "|"
+    << event.GetParentPid()        << "|"
+    << event.GetEventType()        << "|"
+    << event.GetActionType()       << "|"
+    << event.GetMode()             << "|"
+    << event.FSEntryModified()     << "|"
+    << event.GetExecutablePath()   << "|"
+    << event.GetSrcPath()          << "|"
+    << event.GetDstPath()          << "|"
+    << '\0';
+
+    // sent as a C string
+    return strlen(buffer);
+}
+
+IOEvent ReadText(const char *buffer, size_t size)
+{
+    imemorystream ims(buffer, size);
+    ims.imbue(std::locale(ims.getloc(), new PipeDelimiter));
+
+    pid_t pid, cpid, ppid;
+    unsigned int type, action;
+    mode_t mode;
+    bool modified;
+    std::string executable, src, dst;
+    ims >> pid >> cpid >> ppid >> type >> action >> mode >> modified >> executable >> src >> dst;
+
+    return IOEvent(pid, cpid, ppid, (es_event_type_t)type, (es_action_type_t)action, src, dst, executable, mode, modified);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc > 3)
+    {
+        fprintf(stderr, "Usage: ioevent_bench [events] [rounds]\n");
+        return 2;
+    }
+
+    int count = argc > 1 ? atoi(argv[1]) : 10000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 50;
+    if (count <= 0 || rounds <= 0)
+    {
+        fprintf(stderr, "ioevent_bench: invalid number of events or rounds\n");
+        return 2;
+    }
+
+    std::mt19937_64 rng(0xB1B);
+    std::vector<char> buffer(IOEvent::max_size());
+
+    // Binary round trip of arbitrary events
+    for (const IOEvent &event : GenerateEvents(rng, count, /* textSafe */ false))
+    {
+        size_t length = event.Serialize(buffer.data(), buffer.size());
+        Check(length == event.Size(), "Serialize did not write Size() bytes");
+        Check(event.Serialize(buffer.data(), length - 1) == 0, "Serialize wrote into a buffer that is too small");
+
+        IOEventView view;
+        Check(IOEvent::Deserialize(buffer.data(), length, view), "Deserialize failed");
+        Check(SameEvent(event, IOEvent(view)), "binary round trip changed the event");
+        Check(view.srcPath.data > buffer.data() && view.srcPath.data < buffer.data() + length, "Deserialize copied a path");
+        Check(!IOEvent::Deserialize(buffer.data(), length - 1, view), "Deserialize accepted a truncated event");
+        Check(!IOEvent::Deserialize(buffer.data(), length + 1, view), "Deserialize accepted trailing bytes");
+    }
+
+    // Both formats, on events both can carry
+    std::vector<IOEvent> events = GenerateEvents(rng, count, /* textSafe */ true);
+    std::vector<std::vector<char>> text(count), binary(count);
+    double ops = (double)count * rounds;
+    uint64_t textWrite = 0, textRead = 0, binaryWrite = 0, binaryRead = 0;
+    size_t textBytes = 0, binaryBytes = 0;
+
+    for (int r = 0; r < rounds; r++)
+    {
+        uint64_t start = NowNs();
+        for (int i = 0; i < count; i++)
+        {
+            size_t length = WriteText(events[i], buffer.data(), buffer.size());
+            text[i].assign(buffer.data(), buffer.data() + length);
+        }
+        textWrite += NowNs() - start;
+
+        start = NowNs();
+        for (int i = 0; i < count; i++)
+        {
+            size_t length = events[i].Serialize(buffer.data(), buffer.size());
+            binary[i].assign(buffer.data(), buffer.data() + length);
+        }
+        binaryWrite += NowNs() - start;
+
+        start = NowNs();
+        for (int i = 0; i < count; i++)
+        {
+            IOEvent event = ReadText(text[i].data(), text[i].size());
+            Check(event.GetPid() == events[i].GetPid(), "text round trip changed the event");
+        }
+        textRead += NowNs() - start;
+
+        start = NowNs();
+        for (int i = 0; i < count; i++)
+        {
+            IOEventView event;
+            Check(IOEvent::Deserialize(binary[i].data(), binary[i].size(), event), "Deserialize failed");
+            Check(event.pid == events[i].GetPid(), "binary round trip changed the event");
+        }
+        binaryRead += NowNs() - start;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        Check(SameEvent(events[i], ReadText(text[i].data(), text[i].size())), "text round trip changed the event");
+        textBytes += text[i].size();
+        binaryBytes += binary[i].size();
+    }
+
+    printf("# step\ttext_events_per_s\tbinary_events_per_s\n");
+    printf("serialize\t%.0f\t%.0f\n", ops * 1e9 / textWrite, ops * 1e9 / binaryWrite);
+    printf("deserialize\t%.0f\t%.0f\n", ops * 1e9 / textRead, ops * 1e9 / binaryRead);
+    printf("bytes_per_event\t%.1f\t%.1f\n", (double)textBytes / count, (double)binaryBytes / count);
+    return 0;
+}
@@ -0,0 +1,218 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Checks the debug log of the sandbox ('SandboxLog', bxl_log.hpp): buffering, levels, filtering by hook
+// (__BUILDXL_LOG_HOOKS) and the hand-over of the log to a forked child.  Exits with 1 on the first failed check.
+//
+// Usage: log_test <directory for the log files>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+
+#include "bxl_log.hpp"
+
+thread_local bool SandboxLog::sInFilteredHook = false;
+SandboxLog *SandboxLog::sActive = NULL;
+
+namespace
+{
+
+std::string g_dir;
+
+int Open(const char *path, int flags, mode_t mode)
+{
+    return open(path, flags, mode);
+}
+
+void Check(bool condition, const std::string &what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "log_test: %s\n", what.c_str());
+        exit(1);
+    }
+}
+
+std::string LogPath(const char *name)
+{
+    std::string path = g_dir + "/" + name;
+    unlink(path.c_str());
+    return path;
+}
+
+std::string ReadFile(const std::string &path)
+{
+    std::string content;
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL)
+    {
+        return content;
+    }
+
+    char buffer[4096];
+    size_t numRead;
+    while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        content.append(buffer, numRead);
+    }
+
+    fclose(file);
+    return content;
+}
+
+size_t CountOccurrences(const std::string &content, const std::string &what)
+{
+    size_t count = 0;
+    for (size_t pos = content.find(what); pos != std::string::npos; pos = content.find(what, pos + 1))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+// lines are kept in the buffer until it fills up, an error is logged, or the log is flushed
+void CheckBuffering()
+{
+    std::string path = LogPath("buffering.log");
+    SandboxLog log;
+    log.Init(path.c_str(), "info", NULL, Open, write);
+
+    log.Log(kLogInfo, "first %d", 1);
+    Check(ReadFile(path).empty(), "a line was written before the log was flushed");
+
+    log.Flush();
+    char expected[64];
+    snprintf(expected, sizeof(expected), "[log_test:%d] first 1\n", getpid());
+    Check(ReadFile(path) == expected, "flushed log is '" + ReadFile(path) + "', expected '" + expected + "'");
+
+    log.Log(kLogInfo, "second");
+    log.Log(kLogError, "failure");
+    Check(CountOccurrences(ReadFile(path), "second") == 1 && CountOccurrences(ReadFile(path), "failure") == 1, "logging an error did not flush the log");
+
+    // a full buffer is written out before the next line is added to it
+    size_t numLines = 2 * SandboxLog::BUFFER_SIZE / 64;
+    for (size_t i = 0; i < numLines; i++)
+    {
+        log.Log(kLogInfo, "%060zu", i);
+    }
+
+    size_t written = CountOccurrences(ReadFile(path), "\n") - 3;
+    Check(written > 0 && written < numLines, "a full buffer was not written out (" + std::to_string(written) + " lines written)");
+
+    log.Flush();
+    Check(CountOccurrences(ReadFile(path), "\n") - 3 == numLines, "lines were lost when the buffer filled up");
+}
+
+void CheckLevels()
+{
+    struct { const char *value; BxlLogLevel level; } cases[] =
+    {
+        { "none", kLogNone }, { "error", kLogError }, { "INFO", kLogInfo }, { "debug", kLogDebug }, { "trace", kLogTrace },
+        { "1", kLogError }, { "3", kLogDebug }, { "bogus", kLogTrace },
+#if _DEBUG
+        { "", kLogTrace },
+#else
+        { "", kLogError },
+#endif
+    };
+
+    for (auto &c : cases)
+    {
+        SandboxLog log;
+        log.Init(LogPath("levels.log").c_str(), c.value, NULL, Open, write);
+        for (int level = kLogError; level <= kLogTrace; level++)
+        {
+            Check(log.IsEnabled((BxlLogLevel)level) == (level <= c.level),
+                std::string("level ") + std::to_string(level) + " with __BUILDXL_LOG_LEVEL='" + c.value + "'");
+        }
+    }
+
+    // without a path there is no log at all
+    SandboxLog log;
+    log.Init("", "trace", NULL, Open, write);
+    Check(!log.IsOn() && !log.IsEnabled(kLogError), "log enabled without a path");
+}
+
+void CheckHookFiltering()
+{
+    SandboxLog log;
+    log.Init(LogPath("hooks.log").c_str(), "trace", "open,stat", Open, write);
+    Check(log.IsHookLogged("open") && log.IsHookLogged("stat"), "listed hooks are not logged");
+    Check(!log.IsHookLogged("openat") && !log.IsHookLogged("sta"), "unlisted hooks are logged");
+
+    {
+        HookLogScope filtered(log, /*hookLogged*/ false);
+        Check(!log.IsEnabled(kLogError), "lines are logged while a filtered hook runs");
+        {
+            // e.g., a logged hook called from a filtered one
+            HookLogScope logged(log, /*hookLogged*/ true);
+            Check(log.IsEnabled(kLogTrace), "lines are not logged while a listed hook runs");
+        }
+
+        Check(!log.IsEnabled(kLogError), "leaving a nested hook did not restore the filter");
+    }
+
+    Check(log.IsEnabled(kLogTrace), "leaving a filtered hook did not restore the filter");
+
+    SandboxLog all;
+    all.Init(LogPath("all-hooks.log").c_str(), "trace", "", Open, write);
+    Check(all.IsHookLogged("anything"), "hooks are filtered when __BUILDXL_LOG_HOOKS is empty");
+}
+
+// a child discards the lines of its parent once it is told it was forked, and logs nothing before that
+void CheckFork()
+{
+    std::string path = LogPath("fork.log");
+    SandboxLog log;
+    log.Init(path.c_str(), "info", NULL, Open, write);
+    log.Log(kLogInfo, "parent before fork");
+
+    pid_t child = fork();
+    Check(child != -1, "fork failed");
+    if (child == 0)
+    {
+        log.Log(kLogInfo, "child before hand-over");
+        log.Flush();
+        log.OnForked(getpid());
+        log.Log(kLogInfo, "child after hand-over");
+        log.Flush();
+        _exit(0);
+    }
+
+    int status;
+    Check(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0, "child failed");
+
+    log.Log(kLogInfo, "parent after fork");
+    log.Flush();
+
+    std::string content = ReadFile(path);
+    Check(CountOccurrences(content, "parent before fork") == 1, "the lines of the parent were not written exactly once: " + content);
+    Check(CountOccurrences(content, "parent after fork") == 1, "a line of the parent was lost: " + content);
+    Check(CountOccurrences(content, "child before hand-over") == 0, "the child logged before it was told it was forked: " + content);
+    Check(CountOccurrences(content, "child after hand-over") == 1, "the child did not log after it was told it was forked: " + content);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <directory for the log files>\n", argv[0]);
+        return 2;
+    }
+
+    g_dir = argv[1];
+    CheckBuffering();
+    CheckLevels();
+    CheckHookFiltering();
+    CheckFork();
+    printf("log_test: all checks passed\n");
+    return 0;
+}
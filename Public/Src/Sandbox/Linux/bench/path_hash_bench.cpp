@@ -0,0 +1,374 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Measures 'HashPath' and 'ArePathsEqual' (StringOperations.cpp), which run for every path component of every policy
+// lookup, against the character-at-a-time loops they replaced.
+//
+// Usage: path_hash_bench [components] [rounds]
+//   [components]  number of path components per distribution (default: 100000)
+//   [rounds]      number of times every component is hashed and compared (default: 20)
+//
+// Before measuring, checks that:
+//   - the hashes are bit-identical to those of the old loop (the managed side builds the manifest with them),
+//     including for non-ASCII (UTF-8) components;
+//   - 'ArePathsEqual' agrees with the old loop, and never reads past the page a shorter normalized path ends in;
+//   - 'AsciiBlockToUpper' upper-cases 8-bit and 16-bit ASCII characters like the scalar code, and rejects any block
+//     with a non-ASCII character (this is the fast path of the platforms where paths are case-insensitive).
+// Exits with 1 on the first mismatch.
+//
+// Prints one line per distribution of component lengths and operation:
+// "<distribution>\t<operation>\t<old ns per component>\t<new ns per component>".  'upper_fold' compares hashing with
+// upper-casing through 'towupper' to the block fast path, as done where NormalizePathChar is not the identity.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wctype.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "stdafx.h"
+#include "StringOperations.h"
+
+namespace
+{
+
+const DWORD kFnv1Prime32 = 16777619;
+const DWORD kFnv1Basis32 = 2166136261u;
+
+// How many times every measurement is repeated (the best time is kept)
+const int kRepetitions = 5;
+
+struct Distribution
+{
+    const char *name;
+    int minLength, maxLength;
+};
+
+// Component lengths: file and directory names are mostly short, hashed object directories and generated files
+// longer; 'mixed' roughly follows the lengths of the components of the paths of a build
+const Distribution kDistributions[] =
+{
+    { "short",  1,  8 },
+    { "medium", 8,  24 },
+    { "long",   24, 64 },
+    { "mixed",  0,  0 },
+};
+
+uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void Check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "path_hash_bench: %s\n", what);
+        exit(1);
+    }
+}
+
+// The loops HashPath and ArePathsEqual used to run (not inlined, like the functions of StringOperations.cpp they are
+// compared with)
+__attribute__((noinline)) DWORD OldHashPath(PCPathChar path, size_t length)
+{
+    DWORD hash = kFnv1Basis32;
+    for (size_t i = 0; i < length; i++)
+    {
+        WORD c = (WORD)NormalizePathChar(path[i]);
+        hash = (hash * kFnv1Prime32) ^ (BYTE)c;
+        hash = (hash * kFnv1Prime32) ^ (BYTE)(c >> 8);
+    }
+
+    return hash;
+}
+
+__attribute__((noinline)) bool OldArePathsEqual(PCPathChar path, PCPathChar normalizedPath, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        if (NormalizePathChar(path[i]) != normalizedPath[i])
+        {
+            return false;
+        }
+    }
+
+    return !normalizedPath[i];
+}
+
+// Upper-casing hash, scalar and with the block fast path, over 16-bit characters (as on Windows)
+DWORD UpperFoldScalar(const char16_t *path, size_t length)
+{
+    DWORD hash = kFnv1Basis32;
+    for (size_t i = 0; i < length; i++)
+    {
+        WORD c = (WORD)towupper(path[i]);
+        hash = (hash * kFnv1Prime32) ^ (BYTE)c;
+        hash = (hash * kFnv1Prime32) ^ (BYTE)(c >> 8);
+    }
+
+    return hash;
+}
+
+DWORD UpperFoldBlock(const char16_t *path, size_t length)
+{
+    const size_t kBlockLength = sizeof(uint64_t) / sizeof(char16_t);
+    DWORD hash = kFnv1Basis32;
+    size_t i = 0;
+    for (; i + kBlockLength <= length; i += kBlockLength)
+    {
+        uint64_t block;
+        memcpy(&block, path + i, sizeof(block));
+
+        char16_t upper[kBlockLength];
+        if (AsciiBlockToUpper<char16_t>(block))
+        {
+            memcpy(upper, &block, sizeof(block));
+        }
+        else
+        {
+            for (size_t j = 0; j < kBlockLength; j++) upper[j] = (char16_t)towupper(path[i + j]);
+        }
+
+        for (size_t j = 0; j < kBlockLength; j++)
+        {
+            hash = (hash * kFnv1Prime32) ^ (BYTE)upper[j];
+            hash = (hash * kFnv1Prime32) ^ (BYTE)(upper[j] >> 8);
+        }
+    }
+
+    for (; i < length; i++)
+    {
+        WORD c = (WORD)towupper(path[i]);
+        hash = (hash * kFnv1Prime32) ^ (BYTE)c;
+        hash = (hash * kFnv1Prime32) ^ (BYTE)(c >> 8);
+    }
+
+    return hash;
+}
+
+int ComponentLength(std::mt19937_64 &rng, const Distribution &distribution)
+{
+    if (distribution.maxLength > 0)
+    {
+        return distribution.minLength + rng() % (distribution.maxLength - distribution.minLength + 1);
+    }
+
+    // mixed: mostly short names, some medium ones, a few long (hashed) ones
+    switch (rng() % 10)
+    {
+        case 0:  return 24 + rng() % 41;
+        case 1:
+        case 2:
+        case 3:  return 9 + rng() % 16;
+        default: return 1 + rng() % 8;
+    }
+}
+
+std::string Component(std::mt19937_64 &rng, int length, bool nonAscii)
+{
+    static const char kChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._-";
+    std::string component;
+    while ((int)component.length() < length)
+    {
+        if (nonAscii && rng() % 8 == 0 && (int)component.length() + 2 <= length)
+        {
+            component += "\xC3\xA9"; // U+00E9
+        }
+        else
+        {
+            component += kChars[rng() % (sizeof(kChars) - 1)];
+        }
+    }
+
+    return component;
+}
+
+void CheckHashes(std::mt19937_64 &rng)
+{
+    for (int n = 0; n < 20000; n++)
+    {
+        std::string component = Component(rng, rng() % 80, n % 2 == 0);
+        Check(HashPath(component.c_str(), component.length()) == OldHashPath(component.c_str(), component.length()),
+              "HashPath differs from the old loop");
+
+        std::vector<char> buffer(component.length() + 1);
+        DWORD hash = NormalizeAndHashPath(component.c_str(), (PBYTE)buffer.data(), (DWORD)buffer.size());
+        Check(hash == OldHashPath(component.c_str(), component.length()), "NormalizeAndHashPath differs from the old loop");
+        Check(memcmp(buffer.data(), component.c_str(), buffer.size()) == 0, "NormalizeAndHashPath did not normalize as before");
+    }
+}
+
+void CheckEquality(std::mt19937_64 &rng)
+{
+    for (int n = 0; n < 20000; n++)
+    {
+        std::string path = Component(rng, rng() % 80, n % 2 == 0);
+        std::string normalized = path;
+        switch (n % 4)
+        {
+            case 0:  break;
+            case 1:  if (!normalized.empty()) normalized[rng() % normalized.length()] ^= 1; break;
+            case 2:  normalized = normalized.substr(0, normalized.empty() ? 0 : rng() % normalized.length()); break;
+            default: normalized += Component(rng, 1 + rng() % 16, false); break;
+        }
+
+        Check(ArePathsEqual(path.c_str(), normalized.c_str(), path.length()) ==
+              OldArePathsEqual(path.c_str(), normalized.c_str(), path.length()),
+              "ArePathsEqual differs from the old loop");
+    }
+
+    // Normalized paths that end right before an inaccessible page, compared with longer paths
+    long pageSize = sysconf(_SC_PAGESIZE);
+    char *pages = (char *)mmap(nullptr, 2 * pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    Check(pages != MAP_FAILED, "mmap failed");
+    Check(mprotect(pages + pageSize, pageSize, PROT_NONE) == 0, "mprotect failed");
+
+    std::string path = Component(rng, 64, false);
+    for (size_t length = 0; length < 32; length++)
+    {
+        char *normalized = pages + pageSize - length - 1;
+        memcpy(normalized, path.c_str(), length);
+        normalized[length] = 0;
+        Check(!ArePathsEqual(path.c_str(), normalized, path.length()), "a shorter normalized path is equal");
+        Check(ArePathsEqual(path.c_str(), normalized, length), "a normalized path at the end of a page differs");
+    }
+
+    munmap(pages, 2 * pageSize);
+}
+
+template <typename TChar>
+void CheckAsciiBlocks(std::mt19937_64 &rng)
+{
+    const size_t kBlockLength = sizeof(uint64_t) / sizeof(TChar);
+    for (int n = 0; n < 200000; n++)
+    {
+        TChar chars[kBlockLength];
+        bool ascii = true;
+        for (size_t j = 0; j < kBlockLength; j++)
+        {
+            // mostly ASCII, with the boundaries of the lower case range
+            uint64_t r = rng();
+            chars[j] = r % 16 == 0 ? (TChar)(0x80 + (r >> 8) % (sizeof(TChar) == 1 ? 0x80 : 0xFF80))
+                     : r % 16 == 1 ? (TChar)"`az{@AZ["[(r >> 8) % 8]
+                                   : (TChar)((r >> 8) % 0x80);
+            ascii &= (typename std::make_unsigned<TChar>::type)chars[j] < 0x80;
+        }
+
+        uint64_t block;
+        memcpy(&block, chars, sizeof(block));
+        uint64_t original = block;
+        bool converted = AsciiBlockToUpper<TChar>(block);
+        Check(converted == ascii, "AsciiBlockToUpper misclassified a block");
+        if (!converted)
+        {
+            Check(block == original, "AsciiBlockToUpper changed a non-ASCII block");
+            continue;
+        }
+
+        TChar upper[kBlockLength];
+        memcpy(upper, &block, sizeof(block));
+        for (size_t j = 0; j < kBlockLength; j++)
+        {
+            TChar expected = chars[j] >= 'a' && chars[j] <= 'z' ? chars[j] - 'a' + 'A' : chars[j];
+            Check(upper[j] == expected, "AsciiBlockToUpper did not upper-case like the scalar code");
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc > 3)
+    {
+        fprintf(stderr, "Usage: path_hash_bench [components] [rounds]\n");
+        return 2;
+    }
+
+    int count = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    if (count <= 0 || rounds <= 0)
+    {
+        fprintf(stderr, "path_hash_bench: invalid number of components or rounds\n");
+        return 2;
+    }
+
+    std::mt19937_64 rng(0xB1B);
+    CheckHashes(rng);
+    CheckEquality(rng);
+    CheckAsciiBlocks<char>(rng);
+    CheckAsciiBlocks<char16_t>(rng);
+
+    printf("# distribution\toperation\told_ns\tnew_ns\n");
+    double ops = (double)count * rounds;
+    for (const Distribution &distribution : kDistributions)
+    {
+        std::vector<std::string> components, copies;
+        std::vector<std::u16string> wideComponents;
+        for (int i = 0; i < count; i++)
+        {
+            components.push_back(Component(rng, ComponentLength(rng, distribution), false));
+            copies.push_back(components.back());
+            wideComponents.push_back(std::u16string(components.back().begin(), components.back().end()));
+        }
+
+        // old and new take turns, and each keeps its best time, so that neither pays for warming up the caches
+        // alone; the sums keep the compiler from dropping the calls
+        double oldHash = 1e9, newHash = 1e9, oldCompare = 1e9, newCompare = 1e9, oldUpper = 1e9, newUpper = 1e9;
+        for (int repetition = 0; repetition < kRepetitions; repetition++)
+        {
+            DWORD oldSum = 0, newSum = 0;
+            uint64_t start = NowNs();
+            for (int r = 0; r < rounds; r++)
+                for (const std::string &c : components) oldSum += OldHashPath(c.c_str(), c.length());
+            oldHash = std::min(oldHash, (NowNs() - start) / ops);
+
+            start = NowNs();
+            for (int r = 0; r < rounds; r++)
+                for (const std::string &c : components) newSum += HashPath(c.c_str(), c.length());
+            newHash = std::min(newHash, (NowNs() - start) / ops);
+            Check(oldSum == newSum, "HashPath differs from the old loop");
+
+            int oldEqual = 0, newEqual = 0;
+            start = NowNs();
+            for (int r = 0; r < rounds; r++)
+                for (int i = 0; i < count; i++) oldEqual += OldArePathsEqual(components[i].c_str(), copies[i].c_str(), components[i].length());
+            oldCompare = std::min(oldCompare, (NowNs() - start) / ops);
+
+            start = NowNs();
+            for (int r = 0; r < rounds; r++)
+                for (int i = 0; i < count; i++) newEqual += ArePathsEqual(components[i].c_str(), copies[i].c_str(), components[i].length());
+            newCompare = std::min(newCompare, (NowNs() - start) / ops);
+            Check(oldEqual == newEqual && newEqual == count * rounds, "ArePathsEqual differs from the old loop");
+
+            oldSum = newSum = 0;
+            start = NowNs();
+            for (int r = 0; r < rounds; r++)
+                for (const std::u16string &c : wideComponents) oldSum += UpperFoldScalar(c.c_str(), c.length());
+            oldUpper = std::min(oldUpper, (NowNs() - start) / ops);
+
+            start = NowNs();
+            for (int r = 0; r < rounds; r++)
+                for (const std::u16string &c : wideComponents) newSum += UpperFoldBlock(c.c_str(), c.length());
+            newUpper = std::min(newUpper, (NowNs() - start) / ops);
+            Check(oldSum == newSum, "the block fast path upper-cases differently from towupper");
+        }
+
+        printf("%s\thash_path\t%.1f\t%.1f\n", distribution.name, oldHash, newHash);
+        printf("%s\tare_paths_equal\t%.1f\t%.1f\n", distribution.name, oldCompare, newCompare);
+        printf("%s\tupper_fold\t%.1f\t%.1f\n", distribution.name, oldUpper, newUpper);
+    }
+
+    return 0;
+}
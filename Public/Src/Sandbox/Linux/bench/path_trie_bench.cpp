@@ -0,0 +1,207 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Measures the memory footprint and the speed of a path 'Trie' holding the paths a build touches.
+//
+// Usage: path_trie_bench <manifest> [paths]
+//   <manifest>    a FAM written by fam_gen, needed to create the values stored in the trie
+//   [paths]       number of generated paths (default: 1000000)
+//
+// The paths look like those of a build: a handful of roots (source tree, object directories with content-hashed
+// names, system headers and libraries, temp directories), a few levels of directories from a small vocabulary, and
+// file names with common extensions, in mixed case.  Prints "<metric>\t<value>" lines.
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "bench_pip.hpp"
+#include "SandboxedProcess.hpp"
+#include "Trie.hpp"
+
+namespace
+{
+
+typedef Trie<SandboxedProcess> PathTrie;
+
+const char *kRoots[] =
+{
+    "/home/builder/src/BuildXL/Public/Src/",
+    "/home/builder/src/BuildXL/Out/Objects/",
+    "/home/builder/.nuget/packages/",
+    "/usr/include/",
+    "/usr/lib/x86_64-linux-gnu/",
+    "/tmp/bxl/Pip",
+};
+
+const char *kDirs[] =
+{
+    "Engine", "Cache", "Core", "Utilities", "Interop", "Sandbox", "Linux", "MacOs", "Windows", "Tools", "Test",
+    "Processes", "Storage", "Scheduler", "Pips", "Native", "Common", "Collections", "Tracing", "bin", "obj",
+    "Release", "Debug", "netcoreapp3.1", "net472", "linux-x64", "include", "src", "lib", "runtimes", "ref",
+};
+
+const char *kExtensions[] =
+{
+    ".cs", ".cpp", ".hpp", ".h", ".c", ".o", ".dll", ".pdb", ".so", ".json", ".dsc", ".txt", ".xml", ".props",
+};
+
+uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+std::string RandomCase(std::mt19937_64 &rng, std::string str)
+{
+    for (char &ch : str)
+    {
+        if (rng() % 4 == 0) ch = isupper(ch) ? tolower(ch) : toupper(ch);
+    }
+
+    return str;
+}
+
+std::string GeneratePath(std::mt19937_64 &rng)
+{
+    static const char kHex[] = "0123456789abcdef";
+    std::string path = kRoots[rng() % (sizeof(kRoots) / sizeof(kRoots[0]))];
+
+    // object directories and temp directories have content-hashed (or pip-id) names
+    if (path.back() != '/')
+    {
+        for (int i = 0; i < 16; i++) path += kHex[rng() % 16];
+        path += '/';
+    }
+    else if (path.find("Objects") != std::string::npos)
+    {
+        path += kHex[rng() % 16];
+        path += '/';
+        for (int i = 0; i < 8; i++) path += kHex[rng() % 16];
+        path += '/';
+    }
+
+    int depth = 1 + rng() % 5;
+    for (int i = 0; i < depth; i++)
+    {
+        path += kDirs[rng() % (sizeof(kDirs) / sizeof(kDirs[0]))];
+        path += '/';
+    }
+
+    path += kDirs[rng() % (sizeof(kDirs) / sizeof(kDirs[0]))];
+    path += std::to_string(rng() % 1000);
+    path += kExtensions[rng() % (sizeof(kExtensions) / sizeof(kExtensions[0]))];
+    return path;
+}
+
+std::string Lower(std::string str)
+{
+    std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+    return str;
+}
+
+void Check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "path_trie_bench: %s\n", what);
+        exit(1);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: path_trie_bench <manifest> [paths]\n");
+        return 2;
+    }
+
+    int count = argc > 2 ? atoi(argv[2]) : 1000000;
+    if (count <= 0)
+    {
+        fprintf(stderr, "path_trie_bench: invalid number of paths\n");
+        return 2;
+    }
+
+    std::shared_ptr<SandboxedPip> pip = LoadBenchPip("path_trie_bench", argv[1]);
+    std::shared_ptr<SandboxedProcess> value = std::make_shared<SandboxedProcess>(getpid(), pip);
+
+    // paths are case-insensitive: generate 'count' distinct ones, and look them up with a different casing
+    std::mt19937_64 rng(0xB1B);
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> paths, lookups, misses;
+    size_t totalLength = 0;
+    while ((int)paths.size() < count)
+    {
+        std::string path = GeneratePath(rng);
+        if (seen.insert(Lower(path)).second)
+        {
+            totalLength += path.length();
+            paths.push_back(path);
+        }
+    }
+
+    for (const std::string &path : paths)
+    {
+        lookups.push_back(RandomCase(rng, path));
+        misses.push_back(path + "~");
+    }
+
+    std::shuffle(lookups.begin(), lookups.end(), rng);
+
+    uint nodesBefore;
+    double mbBefore;
+    PathTrie::getPathNodeCounts(&nodesBefore, &mbBefore);
+
+    PathTrie *trie = PathTrie::createPathTrie();
+    uint64_t start = NowNs();
+    for (const std::string &path : paths)
+    {
+        Check(trie->insert(path.c_str(), value) == kTrieResultInserted, "insert failed");
+    }
+    double insertNs = (double)(NowNs() - start) / count;
+    Check(trie->getCount() == (uint)count, "wrong number of entries");
+
+    uint nodes;
+    double mb;
+    PathTrie::getPathNodeCounts(&nodes, &mb);
+    nodes -= nodesBefore;
+    mb -= mbBefore;
+
+    start = NowNs();
+    for (const std::string &path : lookups)
+    {
+        Check(trie->get(path.c_str()) == value, "lookup failed");
+    }
+    double lookupNs = (double)(NowNs() - start) / count;
+
+    start = NowNs();
+    for (const std::string &path : misses)
+    {
+        Check(trie->get(path.c_str()) == nullptr, "lookup of a missing path succeeded");
+    }
+    double missNs = (double)(NowNs() - start) / count;
+    delete trie;
+
+    printf("paths\t%d\n", count);
+    printf("average_path_length\t%.1f\n", (double)totalLength / count);
+    printf("nodes\t%u\n", nodes);
+    printf("memory_mb\t%.1f\n", mb);
+    printf("bytes_per_path\t%.1f\n", mb * (1 << 20) / count);
+    printf("insert_ns\t%.1f\n", insertNs);
+    printf("lookup_ns\t%.1f\n", lookupNs);
+    printf("lookup_miss_ns\t%.1f\n", missNs);
+    return 0;
+}
@@ -0,0 +1,225 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Compares the two containers that can track the processes of the sandbox: the uint 'Trie' and 'ConcurrentPidMap'.
+//
+// Usage: pid_map_bench <manifest> [processes] [rounds]
+//   <manifest>    a FAM written by fam_gen, needed to create the pip all the tracked processes belong to
+//   [processes]   number of processes tracked at once (default: 1000)
+//   [rounds]      number of times every operation is repeated (default: 200)
+//
+// Prints one line per operation: "<operation>\t<trie ns per op>\t<pid map ns per op>".  The pids are random numbers
+// below the default pid_max of 64-bit systems (4194304), which is what a long-running build host hands out.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "bench_pip.hpp"
+#include "ConcurrentPidMap.hpp"
+#include "SandboxedProcess.hpp"
+#include "Trie.hpp"
+
+namespace
+{
+
+typedef std::shared_ptr<SandboxedProcess> Process;
+
+const uint64_t kPidMax = 4194304;
+const int kReaderThreads = 4;
+
+uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// 'count' distinct pids
+std::vector<uint64_t> RandomPids(std::mt19937_64 &rng, size_t count, const std::unordered_set<uint64_t> &exclude = {})
+{
+    std::uniform_int_distribution<uint64_t> distribution(2, kPidMax - 1);
+    std::unordered_set<uint64_t> seen;
+    std::vector<uint64_t> pids;
+    while (pids.size() < count)
+    {
+        uint64_t pid = distribution(rng);
+        if (exclude.count(pid) == 0 && seen.insert(pid).second)
+        {
+            pids.push_back(pid);
+        }
+    }
+
+    return pids;
+}
+
+struct Results
+{
+    double insert, get, getMiss, getOrAddExisting, remove, concurrentGet;
+};
+
+void Check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "pid_map_bench: %s\n", what);
+        exit(1);
+    }
+}
+
+// Both containers expose the same (uint key) API
+template <typename Map>
+Results Run(Map *map, const std::vector<uint64_t> &pids, const std::vector<uint64_t> &missing,
+            const std::vector<Process> &processes, int rounds)
+{
+    Results results = { };
+    size_t n = pids.size();
+    double ops = (double)n * rounds;
+
+    for (int r = 0; r < rounds; r++)
+    {
+        uint64_t start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            Check(map->insert(pids[i], processes[i]) == kTrieResultInserted, "insert failed");
+        }
+        results.insert += NowNs() - start;
+
+        start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            Check(map->get(pids[i]) != nullptr, "get failed");
+        }
+        results.get += NowNs() - start;
+
+        start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            Check(map->get(missing[i]) == nullptr, "get of a missing pid succeeded");
+        }
+        results.getMiss += NowNs() - start;
+
+        start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            TrieResult result;
+            map->getOrAdd(pids[i], processes[i], &result);
+            Check(result == kTrieResultAlreadyExists, "getOrAdd of an existing pid added it");
+        }
+        results.getOrAddExisting += NowNs() - start;
+
+        start = NowNs();
+        for (size_t i = 0; i < n; i++)
+        {
+            Check(map->remove(pids[i]) == kTrieResultRemoved, "remove failed");
+        }
+        results.remove += NowNs() - start;
+        Check(map->getCount() == 0, "entries left after removing them all");
+    }
+
+    // Lookups from several threads while one thread keeps adding and removing processes, like reports coming in for
+    // the processes of a pip while it forks and reaps children
+    for (size_t i = 0; i < n; i++)
+    {
+        map->insert(pids[i], processes[i]);
+    }
+
+    std::atomic<bool> done(false);
+    std::thread writer([&]()
+    {
+        for (size_t i = 0; !done.load(std::memory_order_relaxed); i = (i + 1) % n)
+        {
+            map->insert(missing[i], processes[i]);
+            map->remove(missing[i]);
+        }
+    });
+
+    std::atomic<uint64_t> elapsed(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < kReaderThreads; t++)
+    {
+        readers.emplace_back([&, t]()
+        {
+            uint64_t start = NowNs();
+            for (int r = 0; r < rounds; r++)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    Check(map->get(pids[(i + t * 7919) % n]) != nullptr, "concurrent get failed");
+                }
+            }
+            elapsed += NowNs() - start;
+        });
+    }
+
+    for (std::thread &reader : readers) reader.join();
+    done = true;
+    writer.join();
+    results.concurrentGet = (double)elapsed / kReaderThreads;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        map->remove(pids[i]);
+    }
+
+    results.insert /= ops;
+    results.get /= ops;
+    results.getMiss /= ops;
+    results.getOrAddExisting /= ops;
+    results.remove /= ops;
+    results.concurrentGet /= ops;
+    return results;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 4)
+    {
+        fprintf(stderr, "Usage: pid_map_bench <manifest> [processes] [rounds]\n");
+        return 2;
+    }
+
+    int count = argc > 2 ? atoi(argv[2]) : 1000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 200;
+    if (count <= 0 || rounds <= 0)
+    {
+        fprintf(stderr, "pid_map_bench: invalid number of processes or rounds\n");
+        return 2;
+    }
+
+    std::shared_ptr<SandboxedPip> pip = LoadBenchPip("pid_map_bench", argv[1]);
+
+    std::mt19937_64 rng(0xB1B);
+    std::vector<uint64_t> pids = RandomPids(rng, count);
+    std::vector<uint64_t> missing = RandomPids(rng, count, std::unordered_set<uint64_t>(pids.begin(), pids.end()));
+    std::vector<Process> processes;
+    for (uint64_t pid : pids)
+    {
+        processes.push_back(std::make_shared<SandboxedProcess>((pid_t)pid, pip));
+    }
+
+    Trie<SandboxedProcess> *trie = Trie<SandboxedProcess>::createUintTrie();
+    ConcurrentPidMap<SandboxedProcess> *map = new ConcurrentPidMap<SandboxedProcess>();
+    Results t = Run(trie, pids, missing, processes, rounds);
+    Results m = Run(map, pids, missing, processes, rounds);
+    delete trie;
+    delete map;
+
+    printf("# operation\ttrie_ns\tpid_map_ns\n");
+    printf("insert\t%.1f\t%.1f\n", t.insert, m.insert);
+    printf("get\t%.1f\t%.1f\n", t.get, m.get);
+    printf("get_miss\t%.1f\t%.1f\n", t.getMiss, m.getMiss);
+    printf("get_or_add_existing\t%.1f\t%.1f\n", t.getOrAddExisting, m.getOrAddExisting);
+    printf("remove\t%.1f\t%.1f\n", t.remove, m.remove);
+    printf("concurrent_get\t%.1f\t%.1f\n", t.concurrentGet, m.concurrentGet);
+    return 0;
+}
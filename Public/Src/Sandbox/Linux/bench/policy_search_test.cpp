@@ -0,0 +1,239 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Checks that policy searches give the same results on every platform: before 'PolicySearchAncestors', the parent
+// chain of a 'PolicySearchCursor' was only recorded on Windows (one heap-allocated parent cursor per level), so that
+// 'PolicyResult::FindLowestConsecutiveLevelThatStillHasProperty' could not look at the parents anywhere else.
+// Exits with 1 on the first mismatch.
+//
+// Usage: policy_search_test <manifest>
+//   <manifest>    a FAM written by fam_gen; it should be deeper than PolicySearchAncestors::MaxRecords somewhere, so
+//                 that the ancestors that do not fit in a cursor are covered too
+//
+// Every path of the manifest, and paths going past its leaves, are looked up both with FindFileAccessPolicyInTreeEx
+// and with the search Windows used to run (kept below as the reference), from the root and resumed from the cursor of
+// every prefix of the path.  For every flag of FileAccessPolicy, the level FindLowestConsecutiveLevelThatStillHasProperty
+// returns must be the one the Windows parent chain gives.  Finally, all of these paths (shuffled, with duplicates) are
+// looked up at once with FindFileAccessPolicies, which must give the same cursors as the lookups one by one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_pip.hpp"
+#include "PolicyResult.h"
+#include "PolicySearch.h"
+
+namespace
+{
+
+void Check(bool condition, const std::string &path, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "policy_search_test: '%s': %s\n", path.c_str(), what);
+        exit(1);
+    }
+}
+
+// The cursor of the Windows search: a heap-allocated chain of parent cursors
+struct ReferenceCursor
+{
+    PCManifestRecord record;
+    size_t level;
+    std::shared_ptr<ReferenceCursor> parent;
+    bool truncated;
+};
+
+ReferenceCursor ReferenceSearch(const ReferenceCursor &cursor, const char *path)
+{
+    if (cursor.truncated)
+    {
+        return cursor;
+    }
+
+    bool endOfPath = path[0] == 0;
+    if (cursor.record->BucketCount == 0 || endOfPath)
+    {
+        return { cursor.record, cursor.level, cursor.parent, !endOfPath };
+    }
+
+    // same tokenization as GetPartialPathAndRemainder
+    size_t length = strlen(path);
+    size_t found = 0;
+    while (IsDirectorySeparator(path[found])) found++;
+    while (found < length && !IsDirectorySeparator(path[found])) found++;
+    const char *remainder = path + found + (found < length ? 1 : 0);
+
+    PCManifestRecord child;
+    if (!cursor.record->FindChild(path, found, child) || child == nullptr)
+    {
+        return { cursor.record, cursor.level, cursor.parent, true };
+    }
+
+    return ReferenceSearch({ child, cursor.level + 1, std::make_shared<ReferenceCursor>(cursor), false }, remainder);
+}
+
+// FindLowestConsecutiveLevelThatStillHasProperty, walking the Windows parent chain
+size_t ReferenceFindLowestLevel(const ReferenceCursor &cursor, FileAccessPolicy flag)
+{
+    FileAccessPolicy policy = cursor.truncated ? cursor.record->GetConePolicy() : cursor.record->GetNodePolicy();
+    size_t firstLevel = 0;
+    if ((policy & flag) != 0)
+    {
+        firstLevel = cursor.level - 1;
+        for (std::shared_ptr<ReferenceCursor> parent = cursor.parent; parent != nullptr; parent = parent->parent)
+        {
+            if ((parent->record->GetConePolicy() & flag) != 0)
+            {
+                firstLevel = parent->level - 1;
+            }
+        }
+    }
+
+    return firstLevel;
+}
+
+void CollectPaths(PCManifestRecord record, const std::string &path, size_t depth, std::vector<std::string> &paths, size_t &maxDepth)
+{
+    paths.push_back(path);
+    maxDepth = depth > maxDepth ? depth : maxDepth;
+    for (ManifestRecord::BucketCountType i = 0; i < record->BucketCount; i++)
+    {
+        PCManifestRecord child = record->GetChildRecord(i);
+        if (child != nullptr)
+        {
+            CollectPaths(child, path + "/" + child->GetPartialPath(), depth + 1, paths, maxDepth);
+        }
+    }
+}
+
+void CheckPath(PCManifestRecord root, const std::string &path)
+{
+    // as AccessHandler::FindManifestRecord does, without the leading '/'
+    const char *relative = path.c_str() + 1;
+    ReferenceCursor reference = ReferenceSearch({ root, 0, nullptr, false }, relative);
+
+    std::vector<PolicySearchCursor> cursors;
+    cursors.push_back(FindFileAccessPolicyInTreeEx(PolicySearchCursor(root), relative, strlen(relative)));
+
+    // resumed from the cursor of every prefix, as PolicyResult::GetPolicyForSubpath does
+    for (const char *separator = strchr(relative, '/'); separator != nullptr; separator = strchr(separator + 1, '/'))
+    {
+        std::string prefix(relative, separator - relative);
+        PolicySearchCursor prefixCursor = FindFileAccessPolicyInTreeEx(PolicySearchCursor(root), prefix.c_str(), prefix.length());
+        cursors.push_back(FindFileAccessPolicyInTreeEx(prefixCursor, separator + 1, strlen(separator + 1)));
+    }
+
+    for (const PolicySearchCursor &cursor : cursors)
+    {
+        Check(cursor.Record == reference.record, path, "different record");
+        Check(cursor.Level == reference.level, path, "different level");
+        Check(cursor.SearchWasTruncated == reference.truncated, path, "different truncation");
+
+        PolicyResult result((FileAccessManifestFlag)0, (FileAccessManifestExtraFlag)0, path.c_str(), cursor);
+        for (int bit = 0; bit < 14; bit++)
+        {
+            FileAccessPolicy flag = (FileAccessPolicy)(1 << bit);
+            Check(result.FindLowestConsecutiveLevelThatStillHasProperty(flag) == ReferenceFindLowestLevel(reference, flag),
+                  path, "FindLowestConsecutiveLevelThatStillHasProperty differs from the Windows parent chain");
+        }
+    }
+}
+
+// FindFileAccessPolicies must return what looking the paths up one by one does, whatever their order
+void CheckBatch(PCManifestRecord root, std::vector<std::string> paths)
+{
+    // duplicates, and paths that are prefixes of others without being whole components of them
+    size_t count = paths.size();
+    for (size_t i = 0; i < count; i += 7)
+    {
+        paths.push_back(paths[i]);
+        paths.push_back(paths[i] + "x");
+        paths.push_back(paths[i].substr(0, paths[i].length() - 1));
+    }
+
+    std::mt19937 rng(0xB1B);
+    std::shuffle(paths.begin(), paths.end(), rng);
+
+    std::vector<PCPathChar> relative;
+    for (const std::string &path : paths)
+    {
+        relative.push_back(path.c_str() + 1);
+    }
+
+    std::vector<PolicySearchCursor> results(paths.size());
+    FindFileAccessPolicies(PolicySearchCursor(root), relative.data(), relative.size(), results.data());
+
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        PolicySearchCursor single = FindFileAccessPolicyInTreeEx(PolicySearchCursor(root), relative[i], strlen(relative[i]));
+        Check(results[i].Record == single.Record, paths[i], "the batch found a different record");
+        Check(results[i].Level == single.Level, paths[i], "the batch found a different level");
+        Check(results[i].SearchWasTruncated == single.SearchWasTruncated, paths[i], "the batch found a different truncation");
+        Check(results[i].Ancestors.Count() == single.Ancestors.Count(), paths[i], "the batch found different ancestors");
+
+        PolicyResult batchResult((FileAccessManifestFlag)0, (FileAccessManifestExtraFlag)0, paths[i].c_str(), results[i]);
+        PolicyResult singleResult((FileAccessManifestFlag)0, (FileAccessManifestExtraFlag)0, paths[i].c_str(), single);
+        for (int bit = 0; bit < 14; bit++)
+        {
+            FileAccessPolicy flag = (FileAccessPolicy)(1 << bit);
+            Check(batchResult.FindLowestConsecutiveLevelThatStillHasProperty(flag) == singleResult.FindLowestConsecutiveLevelThatStillHasProperty(flag),
+                  paths[i], "the batch found ancestors with different policies");
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: policy_search_test <manifest>\n");
+        return 2;
+    }
+
+    std::shared_ptr<SandboxedPip> pip = LoadBenchPip("policy_search_test", argv[1]);
+    PCManifestRecord root = pip->GetManifestRecord();
+
+    std::vector<std::string> paths;
+    size_t maxDepth = 0;
+    for (ManifestRecord::BucketCountType i = 0; i < root->BucketCount; i++)
+    {
+        PCManifestRecord child = root->GetChildRecord(i);
+        if (child != nullptr)
+        {
+            CollectPaths(child, std::string("/") + child->GetPartialPath(), 1, paths, maxDepth);
+        }
+    }
+
+    if (maxDepth <= PolicySearchAncestors::MaxRecords)
+    {
+        fprintf(stderr, "policy_search_test: the manifest is only %zu levels deep, the overflow of the ancestors is not covered\n", maxDepth);
+        return 1;
+    }
+
+    std::vector<std::string> checked;
+    for (const std::string &path : paths)
+    {
+        checked.push_back(path);
+        checked.push_back(path + "/not-in-manifest");
+        checked.push_back(path + "/not-in-manifest/deeper");
+    }
+
+    for (const std::string &path : checked)
+    {
+        CheckPath(root, path);
+    }
+
+    CheckBatch(root, checked);
+
+    printf("policy_search_test: %zu paths up to %zu levels deep match the Windows parent chain, one by one and in a batch\n", checked.size(), maxDepth);
+    return 0;
+}
@@ -0,0 +1,264 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Drains the reports the sandbox writes to a FIFO (standing in for SandboxConnectionLinuxDetours.cs, which the
+// benchmarks run without), so that writers do not have to spill reports (see ReportWriter in bxl_reports.hpp).
+//
+// Usage: report_sink [--delay-us <us>] [--pipe-size <bytes>] [--dump <file>] <fifo> <stats file>
+//   --delay-us     time to wait after reading each report from the FIFO, to play a reader that cannot keep up
+//   --pipe-size    capacity to give the FIFO (see F_SETPIPE_SZ), e.g., to make it fill up sooner
+//   --dump         file to write the text of every report to (one line per report, as soon as it is read)
+//
+// Creates the FIFO if needed and reads length-prefixed reports from it until it gets SIGTERM or SIGINT; then
+// drains what is left in the FIFO and writes "<reports>\t<bytes>\t<spilled reports>" to the stats file.  Reports
+// spilled to files are read from there when their announcement is read from the FIFO.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "../utils.h"
+
+static volatile sig_atomic_t sStop = 0;
+static useconds_t sDelayUs = 0;
+static FILE *sDump = NULL;
+
+static void on_signal(int signo)
+{
+    sStop = 1;
+}
+
+static bool write_stats(const char *path, uint64_t reports, uint64_t bytes, uint64_t spilled)
+{
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        return false;
+    }
+
+    fprintf(out, "%lu\t%lu\t%lu\n", reports, bytes, spilled);
+    return fclose(out) == 0;
+}
+
+// Counts the reports announced by "<pid>|<offset>|<length>|<path>\n" (see ReportWriter::AnnounceLocked).
+static bool read_spilled(const char *announcement, uint64_t &reports, uint64_t &bytes, uint64_t &spilled)
+{
+    unsigned long offset, length;
+    int pathStart;
+    if (sscanf(announcement, "%*d|%lu|%lu|%n", &offset, &length, &pathStart) != 2)
+    {
+        return false;
+    }
+
+    std::string path(announcement + pathStart);
+    path.erase(path.find_last_not_of('\n') + 1);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    std::vector<char> buf(length);
+    bool read = fd != -1 && pread(fd, buf.data(), length, offset) == (ssize_t)length;
+    if (fd != -1) close(fd);
+    if (!read)
+    {
+        return false;
+    }
+
+    for (size_t pos = 0; pos + sizeof(uint32_t) <= length; )
+    {
+        uint32_t size;
+        memcpy(&size, &buf[pos], sizeof(size));
+        size &= ~REPORTS_MESSAGE_KIND_MASK;
+        if (size == 0 || size > PIPE_BUF || pos + sizeof(size) + size > length)
+        {
+            return false;
+        }
+
+        if (sDump != NULL)
+        {
+            fwrite(&buf[pos + sizeof(size)], 1, size, sDump);
+        }
+
+        reports++;
+        spilled++;
+        bytes += sizeof(size) + size;
+        pos += sizeof(size) + size;
+    }
+
+    return true;
+}
+
+// Reads exactly 'size' bytes; returns 1 if it did, 0 if there was nothing to read (the read was interrupted, or the
+// FIFO is empty in non-blocking mode) and -1 on errors.  A report that is partially read is always read to its end.
+static int read_fully(int fd, char *buf, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t n = read(fd, buf + total, size - total);
+        if (n > 0)
+        {
+            total += n;
+        }
+        else if (n == -1 && (errno == EINTR || errno == EAGAIN))
+        {
+            if (total == 0) return 0;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+// Reads reports until there are none left to read or (when 'untilStopped') until asked to stop.
+static bool drain(int fd, bool untilStopped, uint64_t &reports, uint64_t &bytes, uint64_t &spilled)
+{
+    char buf[PIPE_BUF + 1];
+    while (!untilStopped || !sStop)
+    {
+        // polls with a timeout rather than blocking in 'read', which would miss a signal arriving right before it
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (untilStopped && poll(&pfd, 1, 100) <= 0)
+        {
+            continue;
+        }
+
+        // CODESYNC: BxlObserver::SendReport (a uint length followed by the report itself) and ReportWriter::AnnounceLocked
+        uint32_t length;
+        int result = read_fully(fd, (char *)&length, sizeof(length));
+        if (result == 0 && !untilStopped)
+        {
+            return true;
+        }
+
+        if (result == 0)
+        {
+            continue;
+        }
+
+        bool isSpillAnnouncement = (length & REPORTS_SPILL_ANNOUNCEMENT) != 0;
+        length &= ~REPORTS_MESSAGE_KIND_MASK;
+        if (result == -1 || length > PIPE_BUF || read_fully(fd, buf, length) != 1)
+        {
+            fprintf(stderr, "report_sink: malformed report stream\n");
+            return false;
+        }
+
+        if (isSpillAnnouncement)
+        {
+            buf[length] = '\0';
+            if (!read_spilled(buf, reports, bytes, spilled))
+            {
+                fprintf(stderr, "report_sink: could not read the spilled reports announced by '%s'\n", buf);
+                return false;
+            }
+
+            continue;
+        }
+
+        if (sDump != NULL)
+        {
+            fwrite(buf, 1, length, sDump);
+        }
+
+        reports++;
+        bytes += sizeof(length) + length;
+        if (sDelayUs > 0)
+        {
+            usleep(sDelayUs);
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int pipeSize = 0;
+    int arg = 1;
+    for (; arg + 1 < argc && strncmp(argv[arg], "--", 2) == 0; arg += 2)
+    {
+        if (strcmp(argv[arg], "--delay-us") == 0)
+        {
+            sDelayUs = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "--pipe-size") == 0)
+        {
+            pipeSize = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "--dump") == 0)
+        {
+            // line buffered: a report is in the file as soon as it was read
+            sDump = fopen(argv[arg + 1], "w");
+            if (sDump == NULL || setvbuf(sDump, NULL, _IOLBF, 0) != 0)
+            {
+                fprintf(stderr, "report_sink: could not open '%s': %s\n", argv[arg + 1], strerror(errno));
+                return 1;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (argc - arg != 2)
+    {
+        fprintf(stderr, "Usage: report_sink [--delay-us <us>] [--pipe-size <bytes>] [--dump <file>] <fifo> <stats file>\n");
+        return 2;
+    }
+
+    const char *fifo = argv[arg];
+    const char *statsPath = argv[arg + 1];
+    if (mkfifo(fifo, 0600) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "report_sink: could not create '%s': %s\n", fifo, strerror(errno));
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+
+    // opened for writing too, so that reads block (instead of returning EOF) while no sandboxed process has it open
+    int fd = open(fifo, O_RDWR);
+    if (fd == -1)
+    {
+        fprintf(stderr, "report_sink: could not open '%s': %s\n", fifo, strerror(errno));
+        return 1;
+    }
+
+    if (pipeSize > 0 && fcntl(fd, F_SETPIPE_SZ, pipeSize) == -1)
+    {
+        fprintf(stderr, "report_sink: could not resize '%s': %s\n", fifo, strerror(errno));
+        return 1;
+    }
+
+    uint64_t reports = 0, bytes = 0, spilled = 0;
+    if (!drain(fd, true, reports, bytes, spilled)
+        || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0
+        || !drain(fd, false, reports, bytes, spilled))
+    {
+        return 1;
+    }
+
+    close(fd);
+    if (sDump != NULL)
+    {
+        fclose(sDump);
+    }
+
+    return write_stats(statsPath, reports, bytes, spilled) ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+#!/bin/bash
+
+# Measures the overhead libDetours.so adds to the libc calls it interposes.
+#
+# Every hook of bench_driver is timed natively and then under LD_PRELOAD (with a manifest generated by fam_gen that
+# reports every access, and report_sink draining the report FIFO), and the median of several repetitions is kept.
+# The result is a TSV file with one line per hook:
+#
+#   <hook>  <iterations>  <native ns/call>  <sandboxed ns/call>  <overhead ns/call>  <reports per run>
+#
+# which compare_bench.sh compares against a baseline (see 'make bench' and 'make bench-baseline').
+
+set -euo pipefail
+
+readonly MY_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+readonly ALL_HOOKS="open openat stat access write putc readlink opendir fork_exec clone_thread"
+
+config=release
+iterations=20000
+repetitions=5
+output=/dev/stdout
+
+function usage {
+    echo "Usage: $0 [-c debug|release] [-n iterations] [-r repetitions] [-o output file] [hook...]" >&2
+    echo "Hooks: $ALL_HOOKS" >&2
+    exit 2
+}
+
+while getopts "c:n:r:o:h" opt; do
+    case $opt in
+        c) config=$OPTARG ;;
+        n) iterations=$OPTARG ;;
+        r) repetitions=$OPTARG ;;
+        o) output=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+shift $((OPTIND - 1))
+hooks="${*:-$ALL_HOOKS}"
+
+source "$MY_DIR/common.sh"
+bench_init $config
+
+# prints the ns/call reported by the driver
+function run_native {
+    "$BIN/bench_driver" "$1" "$2" "$WORK/files" | cut -f3
+}
+
+# prints the ns/call reported by the driver, followed by the number of reports the sandbox sent
+function run_sandboxed {
+    start_sink
+    local ns
+    ns=$("${PRELOADED[@]}" "$BIN/bench_driver" "$1" "$2" "$WORK/files" | cut -f3)
+    echo "$ns $(stop_sink)"
+}
+
+{
+    echo -e "# hook\titerations\tnative_ns\tsandboxed_ns\toverhead_ns\treports"
+    for hook in $hooks; do
+        # creating processes is orders of magnitude slower than the other calls
+        n=$iterations
+        [[ $hook == fork_exec ]] && n=$(( iterations / 100 > 20 ? iterations / 100 : 20 ))
+
+        native=()
+        sandboxed=()
+        reports=0
+        for ((r = 0; r < repetitions; r++)); do
+            native+=("$(run_native $hook $n)")
+            read -r ns reports < <(run_sandboxed $hook $n)
+            sandboxed+=("$ns")
+        done
+
+        native_ns=$(printf "%s\n" "${native[@]}" | median)
+        sandboxed_ns=$(printf "%s\n" "${sandboxed[@]}" | median)
+        awk -v h=$hook -v n=$n -v a=$native_ns -v b=$sandboxed_ns -v r=$reports \
+            'BEGIN { printf "%s\t%d\t%.1f\t%.1f\t%.1f\t%d\n", h, n, a, b, b - a, r }'
+    done
+} > "$output"
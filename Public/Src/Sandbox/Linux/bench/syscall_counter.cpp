@@ -0,0 +1,214 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Runs a command under ptrace and counts the syscalls made by it (and by every process it creates) between the
+// begin and end markers of syscall_markers.h, for check_syscalls.sh to compare with and without the sandbox.
+//
+// Usage: syscall_counter <output file> <command> [args...]
+// Writes "total\t<count>" followed by one "<syscall>\t<count>" line per syscall that was made, most frequent first.
+// Exits with the exit code of the command.
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "syscall_markers.h"
+
+// PTRACE_GET_SYSCALL_INFO (Linux 5.3) is declared by glibc 2.31 and later only, and the sandbox is built (and its
+// syscall budget checked, see build-manylinux.sh) against an older glibc; see ptrace(2) for the layout
+#ifndef PTRACE_GET_SYSCALL_INFO
+#define PTRACE_GET_SYSCALL_INFO 0x420e
+#define PTRACE_SYSCALL_INFO_ENTRY 1
+struct __ptrace_syscall_info
+{
+    uint8_t op;
+    uint8_t pad[3];
+    uint32_t arch;
+    uint64_t instruction_pointer;
+    uint64_t stack_pointer;
+    union
+    {
+        struct { uint64_t nr; uint64_t args[6]; } entry;
+        struct { int64_t rval; uint8_t is_error; } exit;
+        struct { uint64_t nr; uint64_t args[6]; uint32_t ret_data; } seccomp;
+    };
+};
+#endif
+
+#define NAMED(name) { SYS_##name, #name },
+
+// Names of the syscalls the sandbox is known to make; others are shown by number
+static const std::map<long, const char *> kSyscallNames =
+{
+#ifdef SYS_open
+    NAMED(open)
+#endif
+#ifdef SYS_stat
+    NAMED(stat)
+#endif
+#ifdef SYS_lstat
+    NAMED(lstat)
+#endif
+#ifdef SYS_access
+    NAMED(access)
+#endif
+#ifdef SYS_readlink
+    NAMED(readlink)
+#endif
+#ifdef SYS_fork
+    NAMED(fork)
+#endif
+#ifdef SYS_vfork
+    NAMED(vfork)
+#endif
+#ifdef SYS_newfstatat
+    NAMED(newfstatat)
+#endif
+    NAMED(openat)
+    NAMED(close)
+    NAMED(read)
+    NAMED(write)
+    NAMED(fstat)
+    NAMED(statx)
+    NAMED(faccessat)
+    NAMED(readlinkat)
+    NAMED(getcwd)
+    NAMED(getpid)
+    NAMED(getppid)
+    NAMED(gettid)
+    NAMED(getdents64)
+    NAMED(lseek)
+    NAMED(mmap)
+    NAMED(munmap)
+    NAMED(mprotect)
+    NAMED(brk)
+    NAMED(fcntl)
+    NAMED(ioctl)
+    NAMED(clone)
+    NAMED(clone3)
+    NAMED(execve)
+    NAMED(wait4)
+    NAMED(exit_group)
+    NAMED(rt_sigaction)
+    NAMED(rt_sigprocmask)
+    NAMED(futex)
+    NAMED(sched_yield)
+    NAMED(prlimit64)
+    NAMED(set_robust_list)
+    NAMED(set_tid_address)
+    NAMED(rseq)
+    NAMED(getrandom)
+    NAMED(ftruncate)
+    NAMED(pread64)
+    NAMED(clock_gettime)
+};
+
+static std::string syscall_name(long nr)
+{
+    auto it = kSyscallNames.find(nr);
+    return it != kSyscallNames.end() ? it->second : "syscall_" + std::to_string(nr);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: syscall_counter <output file> <command> [args...]\n");
+        return 2;
+    }
+
+    pid_t root = fork();
+    if (root == 0)
+    {
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        execvp(argv[2], &argv[2]);
+        fprintf(stderr, "syscall_counter: could not run '%s': %s\n", argv[2], strerror(errno));
+        _exit(127);
+    }
+
+    int status;
+    if (root == -1 || waitpid(root, &status, 0) != root || !WIFSTOPPED(status))
+    {
+        fprintf(stderr, "syscall_counter: could not start tracing: %s\n", strerror(errno));
+        return 1;
+    }
+
+    long options = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL;
+    if (ptrace(PTRACE_SETOPTIONS, root, NULL, (void *)options) != 0 || ptrace(PTRACE_SYSCALL, root, NULL, NULL) != 0)
+    {
+        fprintf(stderr, "syscall_counter: ptrace failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    bool counting = false;
+    uint64_t total = 0;
+    std::map<long, uint64_t> counts;
+    int exitCode = 1;
+
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, __WALL)) != -1)
+    {
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+        {
+            if (pid == root) exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            continue;
+        }
+
+        int signal = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80))
+        {
+            struct __ptrace_syscall_info info;
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, (void *)sizeof(info), &info) > 0 && info.op == PTRACE_SYSCALL_INFO_ENTRY)
+            {
+                int arg = (int)info.entry.args[0];
+                if (info.entry.nr == SYS_close && (arg == BXL_SYSCALL_MARKER_BEGIN || arg == BXL_SYSCALL_MARKER_END))
+                {
+                    counting = arg == BXL_SYSCALL_MARKER_BEGIN;
+                }
+                else if (counting)
+                {
+                    total++;
+                    counts[(long)info.entry.nr]++;
+                }
+            }
+        }
+        else if (WSTOPSIG(status) != SIGTRAP && WSTOPSIG(status) != SIGSTOP)
+        {
+            // a genuine signal (rather than a ptrace event, or the initial stop of a new tracee): deliver it
+            signal = WSTOPSIG(status);
+        }
+
+        ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)signal);
+    }
+
+    std::vector<std::pair<long, uint64_t>> sorted(counts.begin(), counts.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+
+    FILE *out = fopen(argv[1], "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "syscall_counter: could not write '%s': %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    fprintf(out, "total\t%lu\n", total);
+    for (const auto &entry : sorted)
+    {
+        fprintf(out, "%s\t%lu\n", syscall_name(entry.first).c_str(), entry.second);
+    }
+
+    fclose(out);
+    return exitCode;
+}
@@ -0,0 +1,18 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// bench_driver brackets the calls it measures with these markers, which syscall_counter looks for.
+// A marker is a raw close(2) of an invalid file descriptor: it fails right away, nothing interposes it,
+// and no real program makes it.
+#define BXL_SYSCALL_MARKER_BEGIN -0xB1B0
+#define BXL_SYSCALL_MARKER_END   -0xB1B1
+
+inline void bxl_syscall_marker(int marker)
+{
+    syscall(SYS_close, marker);
+}
@@ -0,0 +1,326 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Replays the traces written by libDetours.so when __BUILDXL_TRACE_DIR is set (see bxl_trace.hpp): the events every
+// process checked are fed again through 'BxlObserver::report_access', against the manifest of the pip, so the resulting
+// reports are translated, formatted and sent by 'BxlObserver::SendReport', without running any of the traced tools.
+//
+// Usage: trace_replay [--rounds <n>] <manifest> <trace or directory>...
+//   <manifest>          the FAM the traced pip ran with (or a FAM written by fam_gen, to see how another manifest fares)
+//   <trace>             a trace file, or a directory whose *.bxltrace files are all replayed
+//   --rounds <n>        number of times every trace is replayed (default: 20)
+//
+// The reports of every round go where the manifest says, so something must read them when that is a FIFO (see
+// 'capture_trace.sh -r', which replays the traces it captures with report_sink reading the reports).  They carry the
+// name and the pid of the traced process (see 'BxlObserver::report_access_on_behalf'), but the time of the replay.
+//
+// Every trace is replayed the way the process that wrote it checked its events, on behalf of a process that has the
+// pid and the program of the traced process.  Events that the process found in its cache (or did not check)
+// are skipped, as they were then.  The result of every check must be the one that was recorded; since those only depend
+// on the manifest and on the events, this holds on any machine (except for opens of paths whose mode was not recorded,
+// see 'IOHandler::HandleOpen', which look the path up).  Exits with 1 if a trace cannot be read or a result differs.
+//
+// Prints one line per hook: "<hook>\t<checks>\t<live ns per check>\t<replay ns per check>", where the live time is the
+// one recorded in the traces; both include sending the reports.  Then prints a 'total' line.
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench_pip.hpp"
+#include "bxl_aggregator.hpp"
+#include "bxl_observer.hpp"
+#include "bxl_trace.hpp"
+
+namespace
+{
+
+struct TracedAccess
+{
+    uint8_t flags;
+    uint16_t hook;
+    TraceAccess check;
+    IOEvent event;
+};
+
+struct Trace
+{
+    std::string file;
+    TraceFileHeader header;
+    std::string program;
+    std::vector<std::string> hooks;
+    std::vector<TracedAccess> accesses;
+};
+
+struct HookTotals
+{
+    uint64_t checks = 0;
+    uint64_t liveNs = 0;
+    uint64_t replayNs = 0;
+};
+
+uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool Fail(const std::string &file, const char *what)
+{
+    fprintf(stderr, "trace_replay: '%s': %s\n", file.c_str(), what);
+    return false;
+}
+
+bool ReadTrace(const std::string &file, Trace &trace)
+{
+    std::vector<char> bytes = ReadBenchManifest("trace_replay", file.c_str());
+    const char *pos = bytes.data();
+    const char *end = pos + bytes.size();
+
+    trace.file = file;
+    if ((size_t)(end - pos) < sizeof(TraceFileHeader))
+    {
+        return Fail(file, "not a trace");
+    }
+
+    memcpy(&trace.header, pos, sizeof(TraceFileHeader));
+    pos += sizeof(TraceFileHeader);
+    if (memcmp(trace.header.magic, BxlTraceMagic, sizeof(trace.header.magic)) != 0 || trace.header.version != BxlTraceVersion)
+    {
+        return Fail(file, "not a trace (or a trace of another version)");
+    }
+
+    if ((size_t)(end - pos) < trace.header.programPathLength)
+    {
+        return Fail(file, "truncated header");
+    }
+
+    trace.program.assign(pos, trace.header.programPathLength);
+    pos += trace.header.programPathLength;
+
+    // a trace ends with the last buffer its process flushed, so a process that was killed may leave an incomplete record
+    while ((size_t)(end - pos) >= sizeof(TraceRecordHeader))
+    {
+        TraceRecordHeader record;
+        memcpy(&record, pos, sizeof(record));
+        pos += sizeof(record);
+        if ((size_t)(end - pos) < record.size)
+        {
+            break;
+        }
+
+        if (record.kind == kTraceHook)
+        {
+            if (record.hook != trace.hooks.size())
+            {
+                return Fail(file, "hooks out of order");
+            }
+
+            trace.hooks.push_back(std::string(pos, record.size));
+        }
+        else if (record.kind == kTraceAccess)
+        {
+            TracedAccess access;
+            access.flags = record.flags;
+            access.hook = record.hook;
+            IOEventView event;
+            if (record.size < sizeof(TraceAccess) ||
+                !IOEvent::Deserialize(pos + sizeof(TraceAccess), record.size - sizeof(TraceAccess), event))
+            {
+                return Fail(file, "corrupted access");
+            }
+
+            access.event = IOEvent(event);
+
+            memcpy(&access.check, pos, sizeof(TraceAccess));
+            trace.accesses.push_back(access);
+        }
+
+        pos += record.size;
+    }
+
+    return true;
+}
+
+void CollectTraces(const char *arg, std::vector<std::string> &files)
+{
+    DIR *dir = opendir(arg);
+    if (dir == nullptr)
+    {
+        files.push_back(arg);
+        return;
+    }
+
+    std::vector<std::string> found;
+    size_t suffixLength = strlen(BxlTraceFileSuffix);
+    for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        size_t length = strlen(entry->d_name);
+        if (length > suffixLength && strcmp(entry->d_name + length - suffixLength, BxlTraceFileSuffix) == 0)
+        {
+            found.push_back(std::string(arg) + "/" + entry->d_name);
+        }
+    }
+
+    closedir(dir);
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+const std::string &HookName(const Trace &trace, uint16_t hook)
+{
+    static const std::string unknown = "?";
+    return hook < trace.hooks.size() ? trace.hooks[hook] : unknown;
+}
+
+// Replays 'trace' once; returns the number of checks whose result differs from the recorded one
+size_t Replay(Trace &trace, std::map<std::string, HookTotals> *totals, bool verbose)
+{
+    BxlObserver *bxl = BxlObserver::GetInstance();
+    std::shared_ptr<SandboxedProcess> process = bxl->CreateObservedProcess(trace.header.pid, trace.program.c_str());
+
+    size_t mismatches = 0;
+    for (TracedAccess &access : trace.accesses)
+    {
+        if (access.flags & (kTraceCacheHit | kTraceNotChecked))
+        {
+            continue;
+        }
+
+        uint64_t start = NowNs();
+        AccessCheckResult result = bxl->report_access_on_behalf(HookName(trace, access.hook).c_str(), access.event, process);
+        uint64_t elapsed = NowNs() - start;
+
+        if (totals != nullptr)
+        {
+            HookTotals &hook = (*totals)[HookName(trace, access.hook)];
+            hook.checks++;
+            hook.liveNs += access.check.duration;
+            hook.replayNs += elapsed;
+        }
+
+        if ((uint8_t)result.Access != access.check.access || (uint8_t)result.Result != access.check.action ||
+            (uint8_t)result.Level != access.check.level || (uint8_t)result.Validity != access.check.validity)
+        {
+            if (verbose && mismatches < 10)
+            {
+                fprintf(stderr, "trace_replay: '%s': %s '%s': recorded %d/%d/%d/%d, replayed %d/%d/%d/%d (access/action/level/validity)\n",
+                        trace.file.c_str(), HookName(trace, access.hook).c_str(), access.event.GetEventPath(SRC_PATH),
+                        access.check.access, access.check.action, access.check.level, access.check.validity,
+                        (int)result.Access, (int)result.Result, (int)result.Level, (int)result.Validity);
+            }
+
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int rounds = 20;
+    int arg = 1;
+    for (; arg + 1 < argc && strcmp(argv[arg], "--rounds") == 0; arg += 2)
+    {
+        rounds = atoi(argv[arg + 1]);
+    }
+
+    if (argc - arg < 2 || rounds <= 0)
+    {
+        fprintf(stderr, "Usage: trace_replay [--rounds <n>] <manifest> <trace or directory>...\n");
+        return 2;
+    }
+
+    // the observer of this process checks and reports the replayed accesses against the manifest, on its own: it must
+    // neither trace them again, nor join a process tree, nor hand its reports to an aggregator
+    setenv(BxlEnvFamPath, argv[arg], /* overwrite */ 1);
+    unsetenv(BxlEnvTraceDir);
+    unsetenv(BxlEnvReportAggregator);
+    unsetenv(BxlEnvCountedPid);
+    unsetenv(BxlEnvRootPid);
+    if (BxlObserver::GetInstance()->CreateObservedProcess(getpid(), "") == nullptr)
+    {
+        fprintf(stderr, "trace_replay: '%s' is not a manifest that checks accesses\n", argv[arg]);
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    for (int i = arg + 1; i < argc; i++)
+    {
+        CollectTraces(argv[i], files);
+    }
+
+    std::vector<Trace> traces(files.size());
+    uint64_t events = 0, skipped = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (!ReadTrace(files[i], traces[i]))
+        {
+            return 1;
+        }
+
+        for (const TracedAccess &access : traces[i].accesses)
+        {
+            events++;
+            skipped += (access.flags & (kTraceCacheHit | kTraceNotChecked)) != 0;
+        }
+    }
+
+    // the first round checks the results
+    size_t mismatches = 0;
+    for (Trace &trace : traces)
+    {
+        mismatches += Replay(trace, nullptr, /* verbose */ true);
+    }
+
+    std::map<std::string, HookTotals> totals;
+    for (int r = 0; r < rounds; r++)
+    {
+        for (Trace &trace : traces)
+        {
+            Replay(trace, &totals, /* verbose */ false);
+        }
+    }
+
+    // like any process under the sandbox, this one reports its exit, which announces the reports it spilled while the
+    // reader of the FIFO lagged behind
+    BxlObserver::GetInstance()->report_process_exit("trace_replay");
+
+    printf("# hook\tchecks\tlive_ns\treplay_ns\t(%zu traces, %lu events, %lu cache hits or unchecked)\n",
+           traces.size(), events, skipped);
+    HookTotals all;
+    for (const auto &hook : totals)
+    {
+        uint64_t checks = hook.second.checks / rounds;
+        printf("%s\t%lu\t%.1f\t%.1f\n", hook.first.c_str(), checks,
+               (double)hook.second.liveNs / hook.second.checks, (double)hook.second.replayNs / hook.second.checks);
+        all.checks += hook.second.checks;
+        all.liveNs += hook.second.liveNs;
+        all.replayNs += hook.second.replayNs;
+    }
+
+    if (all.checks > 0)
+    {
+        printf("total\t%lu\t%.1f\t%.1f\n", all.checks / rounds, (double)all.liveNs / all.checks, (double)all.replayNs / all.checks);
+    }
+
+    if (mismatches > 0)
+    {
+        fprintf(stderr, "trace_replay: %zu checks gave another result than the recorded one\n", mismatches);
+        return 1;
+    }
+
+    return 0;
+}
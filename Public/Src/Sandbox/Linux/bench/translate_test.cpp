@@ -0,0 +1,238 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Checks that 'PathTranslator' (bxl_translate.hpp) translates reported paths the way TranslateFilePath in DetoursHelpers.cpp
+// does on Windows (kept below as the reference, without its canonicalization and case folding).  Exits with 1 on the
+// first mismatch.
+//
+// Usage: translate_test
+//
+// A fixed set of translations, several of which share prefixes, is checked against the expected translations of a few
+// paths; then random translations over a small alphabet (so that their 'from' paths overlap a lot) are checked against
+// the reference on random paths.  Finally, the time a lookup takes is printed for a growing number of translations.
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <list>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bxl_translate.hpp"
+
+namespace
+{
+
+typedef std::vector<std::pair<std::string, std::string>> Translations;
+
+// TranslateFilePath, with '/' for the separator
+std::string ReferenceTranslate(const Translations &translations, const std::string &path, size_t maxChained)
+{
+    std::list<const std::pair<std::string, std::string> *> candidates;
+    for (auto &translation : translations)
+    {
+        if (!translation.first.empty() && !translation.second.empty())
+        {
+            candidates.push_back(&translation);
+        }
+    }
+
+    std::string result = path;
+    for (size_t round = 0; round < maxChained && !result.empty(); round++)
+    {
+        size_t longest = 0;
+        size_t replaced = 0;
+        auto replacement = candidates.end();
+        for (auto it = candidates.begin(); it != candidates.end(); ++it)
+        {
+            const std::string &from = (*it)->first;
+            bool matches = result.compare(0, from.length(), from) == 0;
+            bool mayBeDirectory = false;
+            if (!matches && result.back() != '/' && from.back() == '/' && result.length() == from.length() - 1)
+            {
+                matches = (result + '/').compare(0, from.length(), from) == 0;
+                mayBeDirectory = true;
+            }
+
+            if (matches && longest < from.length())
+            {
+                replacement = it;
+                longest = from.length();
+                replaced = mayBeDirectory ? from.length() - 1 : from.length();
+            }
+        }
+
+        if (replacement == candidates.end())
+        {
+            break;
+        }
+
+        result = (*replacement)->second + result.substr(replaced);
+        candidates.erase(replacement);
+    }
+
+    return result;
+}
+
+std::string Translate(const PathTranslator &translator, const std::string &path)
+{
+    std::string translated;
+    return translator.Translate(path.data(), path.length(), translated) ? translated : path;
+}
+
+void Check(const std::string &actual, const std::string &expected, const std::string &path)
+{
+    if (actual != expected)
+    {
+        fprintf(stderr, "translate_test: '%s': got '%s', expected '%s'\n", path.c_str(), actual.c_str(), expected.c_str());
+        exit(1);
+    }
+}
+
+void CheckFixedTranslations()
+{
+    const Translations translations =
+    {
+        { "/a/", "/x/" },
+        { "/a/b/", "/y/" },
+        { "/a/bc/", "/z/" },
+        { "/ab/", "/w/" },
+        { "/src/", "/mnt/work/" },  // chained with the next one
+        { "/mnt/", "/m/" },
+        { "/dup/", "/first/" },     // the first one with the same 'from' wins
+        { "/dup/", "/second/" },
+        { "/p/", "/q/" },           // a cycle: each translation is used once
+        { "/q/", "/p/" },
+        { "", "/ignored/" },
+        { "/ignored/", "" },
+    };
+
+    const std::pair<std::string, std::string> cases[] =
+    {
+        { "/a/f", "/x/f" },
+        { "/a/b/f", "/y/f" },
+        { "/a/bc/f", "/z/f" },
+        { "/a/bcd/f", "/x/bcd/f" },
+        { "/a/b", "/y/" },
+        { "/a/bc", "/z/" },
+        { "/a", "/x/" },
+        { "/a/", "/x/" },
+        { "/ab/f", "/w/f" },
+        { "/abc/f", "/abc/f" },
+        { "/A/f", "/A/f" },
+        { "/src/f", "/m/work/f" },
+        { "/mnt/f", "/m/f" },
+        { "/dup/f", "/first/f" },
+        { "/p/f", "/p/f" },
+        { "/q", "/q/" },
+        { "/ignored/f", "/ignored/f" },
+        { "/f", "/f" },
+        { "/", "/" },
+        { "", "" },
+    };
+
+    PathTranslator translator;
+    translator.Init(translations);
+    for (auto &c : cases)
+    {
+        Check(Translate(translator, c.first), c.second, c.first);
+        Check(ReferenceTranslate(translations, c.first, PathTranslator::MAX_CHAINED_TRANSLATIONS), c.second, c.first + " (reference)");
+    }
+
+    // paths are not necessarily 0-terminated
+    std::string translated;
+    Check(translator.Translate("/a/bc/f", 4, translated) ? translated : "", "/y/", "/a/b (not 0-terminated)");
+
+    // paths longer than PIPE_BUF, and translations longer than the path, are translated too
+    std::string longPath = "/src/" + std::string(2 * PIPE_BUF, 'f');
+    Check(Translate(translator, longPath), "/m/work/" + longPath.substr(5), "/src/ff... (" + std::to_string(longPath.length()) + " bytes)");
+    std::string longFrom = "/" + std::string(PIPE_BUF, 'l') + "/";
+    PathTranslator shortening;
+    shortening.Init({ { longFrom, "/s/" } });
+    Check(Translate(shortening, longFrom + "f"), "/s/f", "/ll.../f (" + std::to_string(longFrom.length() + 1) + " bytes)");
+}
+
+std::string RandomPath(std::mt19937 &random, size_t maxLength)
+{
+    static const char alphabet[] = "ab/";
+    std::string path = "/";
+    size_t length = random() % (maxLength + 1);
+    for (size_t i = 0; i < length; i++)
+    {
+        path.push_back(alphabet[random() % 3]);
+    }
+
+    return path;
+}
+
+void CheckRandomTranslations()
+{
+    std::mt19937 random(42);
+    for (int run = 0; run < 2000; run++)
+    {
+        Translations translations;
+        size_t count = 1 + random() % 12;
+        for (size_t i = 0; i < count; i++)
+        {
+            // like the ones of DirectoryTranslator, most of them end with '/'
+            std::string from = RandomPath(random, 5);
+            if (random() % 4 != 0 && from.back() != '/') from.push_back('/');
+            translations.emplace_back(from, RandomPath(random, 4));
+        }
+
+        PathTranslator translator;
+        translator.Init(translations);
+        for (int i = 0; i < 50; i++)
+        {
+            std::string path = RandomPath(random, 10);
+            Check(Translate(translator, path), ReferenceTranslate(translations, path, PathTranslator::MAX_CHAINED_TRANSLATIONS), path);
+        }
+    }
+}
+
+void PrintLookupTimes()
+{
+    const std::string path = "/home/agent/work/1/s/out/obj/Release/some/deep/directory/file.o";
+    printf("translations  ns/lookup\n");
+    for (size_t count : { 1, 10, 100, 1000, 10000 })
+    {
+        // all of them share a long prefix with the path, and the last one applies to it
+        Translations translations;
+        for (size_t i = 0; i + 1 < count; i++)
+        {
+            translations.emplace_back("/home/agent/work/" + std::to_string(i) + "/", "/w/" + std::to_string(i) + "/");
+        }
+
+        translations.emplace_back("/home/agent/work/1/s/", "/w/s/");
+
+        PathTranslator translator;
+        translator.Init(translations);
+        const int iterations = 200000;
+        std::string translated;
+        size_t total = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            translator.Translate(path.data(), path.length(), translated);
+            total += translated.length();
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        Check(std::to_string(total / iterations), std::to_string(path.length() - 21 + 5), path);
+        printf("%12zu  %9.1f\n", count, (double)elapsed / iterations);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    CheckFixedTranslations();
+    CheckRandomTranslations();
+    PrintLookupTimes();
+    return 0;
+}
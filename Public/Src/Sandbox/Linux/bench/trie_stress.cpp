@@ -0,0 +1,251 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+// Multi-threaded stress test of the Interop 'Trie', for both kinds of keys.  Exits with 1 on the first violation.
+//
+// Usage: trie_stress <manifest> [threads] [keys] [operations per thread]
+//   <manifest>    a FAM written by fam_gen, needed to create the values stored in the trie
+//   [threads]     default: 8
+//   [keys]        number of distinct keys (default: 20000)
+//   [operations]  number of random operations per thread in the second phase (default: 200000)
+//
+// Phase 1 ('getOrAdd'): all threads add all the keys, each with its own values and in its own order.  For every key
+// exactly one thread must get 'kTrieResultInserted', and every thread must get back the value of that thread.
+//
+// Phase 2 (churn): all threads insert, replace, and remove random keys.  Every thread counts how much its successful
+// operations changed the size of the trie; in the end, the sum of those must equal both 'getCount' and the number of
+// entries 'forEach' visits, and every uint key 'forEach' passes must be that of the value it passes.
+//
+// Finally, destroying the tries must give back all the nodes and memory they took (no child node created by a thread
+// that lost a race may leak).
+//
+// Prints the throughput of both phases: "<kind>\t<phase>\t<operations per second>".
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bench_pip.hpp"
+#include "SandboxedProcess.hpp"
+#include "Trie.hpp"
+
+namespace
+{
+
+typedef Trie<SandboxedProcess> TestTrie;
+typedef std::shared_ptr<SandboxedProcess> Value;
+
+uint64_t NowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void Check(bool condition, const char *kind, const char *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "trie_stress: %s trie: %s\n", kind, what);
+        exit(1);
+    }
+}
+
+// Uint and path keys go through the same overloads of 'Trie'
+struct UintKeys
+{
+    static constexpr const char *kName = "uint";
+    std::vector<uint64_t> keys;
+
+    UintKeys(int count)
+    {
+        // pid-like numbers, many sharing their low digits (the uint trie indexes the least significant digit first)
+        for (int i = 0; i < count; i++) keys.push_back(1000 + (uint64_t)i * 37);
+    }
+
+    uint64_t operator[](size_t i) const { return keys[i]; }
+    static TestTrie* create()                    { return TestTrie::createUintTrie(); }
+    static void counts(uint *nodes, double *mb)  { TestTrie::getUintNodeCounts(nodes, mb); }
+};
+
+struct PathKeys
+{
+    static constexpr const char *kName = "path";
+    std::vector<std::string> keys;
+
+    PathKeys(int count)
+    {
+        // paths sharing long prefixes, so that threads keep racing for the same nodes
+        char path[PATH_MAX];
+        for (int i = 0; i < count; i++)
+        {
+            snprintf(path, sizeof(path), "/home/builder/src/Out/Objects/%x/%x/File%d.obj", i % 16, (i / 16) % 64, i);
+            keys.push_back(path);
+        }
+    }
+
+    const char* operator[](size_t i) const { return keys[i].c_str(); }
+    static TestTrie* create()                    { return TestTrie::createPathTrie(); }
+    static void counts(uint *nodes, double *mb)  { TestTrie::getPathNodeCounts(nodes, mb); }
+};
+
+template <typename Keys>
+void Run(const std::shared_ptr<SandboxedPip> &pip, int threads, int count, int operations)
+{
+    const char *kind = Keys::kName;
+    Keys keys(count);
+
+    uint nodesBefore;
+    double mbBefore;
+    Keys::counts(&nodesBefore, &mbBefore);
+
+    TestTrie *trie = Keys::create();
+
+    std::vector<Value> values;
+    for (int t = 0; t < threads; t++)
+    {
+        values.push_back(std::make_shared<SandboxedProcess>(t + 1, pip));
+    }
+
+    // Phase 1
+    std::vector<std::atomic<int>> winners(count);
+    for (auto &winner : winners) winner = -1;
+
+    std::vector<std::thread> workers;
+    uint64_t start = NowNs();
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            for (int n = 0; n < count; n++)
+            {
+                size_t i = ((size_t)n * 7919 + (size_t)t * 104729) % count;
+                TrieResult result;
+                Value value = trie->getOrAdd(keys[i], values[t], &result);
+                Check(value != nullptr, kind, "getOrAdd returned null");
+                if (result == kTrieResultInserted)
+                {
+                    int none = -1;
+                    Check(value == values[t], kind, "getOrAdd inserted but returned another value");
+                    Check(winners[i].compare_exchange_strong(none, t), kind, "two threads inserted the same key");
+                }
+                else
+                {
+                    Check(result == kTrieResultAlreadyExists, kind, "unexpected getOrAdd result");
+                }
+            }
+        });
+    }
+
+    for (std::thread &worker : workers) worker.join();
+    double getOrAddOps = (double)count * threads * 1e9 / (NowNs() - start);
+    workers.clear();
+
+    Check(trie->getCount() == (uint)count, kind, "wrong count after getOrAdd");
+    for (int i = 0; i < count; i++)
+    {
+        Check(winners[i] >= 0, kind, "no thread inserted a key");
+        Check(trie->get(keys[i]) == values[winners[i]], kind, "the stored value is not that of the winner");
+    }
+
+    // Phase 2
+    std::atomic<long> sizeChange(0);
+    start = NowNs();
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]()
+        {
+            std::mt19937 rng(t);
+            long change = 0;
+            for (int n = 0; n < operations; n++)
+            {
+                size_t i = rng() % count;
+                switch (rng() % 3)
+                {
+                    case 0:
+                    {
+                        TrieResult result = trie->insert(keys[i], values[t]);
+                        Check(result == kTrieResultInserted || result == kTrieResultAlreadyExists, kind, "unexpected insert result");
+                        if (result == kTrieResultInserted) change++;
+                        break;
+                    }
+                    case 1:
+                    {
+                        TrieResult result = trie->replace(keys[i], values[t]);
+                        Check(result == kTrieResultInserted || result == kTrieResultReplaced || result == kTrieResultRace, kind, "unexpected replace result");
+                        if (result == kTrieResultInserted) change++;
+                        break;
+                    }
+                    default:
+                    {
+                        TrieResult result = trie->remove(keys[i]);
+                        Check(result == kTrieResultRemoved || result == kTrieResultAlreadyEmpty || result == kTrieResultRace, kind, "unexpected remove result");
+                        if (result == kTrieResultRemoved) change--;
+                        break;
+                    }
+                }
+            }
+
+            sizeChange += change;
+        });
+    }
+
+    for (std::thread &worker : workers) worker.join();
+    double churnOps = (double)operations * threads * 1e9 / (NowNs() - start);
+
+    struct Visited { TestTrie *trie; bool uintKeys; uint count; uint wrongKeys; };
+    Visited visited = { trie, std::is_same<Keys, UintKeys>::value, 0, 0 };
+    trie->forEach(&visited, [](void *data, uint64_t key, const Value value)
+    {
+        Visited *visited = (Visited*)data;
+        if (value != nullptr) visited->count++;
+        if (visited->uintKeys && visited->trie->get(key) != value) visited->wrongKeys++;
+    });
+
+    Check((long)trie->getCount() == count + sizeChange, kind, "count does not match the successful operations");
+    Check(trie->getCount() == visited.count, kind, "count does not match the number of entries");
+    Check(visited.wrongKeys == 0, kind, "forEach passed keys of other values");
+
+    delete trie;
+
+    uint nodesAfter;
+    double mbAfter;
+    Keys::counts(&nodesAfter, &mbAfter);
+    Check(nodesAfter == nodesBefore && mbAfter == mbBefore, kind, "nodes leaked");
+
+    printf("%s\tget_or_add\t%.0f\n", kind, getOrAddOps);
+    printf("%s\tchurn\t%.0f\n", kind, churnOps);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 5)
+    {
+        fprintf(stderr, "Usage: trie_stress <manifest> [threads] [keys] [operations per thread]\n");
+        return 2;
+    }
+
+    int threads = argc > 2 ? atoi(argv[2]) : 8;
+    int count = argc > 3 ? atoi(argv[3]) : 20000;
+    int operations = argc > 4 ? atoi(argv[4]) : 200000;
+    if (threads <= 0 || count <= 0 || operations <= 0)
+    {
+        fprintf(stderr, "trie_stress: invalid arguments\n");
+        return 2;
+    }
+
+    std::shared_ptr<SandboxedPip> pip = LoadBenchPip("trie_stress", argv[1]);
+    Run<UintKeys>(pip, threads, count, operations);
+    Run<PathKeys>(pip, threads, count, operations);
+    return 0;
+}
@@ -1,5 +1,10 @@
 #!/bin/bash
 
+# Builds the sandbox in the manylinux2014 image, i.e., against glibc 2.17 (see bxl_observer.hpp).
+#
+# Usage: build-manylinux.sh [make target...]
+# Makes 'all' by default; other targets (e.g., 'syscall-budget') run in the same image, against what it built.
+
 set -euo pipefail
 
 __dir="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
@@ -15,6 +20,9 @@ docker pull quay.io/pypa/manylinux2014_x86_64
 
 function onExit {
     sudo chown -R `whoami`: "${__dir}/bin"
+    if [[ -d "${__dir}/bench/bin" ]]; then
+        sudo chown -R `whoami`: "${__dir}/bench/bin"
+    fi
 }
 
 trap onExit EXIT
@@ -26,4 +34,4 @@ docker run                                 \
     -v ${SANDBOX_ROOT}:/src                \
     -w /src/${__dir##$SANDBOX_ROOT/}       \
     quay.io/pypa/manylinux2014_x86_64      \
-    make all -j${JOBS}
+    make ${@:-all} -j${JOBS}
@@ -0,0 +1,478 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "OpNames.hpp"
+#include "bxl_reports.hpp"
+#include "utils.h"
+
+// Missing from the headers of older distributions (close_range was added in Linux 5.9; it has the same number everywhere)
+#ifndef SYS_close_range
+    #define SYS_close_range 436
+#endif
+
+// Not set by the engine: when set to "1", the first process of a pip starts a report aggregator for its whole process
+// tree (see 'ReportAggregator'); the other processes of the tree learn that it did from the file of the process tree count
+#define BxlEnvReportAggregator "__BUILDXL_REPORT_AGGREGATOR"
+
+// CODESYNC: Public/Src/Engine/Processes/SandboxConnectionLinuxDetours.cs
+// Suffix appended to the reports path to get the path of the socket of the report aggregator
+#define BxlReportAggregatorSocketSuffix ".aggregator"
+
+/**
+ * Optional per-pip process that the reports of a whole process tree go through on their way to the reports FIFO.
+ *
+ * It is started by the first process of the tree (see 'Start') and listens on a Unix socket next to the FIFO, which only
+ * the user the pip runs as can connect to.  Every process of the tree connects to it once (see 'Send') and sends its
+ * reports there, one message per report, instead of writing them to the FIFO.  The aggregator drops the reports that
+ * only differ from one it already forwarded by the pid of the process and their timestamps (see 'IsCoalescable' for
+ * the ones it never drops), and forwards the others in batches of whole reports of up to PIPE_BUF bytes (whatever it
+ * received until it runs out of messages), through a 'ReportWriter' of its own.  The engine thus gets the same stream
+ * it would get from the processes themselves (each report still carries the pid of the process that sent it, and the
+ * reports of a process stay in the order it sent them), with one report per distinct access of the tree instead of one
+ * per access of each of its processes.
+ *
+ * The aggregator exits once it has forwarded the completion of the process tree, or when the engine no longer reads
+ * the FIFO (e.g., because the pip was killed), or when it fails to forward reports.  It first forwards every report it
+ * was sent (see 'Stop'): a process that sends a report after that point waits for the aggregator to be done with the
+ * reports it sent before, then writes that report, and the ones after it, to the FIFO directly.
+ */
+class ReportAggregator final
+{
+public:
+    typedef pid_t (*ForkFn)(void);
+    typedef void (*ExitFn)(int);
+    typedef int (*UnlinkFn)(const char *);
+
+    // How long the aggregator waits for reports before checking whether it is still needed
+    static const int IDLE_TIMEOUT_MS = 100;
+
+private:
+    char path_[sizeof(((struct sockaddr_un *)NULL)->sun_path)];  // the socket, next to the reports FIFO
+    struct sockaddr_un address_;
+    ReportWriter::CloseFn close_;
+    std::atomic<int> fd_;           // the connection of this process, -1 until it sends its first report
+    std::atomic<bool> on_;
+
+    // The reports the aggregator received and did not forward yet, and the accesses it already forwarded.
+    struct Forwarder
+    {
+        ReportWriter &writer;
+        std::unordered_set<std::string> forwarded;
+        char batch[PIPE_BUF];
+        size_t batchLength;
+        char arena[PIPE_BUF];
+        bool completed;             // the completion of the process tree was received
+        bool sentAny;
+        bool failed;                // the reports can no longer be forwarded
+
+        explicit Forwarder(ReportWriter &w) : writer(w), batchLength(0), completed(false), sentAny(false), failed(false) {}
+
+        void Forward()
+        {
+            if (batchLength > 0 && !failed)
+            {
+                failed = writer.Send(batch, batchLength) == ReportWriter::kReportFailed;
+                sentAny = true;
+            }
+
+            batchLength = 0;
+        }
+
+        // Adds the report in 'message' to the batch, unless it is redundant (or not a report at all).
+        void Add(const char *message, ssize_t size)
+        {
+            // CODESYNC: BxlObserver::SendReport (one length-prefixed report per message)
+            parsed_report report;
+            int numReports, arenaUsed;
+            if (size < (ssize_t)sizeof(uint32_t) || (*(uint32_t *)message & ~REPORTS_MESSAGE_KIND_MASK) != size - sizeof(uint32_t) ||
+                parse_reports(message, 0, size, &report, 1, arena, sizeof(arena), &numReports, &arenaUsed) != size || numReports != 1)
+            {
+                // not a report: it has no business in the FIFO
+                return;
+            }
+
+            if (IsCoalescable(report))
+            {
+                // everything but the pid and the timestamps: "<program>|<access>|<status>|<explicit>|<error>|<operation>|<path>"
+                const char *text = message + sizeof(uint32_t);
+                const char *programEnd = (const char *)memchr(text, '|', size - sizeof(uint32_t));
+                std::string key(text, programEnd - text);
+                key.append((const char *)&report.requested_access, 5 * sizeof(uint32_t));
+                key.append(arena + report.path_offset, report.path_length);
+                if (!forwarded.insert(std::move(key)).second)
+                {
+                    return;
+                }
+            }
+
+            completed |= report.operation == kOpProcessTreeCompleted;
+            if (batchLength + size > sizeof(batch))
+            {
+                Forward();
+            }
+
+            memcpy(batch + batchLength, message, size);
+            batchLength += size;
+        }
+    };
+
+    static bool IsCoalescable(const parsed_report &report)
+    {
+        if ((report.flags & (PARSED_REPORT_HAS_DIGEST | PARSED_REPORT_MALFORMED | PARSED_REPORT_SPILL | PARSED_REPORT_STATISTICS)) != 0)
+        {
+            return false;
+        }
+
+        switch (report.operation)
+        {
+            case kOpProcessStart:
+            case kOpProcessExit:
+            case kOpProcessTreeCompleted:
+            case kOpMacVNodeCloneSource:
+            case kOpMacVNodeCloneDest:
+            case kOpKAuthMoveSource:
+            case kOpKAuthMoveDest:
+            case kOpKAuthCreateHardlinkSource:
+            case kOpKAuthCreateHardlinkDest:
+            case kOpKAuthCopySource:
+            case kOpKAuthCopyDest:
+                return false;
+
+            default:
+                return true;
+        }
+    }
+
+    // Whether the engine still has the reports FIFO open for reading.
+    static bool HasReader(const char *reportsPath, ReportWriter::OpenFn openFn, ReportWriter::CloseFn closeFn)
+    {
+        // (fails with ENXIO when the FIFO has no reader, with ENOENT when it is gone)
+        int fd = openFn(reportsPath, O_WRONLY | O_NONBLOCK | O_CLOEXEC, 0);
+        if (fd == -1)
+        {
+            return false;
+        }
+
+        closeFn(fd);
+        return true;
+    }
+
+    // Reads the reports connection 'fd' has until it has none left; returns false once the connection is over.
+    static bool Receive(int fd, Forwarder &forwarder)
+    {
+        char message[PIPE_BUF + 1];
+        for (;;)
+        {
+            ssize_t size = recv(fd, message, sizeof(message), MSG_DONTWAIT);
+            if (size > 0)
+            {
+                forwarder.Add(message, size);
+            }
+            else if (size == 0 || errno != EINTR)
+            {
+                return size == -1 && errno == EAGAIN;
+            }
+        }
+    }
+
+    // Accepts the connections of the processes that connected since the last call.
+    static void Accept(int listener, std::vector<struct pollfd> &fds)
+    {
+        int fd;
+        while ((fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC)) != -1 || errno == EINTR)
+        {
+            if (fd != -1)
+            {
+                fds.push_back({ fd, POLLIN, 0 });
+            }
+        }
+    }
+
+    /**
+     * Stops taking reports, but forwards every report it was sent: the processes that send one from now on fail to (see
+     * 'Send'), and wait for their connection to be closed, which only happens once the reports they sent before were forwarded.
+     */
+    static void Stop(std::vector<struct pollfd> &fds, Forwarder &forwarder, ReportWriter::CloseFn closeFn)
+    {
+        // (once the listening socket is shut down, connecting to it is refused, so no connection is left unaccepted)
+        shutdown(fds[0].fd, SHUT_RD);
+        Accept(fds[0].fd, fds);
+        for (size_t i = 1; i < fds.size(); i++)
+        {
+            // what was sent before is still received, then the end of the connection
+            shutdown(fds[i].fd, SHUT_RD);
+            Receive(fds[i].fd, forwarder);
+        }
+
+        forwarder.Forward();
+        forwarder.writer.Flush();
+        for (const struct pollfd &pfd : fds)
+        {
+            closeFn(pfd.fd);
+        }
+    }
+
+    // The body of the aggregator process: returns when it is no longer needed.
+    static void Run(int listener, ReportWriter &writer, ReportWriter::OpenFn openFn, ReportWriter::CloseFn closeFn)
+    {
+        Forwarder forwarder(writer);
+        std::vector<struct pollfd> fds = { { listener, POLLIN, 0 } };
+        while (!forwarder.failed)
+        {
+            // only waits when there is nothing left to forward
+            int ready = poll(fds.data(), fds.size(), forwarder.batchLength == 0 ? IDLE_TIMEOUT_MS : 0);
+            if (ready == -1 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (ready == -1 || (ready == 0 && forwarder.batchLength == 0 &&
+                (forwarder.completed || (forwarder.sentAny && !HasReader(writer.GetReportsPath(), openFn, closeFn)))))
+            {
+                break;
+            }
+
+            if (ready == 0)
+            {
+                forwarder.Forward();
+                continue;
+            }
+
+            // The connections are read in the order they were accepted, each until it has nothing left, so the reports a
+            // process sent on a connection it lost (see 'OnFdClosed') come before those it sends on its new one.
+            for (size_t i = 1; i < fds.size(); i++)
+            {
+                if (fds[i].revents != 0 && !Receive(fds[i].fd, forwarder))
+                {
+                    closeFn(fds[i].fd);
+                    fds[i].fd = -1;
+                }
+            }
+
+            fds.erase(std::remove_if(fds.begin() + 1, fds.end(), [](const struct pollfd &pfd) { return pfd.fd == -1; }), fds.end());
+            if (fds[0].revents != 0)
+            {
+                Accept(listener, fds);
+            }
+        }
+
+        Stop(fds, forwarder, closeFn);
+    }
+
+    // The connection of this process to the aggregator (made on first use), or -1 if it could not be made.
+    int Connect()
+    {
+        int fd = fd_.load();
+        if (fd != -1)
+        {
+            return fd;
+        }
+
+        fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd != -1 && connect(fd, (struct sockaddr *)&address_, sizeof(address_)) != 0)
+        {
+            close_(fd);
+            return -1;
+        }
+
+        // (another thread may have connected in the meantime)
+        int expected = -1;
+        if (fd != -1 && !fd_.compare_exchange_strong(expected, fd))
+        {
+            close_(fd);
+            return expected;
+        }
+
+        return fd;
+    }
+
+public:
+    ReportAggregator() : close_(NULL), fd_(-1), on_(false)
+    {
+        path_[0] = '\0';
+        memset(&address_, 0, sizeof(address_));
+    }
+
+    /**
+     * Sends the reports of this process to the aggregator of the pip whose reports FIFO is at 'reportsPath' (not
+     * necessarily 0-terminated, hence 'length'), see 'Start'.
+     */
+    void Init(const char *reportsPath, int length, ReportWriter::CloseFn closeFn)
+    {
+        int pathLength = snprintf(path_, sizeof(path_), "%.*s" BxlReportAggregatorSocketSuffix, length, reportsPath);
+        if (pathLength < 0 || pathLength >= (int)sizeof(path_))
+        {
+            // too long for the address of a socket: the reports go to the FIFO directly
+            path_[0] = '\0';
+            return;
+        }
+
+        address_.sun_family = AF_UNIX;
+        strcpy(address_.sun_path, path_);
+        close_ = closeFn;
+        on_ = true;
+    }
+
+    /**
+     * Called in the first process of a pip: starts the aggregator, which forwards the reports it gets to the FIFO at
+     * 'reportsPath' (not necessarily 0-terminated, hence 'length'), and sends the reports of this process to it.
+     * Returns false if the aggregator could not be started; this process then writes its reports to the FIFO itself.
+     */
+    bool Start(const char *reportsPath, int length, ForkFn forkFn, ExitFn exitFn, UnlinkFn unlinkFn,
+               ReportWriter::OpenFn openFn, ReportWriter::WriteFn writeFn, ReportWriter::CloseFn closeFn)
+    {
+        Init(reportsPath, length, closeFn);
+        if (!on_)
+        {
+            return false;
+        }
+
+        // Bound before forking, so that the processes that connect before the aggregator gets to run wait for it.  Only
+        // the user the pip runs as may connect (the socket of a previous run of the pip is left behind if it was killed).
+        unlinkFn(path_);
+        int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        mode_t mask = umask(0177);
+        bool bound = sock != -1 && bind(sock, (struct sockaddr *)&address_, sizeof(address_)) == 0;
+        umask(mask);
+        if (!bound || listen(sock, SOMAXCONN) != 0)
+        {
+            if (sock != -1) closeFn(sock);
+            if (bound) unlinkFn(path_);
+            on_ = false;
+            return false;
+        }
+
+        // The aggregator is forked by a child that exits right away, so that it is not a child of this process: it must
+        // neither be seen by this process waiting for its children, nor keep the process tree from completing (see
+        // 'BxlObserver::has_uncounted_children').  It stays in the process group of the pip, which it is killed along with.
+        pid_t pid = forkFn();
+        if (pid == 0)
+        {
+            pid_t aggregator = forkFn();
+            if (aggregator != 0)
+            {
+                exitFn(aggregator == -1 ? 1 : 0);
+            }
+
+            // the aggregator must not hold on to anything of the process it was forked from (e.g., the pipes the
+            // engine reads its output from, which would not be closed when it exits)
+            if ((sock > 0 && syscall(SYS_close_range, 0, sock - 1, 0) != 0) || syscall(SYS_close_range, sock + 1, ~0U, 0) != 0)
+            {
+                for (int fd = 0; fd < 1024; fd++)
+                {
+                    if (fd != sock) closeFn(fd);
+                }
+            }
+
+            prctl(PR_SET_NAME, "bxl-aggregator", 0, 0, 0);
+            ReportWriter writer;
+            writer.Init(reportsPath, length, getpid(), openFn, writeFn, closeFn);
+            Run(sock, writer, openFn, closeFn);
+            unlinkFn(path_);
+            exitFn(0);
+        }
+
+        closeFn(sock);
+
+        // (when this process ignores SIGCHLD, its children are reaped without it waiting for them)
+        int status = 0;
+        pid_t waited = -1;
+        while (pid != -1 && (waited = waitpid(pid, &status, 0)) == -1 && errno == EINTR)
+        {
+        }
+
+        on_ = pid != -1 && (waited == -1 ? errno == ECHILD : WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        if (!on_)
+        {
+            unlinkFn(path_);
+        }
+
+        return on_;
+    }
+
+    inline bool IsOn() const { return on_; }
+
+    /** Called in a child right after it was forked: the connection it inherited is the one of its parent. */
+    void OnForked()
+    {
+        int fd = fd_.exchange(-1);
+        if (fd != -1)
+        {
+            close_(fd);
+        }
+    }
+
+    /** Called when this process closes file descriptor 'fd': if it is the connection to the aggregator, the next report makes another one. */
+    void OnFdClosed(int fd)
+    {
+        fd_.compare_exchange_strong(fd, -1);
+    }
+
+    /**
+     * Sends a report (at most PIPE_BUF bytes, including its length prefix) to the aggregator, waiting for it if it has
+     * too many reports to go through.  Returns false if the aggregator is gone (once it has forwarded the reports this
+     * process sent before), in which case this process stops using it.
+     */
+    bool Send(const char *buf, size_t size)
+    {
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            int fd = Connect();
+            if (fd == -1)
+            {
+                break;
+            }
+
+            ssize_t numSent;
+            while ((numSent = send(fd, buf, size, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+            {
+            }
+
+            if (numSent == (ssize_t)size)
+            {
+                return true;
+            }
+
+            if (numSent == -1 && (errno == EBADF || errno == ENOTSOCK))
+            {
+                // this process closed the connection without closing it through us (e.g., with close_range): make another one
+                fd_.compare_exchange_strong(fd, -1);
+                continue;
+            }
+
+            // The aggregator is stopping (see 'Stop'): it closes the connection once it has forwarded what was sent on it.
+            // (The connection itself is left open, as other threads of this process may still be using it.)
+            char byte;
+            while (recv(fd, &byte, sizeof(byte), 0) == -1 && errno == EINTR)
+            {
+            }
+
+            break;
+        }
+
+        int error = errno;
+        on_ = false;
+        errno = error;
+        return false;
+    }
+};
@@ -0,0 +1,312 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <atomic>
+
+extern const char *__progname;
+
+// CODESYNC: Public/Src/Engine/Processes/SandboxedProcessUnix.cs
+#define BxlEnvLogLevel "__BUILDXL_LOG_LEVEL"
+#define BxlEnvLogHooks "__BUILDXL_LOG_HOOKS"
+
+typedef enum
+{
+    kLogNone  = 0,
+    kLogError = 1,  // failures of the sandbox itself
+    kLogInfo  = 2,  // accesses checked and reports sent
+    kLogDebug = 3,  // every intercepted call
+    kLogTrace = 4,  // every forwarded call, with its arguments
+} BxlLogLevel;
+
+/**
+ * Per-process debug log of the sandbox, enabled by setting __BUILDXL_LOG_PATH.
+ *
+ * Lines are formatted into a buffer which is appended to the log file (opened once, with O_APPEND, so that the
+ * processes of a pip can share it) whenever it fills up, when an error is logged, and when this process is about
+ * to exit or exec (see 'Flush').  A child created by fork/clone discards the lines it inherited from its parent when
+ * it is told it was forked (see 'OnForked'); until then (or if it never is) it logs nothing.
+ *
+ * What gets logged is configured through the environment:
+ *   - __BUILDXL_LOG_LEVEL: "error", "info", "debug" or "trace" (or the corresponding number, 1 to 4);
+ *     defaults to "trace" in debug builds and to "error" otherwise;
+ *   - __BUILDXL_LOG_HOOKS: comma-separated names of the interposed functions whose calls are logged;
+ *     when set, whatever is logged while any other interposed function is running is dropped.
+ */
+class SandboxLog final
+{
+public:
+    typedef int (*OpenFn)(const char *, int, mode_t);
+    typedef ssize_t (*WriteFn)(int, const void *, size_t);
+
+    static const size_t BUFFER_SIZE = 32 * 1024;
+    static const size_t MAX_LINE_LENGTH = 4096;
+    static const size_t MAX_HOOKS_LENGTH = 1024;
+
+    // Whether the current thread is running an interposed function that is filtered out by __BUILDXL_LOG_HOOKS
+    static thread_local bool sInFilteredHook;
+
+private:
+    BxlLogLevel level_;
+    char path_[PATH_MAX];
+    char hooks_[MAX_HOOKS_LENGTH];  // ",name,name,...,", or empty when all hooks are logged
+    OpenFn open_;
+    WriteFn write_;
+
+    int fd_;
+    pid_t ownerPid_;                // the process the buffered lines belong to
+    std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+    size_t length_;
+    char buffer_[BUFFER_SIZE];
+
+    // the log '_fatal' writes to before exiting
+    static SandboxLog *sActive;
+
+    static BxlLogLevel ParseLevel(const char *str)
+    {
+        if (str == NULL || *str == '\0')
+        {
+#if _DEBUG
+            return kLogTrace;
+#else
+            return kLogError;
+#endif
+        }
+
+        static const char *names[] = { "none", "error", "info", "debug", "trace" };
+        for (int level = kLogNone; level <= kLogTrace; level++)
+        {
+            if (strcasecmp(str, names[level]) == 0 || (str[0] == '0' + level && str[1] == '\0'))
+            {
+                return (BxlLogLevel)level;
+            }
+        }
+
+        return kLogTrace;
+    }
+
+    void Lock()
+    {
+        while (lock_.test_and_set(std::memory_order_acquire))
+        {
+            sched_yield();
+        }
+    }
+
+    void Unlock()
+    {
+        lock_.clear(std::memory_order_release);
+    }
+
+    // Must be called with the lock held.
+    void FlushLocked()
+    {
+        if (length_ == 0)
+        {
+            return;
+        }
+
+        if (fd_ == -1)
+        {
+            fd_ = open_(path_, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        }
+
+        // lines are only ever written in whole buffers, so those of different processes do not interleave
+        size_t written = 0;
+        while (fd_ != -1 && written < length_)
+        {
+            ssize_t n = write_(fd_, buffer_ + written, length_ - written);
+            if (n <= 0)
+            {
+                break;
+            }
+
+            written += n;
+        }
+
+        length_ = 0;
+    }
+
+public:
+    SandboxLog() : level_(kLogNone), open_(NULL), write_(NULL), fd_(-1), ownerPid_(0), length_(0)
+    {
+        path_[0] = '\0';
+        hooks_[0] = '\0';
+    }
+
+    /** Enables the log when 'path' is not empty; 'level' and 'hooks' are the values of the corresponding environment variables. */
+    void Init(const char *path, const char *level, const char *hooks, OpenFn openFn, WriteFn writeFn)
+    {
+        if (path == NULL || *path == '\0' || strlen(path) >= PATH_MAX)
+        {
+            level_ = kLogNone;
+            return;
+        }
+
+        strcpy(path_, path);
+        open_ = openFn;
+        write_ = writeFn;
+        ownerPid_ = getpid();
+        hooks_[0] = '\0';
+        if (hooks != NULL && *hooks != '\0')
+        {
+            snprintf(hooks_, sizeof(hooks_), ",%s,", hooks);
+        }
+
+        level_ = ParseLevel(level);
+        sActive = this;
+    }
+
+    inline bool IsOn() const { return level_ != kLogNone; }
+
+    inline bool IsEnabled(BxlLogLevel level) const
+    {
+        return level <= level_ && !sInFilteredHook;
+    }
+
+    /** Whether the lines logged while interposed function 'name' runs are kept. */
+    bool IsHookLogged(const char *name) const
+    {
+        if (hooks_[0] == '\0')
+        {
+            return true;
+        }
+
+        char key[128];
+        int len = snprintf(key, sizeof(key), ",%s,", name);
+        return len > 0 && (size_t)len < sizeof(key) && strstr(hooks_, key) != NULL;
+    }
+
+    /** Formats a line (prefixed with the name and pid of this process) into the buffer. */
+    void Log(BxlLogLevel level, const char *fmt, ...) __attribute__((format(printf, 3, 4)))
+    {
+        va_list args;
+        va_start(args, fmt);
+        LogV(level, fmt, args);
+        va_end(args);
+    }
+
+    void LogV(BxlLogLevel level, const char *fmt, va_list args)
+    {
+        // the buffer (and the lock) belong to the parent of a child that was not told it was forked, and may be
+        // shared with it (see CLONE_VM)
+        pid_t pid = getpid();
+        if (pid != ownerPid_)
+        {
+            return;
+        }
+
+        char line[MAX_LINE_LENGTH];
+        int prefixLength = snprintf(line, sizeof(line), "[%s:%d] ", __progname, pid);
+        int len = vsnprintf(line + prefixLength, sizeof(line) - prefixLength, fmt, args);
+        if (len < 0)
+        {
+            return;
+        }
+
+        len = prefixLength + len < (int)sizeof(line) - 1 ? prefixLength + len : (int)sizeof(line) - 2;
+        if (line[len - 1] != '\n')
+        {
+            line[len++] = '\n';
+            line[len] = '\0';
+        }
+
+        Lock();
+        if (length_ + len > sizeof(buffer_))
+        {
+            FlushLocked();
+        }
+
+        memcpy(buffer_ + length_, line, len);
+        length_ += len;
+        if (level == kLogError)
+        {
+            FlushLocked();
+        }
+
+        Unlock();
+    }
+
+    /** Writes the buffered lines to the log file. */
+    void Flush()
+    {
+        if (!IsOn() || getpid() != ownerPid_)
+        {
+            return;
+        }
+
+        Lock();
+        FlushLocked();
+        Unlock();
+    }
+
+    /**
+     * Called in a child created by fork/clone (without CLONE_VM), before it runs anything else: the lines it inherited
+     * belong to its parent, and so may the lock (some other thread of the parent may have held it).
+     */
+    void OnForked(pid_t pid)
+    {
+        lock_.clear();
+        length_ = 0;
+        ownerPid_ = pid;
+    }
+
+    /** Called when this process closes file descriptor 'fd', which must then no longer be used for the log. */
+    inline void OnFdClosed(int fd)
+    {
+        if (fd == fd_ && fd != -1)
+        {
+            fd_ = -1;
+        }
+    }
+
+    /** Logs (and flushes) an error in the log of this process, if any; used right before exiting because of a fatal error. */
+    static void LogFatal(const char *fmt, ...) __attribute__((format(printf, 1, 2)))
+    {
+        if (sActive != NULL && sActive->IsOn())
+        {
+            va_list args;
+            va_start(args, fmt);
+            sActive->LogV(kLogError, fmt, args);
+            va_end(args);
+        }
+    }
+};
+
+/**
+ * Marks the current thread as running an interposed function whose lines are (not) logged, until it goes out of scope.
+ */
+class HookLogScope final
+{
+private:
+    bool active_;
+    bool saved_;
+
+public:
+    HookLogScope(const SandboxLog &log, bool hookLogged) : active_(log.IsOn()), saved_(false)
+    {
+        if (active_)
+        {
+            saved_ = SandboxLog::sInFilteredHook;
+            SandboxLog::sInFilteredHook = !hookLogged;
+        }
+    }
+
+    ~HookLogScope()
+    {
+        if (active_)
+        {
+            SandboxLog::sInFilteredHook = saved_;
+        }
+    }
+};
@@ -4,31 +4,46 @@
 #include "bxl_observer.hpp"
 #include "IOHandler.hpp"
 
-static void HandleAccessReport(AccessReport report, int _)
+static void HandleAccessReport(const AccessReportView &report, int _)
 {
     BxlObserver::GetInstance()->SendReport(report);
 }
 
 AccessCheckResult BxlObserver::sNotChecked = AccessCheckResult::Invalid();
+thread_local const char *BxlObserver::sPendingReportDigest = NULL;
+thread_local const std::shared_ptr<SandboxedProcess> *BxlObserver::sReportingProcess = NULL;
+thread_local uint64_t SandboxStats::sForwardedTicks = 0;
+thread_local bool SandboxLog::sInFilteredHook = false;
+SandboxLog *SandboxLog::sActive = NULL;
 
 BxlObserver* BxlObserver::GetInstance()
 {
-    static BxlObserver s_singleton;
-    return &s_singleton;
+    // Never destroyed: glibc runs the destructors of the static objects of this library before the on-exit handler
+    // that reports the exit of this process (see 'report_exit' in detours.cpp), which still needs this instance.
+    alignas(BxlObserver) static char s_storage[sizeof(BxlObserver)];
+    static BxlObserver *s_singleton = new (s_storage) BxlObserver();
+    return s_singleton;
 }
 
 BxlObserver::BxlObserver()
 {
     empty_str_ = "";
+    memset(hashOnClose_, 0, sizeof(hashOnClose_));
     real_readlink("/proc/self/exe", progFullPath_, PATH_MAX);
 
     const char *rootPidStr = getenv(BxlEnvRootPid);
     rootPid_ = is_null_or_empty(rootPidStr) ? -1 : atoi(rootPidStr);
     disposed_ = false;
+    statsReported_ = false;
+    translator_ = NULL;
 
     InitLogFile();
+    InitTraceFile();
     InitFam();
     InitDetoursLibPath();
+    InitProcessTreeCount();
+    InitReportAggregator();
+    InitChildEnvs();
 }
 
 void BxlObserver::InitDetoursLibPath()
@@ -51,7 +66,7 @@ void BxlObserver::InitFam()
     const char *famPath = getenv(BxlEnvFamPath);
     if (is_null_or_empty(famPath))
     {
-        LOG_DEBUG("[%s] ERROR: Env var '%s' not set\n", __func__, BxlEnvFamPath);
+        LOG_ERROR("[%s] Env var '%s' not set", __func__, BxlEnvFamPath);
         return;
     }
 
@@ -71,9 +86,19 @@ void BxlObserver::InitFam()
     real_fclose(famFile);
 
     // create SandboxedPip (which parses FAM and throws on error)
-    pip_ = shared_ptr<SandboxedPip>(new SandboxedPip(getpid(), famPayload, famLength));
+    pid_t pid = getpid();
+    pip_ = shared_ptr<SandboxedPip>(new SandboxedPip(pid, famPayload, famLength));
     free(famPayload);
 
+    int reportsPathLength;
+    const char *reportsPath = pip_->GetReportsPath(&reportsPathLength);
+    reports_.Init(reportsPath, reportsPathLength, pid, real_open, real_write, real_close);
+
+    vector<pair<string, string>> translations;
+    pip_->GetTranslatePaths(translations);
+    translator_ = new PathTranslator();
+    translator_->Init(translations);
+
     // create sandbox
     sandbox_ = new Sandbox(0, Configuration::DetoursLinuxSandboxType);
 
@@ -83,25 +108,185 @@ void BxlObserver::InitFam()
         _fatal("Could not track root process %s:%d", __progname, getpid());
     }
 
-    process_ = sandbox_->FindTrackedProcess(getpid());
+    process_ = sandbox_->FindTrackedProcess(pid);
     process_->SetPath(progFullPath_);
     sandbox_->SetAccessReportCallback(HandleAccessReport);
+
+    if (CheckReportSandboxStatistics(pip_->GetFamExtraFlags()))
+    {
+        stats_.Enable();
+    }
 }
 
-void BxlObserver::InitLogFile()
+void BxlObserver::InitProcessTreeCount()
+{
+    processTree_ = NULL;
+    processTreeCount_ = NULL;
+    processTreeCountPath_[0] = '\0';
+    countedPid_ = -1;
+    isLastInProcessTree_ = false;
+    isFirstInProcessTree_ = false;
+
+    // the count can only reach zero if every process of the tree is monitored
+    if (!IsEnabled() || !IsMonitoringChildProcesses() || pip_->AllowChildProcessesToBreakAway())
+    {
+        return;
+    }
+
+    int len;
+    const char *reportsPath = pip_->GetReportsPath(&len);
+    snprintf(processTreeCountPath_, PATH_MAX, "%.*s%s", len, reportsPath, BxlProcessTreeCountFileSuffix);
+
+    // the first process of the tree creates the file, every other one just maps it
+    bool created = true;
+    int fd = real_open(processTreeCountPath_, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1 && errno == EEXIST)
+    {
+        created = false;
+        fd = real_open(processTreeCountPath_, O_RDWR | O_CLOEXEC, 0);
+    }
+
+    if (fd == -1 || (created && real_ftruncate(fd, sizeof(ProcessTreeState)) != 0))
+    {
+        LOG_ERROR("Could not open process tree count file '%s'; errno: %d", processTreeCountPath_, errno);
+        if (fd != -1) real_close(fd);
+        return;
+    }
+
+    void *state = mmap(NULL, sizeof(ProcessTreeState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    real_close(fd);
+    if (state == MAP_FAILED)
+    {
+        LOG_ERROR("Could not map process tree count file '%s'; errno: %d", processTreeCountPath_, errno);
+        return;
+    }
+
+    processTree_ = (ProcessTreeState *)state;
+    processTreeCount_ = &processTree_->count;
+    pip_->UseSharedProcessTreeCount(processTreeCount_);
+
+    // A process counted by its parent (see 'count_child_process') passes its pid on to the image it execs, while a
+    // process spawning a child with posix_spawn counts it beforehand and marks it with BxlSpawnedChildPidPrefix (see
+    // 'ensureEnvs').  Any other process (e.g., one started by a call we don't interpose) counts itself here.
+    // The marker is trusted as is (the parent may have exited already, so it can't be matched against getppid), which
+    // is only right for the process it was passed to: that process replaces it with its own pid right away, so that
+    // the processes that inherit its environment some other way (e.g., a raw fork followed by an exec) count themselves.
+    const char *countedPidStr = getenv(BxlEnvCountedPid);
+    bool alreadyCounted = !is_null_or_empty(countedPidStr) &&
+        (countedPidStr[0] == BxlSpawnedChildPidPrefix || atoi(countedPidStr) == getpid());
+    if (created)
+    {
+        processTreeCount_->store(1);
+        isFirstInProcessTree_ = true;
+    }
+    else if (!alreadyCounted)
+    {
+        (*processTreeCount_)++;
+    }
+
+    countedPid_ = getpid();
+    if (!is_null_or_empty(countedPidStr) && countedPidStr[0] == BxlSpawnedChildPidPrefix)
+    {
+        char pidStr[16];
+        snprintf(pidStr, sizeof(pidStr), "%d", countedPid_);
+        setenv(BxlEnvCountedPid, pidStr, /*overwrite*/ 1);
+    }
+}
+
+void BxlObserver::InitReportAggregator()
+{
+    // only used along with the process tree count: the aggregator exits once it has forwarded the completion of the tree
+    if (processTree_ == NULL)
+    {
+        return;
+    }
+
+    int len;
+    const char *reportsPath = pip_->GetReportsPath(&len);
+    if (!isFirstInProcessTree_)
+    {
+        // (any process that joins the tree was started after its first process, which started the aggregator if it was to)
+        if (processTree_->hasAggregator)
+        {
+            aggregator_.Init(reportsPath, len, real_close);
+        }
+
+        return;
+    }
+
+    const char *enabled = getenv(BxlEnvReportAggregator);
+    if (is_null_or_empty(enabled) || strcmp(enabled, "1") != 0)
+    {
+        return;
+    }
+
+    if (!aggregator_.Start(reportsPath, len, real_fork, real__exit, real_unlink, real_open, real_write, real_close))
+    {
+        LOG_ERROR("Could not start the report aggregator; errno: %d", errno);
+        return;
+    }
+
+    processTree_->hasAggregator = true;
+}
+
+void BxlObserver::InitChildEnvs()
+{
+    childEnvCount_ = 0;
+    if (IsValid())
+    {
+        // When child processes are monitored they get the values this process got (those not set here are left
+        // as they are); otherwise all of them are cleared, so that the children are not sandboxed.
+        bool monitoring = IsMonitoringChildProcesses();
+        const char *names[MAX_CHILD_ENVS] = { BxlEnvFamPath, BxlEnvLogPath, BxlEnvLogLevel, BxlEnvLogHooks, BxlEnvRootPid, BxlEnvDetoursPath, BxlEnvTraceDir };
+        char *pBuf = childEnvBuf_;
+        const char *end = childEnvBuf_ + sizeof(childEnvBuf_);
+        for (const char *name : names)
+        {
+            const char *value = monitoring ? getenv(name) : "";
+            if (monitoring && is_null_or_empty(value))
+            {
+                continue;
+            }
+
+            int len = snprintf(pBuf, end - pBuf, "%s=%s", name, value);
+            if (len < 0 || len >= end - pBuf)
+            {
+                _fatal("Environment variable %s is too long: %s", name, value);
+            }
+
+            childEnvs_[childEnvCount_++] = pBuf;
+            pBuf += len + 1;
+        }
+    }
+
+    UpdateCountedPidEnvs();
+}
+
+void BxlObserver::UpdateCountedPidEnvs()
 {
-    const char *logPath = getenv(BxlEnvLogPath);
-    if (!is_null_or_empty(logPath))
+    // the children of a process that is not counted count themselves
+    if (processTreeCount_ != NULL && countedPid_ == getpid())
     {
-        strlcpy(logFile_, logPath, PATH_MAX);
-        logFile_[PATH_MAX-1] = '\0';
+        snprintf(countedPidEnv_, sizeof(countedPidEnv_), "%s=%d", BxlEnvCountedPid, countedPid_);
+        snprintf(spawnedPidEnv_, sizeof(spawnedPidEnv_), "%s=%c%d", BxlEnvCountedPid, BxlSpawnedChildPidPrefix, countedPid_);
     }
     else
     {
-        logFile_[0] = '\0';
+        snprintf(countedPidEnv_, sizeof(countedPidEnv_), "%s=", BxlEnvCountedPid);
+        snprintf(spawnedPidEnv_, sizeof(spawnedPidEnv_), "%s=", BxlEnvCountedPid);
     }
 }
 
+void BxlObserver::InitLogFile()
+{
+    log_.Init(getenv(BxlEnvLogPath), getenv(BxlEnvLogLevel), getenv(BxlEnvLogHooks), real_open, real_write);
+}
+
+void BxlObserver::InitTraceFile()
+{
+    trace_.Init(getenv(BxlEnvTraceDir), progFullPath_, real_open, real_write);
+}
+
 bool BxlObserver::IsCacheHit(es_event_type_t event, const string &path, const string &secondPath)
 {
     // (1) IMPORTANT           : never do any of this stuff after this object has been disposed!
@@ -166,10 +351,13 @@ bool BxlObserver::IsCacheHit(es_event_type_t event, const string &path, const st
         unordered_set<string> set;
         set.insert(path);
         cache_.insert(make_pair(key, set));
+        stats_.RecordCacheLookup(/*hit*/ false);
         return false;
     }
 
-    return !it->second.insert(path).second;
+    bool isHit = !it->second.insert(path).second;
+    stats_.RecordCacheLookup(isHit);
+    return isHit;
 }
 
 bool BxlObserver::Send(const char *buf, size_t bufsiz)
@@ -185,49 +373,239 @@ bool BxlObserver::Send(const char *buf, size_t bufsiz)
         _fatal("Cannot atomically send a buffer whose size (%ld) is greater than PIPE_BUF (%d)", bufsiz, PIPE_BUF);
     }
 
-    const char *reportsPath = GetReportsPath();
-    int logFd = real_open(reportsPath, O_WRONLY | O_APPEND, 0);
-    if (logFd == -1)
+    // with a report aggregator, reports go through it (unless it is gone, e.g., after the completion of the process tree)
+    if (aggregator_.IsOn() && aggregator_.Send(buf, bufsiz))
     {
-        _fatal("Could not open file '%s'; errno: %d", reportsPath, errno);
+        stats_.RecordReport(bufsiz, /* spilled */ false);
+        return true;
     }
 
-    ssize_t numWritten = real_write(logFd, buf, bufsiz);
-    if (numWritten < bufsiz)
+    // never blocks while the engine keeps up with the reports: when the FIFO is full, the report is spilled to a file
+    ReportWriter::SendResult result = reports_.Send(buf, bufsiz);
+    if (result == ReportWriter::kReportFailed)
     {
-        _fatal("Wrote only %ld bytes out of %ld", numWritten, bufsiz);
+        _fatal("Could not send a report to '%s'; errno: %d", reports_.GetReportsPath(), errno);
     }
 
-    real_close(logFd);
+    stats_.RecordReport(bufsiz, /* spilled */ result == ReportWriter::kReportSpilled);
     return true;
 }
 
-bool BxlObserver::SendReport(AccessReport &report)
+bool BxlObserver::SendReport(const AccessReportView &report)
 {
-    // there is no central sendbox process here (i.e., there is an instance of this
-    // guy in every child process), so counting process tree size is not feasible
-    if (report.operation == FileOperation::kOpProcessTreeCompleted)
+    // there is no central sendbox process here (i.e., there is an instance of this guy in every child
+    // process), so several processes may see the (shared) process tree count drop to zero at the same time;
+    // only the one that actually brought it to zero reports that the process tree has completed
+    if (report.operation == FileOperation::kOpProcessTreeCompleted && !isLastInProcessTree_)
     {
         return true;
     }
 
+    // both timestamps are taken with CLOCK_MONOTONIC (see monotonic_time_ns), so the engine can compare them with the
+    // time it reads the report; reports that were not created by a handler that knew when the access happened are
+    // considered created right now
+    uint64_t enqueueTime = monotonic_time_ns();
+    uint64_t creationTime = report.stats.creationTime == 0 ? enqueueTime : report.stats.creationTime;
+
+    // reported paths do not depend on where the pip ran (see PathTranslator); this is the only place they are
+    // translated, the engine takes them as they are
+    // CODESYNC: Public/Src/Engine/Processes/SandboxedProcessReports.cs (PathsTranslatedBySandbox)
+    std::string translatedPath;
+    bool translated = translator_ != NULL && translator_->Translate(report.path, report.pathLength, translatedPath);
+    const char *path = translated ? translatedPath.data() : report.path;
+    int pathLength = translated ? (int)translatedPath.length() : (int)report.pathLength;
+
     const int PrefixLength = sizeof(uint);
     char buffer[PIPE_BUF] = {0};
     int maxMessageLength = PIPE_BUF - PrefixLength;
-    int numWritten = snprintf(
-        &buffer[PrefixLength], maxMessageLength, "%s|%d|%d|%d|%d|%d|%d|%s\n",
-        __progname, getpid(), report.requestedAccess, report.status, report.reportExplicitly, report.error, report.operation, report.path);
+    // CODESYNC: Public/Src/Engine/Processes/SandboxConnectionLinuxDetours.cs
+    // (a pending digest, when present, is sent as an extra trailing field; only the close of a modified file has one)
+    const char *digest = sPendingReportDigest;
+    // (reports sent on behalf of another process carry its name and pid, see 'report_access_on_behalf')
+    const char *progName = __progname;
+    pid_t pid = getpid();
+    if (sReportingProcess != NULL)
+    {
+        const char *exePath = (*sReportingProcess)->GetPath();
+        const char *lastSlash = strrchr(exePath, '/');
+        progName = lastSlash != NULL ? lastSlash + 1 : exePath;
+        pid = (*sReportingProcess)->GetPid();
+    }
+
+    // (a report view does not promise a 0-terminated path, hence the precision of the path)
+    int numWritten = digest != NULL
+        ? snprintf(
+            &buffer[PrefixLength], maxMessageLength, "%s|%d|%d|%d|%d|%d|%d|%lu|%lu|%.*s|%s\n",
+            progName, pid, report.requestedAccess, report.status, report.reportExplicitly, report.error, report.operation,
+            creationTime, enqueueTime, pathLength, path, digest)
+        : snprintf(
+            &buffer[PrefixLength], maxMessageLength, "%s|%d|%d|%d|%d|%d|%d|%lu|%lu|%.*s\n",
+            progName, pid, report.requestedAccess, report.status, report.reportExplicitly, report.error, report.operation,
+            creationTime, enqueueTime, pathLength, path);
     if (numWritten == maxMessageLength)
     {
         // TODO: once 'send' is capable of sending more than PIPE_BUF at once, allocate a bigger buffer and send that
         _fatal("Message truncated to fit PIPE_BUF (%d): %s", PIPE_BUF, buffer);
     }
 
-    LOG_DEBUG("Sending report: %s", &buffer[PrefixLength]);
+    LOG_INFO("Sending report: %s", &buffer[PrefixLength]);
     *(uint*)(buffer) = numWritten;
     return Send(buffer, numWritten + PrefixLength);
 }
 
+bool BxlObserver::count_child_process()
+{
+    // the child is counted before it is created, so that the count cannot drop to zero while the child is starting up
+    if (processTreeCount_ == NULL)
+    {
+        return false;
+    }
+
+    (*processTreeCount_)++;
+    return true;
+}
+
+void BxlObserver::uncount_child_process()
+{
+    // only called when creating a counted child failed, so the calling process (which is still counted) keeps the count above zero
+    (*processTreeCount_)--;
+}
+
+void BxlObserver::mark_counted_in_process_tree()
+{
+    // this is a new process: the statistics (and the spilled reports) it inherited from its parent are not its own
+    if (stats_.IsEnabled())
+    {
+        stats_.Reset();
+        statsReported_ = false;
+    }
+
+    pid_t pid = getpid();
+    log_.OnForked(pid);
+    reports_.OnForked(pid);
+    aggregator_.OnForked();
+
+    if (processTreeCount_ != NULL)
+    {
+        countedPid_ = pid;
+        isLastInProcessTree_ = false;
+        UpdateCountedPidEnvs();
+    }
+}
+
+bool BxlObserver::has_uncounted_children()
+{
+    // Called once the count dropped to zero, so any child still alive is one that has not counted itself yet (i.e.,
+    // it was not created by a call we interpose and its library has not been initialized yet) or never will.
+    char path[PATH_MAX];
+    DIR *tasks = real_opendir("/proc/self/task");
+    if (tasks == NULL)
+    {
+        return false;
+    }
+
+    bool found = false;
+    for (struct dirent *task = readdir(tasks); task != NULL && !found; task = readdir(tasks))
+    {
+        if (task->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        char children[PIPE_BUF] = {0};
+        snprintf(path, sizeof(path), "/proc/self/task/%s/children", task->d_name);
+        int fd = real_open(path, O_RDONLY | O_CLOEXEC, 0);
+        ssize_t length = fd == -1 ? -1 : read(fd, children, sizeof(children) - 1);
+        if (fd != -1) real_close(fd);
+
+        // "<pid> <pid> ... "; children that exited but were not waited for yet do not count
+        char *next = NULL;
+        for (char *pidStr = length > 0 ? strtok_r(children, " \n", &next) : NULL; pidStr != NULL && !found; pidStr = strtok_r(NULL, " \n", &next))
+        {
+            char stat[512] = {0};
+            snprintf(path, sizeof(path), "/proc/%s/stat", pidStr);
+            fd = real_open(path, O_RDONLY | O_CLOEXEC, 0);
+            length = fd == -1 ? -1 : read(fd, stat, sizeof(stat) - 1);
+            if (fd != -1) real_close(fd);
+
+            // "<pid> (<comm>) <state> ...", where <comm> may contain anything
+            const char *state = length > 0 ? strrchr(stat, ')') : NULL;
+            found = state != NULL && state[1] == ' ' && state[2] != 'Z' && state[2] != 'X';
+        }
+    }
+
+    closedir(tasks);
+    return found;
+}
+
+bool BxlObserver::SendStatistics()
+{
+    if (!stats_.IsEnabled() || statsReported_)
+    {
+        return true;
+    }
+
+    // CODESYNC: parse_reports in utils.c (REPORTS_STATISTICS)
+    const int PrefixLength = sizeof(uint);
+    char buffer[PIPE_BUF];
+    int length = snprintf(&buffer[PrefixLength], sizeof(buffer) - PrefixLength, "%d|", getpid());
+    int statsLength = stats_.Format(&buffer[PrefixLength + length], sizeof(buffer) - PrefixLength - length - 1);
+    if (statsLength <= 0)
+    {
+        return false;
+    }
+
+    length += statsLength;
+    buffer[PrefixLength + length++] = '\n';
+    *(uint*)(buffer) = (uint)length | REPORTS_STATISTICS;
+    statsReported_ = true;
+    return Send(buffer, length + PrefixLength);
+}
+
+void BxlObserver::report_process_exit(const char *syscallName)
+{
+    // The statistics of this process (if they are collected) and its exit are reported (and the reports this process
+    // spilled are announced) while this process is still counted, so that the process tree cannot be reported as
+    // completed before the engine gets every report of this process.
+    SendStatistics();
+    report_access(syscallName, ES_EVENT_TYPE_NOTIFY_EXIT, empty_str_, empty_str_);
+    reports_.Flush();
+
+    if (processTreeCount_ != NULL && countedPid_ == getpid())
+    {
+        countedPid_ = -1;
+        if (--(*processTreeCount_) == 0)
+        {
+            report_process_tree_completed(syscallName);
+        }
+    }
+
+    log_.Flush();
+    trace_.Flush();
+}
+
+void BxlObserver::report_process_tree_completed(const char *syscallName)
+{
+    // A child that was not counted before it was created counts itself when it starts; until then the tree is not
+    // complete, and the count file is left in place for that child to find (the engine deletes it along with the
+    // pip's connection info if the child never does).
+    if (has_uncounted_children())
+    {
+        LOG_INFO("The process tree count dropped to zero while uncounted children of %d are alive", getpid());
+        return;
+    }
+
+    isLastInProcessTree_ = true;
+    real_unlink(processTreeCountPath_);
+    if (IsEnabled())
+    {
+        IOHandler handler(sandbox_);
+        handler.SetProcess(process_);
+        handler.ReportProcessTreeCompleted(pip_->GetProcessId());
+        reports_.Flush();
+    }
+}
+
 void BxlObserver::report_exec(const char *syscallName, const char *procName, const char *file)
 {
     if (IsMonitoringChildProcesses())
@@ -242,6 +620,12 @@ AccessCheckResult BxlObserver::report_access(const char *syscallName, es_event_t
 {
     if (IsCacheHit(eventType, reportPath, secondPath))
     {
+        if (trace_.IsOn())
+        {
+            IOEvent event(getpid(), 0, getppid(), eventType, ES_ACTION_TYPE_NOTIFY, reportPath, secondPath, std::string(progFullPath_), 0, false);
+            trace_.RecordAccess(syscallName, event, sNotChecked, monotonic_time_ns(), 0, kTraceCacheHit);
+        }
+
         return sNotChecked;
     }
 
@@ -262,25 +646,63 @@ AccessCheckResult BxlObserver::report_access(const char *syscallName, IOEvent &e
 
     if (checkCache && IsCacheHit(eventType, event.GetSrcPath(), event.GetDstPath()))
     {
+        if (trace_.IsOn())
+        {
+            trace_.RecordAccess(syscallName, event, sNotChecked, monotonic_time_ns(), 0, kTraceCacheHit);
+        }
+
         return sNotChecked;
     }
 
     AccessCheckResult result = sNotChecked;
+    uint64_t start = monotonic_time_ns();
+    bool enabled = IsEnabled();
 
-    if (IsEnabled())
+    if (enabled)
     {
         IOHandler handler(sandbox_);
-        handler.SetProcess(process_);
+        handler.SetProcess(sReportingProcess != NULL ? *sReportingProcess : process_);
+        handler.SetCreationTimestamp(start);
         result = handler.HandleEvent(event);
     }
 
-    LOG_DEBUG("(( %10s:%2d )) %s %s%s", syscallName, event.GetEventType(), event.GetEventPath(),
+    if (trace_.IsOn())
+    {
+        trace_.RecordAccess(syscallName, event, result, start, monotonic_time_ns() - start, enabled ? 0 : kTraceNotChecked);
+    }
+
+    LOG_INFO("(( %10s:%2d )) %s %s%s", syscallName, event.GetEventType(), event.GetEventPath(),
         !result.ShouldReport() ? "[Ignored]" : result.ShouldDenyAccess() ? "[Denied]" : "[Allowed]",
         result.ShouldDenyAccess() && IsFailingUnexpectedAccesses() ? "[Blocked]" : "");
 
     return result;
 }
 
+AccessCheckResult BxlObserver::report_access_on_behalf(const char *syscallName, IOEvent &event, const std::shared_ptr<SandboxedProcess> &process)
+{
+    if (process == nullptr)
+    {
+        return report_access(syscallName, event, /* checkCache */ false);
+    }
+
+    sReportingProcess = &process;
+    AccessCheckResult result = report_access(syscallName, event, /* checkCache */ false);
+    sReportingProcess = NULL;
+    return result;
+}
+
+std::shared_ptr<SandboxedProcess> BxlObserver::CreateObservedProcess(pid_t pid, const char *exePath)
+{
+    if (!IsEnabled())
+    {
+        return nullptr;
+    }
+
+    std::shared_ptr<SandboxedProcess> process(new SandboxedProcess(pid, pip_));
+    process->SetPath(exePath);
+    return process;
+}
+
 AccessCheckResult BxlObserver::report_access(const char *syscallName, es_event_type_t eventType, const char *pathname, int flags)
 {
     return report_access(syscallName, eventType, normalize_path(pathname, flags), "");
@@ -340,8 +762,187 @@ void BxlObserver::reset_fd_table_entry(int fd)
 {
     if (fd >= 0 && fd < MAX_FD)
     {
+        uncount_open_for_write(fd);
         fdTable_[fd] = empty_str_;
     }
+
+    // the process may close the descriptor of the log (e.g., when it closes all its descriptors before becoming a daemon)
+    log_.OnFdClosed(fd);
+    trace_.OnFdClosed(fd);
+    aggregator_.OnFdClosed(fd);
+}
+
+bool BxlObserver::count_open_for_write(int fd, const std::string &path)
+{
+    // like the cache, never block indefinitely here: if the lock can't be taken the file is simply not hashed
+    if (!openForWriteMtx_.try_lock_for(chrono::milliseconds(1)))
+    {
+        return false;
+    }
+
+    openForWriteCounts_[path]++;
+    openForWriteMtx_.unlock();
+
+    hashOnClose_[fd] = true;
+    fdTable_[fd] = path;
+    return true;
+}
+
+bool BxlObserver::uncount_open_for_write(int fd)
+{
+    if (!hashOnClose_[fd])
+    {
+        return false;
+    }
+
+    hashOnClose_[fd] = false;
+    if (!openForWriteMtx_.try_lock_for(chrono::milliseconds(1)))
+    {
+        return false;
+    }
+
+    bool isLast = false;
+    auto it = openForWriteCounts_.find(fdTable_[fd]);
+    if (it != openForWriteCounts_.end() && --it->second == 0)
+    {
+        openForWriteCounts_.erase(it);
+        isLast = true;
+    }
+
+    openForWriteMtx_.unlock();
+    return isLast;
+}
+
+void BxlObserver::track_output_fd(int fd, const std::string &path, bool openedForWrite)
+{
+    if (fd < 0 || fd >= MAX_FD)
+    {
+        return;
+    }
+
+    // always overwrite the entry: the descriptor might have been recycled without us seeing it closed
+    uncount_open_for_write(fd);
+    if (!openedForWrite || !IsEnabled())
+    {
+        return;
+    }
+
+    int savedErrno = errno;
+
+    IOHandler handler(sandbox_);
+    handler.SetProcess(process_);
+    if (handler.PolicyForPath(path.c_str()).ReportContentHashOnClose())
+    {
+        count_open_for_write(fd, path);
+    }
+
+    errno = savedErrno;
+}
+
+void BxlObserver::track_duplicated_fd(int oldfd, int newfd)
+{
+    if (newfd < 0 || newfd >= MAX_FD || newfd == oldfd)
+    {
+        return;
+    }
+
+    // 'newfd' now refers to the same open file as 'oldfd' (whatever it referred to before was closed)
+    reset_fd_table_entry(newfd);
+    if (oldfd >= 0 && oldfd < MAX_FD && hashOnClose_[oldfd])
+    {
+        int savedErrno = errno;
+        count_open_for_write(newfd, fdTable_[oldfd]);
+        errno = savedErrno;
+    }
+}
+
+bool BxlObserver::hash_fd_content(int fd, char *digest, size_t digestSize)
+{
+    // 'fd' may well be write-only, so the file is mapped through a new read-only file descriptor
+    char procPath[100] = {0};
+    sprintf(procPath, "/proc/self/fd/%d", fd);
+    int readFd = real_open(procPath, O_RDONLY | O_CLOEXEC, 0);
+    if (readFd == -1)
+    {
+        return false;
+    }
+
+    bool success = false;
+    struct stat before, after;
+    if (real___fxstat(1, readFd, &before) == 0 && S_ISREG(before.st_mode))
+    {
+        size_t length = before.st_size;
+        void *content = length > 0 ? mmap(NULL, length, PROT_READ, MAP_SHARED, readFd, 0) : NULL;
+        if (content != MAP_FAILED)
+        {
+            if (length > 0) madvise(content, length, MADV_SEQUENTIAL);
+            unsigned char hash[32];
+            hash_content_vso0(content, length, hash);
+            if (length > 0) munmap(content, length);
+
+            // If the file was modified while it was being hashed (e.g., through a file descriptor we don't track)
+            // the digest is not reported and the engine falls back to hashing the file itself.  The size and the
+            // modification time are reported along with the hash for the same reason: the digest may be used only
+            // as long as they still match the file on disk.
+            success =
+                real___fxstat(1, readFd, &after) == 0 &&
+                after.st_size == before.st_size &&
+                after.st_mtim.tv_sec == before.st_mtim.tv_sec &&
+                after.st_mtim.tv_nsec == before.st_mtim.tv_nsec;
+
+            if (success)
+            {
+                int offset = 0;
+                for (size_t i = 0; i < sizeof(hash); i++)
+                {
+                    offset += snprintf(digest + offset, digestSize - offset, "%02x", hash[i]);
+                }
+
+                snprintf(digest + offset, digestSize - offset, ":%lld:%lld.%09ld",
+                    (long long)after.st_size, (long long)after.st_mtim.tv_sec, after.st_mtim.tv_nsec);
+            }
+        }
+    }
+
+    real_close(readFd);
+    return success;
+}
+
+void BxlObserver::report_content_hash_on_close(const char *syscallName, int fd, FILE *stream)
+{
+    if (fd < 0 || fd >= MAX_FD || !hashOnClose_[fd])
+    {
+        return;
+    }
+
+    // if the same file is still open for writing through another tracked descriptor, hash it when that one is closed
+    int savedErrno = errno;
+    if (!uncount_open_for_write(fd) || !IsEnabled())
+    {
+        errno = savedErrno;
+        return;
+    }
+
+    std::string path = fdTable_[fd];
+    if (stream != NULL)
+    {
+        fflush(stream);
+    }
+
+    char digest[128] = {0};
+    if (hash_fd_content(fd, digest, sizeof(digest)))
+    {
+        IOEvent event(getpid(), 0, getppid(), ES_EVENT_TYPE_NOTIFY_CLOSE, ES_ACTION_TYPE_NOTIFY, path, empty_str_, progFullPath_, S_IFREG, /* modified */ true);
+        sPendingReportDigest = digest;
+        report_access(syscallName, event, /* checkCache */ false);
+        sPendingReportDigest = NULL;
+    }
+    else
+    {
+        LOG_INFO("Could not hash content of '%s' (fd: %d); the engine will hash it instead", path.c_str(), fd);
+    }
+
+    errno = savedErrno;
 }
 
 std::string BxlObserver::fd_to_path(int fd)
@@ -523,47 +1124,30 @@ void BxlObserver::resolve_path(char *fullpath, bool followFinalSymlink)
     }
 }
 
-char** BxlObserver::ensure_env_value_with_log(char *const envp[], char const *envName)
+char** BxlObserver::ensureEnvs(char *const envp[], bool forSpawnedChild)
 {
-    char *envValue = getenv(envName);
-    if (is_null_or_empty(envValue))
+    // the sandbox environment variables are computed once per process, so this only takes one pass over 'envp'
+    const char *block[MAX_CHILD_ENVS + 2];
+    int n = 0;
+    for (int i = 0; i < childEnvCount_; i++)
     {
-        return (char**)envp;
+        block[n++] = childEnvs_[i];
     }
+    block[n++] = forSpawnedChild ? spawnedPidEnv_ : countedPidEnv_;
+    block[n] = NULL;
 
-    char **newEnvp = ensure_env_value(envp, envName, envValue);
+    bool monitoring = IsMonitoringChildProcesses();
+    char **newEnvp = merge_env_block((const char *const *)envp, block, detoursLibFullPath_, /*removeFromLdPreload*/ !monitoring);
     if (newEnvp != envp)
     {
-        LOG_DEBUG("envp has been modified with %s added to %s", envValue, envName);
+        LOG_DEBUG("envp has been modified with the sandbox environment variables (%s %s LD_PRELOAD)",
+            detoursLibFullPath_, monitoring ? "added to" : "removed from");
     }
 
+    // this process is about to exec (or spawn) a new image: the lines logged (and the reports spilled) so far must not be
+    // lost in the former case, and should come before those of the child in the latter
+    log_.Flush();
+    trace_.Flush();
+    reports_.Flush();
     return newEnvp;
-}
-
-char** BxlObserver::ensureEnvs(char *const envp[])
-{
-    if (!IsMonitoringChildProcesses())
-    {
-        char **newEnvp = remove_path_from_LDPRELOAD(envp, detoursLibFullPath_);
-        newEnvp = ensure_env_value(newEnvp, BxlEnvFamPath, "");
-        newEnvp = ensure_env_value(newEnvp, BxlEnvLogPath, "");
-        newEnvp = ensure_env_value(newEnvp, BxlEnvRootPid, "");
-        newEnvp = ensure_env_value(newEnvp, BxlEnvDetoursPath, "");
-        return newEnvp;
-    }
-    else
-    {
-        char **newEnvp = ensure_paths_included_in_env(envp, LD_PRELOAD_ENV_VAR_PREFIX, detoursLibFullPath_, NULL);
-        if (newEnvp != envp)
-        {
-            LOG_DEBUG("envp has been modified with %s added to %s", detoursLibFullPath_, "LD_PRELOAD");
-        }
-
-        newEnvp = ensure_env_value_with_log(newEnvp, BxlEnvFamPath);
-        newEnvp = ensure_env_value_with_log(newEnvp, BxlEnvLogPath);
-        newEnvp = ensure_env_value_with_log(newEnvp, BxlEnvRootPid);
-        newEnvp = ensure_env_value_with_log(newEnvp, BxlEnvDetoursPath);
-
-        return newEnvp;
-    }
 }
\ No newline at end of file
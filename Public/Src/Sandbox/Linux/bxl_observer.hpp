@@ -5,6 +5,7 @@
 
 #include "dirent.h"
 #include <sched.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,6 +16,7 @@
 #include <limits.h>
 #include <stddef.h>
 #include <sys/sendfile.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
@@ -25,6 +27,7 @@
 
 #include <ostream>
 #include <sstream>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <unordered_set>
@@ -32,6 +35,12 @@
 
 #include "Sandbox.hpp"
 #include "SandboxedPip.hpp"
+#include "bxl_aggregator.hpp"
+#include "bxl_log.hpp"
+#include "bxl_reports.hpp"
+#include "bxl_translate.hpp"
+#include "bxl_stats.hpp"
+#include "bxl_trace.hpp"
 #include "utils.h"
 
 /*
@@ -44,6 +53,25 @@
     #warning This library must support glibc 2.17.  Please compile against at most glibc 2.17 before publishing a new version of this library.
 #endif
 
+/*
+ * glibc 2.33 made stat, lstat and fstat(at) real functions and stopped declaring the __xstat wrappers the older versions
+ * routed them through. libc still exports the wrappers (binaries built against older versions call them), so they are
+ * declared here to interpose and forward them when building against a newer glibc.
+ */
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+extern "C"
+{
+    int __xstat(int __ver, const char *__filename, struct stat *__stat_buf);
+    int __xstat64(int __ver, const char *__filename, struct stat64 *__stat_buf);
+    int __lxstat(int __ver, const char *__filename, struct stat *__stat_buf);
+    int __lxstat64(int __ver, const char *__filename, struct stat64 *__stat_buf);
+    int __fxstat(int __ver, int __fildes, struct stat *__stat_buf);
+    int __fxstat64(int __ver, int __fildes, struct stat64 *__stat_buf);
+    int __fxstatat(int __ver, int __fildes, const char *__filename, struct stat *__stat_buf, int __flag);
+    int __fxstatat64(int __ver, int __fildes, const char *__filename, struct stat64 *__stat_buf, int __flag);
+}
+#endif
+
 /*
  * This header is compiled into two different libraries: libDetours.so and libAudit.so.
  *
@@ -74,6 +102,18 @@
         return -1;
     }
     #endif
+
+    // Library support for execveat was added in glibc 2.34 (https://man7.org/linux/man-pages/man2/execveat.2.html)
+    #if __GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 34)
+    inline int execveat(int dirfd, const char *pathname, char *const argv[], char *const envp[], int flags) {
+    #ifdef SYS_execveat
+        return syscall(SYS_execveat, dirfd, pathname, argv, envp, flags);
+    #else
+        errno = ENOSYS;
+        return -1;
+    #endif
+    }
+    #endif
 #endif
 
 using namespace std;
@@ -86,6 +126,23 @@ extern const char *__progname;
 #define BxlEnvRootPid "__BUILDXL_ROOT_PID"
 #define BxlEnvDetoursPath "__BUILDXL_DETOURS_PATH"
 
+// Not set by the engine: the pid of the process that was counted in the process tree count right before it
+// exec'd, or BxlSpawnedChildPidPrefix followed by the pid of the process that counted its child right before
+// spawning it with posix_spawn (see 'BxlObserver::InitProcessTreeCount')
+#define BxlEnvCountedPid "__BUILDXL_COUNTED_PID"
+#define BxlSpawnedChildPidPrefix '^'
+
+// CODESYNC: Public/Src/Engine/Processes/SandboxConnectionLinuxDetours.cs
+// Suffix appended to the reports path to get the path of the file holding the process tree count
+#define BxlProcessTreeCountFileSuffix ".tree"
+
+// The content of that file, shared by every process of the tree
+typedef struct
+{
+    std::atomic<int> count;                                 // see 'BxlObserver::processTreeCount_'
+    bool hasAggregator;                                     // whether the tree has a report aggregator (see 'ReportAggregator::Start')
+} ProcessTreeState;
+
 static const char LD_PRELOAD_ENV_VAR_PREFIX[] = "LD_PRELOAD=";
 
 #define ARRAYSIZE(arr) (sizeof(arr)/sizeof(arr[0]))
@@ -106,6 +163,10 @@ static const char LD_PRELOAD_ENV_VAR_PREFIX[] = "LD_PRELOAD=";
         DLL_EXPORT ret name(__VA_ARGS__) {                           \
             short_circuit_check                                      \
             BxlObserver *bxl = BxlObserver::GetInstance();           \
+            static const int hookId = bxl->GetStats().RegisterHook(#name); \
+            HookTimer hookTimer(bxl->GetStats(), hookId);            \
+            static const bool hookLogged = bxl->GetLog().IsHookLogged(#name); \
+            HookLogScope hookLogScope(bxl->GetLog(), hookLogged);    \
             BXL_LOG_DEBUG(bxl, "Intercepted %s", #name);             \
             MAKE_BODY
 
@@ -125,9 +186,11 @@ static const char LD_PRELOAD_ENV_VAR_PREFIX[] = "LD_PRELOAD=";
     GEN_FN_DEF_REAL(ret, name, __VA_ARGS__)                                     \
     template<typename ...TArgs> result_t<ret> fwd_##name(TArgs&& ...args)       \
     {                                                                           \
+        uint64_t fwdStart = stats_.StartForwardedCall();                       \
         ret result = real_##name(std::forward<TArgs>(args)...);                 \
         result_t<ret> return_value(result);                                     \
-        LOG_DEBUG("Forwarded syscall %s (errno: %d)",                           \
+        stats_.EndForwardedCall(fwdStart);                                      \
+        LOG_TRACE("Forwarded syscall %s (errno: %d)",                           \
             RenderSyscall(#name, result, std::forward<TArgs>(args)...).c_str(), \
             return_value.get_errno());                                          \
         return return_value;                                                    \
@@ -145,7 +208,11 @@ static const char LD_PRELOAD_ENV_VAR_PREFIX[] = "LD_PRELOAD=";
         }                                                                       \
     }
 
-#define _fatal(fmt, ...) do { real_fprintf(stderr, "(%s) " fmt "\n", __func__, __VA_ARGS__); _exit(1); } while (0)
+#define _fatal(fmt, ...) do {                                                \
+        real_fprintf(stderr, "(%s) " fmt "\n", __func__, __VA_ARGS__);         \
+        SandboxLog::LogFatal("(%s) " fmt, __func__, __VA_ARGS__);             \
+        _exit(1);                                                           \
+    } while (0)
 #define fatal(msg) _fatal("%s", msg)
 
 /**
@@ -197,14 +264,13 @@ class BxlObserver final
 {
 private:
     BxlObserver();
-    ~BxlObserver() { disposed_ = true; }
+    ~BxlObserver() { log_.Flush(); trace_.Flush(); reports_.Flush(); disposed_ = true; }
     BxlObserver(const BxlObserver&) = delete;
     BxlObserver& operator = (const BxlObserver&) = delete;
 
     volatile int disposed_;
     int rootPid_;
     char progFullPath_[PATH_MAX];
-    char logFile_[PATH_MAX];
     char detoursLibFullPath_[PATH_MAX];
 
     std::timed_mutex cacheMtx_;
@@ -220,18 +286,89 @@ private:
     std::string fdTable_[MAX_FD];
     std::string empty_str_;
 
+    // Indexed by file descriptor (just like 'fdTable_'); an entry is set when the corresponding file descriptor was
+    // opened for writing a file whose policy has FileAccessPolicy_ReportContentHashOnClose (or duplicated from such a
+    // descriptor), in which case the content of that file (whose path is then in 'fdTable_') is hashed when the last
+    // such descriptor is closed.
+    bool hashOnClose_[MAX_FD];
+
+    // How many of the descriptors set in 'hashOnClose_' are open for writing each file, keyed by path
+    std::unordered_map<std::string, int> openForWriteCounts_;
+    std::timed_mutex openForWriteMtx_;
+
+    // Digest to be appended (as an extra trailing field) to the next report sent from the current thread.
+    static thread_local const char *sPendingReportDigest;
+
+    // The process the reports sent from the current thread are attributed to, when it is not this one (see 'report_access_on_behalf').
+    static thread_local const std::shared_ptr<SandboxedProcess> *sReportingProcess;
+
+    // Number of live processes in the pip's process tree, kept in a file that is mapped into every process of the
+    // tree (created by the first one).  A process is counted by its parent right before it is forked and uncounted
+    // right after it reports its exit; the process that brings the count to zero reports kOpProcessTreeCompleted
+    // (unless it still has children that did not count themselves yet, see 'has_uncounted_children').
+    ProcessTreeState *processTree_;
+    std::atomic<int> *processTreeCount_;  // &processTree_->count
+    char processTreeCountPath_[PATH_MAX];
+
+    // The pid for which this instance was counted in 'processTreeCount_' (-1 if not counted, e.g., after
+    // this process was uncounted, or when this instance is shared with a child created by 'clone' with CLONE_VM).
+    pid_t countedPid_;
+
+    // Whether this process brought the process tree count to zero.
+    bool isLastInProcessTree_;
+
+    // Whether this process created the process tree count, i.e., is the first process of the tree.
+    bool isFirstInProcessTree_;
+
+    // The sandbox environment variables ("NAME=value") every child process must get (see 'ensureEnvs').  They are computed
+    // once per process; only the __BUILDXL_COUNTED_PID ones change, whenever this process gets counted in the process tree.
+    static const int MAX_CHILD_ENVS = 7;
+    char childEnvBuf_[4 * PATH_MAX + SandboxLog::MAX_HOOKS_LENGTH + 256];
+    const char *childEnvs_[MAX_CHILD_ENVS];
+    int childEnvCount_;
+    char countedPidEnv_[64];  // for the images this process execs
+    char spawnedPidEnv_[64];  // for the children this process spawns with posix_spawn
+
+    // Per-hook counters and latency histograms, sent right before the exit report of this process when enabled (see 'SendStatistics')
+    SandboxStats stats_;
+    bool statsReported_;
+
+    // Buffered debug log (see __BUILDXL_LOG_PATH)
+    SandboxLog log_;
+
+    // Binary trace of the checked accesses (see __BUILDXL_TRACE_DIR)
+    SandboxTrace trace_;
+
+    // Writes reports to the reports FIFO, or spills them to a file while the FIFO is full
+    ReportWriter reports_;
+
+    // The report aggregator of the process tree, if any (see __BUILDXL_REPORT_AGGREGATOR)
+    ReportAggregator aggregator_;
+
+    // The path translations of the FAM, applied to every reported path (never freed, like 'sandbox_': processes still
+    // send reports, e.g., of their exit, after this object was disposed)
+    PathTranslator *translator_;
+
     std::shared_ptr<SandboxedPip> pip_;
     std::shared_ptr<SandboxedProcess> process_;
     Sandbox *sandbox_;
 
     void InitFam();
     void InitLogFile();
+    void InitTraceFile();
     void InitDetoursLibPath();
+    void InitProcessTreeCount();
+    void InitReportAggregator();
+    void InitChildEnvs();
+    void UpdateCountedPidEnvs();
     bool Send(const char *buf, size_t bufsiz);
+    bool SendStatistics();
     bool IsCacheHit(es_event_type_t event, const string &path, const string &secondPath);
-    char** ensure_env_value_with_log(char *const envp[], char const *envName);
 
     ssize_t read_path_for_fd(int fd, char *buf, size_t bufsiz);
+    bool hash_fd_content(int fd, char *digest, size_t digestSize);
+    bool count_open_for_write(int fd, const std::string &path);
+    bool uncount_open_for_write(int fd);
 
     bool IsMonitoringChildProcesses() const { return CheckMonitorChildProcesses(pip_->GetFamFlags()); }
     inline bool IsValid() const             { return sandbox_ != NULL; }
@@ -271,23 +408,25 @@ private:
     static BxlObserver *sInstance;
     static AccessCheckResult sNotChecked;
 
-#if _DEBUG
-    #define BXL_LOG_DEBUG(bxl, fmt, ...) if (bxl->LogDebugEnabled()) bxl->LogDebug("[%s:%d] " fmt "\n", __progname, getpid(), __VA_ARGS__);
-#else
-    #define BXL_LOG_DEBUG(bxl, fmt, ...)
-#endif
+#define BXL_LOG(bxl, level, fmt, ...) do { if (bxl->GetLog().IsEnabled(level)) bxl->GetLog().Log(level, fmt, __VA_ARGS__); } while (0)
+#define BXL_LOG_DEBUG(bxl, fmt, ...) BXL_LOG(bxl, kLogDebug, fmt, __VA_ARGS__)
 
-#define LOG_DEBUG(fmt, ...) BXL_LOG_DEBUG(this, fmt, __VA_ARGS__)
+#define LOG_ERROR(fmt, ...) BXL_LOG(this, kLogError, fmt, __VA_ARGS__)
+#define LOG_INFO(fmt, ...)  BXL_LOG(this, kLogInfo, fmt, __VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) BXL_LOG(this, kLogDebug, fmt, __VA_ARGS__)
+#define LOG_TRACE(fmt, ...) BXL_LOG(this, kLogTrace, fmt, __VA_ARGS__)
 
 public:
     static BxlObserver* GetInstance();
 
-    bool SendReport(AccessReport &report);
-    char** ensureEnvs(char *const envp[]);
+    bool SendReport(const AccessReportView &report);
+    char** ensureEnvs(char *const envp[], bool forSpawnedChild = false);
 
     const char* GetProgramPath() { return progFullPath_; }
     const char* GetReportsPath() { int len; return IsValid() ? pip_->GetReportsPath(&len) : NULL; }
     const char* GetDetoursLibPath() { return detoursLibFullPath_; }
+    SandboxStats& GetStats() { return stats_; }
+    SandboxLog& GetLog() { return log_; }
 
     void report_exec(const char *syscallName, const char *procName, const char *file);
     void report_audit_objopen(const char *fullpath)
@@ -297,37 +436,39 @@ public:
     }
 
     AccessCheckResult report_access(const char *syscallName, IOEvent &event, bool checkCache = true);
+
+    /**
+     * Checks and reports 'event' as an access made by 'process', another process of the tree whose accesses this one observes
+     * (see bxl-seccomp): the reports carry the pid and the name of that process rather than those of this one.
+     */
+    AccessCheckResult report_access_on_behalf(const char *syscallName, IOEvent &event, const std::shared_ptr<SandboxedProcess> &process);
+
+    /**
+     * A process of the tree running 'exePath' that accesses can be reported on behalf of (see 'report_access_on_behalf'),
+     * or NULL when this process does not check accesses.
+     */
+    std::shared_ptr<SandboxedProcess> CreateObservedProcess(pid_t pid, const char *exePath);
     AccessCheckResult report_access(const char *syscallName, es_event_type_t eventType, const char *pathname, int oflags = 0);
     AccessCheckResult report_access(const char *syscallName, es_event_type_t eventType, const std::string &reportPath, const std::string &secondPath);
 
     AccessCheckResult report_access_fd(const char *syscallName, es_event_type_t eventType, int fd);
     AccessCheckResult report_access_at(const char *syscallName, es_event_type_t eventType, int dirfd, const char *pathname, int oflags = 0);
 
+    void track_output_fd(int fd, const std::string &path, bool openedForWrite);
+    void track_duplicated_fd(int oldfd, int newfd);
+    void report_content_hash_on_close(const char *syscallName, int fd, FILE *stream = NULL);
+
+    bool count_child_process();
+    void uncount_child_process();
+    void mark_counted_in_process_tree();
+    void report_process_exit(const char *syscallName);
+    void report_process_tree_completed(const char *syscallName);
+    bool has_uncounted_children();
+
     void reset_fd_table_entry(int fd);
     std::string fd_to_path(int fd);
     std::string normalize_path_at(int dirfd, const char *pathname, int oflags = 0);
 
-    inline bool LogDebugEnabled()
-    {
-        return logFile_ && *logFile_;
-    }
-
-    inline void LogDebug(const char *fmt, ...)
-    {
-        if (LogDebugEnabled())
-        {
-            FILE* f = real_fopen(logFile_, "a");
-            if (f)
-            {
-                va_list args;
-                va_start(args, fmt);
-                real_vfprintf(f, fmt, args);
-                va_end(args);
-                real_fclose(f);
-            }
-        }
-    }
-
     mode_t get_mode(const char *path)
     {
         struct stat buf;
@@ -374,6 +515,9 @@ public:
     GEN_FN_DEF(int, execve, const char *, char *const[], char *const[]);
     GEN_FN_DEF(int, execvp, const char *, char *const[]);
     GEN_FN_DEF(int, execvpe, const char *, char *const[], char *const[]);
+    GEN_FN_DEF(int, execveat, int dirfd, const char *pathname, char *const argv[], char *const envp[], int flags);
+    GEN_FN_DEF(int, posix_spawn, pid_t *, const char *, const posix_spawn_file_actions_t *, const posix_spawnattr_t *, char *const[], char *const[]);
+    GEN_FN_DEF(int, posix_spawnp, pid_t *, const char *, const posix_spawn_file_actions_t *, const posix_spawnattr_t *, char *const[], char *const[]);
     GEN_FN_DEF(int, __lxstat, int, const char *, struct stat *);
     GEN_FN_DEF(int, __lxstat64, int, const char*, struct stat64*);
     GEN_FN_DEF(int, __xstat, int, const char *, struct stat *);
@@ -452,9 +596,11 @@ public:
     GEN_FN_DEF(ssize_t, copy_file_range, int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags);
     GEN_FN_DEF(int, name_to_handle_at, int dirfd, const char *pathname, struct file_handle *handle, int *mount_id, int flags);
 
-    /* ============ don't need to be interposed ======================= */
     GEN_FN_DEF(int, dup, int oldfd);
     GEN_FN_DEF(int, dup2, int oldfd, int newfd);
+    GEN_FN_DEF(int, dup3, int oldfd, int newfd, int flags);
+
+    /* ============ don't need to be interposed ======================= */
     GEN_FN_DEF(int, close, int fd);
     GEN_FN_DEF(int, fclose, FILE *stream);
     GEN_FN_DEF(int, statfs, const char *, struct statfs *buf);
@@ -464,7 +610,6 @@ public:
     /* =================================================================== */
 
     /* ============ old/obsolete/unavailable ==========================
-    GEN_FN_DEF(int, execveat, int dirfd, const char *pathname, char *const argv[], char *const envp[], int flags);
     GEN_FN_DEF(int, renameat2, int olddirfd, const char *oldpath, int newdirfd, const char *newpath, unsigned int flags);
     GEN_FN_DEF(int, getdents, unsigned int fd, struct linux_dirent *dirp, unsigned int count);
     GEN_FN_DEF(int, getdents64, unsigned int fd, struct linux_dirent64 *dirp, unsigned int count);
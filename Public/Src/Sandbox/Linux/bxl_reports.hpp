@@ -0,0 +1,295 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+
+#include "utils.h"
+
+// CODESYNC: Public/Src/Engine/Processes/SandboxConnectionLinuxDetours.cs
+// Suffix of the files reports are spilled to when the reports FIFO is full ('<reports path>.<pid>-<n>.spill')
+#define BxlReportsSpillFileSuffix ".spill"
+
+/**
+ * Writes the (length-prefixed) reports of this process to the reports FIFO without blocking on it.
+ *
+ * Every report is written with a non-blocking write, which (reports being at most PIPE_BUF bytes long) writes either
+ * all of it or nothing.  When the FIFO is full, e.g., because the engine is not reading it for a while, the report
+ * is appended to a spill file of this process instead, and so is every report sent after it until the FIFO has room
+ * for a message announcing them (see REPORTS_SPILL_ANNOUNCEMENT in utils.h).  The engine reads the announced reports
+ * from the spill file when it gets to that message, so the reports of a process are processed in the order they were sent.
+ *
+ * Spill files are mapped into memory (appending a report is a copy) and grown as needed.  Spilled reports that are not
+ * announced yet are announced with a blocking write before this process exits or execs (see 'Flush'); a forked child
+ * leaves those of its parent to its parent (see 'OnForked').
+ */
+class ReportWriter final
+{
+public:
+    typedef int (*OpenFn)(const char *, int, mode_t);
+    typedef ssize_t (*WriteFn)(int, const void *, size_t);
+    typedef int (*CloseFn)(int);
+
+    typedef enum
+    {
+        kReportFailed,
+        kReportSent,     // written to the FIFO
+        kReportSpilled,  // appended to the spill file
+    } SendResult;
+
+    // The size a spill file starts with; it doubles whenever it fills up.
+    static const size_t INITIAL_SPILL_SIZE = 1024 * 1024;
+
+private:
+    char reportsPath_[PATH_MAX];
+    OpenFn open_;
+    WriteFn write_;
+    CloseFn close_;
+
+    pid_t ownerPid_;                // the process the spill file belongs to
+    std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+    std::atomic<bool> pending_;     // whether some spilled reports were not announced yet
+
+    char spillPath_[PATH_MAX];      // empty until the first report of this process is spilled
+    char *spill_;                   // the spill file, mapped into memory
+    size_t spillSize_;
+    size_t spillLength_;            // how many bytes were spilled
+    size_t announced_;              // how many of them were announced
+
+    void Lock()
+    {
+        while (lock_.test_and_set(std::memory_order_acquire))
+        {
+            sched_yield();
+        }
+    }
+
+    void Unlock()
+    {
+        lock_.clear(std::memory_order_release);
+    }
+
+    // Forgets the spill file (without unmapping it: it may be in use by the process this state was inherited from).
+    void ResetSpill(pid_t pid)
+    {
+        ownerPid_ = pid;
+        spillPath_[0] = '\0';
+        spill_ = NULL;
+        spillSize_ = spillLength_ = announced_ = 0;
+        pending_.store(false, std::memory_order_release);
+    }
+
+    // Takes the lock on behalf of this process, which takes over the spill state if it shares it with another process
+    // (see CLONE_VM) or if it is a child that was not told it was forked (see 'OnForked').
+    void LockForThisProcess()
+    {
+        Lock();
+        pid_t pid = getpid();
+        if (pid != ownerPid_)
+        {
+            // whatever the other process spilled must not be lost, in case it never announces it
+            AnnounceLocked(/* block */ true);
+            ResetSpill(pid);
+        }
+    }
+
+    // Writes a whole message to the FIFO; returns how many bytes were written, or -1 (and sets errno).
+    ssize_t WriteFifo(const char *buf, size_t size, bool block)
+    {
+        int fd = open_(reportsPath_, O_WRONLY | O_APPEND | (block ? 0 : O_NONBLOCK), 0);
+        if (fd == -1 && !block && errno == ENXIO)
+        {
+            // the engine has not opened the FIFO for reading yet: wait for it
+            fd = open_(reportsPath_, O_WRONLY | O_APPEND, 0);
+        }
+
+        if (fd == -1)
+        {
+            return -1;
+        }
+
+        ssize_t numWritten = write_(fd, buf, size);
+        int error = errno;
+        close_(fd);
+        errno = error;
+        return numWritten;
+    }
+
+    // Must be called with the lock held.  Maps 'size' bytes of the spill file (creating it if needed).
+    bool MapSpill(size_t size)
+    {
+        bool created = spillPath_[0] == '\0';
+        if (created)
+        {
+            // (the path must fit in an announcement, along with the rest of it)
+            int length = snprintf(spillPath_, sizeof(spillPath_), "%s.%d-%lu" BxlReportsSpillFileSuffix, reportsPath_, ownerPid_, monotonic_time_ns());
+            if (length < 0 || length > PIPE_BUF - 128)
+            {
+                spillPath_[0] = '\0';
+                return false;
+            }
+        }
+
+        int fd = open_(spillPath_, O_RDWR | (created ? O_CREAT | O_EXCL : 0) | O_CLOEXEC, 0600);
+        if (fd == -1)
+        {
+            if (created) spillPath_[0] = '\0';
+            return false;
+        }
+
+        // the blocks are allocated up front: running out of space while writing to the mapping would raise SIGBUS
+        void *spill = posix_fallocate(fd, 0, size) != 0
+            ? MAP_FAILED
+            : spill_ == NULL
+                ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                : mremap(spill_, spillSize_, size, MREMAP_MAYMOVE);
+        close_(fd);
+        if (spill == MAP_FAILED)
+        {
+            return false;
+        }
+
+        spill_ = (char *)spill;
+        spillSize_ = size;
+        return true;
+    }
+
+    // Must be called with the lock held.
+    bool Append(const char *buf, size_t size)
+    {
+        if (spillLength_ + size > spillSize_)
+        {
+            size_t newSize = spillSize_ == 0 ? INITIAL_SPILL_SIZE : 2 * spillSize_;
+            if (!MapSpill(newSize > spillLength_ + size ? newSize : spillLength_ + size))
+            {
+                return false;
+            }
+        }
+
+        // the (first) length prefix goes last, so that a process killed while spilling never leaves a length followed by
+        // an incomplete message in the file (the engine reads whatever follows the announced reports once the FIFO
+        // is closed: the rest of the file is zeros, and a zero length ends the reports)
+        char *message = spill_ + spillLength_;
+        memcpy(message + sizeof(uint32_t), buf + sizeof(uint32_t), size - sizeof(uint32_t));
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(message, buf, sizeof(uint32_t));
+        spillLength_ += size;
+        return true;
+    }
+
+    // Must be called with the lock held.  Tells the engine about the reports spilled since the last announcement.
+    bool AnnounceLocked(bool block)
+    {
+        if (announced_ == spillLength_)
+        {
+            return true;
+        }
+
+        // CODESYNC: parse_reports in utils.c
+        char message[PIPE_BUF];
+        int length = snprintf(message + sizeof(uint32_t), sizeof(message) - sizeof(uint32_t), "%d|%lu|%lu|%s\n",
+            ownerPid_, announced_, spillLength_ - announced_, spillPath_);
+        if (length < 0 || (size_t)length >= sizeof(message) - sizeof(uint32_t))
+        {
+            return false;
+        }
+
+        *(uint32_t *)message = (uint32_t)length | REPORTS_SPILL_ANNOUNCEMENT;
+        if (WriteFifo(message, length + sizeof(uint32_t), block) != (ssize_t)(length + sizeof(uint32_t)))
+        {
+            return false;
+        }
+
+        announced_ = spillLength_;
+        pending_.store(false, std::memory_order_release);
+        return true;
+    }
+
+public:
+    ReportWriter() : open_(NULL), write_(NULL), close_(NULL), ownerPid_(0), pending_(false),
+                     spill_(NULL), spillSize_(0), spillLength_(0), announced_(0)
+    {
+        reportsPath_[0] = '\0';
+        spillPath_[0] = '\0';
+    }
+
+    /** 'reportsPath' is the path of the reports FIFO (not necessarily 0-terminated, hence 'length'); 'pid' is the one of this process. */
+    void Init(const char *reportsPath, int length, pid_t pid, OpenFn openFn, WriteFn writeFn, CloseFn closeFn)
+    {
+        snprintf(reportsPath_, sizeof(reportsPath_), "%.*s", length, reportsPath);
+        open_ = openFn;
+        write_ = writeFn;
+        close_ = closeFn;
+        ownerPid_ = pid;
+    }
+
+    inline const char *GetReportsPath() const { return reportsPath_; }
+
+    /** Called in child 'pid' right after it was forked: the reports its parent spilled are for its parent to announce. */
+    void OnForked(pid_t pid)
+    {
+        // the lock may have been held by another thread of the parent when this process was forked
+        lock_.clear();
+        ResetSpill(pid);
+    }
+
+    /**
+     * Sends a report of at most PIPE_BUF bytes (including its length prefix), or several whole reports that fit in PIPE_BUF
+     * bytes (see ReportAggregator), to the FIFO if it has room for them and no earlier report of this process waits to be
+     * announced, to the spill file otherwise.  Only blocks if the
+     * report can be neither written to the FIFO nor spilled (e.g., there is no space left for the spill file).
+     */
+    SendResult Send(const char *buf, size_t size)
+    {
+        if (!pending_.load(std::memory_order_acquire))
+        {
+            ssize_t numWritten = WriteFifo(buf, size, /* block */ false);
+            if (numWritten == (ssize_t)size)
+            {
+                return kReportSent;
+            }
+
+            if (numWritten != -1 || errno != EAGAIN)
+            {
+                return kReportFailed;
+            }
+        }
+
+        LockForThisProcess();
+        if (!Append(buf, size))
+        {
+            // nowhere to spill it to: wait for the FIFO, after the reports that were spilled before
+            bool sent = AnnounceLocked(/* block */ true) && WriteFifo(buf, size, /* block */ true) == (ssize_t)size;
+            Unlock();
+            return sent ? kReportSent : kReportFailed;
+        }
+
+        pending_.store(true, std::memory_order_release);
+        AnnounceLocked(/* block */ false);
+        Unlock();
+        return kReportSpilled;
+    }
+
+    /** Announces the spilled reports that were not announced yet, waiting for the FIFO if it is full. */
+    void Flush()
+    {
+        if (!pending_.load(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        LockForThisProcess();
+        AnnounceLocked(/* block */ true);
+        Unlock();
+    }
+};
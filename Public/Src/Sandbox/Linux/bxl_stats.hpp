@@ -0,0 +1,263 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+/**
+ * Reads a cheap, monotonically increasing tick counter (the TSC on x86, the virtual counter on ARM64).
+ * Only differences between readings are meaningful; see 'SandboxStats::TicksPerMicrosecond'.
+ */
+inline uint64_t bxl_read_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/**
+ * Per-process counters describing where the sandbox spends its time: per interposed function, the number of
+ * calls and a histogram of the ticks spent inside the sandbox (i.e., excluding the forwarded real call); plus
+ * cache hits/misses and the number/size of the reports sent (and of those that were spilled, see ReportWriter).
+ *
+ * Collection is off unless the manifest asks for it (FileAccessManifestExtraFlag::ReportSandboxStatistics),
+ * in which case the counters are sent once, in a message of their own right before the exit report of the process
+ * (see 'Format' and BxlObserver::SendStatistics).
+ */
+class SandboxStats final
+{
+public:
+    // Histogram bucket i counts the calls that took [2^i, 2^(i+1)) ticks (bucket 0 also counts calls that took 0 ticks)
+    static const int NUM_BUCKETS = 40;
+    static const int MAX_HOOKS = 256;
+
+private:
+    typedef struct {
+        const char *name;
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint64_t> histogram[NUM_BUCKETS];
+    } HookStats;
+
+    bool enabled_;
+    HookStats hooks_[MAX_HOOKS];
+    std::atomic<int> numHooks_;
+    std::atomic<uint64_t> cacheHits_;
+    std::atomic<uint64_t> cacheMisses_;
+    std::atomic<uint64_t> numReports_;
+    std::atomic<uint64_t> reportBytes_;
+    std::atomic<uint64_t> spilledReports_;
+    std::atomic<uint64_t> spilledBytes_;
+
+    // used to estimate the tick frequency
+    uint64_t startTicks_;
+    struct timespec startTime_;
+
+    static int Bucket(uint64_t ticks)
+    {
+        int bucket = ticks == 0 ? 0 : 63 - __builtin_clzll(ticks);
+        return bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1;
+    }
+
+public:
+    // Ticks spent by the current thread in forwarded (real) calls; hooks subtract it from the time they measure
+    static thread_local uint64_t sForwardedTicks;
+
+    SandboxStats() : enabled_(false), numHooks_(0)
+    {
+        Reset();
+    }
+
+    inline bool IsEnabled() const { return enabled_; }
+
+    void Enable()
+    {
+        enabled_ = true;
+        Reset();
+    }
+
+    /** Zeroes all the counters (but keeps the registered hooks), e.g., in a forked child that inherited them from its parent. */
+    void Reset()
+    {
+        for (int i = 0; i < MAX_HOOKS; i++)
+        {
+            hooks_[i].calls = 0;
+            hooks_[i].ticks = 0;
+            for (int b = 0; b < NUM_BUCKETS; b++) hooks_[i].histogram[b] = 0;
+        }
+
+        cacheHits_ = 0;
+        cacheMisses_ = 0;
+        numReports_ = 0;
+        reportBytes_ = 0;
+        spilledReports_ = 0;
+        spilledBytes_ = 0;
+        startTicks_ = bxl_read_ticks();
+        clock_gettime(CLOCK_MONOTONIC, &startTime_);
+    }
+
+    /** Returns the id under which calls to hook 'name' are recorded, or -1 if there is no room for it. */
+    int RegisterHook(const char *name)
+    {
+        int id = numHooks_.fetch_add(1);
+        if (id >= MAX_HOOKS)
+        {
+            return -1;
+        }
+
+        hooks_[id].name = name;
+        return id;
+    }
+
+    inline void RecordHook(int id, uint64_t ticks)
+    {
+        hooks_[id].calls.fetch_add(1, std::memory_order_relaxed);
+        hooks_[id].ticks.fetch_add(ticks, std::memory_order_relaxed);
+        hooks_[id].histogram[Bucket(ticks)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void RecordCacheLookup(bool hit)
+    {
+        if (enabled_) (hit ? cacheHits_ : cacheMisses_).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Records a report that was sent, to the reports FIFO or (when it was full) to a spill file. */
+    inline void RecordReport(size_t size, bool spilled)
+    {
+        if (!enabled_) return;
+        numReports_.fetch_add(1, std::memory_order_relaxed);
+        reportBytes_.fetch_add(size, std::memory_order_relaxed);
+        if (spilled)
+        {
+            spilledReports_.fetch_add(1, std::memory_order_relaxed);
+            spilledBytes_.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+
+    inline uint64_t StartForwardedCall() const
+    {
+        return enabled_ ? bxl_read_ticks() : 0;
+    }
+
+    inline void EndForwardedCall(uint64_t start) const
+    {
+        if (start != 0) sForwardedTicks += bxl_read_ticks() - start;
+    }
+
+    /** Estimated number of ticks per microsecond, based on the ticks and the time elapsed since the counters were reset. */
+    uint64_t TicksPerMicrosecond() const
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t elapsedNs = (now.tv_sec - startTime_.tv_sec) * 1000000000ULL + now.tv_nsec - startTime_.tv_nsec;
+        uint64_t elapsedTicks = bxl_read_ticks() - startTicks_;
+        uint64_t ticksPerUs = elapsedNs >= 1000 ? elapsedTicks * 1000 / elapsedNs : 0;
+        return ticksPerUs > 0 ? ticksPerUs : 1;
+#else
+        return 1000;
+#endif
+    }
+
+    /**
+     * Serializes the counters into 'buf' (never more than 'size' bytes, hooks that do not fit are left out) as
+     *
+     *   <ticks per us>;<cache hits>;<cache misses>;<reports>;<report bytes>;<spilled reports>;<spilled bytes>[;<hook>:<calls>:<ticks>:<first bucket>:<count>,<count>,...]*
+     *
+     * where only hooks that were called are listed, and each histogram is given from its first to its last non-empty bucket.
+     * Returns the length of the serialized string.
+     *
+     * CODESYNC: Public/Src/Engine/Processes/SandboxStatistics.cs
+     */
+    int Format(char *buf, size_t size) const
+    {
+        int len = snprintf(buf, size, "%lu;%lu;%lu;%lu;%lu;%lu;%lu",
+            TicksPerMicrosecond(), cacheHits_.load(), cacheMisses_.load(), numReports_.load(), reportBytes_.load(),
+            spilledReports_.load(), spilledBytes_.load());
+        if (len < 0 || (size_t)len >= size)
+        {
+            return 0;
+        }
+
+        int numHooks = numHooks_ < MAX_HOOKS ? numHooks_.load() : MAX_HOOKS;
+        for (int i = 0; i < numHooks; i++)
+        {
+            const HookStats &hook = hooks_[i];
+            if (hook.calls == 0 || hook.name == NULL)
+            {
+                continue;
+            }
+
+            int first = 0, last = NUM_BUCKETS - 1;
+            while (hook.histogram[first] == 0 && first < last) first++;
+            while (hook.histogram[last] == 0 && last > first) last--;
+
+            char entry[64 + NUM_BUCKETS * 21];
+            int entryLen = snprintf(entry, sizeof(entry), ";%s:%lu:%lu:%d:", hook.name, hook.calls.load(), hook.ticks.load(), first);
+            for (int b = first; b <= last && (size_t)entryLen < sizeof(entry); b++)
+            {
+                entryLen += snprintf(entry + entryLen, sizeof(entry) - entryLen, b == first ? "%lu" : ",%lu", hook.histogram[b].load());
+            }
+
+            if ((size_t)entryLen >= sizeof(entry) || (size_t)(len + entryLen) >= size)
+            {
+                continue;
+            }
+
+            memcpy(buf + len, entry, entryLen + 1);
+            len += entryLen;
+        }
+
+        return len;
+    }
+};
+
+/**
+ * Records, when it goes out of scope, the ticks spent in a hook since it was created, minus the ticks spent in
+ * forwarded calls in the meantime.
+ */
+class HookTimer final
+{
+private:
+    SandboxStats &stats_;
+    int id_;
+    uint64_t start_;
+    uint64_t forwardedAtStart_;
+
+public:
+    HookTimer(SandboxStats &stats, int id) : stats_(stats), id_(id), start_(0), forwardedAtStart_(0)
+    {
+        if (stats.IsEnabled() && id >= 0)
+        {
+            forwardedAtStart_ = SandboxStats::sForwardedTicks;
+            start_ = bxl_read_ticks();
+        }
+    }
+
+    ~HookTimer()
+    {
+        if (start_ != 0)
+        {
+            uint64_t elapsed = bxl_read_ticks() - start_;
+            uint64_t forwarded = SandboxStats::sForwardedTicks - forwardedAtStart_;
+            stats_.RecordHook(id_, elapsed > forwarded ? elapsed - forwarded : 0);
+        }
+    }
+};
@@ -0,0 +1,296 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+
+#include "IOEvent.hpp"
+#include "utils.h"
+
+// Not set by the engine: the directory where every sandboxed process writes a trace of the accesses it checked (see 'SandboxTrace')
+#define BxlEnvTraceDir "__BUILDXL_TRACE_DIR"
+
+#define BxlTraceFileSuffix ".bxltrace"
+
+/**
+ * Layout of a trace file (host byte order): a 'TraceFileHeader' followed by the path of the program, then records,
+ * each of which is a 'TraceRecordHeader' followed by 'size' bytes:
+ *   - kTraceHook:   the name of a hook (once per hook, before the first access it checked); 'hook' is the id it gets
+ *                   in the records that follow;
+ *   - kTraceAccess: a 'TraceAccess' followed by the event that was checked (see 'IOEvent::Serialize').
+ *
+ * CODESYNC: bench/trace_replay.cpp
+ */
+#define BxlTraceMagic "BXLTRACE"
+#define BxlTraceVersion 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    uint32_t ppid;
+    uint32_t programPathLength;
+    uint64_t startTime;
+} TraceFileHeader;
+
+typedef enum : uint8_t
+{
+    kTraceHook   = 1,
+    kTraceAccess = 2,
+} TraceRecordKind;
+
+typedef enum : uint8_t
+{
+    kTraceCacheHit   = 0x1,  // found in the cache of the process, so it was neither checked nor reported
+    kTraceNotChecked = 0x2,  // the sandbox was not enabled (e.g., in a child that broke away)
+} TraceAccessFlags;
+
+typedef struct
+{
+    TraceRecordKind kind;
+    uint8_t flags;
+    uint16_t hook;
+    uint32_t size;
+} TraceRecordHeader;
+
+typedef struct
+{
+    uint64_t time;      // CLOCK_MONOTONIC (see monotonic_time_ns) when the check started
+    uint32_t duration;  // nanoseconds spent checking and reporting the access
+    uint8_t access;     // the AccessCheckResult of the check
+    uint8_t action;
+    uint8_t level;
+    uint8_t validity;
+} TraceAccess;
+
+/**
+ * Per-process binary trace of the accesses the sandbox checked, enabled by setting __BUILDXL_TRACE_DIR.
+ *
+ * Every process (and every image a process execs) writes its own '<pid>-<start time>.bxltrace' file in that directory:
+ * for every access, the hook that intercepted it, the event that was checked (with its normalized paths), the result
+ * of the check and how long it took.  'bench/trace_replay' feeds those events back into 'IOHandler' offline, without
+ * running the original tools.
+ *
+ * Records are buffered like the lines of 'SandboxLog', and written in whole buffers whenever the buffer fills up and when
+ * this process is about to exit or exec (see 'Flush').  A child created by fork/clone starts a trace file of its own.
+ */
+class SandboxTrace final
+{
+public:
+    typedef int (*OpenFn)(const char *, int, mode_t);
+    typedef ssize_t (*WriteFn)(int, const void *, size_t);
+
+    static const size_t BUFFER_SIZE = 64 * 1024;
+    static const int MAX_HOOKS = 256;
+
+    // leaves room in a path of PATH_MAX bytes for the name of a trace file ('<pid>-<start time>.bxltrace')
+    static const size_t MAX_DIR_LENGTH = PATH_MAX - 64;
+
+private:
+    char dir_[MAX_DIR_LENGTH];
+    char path_[PATH_MAX];           // the trace file of this process
+    char programPath_[PATH_MAX];
+    OpenFn open_;
+    WriteFn write_;
+
+    int fd_;
+    pid_t ownerPid_;                // the process the buffered records (and the hook ids) belong to
+    std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+    size_t length_;
+    char buffer_[BUFFER_SIZE];
+
+    // hooks are identified by the (static) names passed to 'RecordAccess'
+    const char *hooks_[MAX_HOOKS];
+    int numHooks_;
+
+    void Lock()
+    {
+        while (lock_.test_and_set(std::memory_order_acquire))
+        {
+            sched_yield();
+        }
+    }
+
+    void Unlock()
+    {
+        lock_.clear(std::memory_order_release);
+    }
+
+    // Must be called with the lock held.
+    void FlushLocked()
+    {
+        if (fd_ == -1)
+        {
+            fd_ = open_(path_, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        }
+
+        size_t written = 0;
+        while (fd_ != -1 && written < length_)
+        {
+            ssize_t n = write_(fd_, buffer_ + written, length_ - written);
+            if (n <= 0)
+            {
+                break;
+            }
+
+            written += n;
+        }
+
+        length_ = 0;
+    }
+
+    // Must be called with the lock held.
+    void Append(const void *data, size_t size)
+    {
+        if (length_ + size > sizeof(buffer_))
+        {
+            FlushLocked();
+        }
+
+        memcpy(buffer_ + length_, data, size);
+        length_ += size;
+    }
+
+    // Starts the trace of this process (in a file of its own, whose header is buffered).
+    void Start()
+    {
+        ownerPid_ = getpid();
+        fd_ = -1;
+        length_ = 0;
+        numHooks_ = 0;
+
+        TraceFileHeader header;
+        memcpy(header.magic, BxlTraceMagic, sizeof(header.magic));
+        header.version = BxlTraceVersion;
+        header.pid = ownerPid_;
+        header.ppid = getppid();
+        header.programPathLength = strlen(programPath_);
+        header.startTime = monotonic_time_ns();
+
+        snprintf(path_, sizeof(path_), "%s/%d-%lu" BxlTraceFileSuffix, dir_, ownerPid_, header.startTime);
+        Append(&header, sizeof(header));
+        Append(programPath_, header.programPathLength);
+    }
+
+    // Must be called with the lock held.
+    int HookId(const char *name)
+    {
+        for (int i = 0; i < numHooks_; i++)
+        {
+            if (hooks_[i] == name)
+            {
+                return i;
+            }
+        }
+
+        if (numHooks_ == MAX_HOOKS)
+        {
+            return MAX_HOOKS;
+        }
+
+        TraceRecordHeader record = { kTraceHook, 0, (uint16_t)numHooks_, (uint32_t)strlen(name) };
+        Append(&record, sizeof(record));
+        Append(name, record.size);
+        hooks_[numHooks_] = name;
+        return numHooks_++;
+    }
+
+public:
+    SandboxTrace() : open_(NULL), write_(NULL), fd_(-1), ownerPid_(0), length_(0), numHooks_(0)
+    {
+        dir_[0] = '\0';
+        path_[0] = '\0';
+        programPath_[0] = '\0';
+    }
+
+    /** Enables the trace when 'dir' is not empty; 'programPath' is the path of the program this process runs. */
+    void Init(const char *dir, const char *programPath, OpenFn openFn, WriteFn writeFn)
+    {
+        if (dir == NULL || *dir == '\0' || strlen(dir) >= MAX_DIR_LENGTH || strlen(programPath) >= PATH_MAX)
+        {
+            return;
+        }
+
+        strcpy(dir_, dir);
+        strcpy(programPath_, programPath);
+        open_ = openFn;
+        write_ = writeFn;
+        Start();
+    }
+
+    inline bool IsOn() const { return dir_[0] != '\0'; }
+
+    /**
+     * Records that hook 'name' (which must be a string that outlives this process, e.g., a literal) checked 'event',
+     * starting at 'time' and for 'duration' nanoseconds, with 'result'.
+     */
+    void RecordAccess(const char *name, const IOEvent &event, const AccessCheckResult &result, uint64_t time, uint64_t duration, uint8_t flags)
+    {
+        size_t eventSize = event.Size();
+        if (sizeof(TraceRecordHeader) + sizeof(TraceAccess) + eventSize > sizeof(buffer_))
+        {
+            return;
+        }
+
+        if (getpid() != ownerPid_)
+        {
+            // a child that inherited this trace (and the file of its parent) from its parent, possibly while some
+            // other thread of the parent held the lock
+            lock_.clear();
+            Start();
+        }
+
+        TraceAccess access;
+        access.time = time;
+        access.duration = duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration;
+        access.access = (uint8_t)result.Access;
+        access.action = (uint8_t)result.Result;
+        access.level = (uint8_t)result.Level;
+        access.validity = (uint8_t)result.Validity;
+
+        Lock();
+        TraceRecordHeader record = { kTraceAccess, flags, (uint16_t)HookId(name), (uint32_t)(sizeof(access) + eventSize) };
+        Append(&record, sizeof(record));
+        Append(&access, sizeof(access));
+        if (length_ + eventSize > sizeof(buffer_))
+        {
+            FlushLocked();
+        }
+
+        // serialized in place (the header of the record and the event may end up in different writes, that's fine:
+        // only the process writes to its trace file)
+        length_ += event.Serialize(buffer_ + length_, eventSize);
+        Unlock();
+    }
+
+    /** Writes the buffered records to the trace file. */
+    void Flush()
+    {
+        if (!IsOn() || getpid() != ownerPid_)
+        {
+            return;
+        }
+
+        Lock();
+        FlushLocked();
+        Unlock();
+    }
+
+    /** Called when this process closes file descriptor 'fd', which must then no longer be used for the trace. */
+    inline void OnFdClosed(int fd)
+    {
+        if (fd == fd_ && fd != -1)
+        {
+            fd_ = -1;
+        }
+    }
+};
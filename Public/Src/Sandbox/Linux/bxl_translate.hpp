@@ -0,0 +1,191 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Applies the path translations of the FAM (see ManifestTranslatePathsStrings) to the paths this process reports, so that
+ * they do not depend on where the pip ran (e.g., the root of the workspace of a build agent).
+ *
+ * Same semantics as TranslateFilePath in DetoursHelpers.cpp, except that paths are case-sensitive: the longest 'from'
+ * that is a prefix of the path (or the path with a trailing '/', for the directories 'from' names) is replaced by its
+ * 'to', and the result is translated again, with the translations that were used left out, until none applies.
+ *
+ * The 'from' paths are compiled into a trie when this process starts (see 'Init'), so that finding the longest one a
+ * path starts with walks the path once, however many translations there are.
+ */
+class PathTranslator final
+{
+public:
+    // How many translations are applied to a path at most (each one at most once)
+    static const size_t MAX_CHAINED_TRANSLATIONS = 16;
+
+private:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Translation
+    {
+        std::string from;
+        std::string to;
+        uint32_t nextSameFrom;  // the next translation with the same 'from' (in the order of the FAM)
+    };
+
+    std::vector<Translation> translations_;
+
+    // the nodes of the trie (the root is 0): the first translation whose 'from' ends at each node, if any
+    std::vector<uint32_t> firstTranslation_;
+
+    // the edges of the trie: (node << 8 | byte) -> child
+    std::unordered_map<uint64_t, uint32_t> edges_;
+
+    inline uint32_t Child(uint32_t node, char c) const
+    {
+        auto it = edges_.find(((uint64_t)node << 8) | (unsigned char)c);
+        return it == edges_.end() ? kNone : it->second;
+    }
+
+    // The first translation ending at 'node' that is not in 'used'
+    uint32_t FirstUnused(uint32_t node, const uint32_t *used, size_t numUsed) const
+    {
+        for (uint32_t t = firstTranslation_[node]; t != kNone; t = translations_[t].nextSameFrom)
+        {
+            bool isUsed = false;
+            for (size_t i = 0; i < numUsed && !isUsed; i++)
+            {
+                isUsed = used[i] == t;
+            }
+
+            if (!isUsed)
+            {
+                return t;
+            }
+        }
+
+        return kNone;
+    }
+
+    /**
+     * Finds the translation with the longest 'from' that applies to 'path' and is not in 'used'; returns kNone if there
+     * is none, and how many bytes of 'path' the translation replaces in 'matched' otherwise.
+     */
+    uint32_t Match(const char *path, size_t length, const uint32_t *used, size_t numUsed, size_t *matched) const
+    {
+        uint32_t best = kNone;
+        uint32_t node = 0;
+        size_t i = 0;
+        for (; node != kNone; i++)
+        {
+            uint32_t t = FirstUnused(node, used, numUsed);
+            if (t != kNone)
+            {
+                best = t;
+                *matched = i;
+            }
+
+            if (i == length)
+            {
+                break;
+            }
+
+            node = Child(node, path[i]);
+        }
+
+        // a directory is named by its 'from' without the trailing '/'
+        if (node != kNone && length > 0 && path[length - 1] != '/')
+        {
+            uint32_t directory = Child(node, '/');
+            uint32_t t = directory == kNone ? kNone : FirstUnused(directory, used, numUsed);
+            if (t != kNone)
+            {
+                best = t;
+                *matched = length;
+            }
+        }
+
+        return best;
+    }
+
+public:
+    PathTranslator() {}
+
+    /** Compiles the ('from', 'to') translations of the FAM; those with an empty 'from' or 'to' are ignored. */
+    void Init(const std::vector<std::pair<std::string, std::string>> &translations)
+    {
+        translations_.clear();
+        firstTranslation_.assign(1, kNone);
+        edges_.clear();
+
+        for (const auto &translation : translations)
+        {
+            if (translation.first.empty() || translation.second.empty())
+            {
+                continue;
+            }
+
+            uint32_t node = 0;
+            for (char c : translation.first)
+            {
+                uint32_t child = Child(node, c);
+                if (child == kNone)
+                {
+                    child = (uint32_t)firstTranslation_.size();
+                    firstTranslation_.push_back(kNone);
+                    edges_.emplace(((uint64_t)node << 8) | (unsigned char)c, child);
+                }
+
+                node = child;
+            }
+
+            // keeps the translations with the same 'from' in order: the first one wins
+            uint32_t index = (uint32_t)translations_.size();
+            translations_.push_back({ translation.first, translation.second, kNone });
+            uint32_t *last = &firstTranslation_[node];
+            while (*last != kNone)
+            {
+                last = &translations_[*last].nextSameFrom;
+            }
+
+            *last = index;
+        }
+    }
+
+    /**
+     * Writes the translation of 'path' (not necessarily 0-terminated, hence 'length') to 'translated' and returns true,
+     * or returns false, leaving 'translated' alone, if no translation applies to 'path'. Paths of any length are
+     * translated: whether the result fits in a report is up to the caller.
+     */
+    bool Translate(const char *path, size_t length, std::string &translated) const
+    {
+        if (translations_.empty())
+        {
+            return false;
+        }
+
+        uint32_t used[MAX_CHAINED_TRANSLATIONS];
+        size_t numUsed = 0;
+        size_t matched = 0;
+        uint32_t t = Match(path, length, used, numUsed, &matched);
+        if (t == kNone)
+        {
+            return false;
+        }
+
+        translated.assign(path, length);
+        while (t != kNone)
+        {
+            // replaces the first 'matched' bytes with 'to', in place
+            translated.replace(0, matched, translations_[t].to);
+            used[numUsed++] = t;
+            t = numUsed < MAX_CHAINED_TRANSLATIONS ? Match(translated.data(), translated.length(), used, numUsed, &matched) : kNone;
+        }
+
+        return true;
+    }
+};
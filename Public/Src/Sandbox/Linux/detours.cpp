@@ -29,7 +29,7 @@
 static std::string sEmptyStr("");
 
 INTERPOSE(void, _exit, int status)({
-    bxl->report_access("_exit", ES_EVENT_TYPE_NOTIFY_EXIT, std::string(""), std::string(""));
+    bxl->report_process_exit("_exit");
     bxl->real__exit(status);
     _exit(status);
 })
@@ -41,18 +41,87 @@ static void report_child_process(const char *syscall, BxlObserver *bxl, pid_t ch
     bxl->report_access(syscall, event);
 }
 
-INTERPOSE(pid_t, fork, void)({
+static pid_t fork_child_process(const char *syscall, BxlObserver *bxl)
+{
+    bool counted = bxl->count_child_process();
     result_t<pid_t> childPid = bxl->fwd_fork();
 
     // report fork only when we are in the parent process
     if (childPid.get() > 0)
     {
-        report_child_process(__func__, bxl, childPid.get());
+        report_child_process(syscall, bxl, childPid.get());
+    }
+    else if (childPid.get() == 0)
+    {
+        bxl->mark_counted_in_process_tree();
+    }
+    else if (counted)
+    {
+        bxl->uncount_child_process();
     }
 
     return childPid.restore();
+}
+
+INTERPOSE(pid_t, fork, void)({
+    return fork_child_process(__func__, bxl);
 })
 
+// The child is counted before it is spawned and is told so through its environment (see 'ensureEnvs'),
+// because posix_spawn does not give us a chance to run any code in it before it execs.
+static int spawn_child_process(const char *syscall, BxlObserver *bxl, bool spawnp, pid_t *pid, const char *file,
+    const posix_spawn_file_actions_t *file_actions, const posix_spawnattr_t *attrp, char *const argv[], char *const envp[])
+{
+    bool counted = bxl->count_child_process();
+    char **newEnvp = bxl->ensureEnvs(envp, /*forSpawnedChild*/ true);
+    pid_t childPid = -1;
+    result_t<int> result = spawnp
+        ? bxl->fwd_posix_spawnp(&childPid, file, file_actions, attrp, argv, newEnvp)
+        : bxl->fwd_posix_spawn(&childPid, file, file_actions, attrp, argv, newEnvp);
+
+    // unlike exec, posix_spawn returns to this process, so the new environment must not be leaked
+    if (newEnvp != envp)
+    {
+        free(newEnvp);
+    }
+
+    if (result.get() == 0)
+    {
+        if (pid != NULL)
+        {
+            *pid = childPid;
+        }
+
+        report_child_process(syscall, bxl, childPid);
+    }
+    else if (counted)
+    {
+        bxl->uncount_child_process();
+    }
+
+    return result.restore();
+}
+
+INTERPOSE(int, posix_spawn, pid_t *pid, const char *path, const posix_spawn_file_actions_t *file_actions, const posix_spawnattr_t *attrp, char *const argv[], char *const envp[])({
+    return spawn_child_process(__func__, bxl, /*spawnp*/ false, pid, path, file_actions, attrp, argv, envp);
+})
+
+INTERPOSE(int, posix_spawnp, pid_t *pid, const char *file, const posix_spawn_file_actions_t *file_actions, const posix_spawnattr_t *attrp, char *const argv[], char *const envp[])({
+    return spawn_child_process(__func__, bxl, /*spawnp*/ true, pid, file, file_actions, attrp, argv, envp);
+})
+
+typedef struct {
+    int (*fn)(void *);
+    void *arg;
+} clone_child_args;
+
+static int clone_child(void *args)
+{
+    clone_child_args *childArgs = (clone_child_args *)args;
+    BxlObserver::GetInstance()->mark_counted_in_process_tree();
+    return childArgs->fn(childArgs->arg);
+}
+
 INTERPOSE(int, clone, int (*fn)(void *), void *child_stack, int flags, void *arg, ... /* pid_t *ptid, void *newtls, pid_t *ctid */ )({
     va_list args;
     va_start(args, arg);
@@ -61,11 +130,31 @@ INTERPOSE(int, clone, int (*fn)(void *), void *child_stack, int flags, void *arg
     pid_t *ctid = va_arg(args, pid_t*);
     va_end(args);
 
-    result_t<int> result = bxl->fwd_clone(fn, child_stack, flags, arg, ptid, newtls, ctid);
+    // A new thread is not a new process: there is nothing to report or count, and the state kept per thread
+    // (thread_local members of BxlObserver) is initialized on first use, so just forward the call.
+    if (flags & CLONE_THREAD)
+    {
+        return bxl->fwd_clone(fn, child_stack, flags, arg, ptid, newtls, ctid).restore();
+    }
+
+    // A child that does not share our memory gets its own copy of 'childArgs' (taken before clone returns), so it
+    // can safely mark itself as counted (and take over its log and reports) before running 'fn'.  One that does share
+    // our memory is counted anyway, but is never marked as such, so it never brings the count to zero.
+    bool counted = bxl->count_child_process();
+    clone_child_args childArgs;
+    childArgs.fn = fn;
+    childArgs.arg = arg;
+    result_t<int> result = (flags & CLONE_VM) == 0
+        ? bxl->fwd_clone(clone_child, child_stack, flags, &childArgs, ptid, newtls, ctid)
+        : bxl->fwd_clone(fn, child_stack, flags, arg, ptid, newtls, ctid);
     if (result.get() > 0)
     {
         report_child_process(__func__, bxl, result.get());
     }
+    else if (counted)
+    {
+        bxl->uncount_child_process();
+    }
 
     return result.restore();
 })
@@ -95,6 +184,21 @@ INTERPOSE(int, execvpe, const char *file, char *const argv[], char *const envp[]
     return bxl->fwd_execvpe(file, argv, bxl->ensureEnvs(envp)).restore();
 })
 
+INTERPOSE(int, execveat, int dirfd, const char *pathname, char *const argv[], char *const envp[], int flags)({
+    if ((flags & AT_EMPTY_PATH) && *pathname == '\0')
+    {
+        bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_EXEC, dirfd);
+    }
+    else
+    {
+        int oflags = (flags & AT_SYMLINK_NOFOLLOW) ? O_NOFOLLOW : 0;
+        string exe_path = bxl->normalize_path_at(dirfd, pathname, oflags);
+        bxl->report_exec(__func__, argv[0], exe_path.c_str());
+    }
+
+    return bxl->fwd_execveat(dirfd, pathname, argv, bxl->ensureEnvs(envp), flags).restore();
+})
+
 INTERPOSE(int, __fxstat, int __ver, int fd, struct stat *__stat_buf)({
     result_t<int> result = bxl->fwd___fxstat(__ver, fd, __stat_buf);
     bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_STAT, fd);
@@ -160,24 +264,39 @@ INTERPOSE(FILE*, fdopen, int fd, const char *mode)({
 })
 
 INTERPOSE(FILE*, fopen, const char *pathname, const char *mode)({
-
-    auto check = bxl->report_access(__func__, get_event_from_open_mode(mode), pathname);
-    return bxl->check_and_fwd_fopen(check, (FILE*)NULL, pathname, mode);
+    string pathStr = bxl->normalize_path(pathname);
+    es_event_type_t eventType = get_event_from_open_mode(mode);
+    auto check = bxl->report_access(__func__, eventType, pathStr, sEmptyStr);
+    FILE *f = bxl->check_and_fwd_fopen(check, (FILE*)NULL, pathname, mode);
+    if (f) bxl->track_output_fd(fileno(f), pathStr, eventType == ES_EVENT_TYPE_NOTIFY_WRITE);
+    return f;
 })
 
 INTERPOSE(FILE*, fopen64, const char *pathname, const char *mode)({
-    auto check = bxl->report_access(__func__, get_event_from_open_mode(mode), pathname);
-    return bxl->check_and_fwd_fopen64(check, (FILE*)NULL, pathname, mode);
+    string pathStr = bxl->normalize_path(pathname);
+    es_event_type_t eventType = get_event_from_open_mode(mode);
+    auto check = bxl->report_access(__func__, eventType, pathStr, sEmptyStr);
+    FILE *f = bxl->check_and_fwd_fopen64(check, (FILE*)NULL, pathname, mode);
+    if (f) bxl->track_output_fd(fileno(f), pathStr, eventType == ES_EVENT_TYPE_NOTIFY_WRITE);
+    return f;
 })
 
 INTERPOSE(FILE*, freopen, const char *pathname, const char *mode, FILE *stream)({
-    auto check = bxl->report_access(__func__, get_event_from_open_mode(mode), pathname);
-    return bxl->check_and_fwd_freopen(check, (FILE*)NULL, pathname, mode, stream);
+    string pathStr = bxl->normalize_path(pathname);
+    es_event_type_t eventType = get_event_from_open_mode(mode);
+    auto check = bxl->report_access(__func__, eventType, pathStr, sEmptyStr);
+    FILE *f = bxl->check_and_fwd_freopen(check, (FILE*)NULL, pathname, mode, stream);
+    if (f) bxl->track_output_fd(fileno(f), pathStr, eventType == ES_EVENT_TYPE_NOTIFY_WRITE);
+    return f;
 })
 
 INTERPOSE(FILE*, freopen64, const char *pathname, const char *mode, FILE *stream)({
-    auto check = bxl->report_access(__func__, get_event_from_open_mode(mode), pathname);
-    return bxl->check_and_fwd_freopen64(check, (FILE*)NULL, pathname, mode, stream);
+    string pathStr = bxl->normalize_path(pathname);
+    es_event_type_t eventType = get_event_from_open_mode(mode);
+    auto check = bxl->report_access(__func__, eventType, pathStr, sEmptyStr);
+    FILE *f = bxl->check_and_fwd_freopen64(check, (FILE*)NULL, pathname, mode, stream);
+    if (f) bxl->track_output_fd(fileno(f), pathStr, eventType == ES_EVENT_TYPE_NOTIFY_WRITE);
+    return f;
 })
 
 INTERPOSE(size_t, fread, void *ptr, size_t size, size_t nmemb, FILE *stream)({
@@ -249,7 +368,9 @@ INTERPOSE(int, open, const char *path, int oflag, ...)({
 
     std::string pathStr = bxl->normalize_path(path);
     AccessCheckResult check = ReportFileOpen(bxl, pathStr, oflag);
-    return bxl->check_and_fwd_open(check, ERROR_RETURN_VALUE, path, oflag, mode);
+    int fd = bxl->check_and_fwd_open(check, ERROR_RETURN_VALUE, path, oflag, mode);
+    bxl->track_output_fd(fd, pathStr, (oflag & O_ACCMODE) != O_RDONLY);
+    return fd;
 })
 
 INTERPOSE(int, open64, const char *path, int oflag, ...)({
@@ -260,7 +381,9 @@ INTERPOSE(int, open64, const char *path, int oflag, ...)({
 
     std::string pathStr = bxl->normalize_path(path);
     AccessCheckResult check = ReportFileOpen(bxl, pathStr, oflag);
-    return bxl->check_and_fwd_open64(check, ERROR_RETURN_VALUE, path, oflag, mode);
+    int fd = bxl->check_and_fwd_open64(check, ERROR_RETURN_VALUE, path, oflag, mode);
+    bxl->track_output_fd(fd, pathStr, (oflag & O_ACCMODE) != O_RDONLY);
+    return fd;
 })
 
 INTERPOSE(int, openat, int dirfd, const char *pathname, int flags, ...)({
@@ -271,7 +394,9 @@ INTERPOSE(int, openat, int dirfd, const char *pathname, int flags, ...)({
 
     std::string pathStr = bxl->normalize_path_at(dirfd, pathname);
     AccessCheckResult check = ReportFileOpen(bxl, pathStr, flags);
-    return bxl->check_and_fwd_openat(check, ERROR_RETURN_VALUE, dirfd, pathname, flags, mode);
+    int fd = bxl->check_and_fwd_openat(check, ERROR_RETURN_VALUE, dirfd, pathname, flags, mode);
+    bxl->track_output_fd(fd, pathStr, (flags & O_ACCMODE) != O_RDONLY);
+    return fd;
 })
 
 INTERPOSE(int, openat64, int dirfd, const char *pathname, int flags, ...)({
@@ -282,7 +407,9 @@ INTERPOSE(int, openat64, int dirfd, const char *pathname, int flags, ...)({
 
     std::string pathStr = bxl->normalize_path_at(dirfd, pathname);
     AccessCheckResult check = ReportFileOpen(bxl, pathStr, flags);
-    return bxl->check_and_fwd_openat(check, ERROR_RETURN_VALUE, dirfd, pathname, flags, mode);
+    int fd = bxl->check_and_fwd_openat(check, ERROR_RETURN_VALUE, dirfd, pathname, flags, mode);
+    bxl->track_output_fd(fd, pathStr, (flags & O_ACCMODE) != O_RDONLY);
+    return fd;
 })
 
 INTERPOSE(int, creat, const char *pathname, mode_t mode)({
@@ -445,6 +572,9 @@ INTERPOSE(ssize_t, readlinkat, int fd, const char *path, char *buf, size_t bufsi
     return bxl->check_and_fwd_readlinkat(check, (ssize_t)ERROR_RETURN_VALUE, fd, path, buf, bufsize);
 })
 
+// Enumerations are reported when a directory is opened; readdir and getdents are not interposed. The entries a process
+// read cannot stand in for the engine's directory membership fingerprint (DirectoryMembershipFingerprinter), which
+// applies membership rules and enumerate patterns, and which comes from the pip graph for writable mounts.
 INTERPOSE(DIR*, opendir, const char *name)({
     auto check = bxl->report_access(__func__, ES_EVENT_TYPE_NOTIFY_READDIR, name);
     return bxl->check_and_fwd_opendir(check, (DIR*)NULL, name);
@@ -623,18 +753,42 @@ INTERPOSE(int, name_to_handle_at, int dirfd, const char *pathname, struct file_h
 })
 
 INTERPOSE(int, close, int fd) ({ 
+    bxl->report_content_hash_on_close(__func__, fd);
     bxl->reset_fd_table_entry(fd);
     return bxl->fwd_close(fd).restore();
 })
 
 INTERPOSE(int, fclose, FILE *f) ({
+    bxl->report_content_hash_on_close(__func__, fileno(f), f);
     bxl->reset_fd_table_entry(fileno(f));
     return bxl->fwd_fclose(f).restore();
 })
 
+// duplicates of a descriptor whose content is hashed on close keep the file open for writing (see track_duplicated_fd)
+INTERPOSE(int, dup, int oldfd) ({
+    result_t<int> result = bxl->fwd_dup(oldfd);
+    bxl->track_duplicated_fd(oldfd, result.get());
+    return result.restore();
+})
+
+INTERPOSE(int, dup2, int oldfd, int newfd) ({
+    // 'newfd' is silently closed if it was open
+    if (oldfd != newfd) bxl->report_content_hash_on_close(__func__, newfd);
+    result_t<int> result = bxl->fwd_dup2(oldfd, newfd);
+    bxl->track_duplicated_fd(oldfd, result.get());
+    return result.restore();
+})
+
+INTERPOSE(int, dup3, int oldfd, int newfd, int flags) ({
+    if (oldfd != newfd) bxl->report_content_hash_on_close(__func__, newfd);
+    result_t<int> result = bxl->fwd_dup3(oldfd, newfd, flags);
+    bxl->track_duplicated_fd(oldfd, result.get());
+    return result.restore();
+})
+
 static void report_exit(int exitCode, void *args)
 {
-    BxlObserver::GetInstance()->report_access("on_exit", ES_EVENT_TYPE_NOTIFY_EXIT, std::string(""), std::string(""));
+    BxlObserver::GetInstance()->report_process_exit("on_exit");
 }
 
 // invoked by the loader when our shared library is dynamically loaded into a new host process
@@ -656,13 +810,6 @@ int main(int argc, char **argv)
     printf("Path: %s\n", inst->GetReportsPath());
 }
 
-/* ============ Sometimes useful (for debugging) to interpose without access checking
-
-INTERPOSE(int, dup, int fd)               ({ return bxl->fwd_dup(fd).restore(); })
-INTERPOSE(int, dup2, int oldfd, int newfd)({ return bxl->fwd_dup2(oldfd, newfd).restore(); })
-
-=================================================================== */
-
 /* ============ don't need to be interposed =======================
 
 INTERPOSE(int, statfs, const char *pathname, struct statfs *buf)({
@@ -693,13 +840,6 @@ INTERPOSE(int, fstatfs64, int fd, struct statfs64 *buf)({
 
 /* ============ old/obsolete/unavailable ==========================
 
-INTERPOSE(int, execveat, int dirfd, const char *pathname, char *const argv[], char *const envp[], int flags)({
-    int oflags = (flags & AT_SYMLINK_NOFOLLOW) ? O_NOFOLLOW : 0;
-    string exe_path = bxl->normalize_path_at(dirfd, pathname, oflags);
-    bxl->report_exec(__func__, argv[0], exe_path.c_str());
-    return bxl->fwd_execveat(dirfd, pathname, argv, bxl->ensureEnvs(envp), flags).restore();
-})
-
 INTERPOSE(int, getdents, unsigned int fd, struct linux_dirent *dirp, unsigned int count)({
     auto check = bxl->report_access_fd(__func__, ES_EVENT_TYPE_NOTIFY_READDIR, fd);
     return bxl->check_and_fwd_getdents(check, ERROR_RETURN_VALUE, fd, dirp, count);
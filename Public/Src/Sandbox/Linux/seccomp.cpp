@@ -0,0 +1,1044 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+
+/*
+ * bxl-seccomp: a sandbox backend that does not depend on LD_PRELOAD.
+ *
+ * Usage: bxl-seccomp <program> [<args>...]
+ *
+ * The program is started with a seccomp-bpf filter that hands the file-related syscalls (the ones libDetours.so
+ * interposes, see syscalls.md) of every process in its tree over to this process (the supervisor) through a
+ * SECCOMP_RET_USER_NOTIF listener; every other syscall runs at native speed.  The supervisor checks and reports
+ * those accesses through the same BxlObserver/IOHandler/PolicyResult code libDetours.so uses, so it must be run
+ * with the same __BUILDXL_* environment variables.  Unlike LD_PRELOAD interposing, this also sees the accesses of
+ * statically linked binaries, binaries not linked against glibc, and raw syscalls.
+ *
+ * Trapped syscalls are resumed with SECCOMP_USER_NOTIF_FLAG_CONTINUE (Linux 5.5+), i.e., the kernel performs them after
+ * the supervisor has looked at their arguments.  This backend only observes accesses: it never fails a syscall (see Supervisor).
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bxl_observer.hpp"
+
+// Definitions missing from the kernel headers of older distributions (user notifications were added in Linux 5.0)
+#ifndef SECCOMP_FILTER_FLAG_NEW_LISTENER
+    #define SECCOMP_FILTER_FLAG_NEW_LISTENER (1UL << 3)
+    #define SECCOMP_RET_USER_NOTIF 0x7fc00000U
+    #define SECCOMP_GET_NOTIF_SIZES 3
+
+    struct seccomp_notif_sizes { __u16 seccomp_notif; __u16 seccomp_notif_resp; __u16 seccomp_data; };
+    struct seccomp_notif { __u64 id; __u32 pid; __u32 flags; struct seccomp_data data; };
+    struct seccomp_notif_resp { __u64 id; __s64 val; __s32 error; __u32 flags; };
+
+    #define SECCOMP_IOCTL_NOTIF_RECV     _IOWR('!', 0, struct seccomp_notif)
+    #define SECCOMP_IOCTL_NOTIF_SEND     _IOWR('!', 1, struct seccomp_notif_resp)
+    #define SECCOMP_IOCTL_NOTIF_ID_VALID _IOW('!', 2, __u64)
+#endif
+
+#ifndef SECCOMP_USER_NOTIF_FLAG_CONTINUE
+    #define SECCOMP_USER_NOTIF_FLAG_CONTINUE (1UL << 0)
+#endif
+
+#if defined(__x86_64__)
+    #define BXL_AUDIT_ARCH AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+    #define BXL_AUDIT_ARCH AUDIT_ARCH_AARCH64
+#else
+    #error Unsupported architecture
+#endif
+
+#ifndef __X32_SYSCALL_BIT
+    #define __X32_SYSCALL_BIT 0x40000000
+#endif
+
+// How often the supervisor looks for processes that have exited while it was idle
+#define PROCESS_SWEEP_INTERVAL_MS 100
+
+// At most how many threads handle notifications (one per CPU, up to this many)
+#define MAX_NOTIFICATION_THREADS 8
+
+// The file-related syscalls handed over to the supervisor.  Syscalls that only take a file descriptor (write, ftruncate,
+// fchmod, ...) are deliberately left out: they are the hot ones, and the file they refer to was reported when it was opened.
+static const int kTrappedSyscalls[] =
+{
+#ifdef SYS_open
+    SYS_open,
+#endif
+#ifdef SYS_creat
+    SYS_creat,
+#endif
+    SYS_openat,
+#ifdef SYS_openat2
+    SYS_openat2,
+#endif
+#ifdef SYS_stat
+    SYS_stat,
+#endif
+#ifdef SYS_lstat
+    SYS_lstat,
+#endif
+#ifdef SYS_newfstatat
+    SYS_newfstatat,
+#endif
+#ifdef SYS_statx
+    SYS_statx,
+#endif
+#ifdef SYS_access
+    SYS_access,
+#endif
+    SYS_faccessat,
+#ifdef SYS_faccessat2
+    SYS_faccessat2,
+#endif
+#ifdef SYS_readlink
+    SYS_readlink,
+#endif
+    SYS_readlinkat,
+    SYS_truncate,
+#ifdef SYS_mkdir
+    SYS_mkdir,
+#endif
+    SYS_mkdirat,
+#ifdef SYS_mknod
+    SYS_mknod,
+#endif
+    SYS_mknodat,
+#ifdef SYS_rmdir
+    SYS_rmdir,
+#endif
+#ifdef SYS_unlink
+    SYS_unlink,
+#endif
+    SYS_unlinkat,
+#ifdef SYS_rename
+    SYS_rename,
+#endif
+#ifdef SYS_renameat
+    SYS_renameat,
+#endif
+#ifdef SYS_renameat2
+    SYS_renameat2,
+#endif
+#ifdef SYS_link
+    SYS_link,
+#endif
+    SYS_linkat,
+#ifdef SYS_symlink
+    SYS_symlink,
+#endif
+    SYS_symlinkat,
+#ifdef SYS_chmod
+    SYS_chmod,
+#endif
+    SYS_fchmodat,
+#ifdef SYS_chown
+    SYS_chown,
+#endif
+#ifdef SYS_lchown
+    SYS_lchown,
+#endif
+    SYS_fchownat,
+#ifdef SYS_utime
+    SYS_utime,
+#endif
+#ifdef SYS_utimes
+    SYS_utimes,
+#endif
+#ifdef SYS_futimesat
+    SYS_futimesat,
+#endif
+    SYS_utimensat,
+    SYS_execve,
+#ifdef SYS_execveat
+    SYS_execveat,
+#endif
+};
+
+static int seccomp(unsigned int operation, unsigned int flags, void *args)
+{
+    return syscall(SYS_seccomp, operation, flags, args);
+}
+
+/**
+ * Installs (in the calling process) a filter that sends every syscall from 'kTrappedSyscalls' to a listener,
+ * and returns the file descriptor of that listener (or -1 on error).
+ */
+static int install_filter()
+{
+    const int numSyscalls = ARRAYSIZE(kTrappedSyscalls);
+    std::vector<struct sock_filter> program;
+
+    // syscalls made with a different ABI (e.g., i386 or x32 ones on x86_64) are let through
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)));
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, BXL_AUDIT_ARCH, 1, 0));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)));
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, __X32_SYSCALL_BIT, 0, 1));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+
+    // a match jumps to the final 'notify' instruction, which comes right after the 'allow' one (jump offsets are 8-bit)
+    for (int i = 0; i < numSyscalls; i++)
+    {
+        program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (__u32)kTrappedSyscalls[i], (__u8)(numSyscalls - i), 0));
+    }
+
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_USER_NOTIF));
+
+    struct sock_fprog prog;
+    prog.len = program.size();
+    prog.filter = program.data();
+
+    // required for installing a filter without CAP_SYS_ADMIN
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0)
+    {
+        return -1;
+    }
+
+    return seccomp(SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_NEW_LISTENER, &prog);
+}
+
+static bool send_fd(int sock, int fd)
+{
+    char data = 0;
+    struct iovec iov = { &data, 1 };
+    char control[CMSG_SPACE(sizeof(int))] = {0};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(sock, &msg, 0) == 1;
+}
+
+static int recv_fd(int sock)
+{
+    char data;
+    struct iovec iov = { &data, 1 };
+    char control[CMSG_SPACE(sizeof(int))] = {0};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(sock, &msg, 0) != 1)
+    {
+        return -1;
+    }
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        return -1;
+    }
+
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+static mode_t get_mode(const char *path)
+{
+    struct stat buf;
+    return lstat(path, &buf) == 0 ? buf.st_mode : 0;
+}
+
+/**
+ * Checks and reports, on behalf of the processes of the tree, the syscalls handed over by the filter.
+ *
+ * Notifications are handled by a pool of threads ('numThreads'); the task that made the syscall is blocked in the kernel
+ * until one of them is done with it.  The main thread reaps the processes of the tree and reports the ones that exited.
+ *
+ * The supervisor only observes: it reports what it checked (including the accesses the manifest denies, which the engine
+ * flags), but every syscall is resumed with SECCOMP_USER_NOTIF_FLAG_CONTINUE.  The kernel reads the arguments of a resumed
+ * syscall again, after the supervisor did, and another thread of the tracee may have changed the memory they point to in
+ * the meantime, so failing a syscall because of the path the supervisor saw would not actually keep the tracee from
+ * accessing a denied path.
+ */
+class Supervisor final
+{
+private:
+    // A task (thread) that made a trapped syscall.
+    class Task final
+    {
+    public:
+        pid_t tid;
+        pid_t pid;        // the process (thread group) the task belongs to
+        int procFd;       // handle to /proc/<tid>: lookups through it fail once the task is gone, even if its id gets reused
+
+        Task(pid_t tid, pid_t pid, int procFd) : tid(tid), pid(pid), procFd(procFd) { }
+        ~Task() { close(procFd); }
+    };
+
+    // A process of the tree that was reported as started.
+    typedef struct {
+        pid_t ppid;
+        int procFd;       // handle to /proc/<pid>
+        std::string exe;  // empty after the process execs, until it is needed again
+        std::shared_ptr<SandboxedProcess> observed;  // 'pid' running 'exe', see BxlObserver::report_access_on_behalf
+    } Process;
+
+    BxlObserver *bxl_;
+    int listener_;
+    pid_t rootPid_;
+    int rootExitCode_;
+    int numThreads_;
+    std::atomic<bool> stopping_;
+    std::atomic<int> runningThreads_;
+
+    // guards 'tasks_' and 'processes_', which are shared by the threads that handle notifications
+    std::mutex stateMtx_;
+    std::unordered_map<pid_t, std::shared_ptr<Task>> tasks_;
+    std::unordered_map<pid_t, Process> processes_;
+
+    size_t reqSize_;
+    size_t respSize_;
+
+    // the id of the notification the current thread handles (see ReadMemory)
+    static thread_local __u64 sNotificationId;
+
+    static bool IsAlive(int procFd)
+    {
+        return faccessat(procFd, "stat", F_OK, 0) == 0;
+    }
+
+    std::shared_ptr<Task> GetTask(pid_t tid);
+    std::shared_ptr<SandboxedProcess> GetObservedProcess(const Task &task, pid_t *ppid, std::string *exe);
+    Process& GetProcess(const Task &task);
+    void ReapChildren();
+    void ForgetExitedProcesses(bool all);
+
+    bool ReadMemory(pid_t tid, uint64_t addr, void *buf, size_t size);
+    bool ReadString(pid_t tid, uint64_t addr, char *buf, size_t bufsize);
+    std::string ResolvePath(const Task &task, int dirfd, uint64_t pathAddr, int oflags = 0, bool emptyPathIsFd = false);
+
+    AccessCheckResult Report(const char *syscallName, const Task &task, es_event_type_t eventType,
+        const std::string &path, const std::string &secondPath = "", mode_t mode = 0);
+    AccessCheckResult ReportOpen(const char *syscallName, const Task &task, const std::string &path, int oflags);
+    AccessCheckResult ReportExec(const char *syscallName, const Task &task, const std::string &path);
+    AccessCheckResult HandleSyscall(const Task &task, const struct seccomp_data &data);
+    void HandleNotification(struct seccomp_notif *req, struct seccomp_notif_resp *resp);
+    void HandleNotifications();
+
+public:
+    Supervisor(BxlObserver *bxl, int listener, pid_t rootPid);
+    ~Supervisor();
+
+    int Run();
+};
+
+thread_local __u64 Supervisor::sNotificationId = 0;
+
+Supervisor::Supervisor(BxlObserver *bxl, int listener, pid_t rootPid)
+    : bxl_(bxl), listener_(listener), rootPid_(rootPid), rootExitCode_(-1), stopping_(false), runningThreads_(0)
+{
+    // the kernel may use bigger structures than the ones we were compiled against
+    struct seccomp_notif_sizes sizes;
+    if (seccomp(SECCOMP_GET_NOTIF_SIZES, 0, &sizes) != 0)
+    {
+        sizes.seccomp_notif = sizeof(struct seccomp_notif);
+        sizes.seccomp_notif_resp = sizeof(struct seccomp_notif_resp);
+    }
+
+    reqSize_ = std::max<size_t>(sizes.seccomp_notif, sizeof(struct seccomp_notif));
+    respSize_ = std::max<size_t>(sizes.seccomp_notif_resp, sizeof(struct seccomp_notif_resp));
+    numThreads_ = std::max(1, std::min((int)std::thread::hardware_concurrency(), MAX_NOTIFICATION_THREADS));
+}
+
+Supervisor::~Supervisor()
+{
+    for (auto &process : processes_) close(process.second.procFd);
+}
+
+std::shared_ptr<Supervisor::Task> Supervisor::GetTask(pid_t tid)
+{
+    std::lock_guard<std::mutex> lock(stateMtx_);
+
+    auto it = tasks_.find(tid);
+    if (it != tasks_.end())
+    {
+        if (IsAlive(it->second->procFd))
+        {
+            return it->second;
+        }
+
+        // the task is gone and its id was reused
+        tasks_.erase(it);
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d", tid);
+    int procFd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (procFd == -1)
+    {
+        return nullptr;
+    }
+
+    pid_t pid = -1, ppid = 0;
+    int statusFd = openat(procFd, "status", O_RDONLY | O_CLOEXEC);
+    FILE *status = statusFd != -1 ? fdopen(statusFd, "r") : NULL;
+    if (status != NULL)
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), status))
+        {
+            sscanf(line, "Tgid: %d", &pid);
+            sscanf(line, "PPid: %d", &ppid);
+        }
+
+        fclose(status);
+    }
+
+    if (pid == -1)
+    {
+        close(procFd);
+        return nullptr;
+    }
+
+    std::shared_ptr<Task> task(new Task(tid, pid, procFd));
+    tasks_[tid] = task;
+
+    // the first task seen from a process gets it reported as started (while the lock is held, so that
+    // no other thread of that process gets an access reported before)
+    if (processes_.find(pid) == processes_.end())
+    {
+        snprintf(path, sizeof(path), "/proc/%d", pid);
+        Process &process = processes_[pid];
+        process.ppid = ppid;
+        process.procFd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        Process &started = GetProcess(*task);
+        IOEvent event(ppid, pid, ppid, ES_EVENT_TYPE_NOTIFY_FORK, ES_ACTION_TYPE_NOTIFY, started.exe, std::string(""), started.exe, 0, false);
+        bxl_->report_access_on_behalf("fork", event, started.observed);
+    }
+
+    return task;
+}
+
+// (must be called with 'stateMtx_' held)
+Supervisor::Process& Supervisor::GetProcess(const Task &task)
+{
+    Process &process = processes_[task.pid];
+    if (process.exe.empty())
+    {
+        char exe[PATH_MAX] = {0};
+        ssize_t len = readlinkat(task.procFd, "exe", exe, PATH_MAX - 1);
+        process.exe = len > 0 ? std::string(exe, len) : std::string(bxl_->GetProgramPath());
+        process.observed = bxl_->CreateObservedProcess(task.pid, process.exe.c_str());
+    }
+
+    return process;
+}
+
+std::shared_ptr<SandboxedProcess> Supervisor::GetObservedProcess(const Task &task, pid_t *ppid, std::string *exe)
+{
+    std::lock_guard<std::mutex> lock(stateMtx_);
+    Process &process = GetProcess(task);
+    *ppid = process.ppid;
+    *exe = process.exe;
+    return process.observed;
+}
+
+void Supervisor::ReapChildren()
+{
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        if (pid == rootPid_)
+        {
+            rootExitCode_ = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+    }
+}
+
+void Supervisor::ForgetExitedProcesses(bool all)
+{
+    std::lock_guard<std::mutex> lock(stateMtx_);
+
+    for (auto it = tasks_.begin(); it != tasks_.end(); )
+    {
+        if (all || !IsAlive(it->second->procFd))
+        {
+            it = tasks_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (auto it = processes_.begin(); it != processes_.end(); )
+    {
+        Process &process = it->second;
+        if (all || process.procFd == -1 || !IsAlive(process.procFd))
+        {
+            std::string exe = process.exe.empty() ? std::string(bxl_->GetProgramPath()) : process.exe;
+            std::shared_ptr<SandboxedProcess> observed = process.observed != nullptr ? process.observed : bxl_->CreateObservedProcess(it->first, exe.c_str());
+            IOEvent event(it->first, 0, process.ppid, ES_EVENT_TYPE_NOTIFY_EXIT, ES_ACTION_TYPE_NOTIFY, std::string(""), std::string(""), exe, 0, false);
+            bxl_->report_access_on_behalf("exit", event, observed);
+            if (process.procFd != -1) close(process.procFd);
+            it = processes_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+bool Supervisor::ReadMemory(pid_t tid, uint64_t addr, void *buf, size_t size)
+{
+    struct iovec local = { buf, size };
+    struct iovec remote = { (void *)addr, size };
+    return process_vm_readv(tid, &local, 1, &remote, 1, 0) == (ssize_t)size
+        // the task may have died (and its id been reused) before the memory was read
+        && ioctl(listener_, SECCOMP_IOCTL_NOTIF_ID_VALID, &sNotificationId) == 0;
+}
+
+bool Supervisor::ReadString(pid_t tid, uint64_t addr, char *buf, size_t bufsize)
+{
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    size_t len = 0;
+    while (len < bufsize)
+    {
+        // never read past the end of a page at once: the next page may not be mapped
+        size_t chunk = std::min(bufsize - len, pageSize - ((addr + len) % pageSize));
+        struct iovec local = { buf + len, chunk };
+        struct iovec remote = { (void *)(addr + len), chunk };
+        ssize_t numRead = process_vm_readv(tid, &local, 1, &remote, 1, 0);
+        if (numRead <= 0)
+        {
+            return false;
+        }
+
+        if (memchr(buf + len, '\0', numRead) != NULL)
+        {
+            return ioctl(listener_, SECCOMP_IOCTL_NOTIF_ID_VALID, &sNotificationId) == 0;
+        }
+
+        len += numRead;
+    }
+
+    return false;
+}
+
+std::string Supervisor::ResolvePath(const Task &task, int dirfd, uint64_t pathAddr, int oflags, bool emptyPathIsFd)
+{
+    char path[PATH_MAX] = {0};
+    if (pathAddr != 0 && !ReadString(task.tid, pathAddr, path, sizeof(path)))
+    {
+        return "";
+    }
+
+    if (path[0] == '/')
+    {
+        return bxl_->normalize_path(path, oflags);
+    }
+
+    if (path[0] == '\0' && !emptyPathIsFd)
+    {
+        return "";
+    }
+
+    // relative paths are resolved against the working directory of the task or the directory 'dirfd' refers to
+    char link[32];
+    if (dirfd == AT_FDCWD)
+    {
+        strcpy(link, "cwd");
+    }
+    else
+    {
+        snprintf(link, sizeof(link), "fd/%d", dirfd);
+    }
+
+    char fullpath[PATH_MAX];
+    ssize_t len = readlinkat(task.procFd, link, fullpath, PATH_MAX - 1);
+    if (len <= 0 || fullpath[0] != '/')
+    {
+        // e.g., a pipe or a socket
+        return "";
+    }
+
+    if (path[0] != '\0')
+    {
+        snprintf(fullpath + len, PATH_MAX - len, "/%s", path);
+    }
+    else
+    {
+        fullpath[len] = '\0';
+    }
+
+    return bxl_->normalize_path(fullpath, oflags);
+}
+
+AccessCheckResult Supervisor::Report(const char *syscallName, const Task &task, es_event_type_t eventType,
+    const std::string &path, const std::string &secondPath, mode_t mode)
+{
+    if (path.empty())
+    {
+        return AccessCheckResult::Invalid();
+    }
+
+    pid_t ppid;
+    std::string exe;
+    std::shared_ptr<SandboxedProcess> observed = GetObservedProcess(task, &ppid, &exe);
+    IOEvent event(task.pid, 0, ppid, eventType, ES_ACTION_TYPE_NOTIFY, path, secondPath, exe,
+        mode != 0 ? mode : get_mode(path.c_str()), false);
+    return bxl_->report_access_on_behalf(syscallName, event, observed);
+}
+
+// Same as 'ReportFileOpen' in detours.cpp:
+// report "Create" if path does not exist and O_CREAT or O_TRUNC is specified
+// report "Write" if path exists and O_CREAT or O_TRUNC is specified (because this truncates the file regardless of its content)
+// otherwise, report "Read"
+AccessCheckResult Supervisor::ReportOpen(const char *syscallName, const Task &task, const std::string &path, int oflags)
+{
+    mode_t pathMode = get_mode(path.c_str());
+    bool pathExists = pathMode != 0;
+    bool isCreate = !pathExists && (oflags & (O_CREAT|O_TRUNC));
+    bool isWrite = pathExists && (oflags & (O_CREAT|O_TRUNC) && (oflags & O_WRONLY));
+    return Report(
+        syscallName,
+        task,
+        isCreate ? ES_EVENT_TYPE_NOTIFY_CREATE : isWrite ? ES_EVENT_TYPE_NOTIFY_WRITE : ES_EVENT_TYPE_NOTIFY_OPEN,
+        path,
+        "",
+        pathMode);
+}
+
+// Same as BxlObserver::report_exec: the process is reported as (re)started with its new executable.  The process reads
+// its new executable path again on its next trapped syscall (the exec may still fail).
+AccessCheckResult Supervisor::ReportExec(const char *syscallName, const Task &task, const std::string &path)
+{
+    if (path.empty())
+    {
+        return AccessCheckResult::Invalid();
+    }
+
+    pid_t ppid;
+    std::string exe;
+    GetObservedProcess(task, &ppid, &exe);
+    std::shared_ptr<SandboxedProcess> observed = bxl_->CreateObservedProcess(task.pid, path.c_str());
+    IOEvent event(task.pid, 0, ppid, ES_EVENT_TYPE_NOTIFY_EXEC, ES_ACTION_TYPE_NOTIFY, path, std::string(""), path, 0, false);
+    AccessCheckResult check = bxl_->report_access_on_behalf(syscallName, event, observed);
+
+    std::lock_guard<std::mutex> lock(stateMtx_);
+    Process &process = processes_[task.pid];
+    process.exe.clear();
+    process.observed = nullptr;
+    return check;
+}
+
+#define ARG_FD(i)    ((int)data.args[i])
+#define ARG_FLAGS(i) ((int)data.args[i])
+#define NOFOLLOW_IF(flags, flag) (((flags) & (flag)) ? O_NOFOLLOW : 0)
+
+AccessCheckResult Supervisor::HandleSyscall(const Task &task, const struct seccomp_data &data)
+{
+    switch (data.nr)
+    {
+#ifdef SYS_open
+        case SYS_open:
+            return ReportOpen("open", task, ResolvePath(task, AT_FDCWD, data.args[0]), ARG_FLAGS(1));
+#endif
+#ifdef SYS_creat
+        case SYS_creat:
+            return ReportOpen("creat", task, ResolvePath(task, AT_FDCWD, data.args[0]), O_CREAT | O_WRONLY | O_TRUNC);
+#endif
+        case SYS_openat:
+            return ReportOpen("openat", task, ResolvePath(task, ARG_FD(0), data.args[1]), ARG_FLAGS(2));
+#ifdef SYS_openat2
+        case SYS_openat2:
+        {
+            // the flags are the first field of 'struct open_how'
+            uint64_t flags = 0;
+            ReadMemory(task.tid, data.args[2], &flags, sizeof(flags));
+            return ReportOpen("openat2", task, ResolvePath(task, ARG_FD(0), data.args[1]), (int)flags);
+        }
+#endif
+#ifdef SYS_stat
+        case SYS_stat:
+            return Report("stat", task, ES_EVENT_TYPE_NOTIFY_STAT, ResolvePath(task, AT_FDCWD, data.args[0]));
+#endif
+#ifdef SYS_lstat
+        case SYS_lstat:
+            return Report("lstat", task, ES_EVENT_TYPE_NOTIFY_STAT, ResolvePath(task, AT_FDCWD, data.args[0], O_NOFOLLOW));
+#endif
+#ifdef SYS_newfstatat
+        case SYS_newfstatat:
+            return Report("newfstatat", task, ES_EVENT_TYPE_NOTIFY_STAT,
+                ResolvePath(task, ARG_FD(0), data.args[1], NOFOLLOW_IF(ARG_FLAGS(3), AT_SYMLINK_NOFOLLOW), ARG_FLAGS(3) & AT_EMPTY_PATH));
+#endif
+#ifdef SYS_statx
+        case SYS_statx:
+            return Report("statx", task, ES_EVENT_TYPE_NOTIFY_STAT,
+                ResolvePath(task, ARG_FD(0), data.args[1], NOFOLLOW_IF(ARG_FLAGS(2), AT_SYMLINK_NOFOLLOW), ARG_FLAGS(2) & AT_EMPTY_PATH));
+#endif
+#ifdef SYS_access
+        case SYS_access:
+            return Report("access", task, ES_EVENT_TYPE_NOTIFY_ACCESS, ResolvePath(task, AT_FDCWD, data.args[0]));
+#endif
+        case SYS_faccessat:
+            return Report("faccessat", task, ES_EVENT_TYPE_NOTIFY_ACCESS, ResolvePath(task, ARG_FD(0), data.args[1]));
+#ifdef SYS_faccessat2
+        case SYS_faccessat2:
+            return Report("faccessat2", task, ES_EVENT_TYPE_NOTIFY_ACCESS,
+                ResolvePath(task, ARG_FD(0), data.args[1], NOFOLLOW_IF(ARG_FLAGS(3), AT_SYMLINK_NOFOLLOW), ARG_FLAGS(3) & AT_EMPTY_PATH));
+#endif
+#ifdef SYS_readlink
+        case SYS_readlink:
+            return Report("readlink", task, ES_EVENT_TYPE_NOTIFY_READLINK, ResolvePath(task, AT_FDCWD, data.args[0], O_NOFOLLOW));
+#endif
+        case SYS_readlinkat:
+            return Report("readlinkat", task, ES_EVENT_TYPE_NOTIFY_READLINK, ResolvePath(task, ARG_FD(0), data.args[1], O_NOFOLLOW));
+        case SYS_truncate:
+            return Report("truncate", task, ES_EVENT_TYPE_NOTIFY_WRITE, ResolvePath(task, AT_FDCWD, data.args[0]));
+#ifdef SYS_mkdir
+        case SYS_mkdir:
+            return Report("mkdir", task, ES_EVENT_TYPE_NOTIFY_CREATE, ResolvePath(task, AT_FDCWD, data.args[0]), "", S_IFDIR);
+#endif
+        case SYS_mkdirat:
+            return Report("mkdirat", task, ES_EVENT_TYPE_NOTIFY_CREATE, ResolvePath(task, ARG_FD(0), data.args[1]), "", S_IFDIR);
+#ifdef SYS_mknod
+        case SYS_mknod:
+            return Report("mknod", task, ES_EVENT_TYPE_NOTIFY_CREATE, ResolvePath(task, AT_FDCWD, data.args[0]), "", S_IFREG);
+#endif
+        case SYS_mknodat:
+            return Report("mknodat", task, ES_EVENT_TYPE_NOTIFY_CREATE, ResolvePath(task, ARG_FD(0), data.args[1]), "", S_IFREG);
+#ifdef SYS_rmdir
+        case SYS_rmdir:
+            return Report("rmdir", task, ES_EVENT_TYPE_NOTIFY_UNLINK, ResolvePath(task, AT_FDCWD, data.args[0]));
+#endif
+#ifdef SYS_unlink
+        case SYS_unlink:
+            return Report("unlink", task, ES_EVENT_TYPE_NOTIFY_UNLINK, ResolvePath(task, AT_FDCWD, data.args[0], O_NOFOLLOW));
+#endif
+        case SYS_unlinkat:
+            return Report("unlinkat", task, ES_EVENT_TYPE_NOTIFY_UNLINK,
+                ResolvePath(task, ARG_FD(0), data.args[1], (ARG_FLAGS(2) & AT_REMOVEDIR) ? 0 : O_NOFOLLOW));
+#ifdef SYS_rename
+        case SYS_rename:
+            return Report("rename", task, ES_EVENT_TYPE_NOTIFY_RENAME,
+                ResolvePath(task, AT_FDCWD, data.args[0], O_NOFOLLOW), ResolvePath(task, AT_FDCWD, data.args[1], O_NOFOLLOW));
+#endif
+#ifdef SYS_renameat
+        case SYS_renameat:
+#endif
+#ifdef SYS_renameat2
+        case SYS_renameat2:
+#endif
+            return Report("renameat", task, ES_EVENT_TYPE_NOTIFY_RENAME,
+                ResolvePath(task, ARG_FD(0), data.args[1], O_NOFOLLOW), ResolvePath(task, ARG_FD(2), data.args[3], O_NOFOLLOW));
+#ifdef SYS_link
+        case SYS_link:
+            return Report("link", task, ES_EVENT_TYPE_NOTIFY_LINK,
+                ResolvePath(task, AT_FDCWD, data.args[0], O_NOFOLLOW), ResolvePath(task, AT_FDCWD, data.args[1], O_NOFOLLOW));
+#endif
+        case SYS_linkat:
+            return Report("linkat", task, ES_EVENT_TYPE_NOTIFY_LINK,
+                ResolvePath(task, ARG_FD(0), data.args[1], O_NOFOLLOW), ResolvePath(task, ARG_FD(2), data.args[3], O_NOFOLLOW));
+#ifdef SYS_symlink
+        case SYS_symlink:
+            return Report("symlink", task, ES_EVENT_TYPE_NOTIFY_CREATE, ResolvePath(task, AT_FDCWD, data.args[1], O_NOFOLLOW), "", S_IFLNK);
+#endif
+        case SYS_symlinkat:
+            return Report("symlinkat", task, ES_EVENT_TYPE_NOTIFY_CREATE, ResolvePath(task, ARG_FD(1), data.args[2], O_NOFOLLOW), "", S_IFLNK);
+#ifdef SYS_chmod
+        case SYS_chmod:
+            return Report("chmod", task, ES_EVENT_TYPE_NOTIFY_SETMODE, ResolvePath(task, AT_FDCWD, data.args[0]));
+#endif
+        case SYS_fchmodat:
+            return Report("fchmodat", task, ES_EVENT_TYPE_NOTIFY_SETMODE, ResolvePath(task, ARG_FD(0), data.args[1]));
+#ifdef SYS_chown
+        case SYS_chown:
+            return Report("chown", task, ES_EVENT_TYPE_AUTH_SETOWNER, ResolvePath(task, AT_FDCWD, data.args[0]));
+#endif
+#ifdef SYS_lchown
+        case SYS_lchown:
+            return Report("lchown", task, ES_EVENT_TYPE_AUTH_SETOWNER, ResolvePath(task, AT_FDCWD, data.args[0], O_NOFOLLOW));
+#endif
+        case SYS_fchownat:
+            return Report("fchownat", task, ES_EVENT_TYPE_AUTH_SETOWNER,
+                ResolvePath(task, ARG_FD(0), data.args[1], NOFOLLOW_IF(ARG_FLAGS(4), AT_SYMLINK_NOFOLLOW), ARG_FLAGS(4) & AT_EMPTY_PATH));
+#ifdef SYS_utime
+        case SYS_utime:
+            return Report("utime", task, ES_EVENT_TYPE_NOTIFY_SETTIME, ResolvePath(task, AT_FDCWD, data.args[0]));
+#endif
+#ifdef SYS_utimes
+        case SYS_utimes:
+            return Report("utimes", task, ES_EVENT_TYPE_NOTIFY_SETTIME, ResolvePath(task, AT_FDCWD, data.args[0]));
+#endif
+#ifdef SYS_futimesat
+        case SYS_futimesat:
+            return Report("futimesat", task, ES_EVENT_TYPE_NOTIFY_SETTIME, ResolvePath(task, ARG_FD(0), data.args[1]));
+#endif
+        case SYS_utimensat:
+            // a NULL path makes it operate on 'dirfd' itself (that's how futimens is implemented)
+            return Report("utimensat", task, ES_EVENT_TYPE_NOTIFY_SETTIME,
+                ResolvePath(task, ARG_FD(0), data.args[1], NOFOLLOW_IF(ARG_FLAGS(3), AT_SYMLINK_NOFOLLOW), /*emptyPathIsFd*/ true));
+        case SYS_execve:
+            return ReportExec("execve", task, ResolvePath(task, AT_FDCWD, data.args[0]));
+#ifdef SYS_execveat
+        case SYS_execveat:
+            return ReportExec("execveat", task,
+                ResolvePath(task, ARG_FD(0), data.args[1], NOFOLLOW_IF(ARG_FLAGS(4), AT_SYMLINK_NOFOLLOW), ARG_FLAGS(4) & AT_EMPTY_PATH));
+#endif
+        default:
+            return AccessCheckResult::Invalid();
+    }
+}
+
+void Supervisor::HandleNotification(struct seccomp_notif *req, struct seccomp_notif_resp *resp)
+{
+    memset(req, 0, reqSize_);
+    if (ioctl(listener_, SECCOMP_IOCTL_NOTIF_RECV, req) != 0)
+    {
+        // EINTR, or ENOENT if the task was killed before its notification was received
+        return;
+    }
+
+    sNotificationId = req->id;
+    std::shared_ptr<Task> task = GetTask(req->pid);
+    if (task != nullptr)
+    {
+        HandleSyscall(*task, req->data);
+    }
+
+    // let the kernel perform the syscall, whatever the result of the check (see Supervisor)
+    memset(resp, 0, respSize_);
+    resp->id = req->id;
+    resp->flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+
+    // fails with ENOENT if the task was killed in the meantime, which is fine
+    ioctl(listener_, SECCOMP_IOCTL_NOTIF_SEND, resp);
+}
+
+void Supervisor::HandleNotifications()
+{
+    struct seccomp_notif *req = (struct seccomp_notif *)calloc(1, reqSize_);
+    struct seccomp_notif_resp *resp = (struct seccomp_notif_resp *)calloc(1, respSize_);
+
+    struct pollfd pfd;
+    pfd.fd = listener_;
+    pfd.events = POLLIN;
+
+    while (!stopping_)
+    {
+        // (several threads may be woken up for the same notification: the ones that don't get it wait in
+        // SECCOMP_IOCTL_NOTIF_RECV for the next one, or until Run interrupts them)
+        pfd.revents = 0;
+        int numReady = poll(&pfd, 1, PROCESS_SWEEP_INTERVAL_MS);
+        if (numReady < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        if (numReady > 0 && (pfd.revents & POLLIN))
+        {
+            HandleNotification(req, resp);
+        }
+        else if (numReady > 0 && (pfd.revents & (POLLHUP | POLLERR)))
+        {
+            // no process uses the filter anymore (Linux 5.8+)
+            break;
+        }
+    }
+
+    free(req);
+    free(resp);
+    runningThreads_--;
+}
+
+static void interrupt_handler(int signum)
+{
+}
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int Supervisor::Run()
+{
+    // SIGUSR1 interrupts (without restarting them) the calls the threads handling notifications wait in
+    struct sigaction action = {0};
+    action.sa_handler = interrupt_handler;
+    sigaction(SIGUSR1, &action, NULL);
+
+    std::vector<std::thread> threads;
+    runningThreads_ = numThreads_;
+    for (int i = 0; i < numThreads_; i++)
+    {
+        threads.emplace_back([this] { HandleNotifications(); });
+    }
+
+    // only waits for the listener to hang up (POLLHUP and POLLERR are reported even though no event is requested)
+    struct pollfd pfd;
+    pfd.fd = listener_;
+    pfd.events = 0;
+
+    uint64_t lastSweep = now_ms();
+    while (true)
+    {
+        pfd.revents = 0;
+        int numReady = poll(&pfd, 1, PROCESS_SWEEP_INTERVAL_MS);
+        if (numReady < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        if (numReady > 0 && (pfd.revents & (POLLHUP | POLLERR)))
+        {
+            // no process uses the filter anymore (Linux 5.8+)
+            break;
+        }
+
+        ReapChildren();
+
+        if (now_ms() - lastSweep >= PROCESS_SWEEP_INTERVAL_MS)
+        {
+            ForgetExitedProcesses(/*all*/ false);
+            lastSweep = now_ms();
+
+            // older kernels never report POLLHUP, so there the tree is over once every process we know of is gone
+            std::lock_guard<std::mutex> lock(stateMtx_);
+            if (rootExitCode_ != -1 && processes_.empty())
+            {
+                break;
+            }
+        }
+    }
+
+    // a thread may (re)enter SECCOMP_IOCTL_NOTIF_RECV right after being interrupted, so keep interrupting them until they are done
+    stopping_ = true;
+    while (runningThreads_ > 0)
+    {
+        for (auto &thread : threads)
+        {
+            pthread_kill(thread.native_handle(), SIGUSR1);
+        }
+
+        usleep(1000);
+    }
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (rootExitCode_ == -1)
+    {
+        int status;
+        if (waitpid(rootPid_, &status, 0) == rootPid_)
+        {
+            rootExitCode_ = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+    }
+
+    ReapChildren();
+    ForgetExitedProcesses(/*all*/ true);
+    return rootExitCode_;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <program> [<args>...]\n", argv[0]);
+        return 2;
+    }
+
+    // This process is exec'd by the root process of the pip (so it keeps its pid) and reads the same environment
+    // variables libDetours.so does; it reports the accesses of the whole tree on behalf of the processes that made them.
+    BxlObserver *bxl = BxlObserver::GetInstance();
+
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+    {
+        fprintf(stderr, "bxl-seccomp: socketpair failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    // processes of the tree that get orphaned are reparented to this process, so that they can be reaped
+    // (a zombie still counts as a user of the filter)
+    prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0);
+
+    pid_t child = fork();
+    if (child == -1)
+    {
+        fprintf(stderr, "bxl-seccomp: fork failed: %s\n", strerror(errno));
+        return 1;
+    }
+
+    if (child == 0)
+    {
+        close(sockets[0]);
+        int listener = install_filter();
+        if (listener == -1 || !send_fd(sockets[1], listener))
+        {
+            fprintf(stderr, "bxl-seccomp: could not install the seccomp filter: %s\n", strerror(errno));
+            _exit(126);
+        }
+
+        close(listener);
+        close(sockets[1]);
+
+        // from here on, the supervisor sees every trapped syscall, starting with this exec
+        execvp(argv[1], &argv[1]);
+        fprintf(stderr, "bxl-seccomp: could not execute '%s': %s\n", argv[1], strerror(errno));
+        _exit(errno == ENOENT ? 127 : 126);
+    }
+
+    close(sockets[1]);
+    int listener = recv_fd(sockets[0]);
+    close(sockets[0]);
+
+    int exitCode;
+    if (listener == -1)
+    {
+        int status;
+        waitpid(child, &status, 0);
+        exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    else
+    {
+        Supervisor supervisor(bxl, listener, child);
+        exitCode = supervisor.Run();
+        close(listener);
+    }
+
+    // this is the last process of the tree to exit
+    bxl->report_process_exit("exit");
+    return exitCode;
+}
@@ -16,12 +16,14 @@
 #include <wchar.h>
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstring>
 #include <iostream>
 #include <istream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #define MAXPATHLEN PATH_MAX
 
@@ -1,11 +1,19 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT License.
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "utils.h"
 
 #define PATH_SEP_CHAR ':'
@@ -50,6 +58,34 @@ char** replace_KVP_in_envp(const char *const envp[], int env_num, int i, const c
     return newenvp;
 }
 
+/**
+ * Whether 'value' is one of the colon-separated values in 'values'.
+ */
+static bool contains_value(const char *values, const char *value)
+{
+    while (*values)
+    {
+        const char *next = skip_prefix(values, value);
+        if (next && (*next == '\0' || *next == PATH_SEP_CHAR))
+        {
+            return true;
+        }
+
+        // keep searching
+        if (next == NULL) next = values;
+        while (*next != '\0' && *next != PATH_SEP_CHAR) next++;
+
+        if (*next == '\0')
+        {
+            break;
+        }
+
+        values = next + 1;
+    }
+
+    return false;
+}
+
 const char* add_value_to_env(const char *src, const char *value_to_add, const char *envPrefix)
 {
     const char *pSrc = skip_prefix(src, envPrefix);
@@ -58,30 +94,11 @@ const char* add_value_to_env(const char *src, const char *value_to_add, const ch
         return src;
     }
 
-    while (*pSrc)
+    if (contains_value(pSrc, value_to_add))
     {
-        const char *next = skip_prefix(pSrc, value_to_add);
-        if (next && (*next == '\0' || *next == PATH_SEP_CHAR))
-        {
-            // found a match --> return the original src
-            return src;
-        }
-        else
-        {
-            // keep searching
-            if (next == NULL) next = pSrc;
-            while (*next != '\0' && *next != PATH_SEP_CHAR) next++;
-
-            if (*next == '\0')
-            {
-                break;
-            }
-            else
-            {
-                pSrc = next + 1;
-            }
-        }
-    }   
+        // found a match --> return the original src
+        return src;
+    }
 
     // no match
     int srcLen = strlen(src);
@@ -301,6 +318,402 @@ bool is_null_or_empty(const char *input)
     return !input || *input == '\0';
 }
 
+// SHA-256 (FIPS 180-4), the building block of the VSO hash below
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t used;
+} sha256_ctx;
+
+static const uint32_t SHA256_K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t sha256_rotr(uint32_t x, int r)
+{
+    return (x >> r) | (x << (32 - r));
+}
+
+static void sha256_compress(uint32_t state[8], const unsigned char *block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = sha256_rotr(w[i - 15], 7) ^ sha256_rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = sha256_rotr(w[i - 2], 17) ^ sha256_rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = h + (sha256_rotr(e, 6) ^ sha256_rotr(e, 11) ^ sha256_rotr(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (sha256_rotr(a, 2) ^ sha256_rotr(a, 13) ^ sha256_rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static void sha256_init(sha256_ctx *ctx)
+{
+    static const uint32_t initial[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256_update(sha256_ctx *ctx, const void *buf, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+    ctx->length += len;
+
+    if (ctx->used > 0)
+    {
+        size_t n = len < 64 - ctx->used ? len : 64 - ctx->used;
+        memcpy(ctx->block + ctx->used, p, n);
+        ctx->used += n;
+        p += n;
+        len -= n;
+        if (ctx->used < 64)
+        {
+            return;
+        }
+
+        sha256_compress(ctx->state, ctx->block);
+        ctx->used = 0;
+    }
+
+    for (; len >= 64; p += 64, len -= 64)
+    {
+        sha256_compress(ctx->state, p);
+    }
+
+    memcpy(ctx->block, p, len);
+    ctx->used = len;
+}
+
+static void sha256_final(sha256_ctx *ctx, unsigned char hash[32])
+{
+    uint64_t bits = ctx->length * 8;
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > 56)
+    {
+        memset(ctx->block + ctx->used, 0, 64 - ctx->used);
+        sha256_compress(ctx->state, ctx->block);
+        ctx->used = 0;
+    }
+
+    memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+    for (int i = 0; i < 8; i++)
+    {
+        ctx->block[56 + i] = (unsigned char)(bits >> (56 - 8 * i));
+    }
+
+    sha256_compress(ctx->state, ctx->block);
+    for (int i = 0; i < 8; i++)
+    {
+        hash[4 * i]     = (unsigned char)(ctx->state[i] >> 24);
+        hash[4 * i + 1] = (unsigned char)(ctx->state[i] >> 16);
+        hash[4 * i + 2] = (unsigned char)(ctx->state[i] >> 8);
+        hash[4 * i + 3] = (unsigned char)(ctx->state[i]);
+    }
+}
+
+static void sha256(const void *buf, size_t len, unsigned char hash[32])
+{
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, buf, len);
+    sha256_final(&ctx, hash);
+}
+
+// CODESYNC: Public/Src/Cache/ContentStore/Hashing/VsoHash.cs
+#define VSO_PAGE_SIZE       (64 * 1024)
+#define VSO_PAGES_PER_BLOCK 32
+#define VSO_BLOCK_SIZE      (VSO_PAGES_PER_BLOCK * VSO_PAGE_SIZE)
+
+void hash_content_vso0(const void *buf, size_t len, unsigned char hash[32])
+{
+    static const char seed[] = "VSO Content Identifier Seed";
+    const unsigned char *p = (const unsigned char *)buf;
+    unsigned char pageHashes[VSO_PAGES_PER_BLOCK * 32];
+    unsigned char blockHash[32];
+    size_t offset = 0;
+
+    // the content identifier rolls over the hashes of its 2MB blocks, each of which is the hash of the hashes of its
+    // 64KB pages; empty content is a single empty block
+    do
+    {
+        size_t blockLength = len - offset < VSO_BLOCK_SIZE ? len - offset : VSO_BLOCK_SIZE;
+        size_t numPages = 0;
+        for (size_t page = 0; page < blockLength; page += VSO_PAGE_SIZE)
+        {
+            size_t pageLength = blockLength - page < VSO_PAGE_SIZE ? blockLength - page : VSO_PAGE_SIZE;
+            sha256(p + offset + page, pageLength, pageHashes + 32 * numPages++);
+        }
+
+        sha256(pageHashes, 32 * numPages, blockHash);
+
+        unsigned char isFinalBlock = offset + blockLength == len;
+        sha256_ctx ctx;
+        sha256_init(&ctx);
+        if (offset == 0)
+        {
+            sha256_update(&ctx, seed, sizeof(seed) - 1);
+        }
+        else
+        {
+            sha256_update(&ctx, hash, 32);
+        }
+
+        sha256_update(&ctx, blockHash, sizeof(blockHash));
+        sha256_update(&ctx, &isFinalBlock, 1);
+        sha256_final(&ctx, hash);
+
+        offset += blockLength;
+    } while (offset < len);
+}
+
+uint64_t monotonic_time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Parses the decimal number that starts at '*pos' and ends right before 'delimiter', and moves '*pos' past that
+ * delimiter.  Returns false if there is no such number (or it does not fit in 64 bits).
+ */
+static bool parse_field(const char **pos, const char *end, char delimiter, uint64_t *value)
+{
+    const char *p = *pos;
+    uint64_t result = 0;
+    if (p == end || *p == delimiter)
+    {
+        return false;
+    }
+
+    for (; p < end && *p != delimiter; p++)
+    {
+        unsigned digit = (unsigned char)*p - '0';
+        if (digit > 9 || result > (UINT64_MAX - digit) / 10)
+        {
+            return false;
+        }
+
+        result = result * 10 + digit;
+    }
+
+    if (p == end)
+    {
+        return false;
+    }
+
+    *pos = p + 1;
+    *value = result;
+    return true;
+}
+
+/**
+ * Parses a single message (without its length prefix) into 'report', copying its path and digest to 'arena'.
+ * CODESYNC: BxlObserver::SendReport in bxl_observer.cpp
+ */
+static bool parse_report(const char *message, int length, parsed_report *report, char *arena, int arena_used)
+{
+    const char *end = message + length;
+    while (end > message && *(end - 1) == '\n') end--;
+
+    // the name of the program is not reported
+    const char *pos = memchr(message, '|', end - message);
+    if (pos == NULL)
+    {
+        return false;
+    }
+
+    pos++;
+    uint64_t fields[8];
+    for (int i = 0; i < 8; i++)
+    {
+        if (!parse_field(&pos, end, '|', &fields[i]) || (i < 6 && fields[i] > UINT32_MAX))
+        {
+            return false;
+        }
+    }
+
+    const char *path = pos;
+    const char *pathEnd = memchr(path, '|', end - path);
+    const char *digest = pathEnd != NULL ? pathEnd + 1 : NULL;
+    if (pathEnd == NULL)
+    {
+        pathEnd = end;
+    }
+    else if (memchr(digest, '|', end - digest) != NULL)
+    {
+        return false;
+    }
+
+    report->pid               = (uint32_t)fields[0];
+    report->requested_access  = (uint32_t)fields[1];
+    report->status            = (uint32_t)fields[2];
+    report->report_explicitly = (uint32_t)fields[3];
+    report->error             = (uint32_t)fields[4];
+    report->operation         = (uint32_t)fields[5];
+    report->creation_time     = fields[6];
+    report->enqueue_time      = fields[7];
+    report->flags             = 0;
+    report->reserved          = 0;
+
+    report->path_offset = arena_used;
+    report->path_length = (int32_t)(pathEnd - path);
+    memcpy(arena + arena_used, path, pathEnd - path);
+
+    report->digest_offset = report->path_offset + report->path_length;
+    report->digest_length = 0;
+    if (digest != NULL)
+    {
+        report->flags |= PARSED_REPORT_HAS_DIGEST;
+        report->digest_length = (int32_t)(end - digest);
+        memcpy(arena + report->digest_offset, digest, end - digest);
+    }
+
+    return true;
+}
+
+/**
+ * Parses an announcement of spilled reports (without its length prefix) into 'report', copying the path of the spill
+ * file to 'arena'.
+ * CODESYNC: ReportWriter::AnnounceLocked in bxl_reports.hpp
+ */
+static bool parse_spill_announcement(const char *message, int length, parsed_report *report, char *arena, int arena_used)
+{
+    const char *end = message + length;
+    while (end > message && *(end - 1) == '\n') end--;
+
+    const char *pos = message;
+    uint64_t fields[3];
+    for (int i = 0; i < 3; i++)
+    {
+        if (!parse_field(&pos, end, '|', &fields[i]) || (i == 0 && fields[i] > UINT32_MAX))
+        {
+            return false;
+        }
+    }
+
+    if (pos == end)
+    {
+        return false;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->pid           = (uint32_t)fields[0];
+    report->creation_time = fields[1];
+    report->enqueue_time  = fields[2];
+    report->flags         = PARSED_REPORT_SPILL;
+
+    report->path_offset = arena_used;
+    report->path_length = (int32_t)(end - pos);
+    report->digest_offset = report->path_offset + report->path_length;
+    memcpy(arena + arena_used, pos, end - pos);
+    return true;
+}
+
+/**
+ * Parses the statistics of a process (without their length prefix) into 'report', copying the statistics to 'arena'.
+ * CODESYNC: BxlObserver::SendStatistics in bxl_observer.cpp
+ */
+static bool parse_statistics(const char *message, int length, parsed_report *report, char *arena, int arena_used)
+{
+    const char *end = message + length;
+    while (end > message && *(end - 1) == '\n') end--;
+
+    const char *pos = message;
+    uint64_t pid;
+    if (!parse_field(&pos, end, '|', &pid) || pid > UINT32_MAX || pos == end)
+    {
+        return false;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->pid   = (uint32_t)pid;
+    report->flags = PARSED_REPORT_STATISTICS;
+
+    report->path_offset = arena_used;
+    report->path_length = (int32_t)(end - pos);
+    report->digest_offset = report->path_offset + report->path_length;
+    memcpy(arena + arena_used, pos, end - pos);
+    return true;
+}
+
+int parse_reports(const char *buf, int offset, int len, parsed_report *reports, int max_reports,
+                  char *arena, int arena_size, int *num_reports, int *arena_used)
+{
+    // CODESYNC: BxlObserver::SendReport (a uint length followed by the message itself), BxlObserver::SendStatistics
+    // and ReportWriter::AnnounceLocked
+    const char *pos = buf + offset;
+    const char *end = pos + len;
+    int count = 0;
+    int used = 0;
+
+    while (count < max_reports && end - pos >= (int)sizeof(uint32_t))
+    {
+        uint32_t length;
+        memcpy(&length, pos, sizeof(length));
+        uint32_t kind = length & REPORTS_MESSAGE_KIND_MASK;
+        length &= ~REPORTS_MESSAGE_KIND_MASK;
+        if ((uint64_t)(end - pos) < sizeof(length) + (uint64_t)length || (uint64_t)used + length > (uint64_t)arena_size)
+        {
+            break;
+        }
+
+        const char *message = pos + sizeof(length);
+        parsed_report *report = &reports[count];
+        bool parsed = kind == REPORTS_SPILL_ANNOUNCEMENT ? parse_spill_announcement(message, (int)length, report, arena, used)
+                    : kind == REPORTS_STATISTICS         ? parse_statistics(message, (int)length, report, arena, used)
+                    : kind == 0                          ? parse_report(message, (int)length, report, arena, used)
+                    : false;
+        if (!parsed)
+        {
+            memset(report, 0, sizeof(*report));
+            report->flags = PARSED_REPORT_MALFORMED;
+            report->path_offset = used;
+            report->path_length = (int32_t)length;
+            report->digest_offset = used + (int32_t)length;
+            memcpy(arena + used, message, length);
+        }
+
+        used += report->path_length + report->digest_length;
+        pos = message + length;
+        count++;
+    }
+
+    *num_reports = count;
+    *arena_used = used;
+    return (int)(pos - (buf + offset));
+}
+
 void copy_result_to_buf_for_test(char **result, char *buf)
 {
     while (result && *result)
@@ -410,6 +823,133 @@ char** remove_path_from_LDPRELOAD(const char *const envp[], const char *path)
     return (char**)envp;
 }
 
+/**
+ * Returns the index of the variable from 'block' that 'env' is a value of, or -1 if there is none.
+ */
+static int find_in_env_block(const char *const block[], const size_t nameLen[], int blockNum, const char *env)
+{
+    for (int i = 0; i < blockNum; i++)
+    {
+        if (strncmp(env, block[i], nameLen[i]) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+char** merge_env_block(const char *const envp[], const char *const block[], const char *ldPreloadPath, bool removeFromLdPreload)
+{
+    size_t nameLen[MAX_ENV_BLOCK_SIZE];
+    bool found[MAX_ENV_BLOCK_SIZE];
+    int blockNum = 0;
+    while (block && block[blockNum] && blockNum < MAX_ENV_BLOCK_SIZE)
+    {
+        const char *eq = strchr(block[blockNum], '=');
+        nameLen[blockNum] = eq ? eq - block[blockNum] + 1 : strlen(block[blockNum]);
+        found[blockNum] = false;
+        ++blockNum;
+    }
+
+    // A single pass over 'envp' counts its entries, finds LD_PRELOAD and
+    // checks which variables from 'block' are either missing or different.
+    bool changed = false;
+    int envNum = 0;
+    const char *ldPreload = NULL;
+    while (envp && envp[envNum])
+    {
+        const char *env = envp[envNum++];
+        if (ldPreload == NULL && skip_prefix(env, LD_PRELOAD_ENV_VAR_PREFIX))
+        {
+            ldPreload = env;
+            continue;
+        }
+
+        int i = find_in_env_block(block, nameLen, blockNum, env);
+        if (i >= 0)
+        {
+            found[i] = true;
+            changed = changed || strcmp(env, block[i]) != 0;
+        }
+    }
+
+    int missingNum = 0;
+    for (int i = 0; i < blockNum; i++)
+    {
+        if (!found[i]) ++missingNum;
+    }
+
+    // Size (including the terminating '\0') of the new LD_PRELOAD variable, or 0 if it stays as it is.
+    size_t ldPreloadSize = 0;
+    if (!is_null_or_empty(ldPreloadPath))
+    {
+        bool included = ldPreload != NULL && contains_value(ldPreload + LD_PRELOAD_ENV_VAR_PREFIX_LENGTH, ldPreloadPath);
+        if (removeFromLdPreload && included)
+        {
+            ldPreloadSize = strlen(ldPreload) + 1;
+        }
+        else if (!removeFromLdPreload && !included)
+        {
+            ldPreloadSize = (ldPreload ? strlen(ldPreload) : LD_PRELOAD_ENV_VAR_PREFIX_LENGTH) + 1 + strlen(ldPreloadPath) + 1;
+        }
+    }
+
+    if (!changed && missingNum == 0 && ldPreloadSize == 0)
+    {
+        return (char**)envp;
+    }
+
+    // The new array and the new LD_PRELOAD variable (if any) share a single allocation.
+    int newNum = envNum + missingNum + (ldPreload == NULL && ldPreloadSize > 0 ? 1 : 0);
+    char **newenvp = (char **)malloc((newNum + 1) * sizeof(char*) + ldPreloadSize);
+    if (newenvp == NULL)
+    {
+        return (char**)envp;
+    }
+
+    char *newLdPreload = NULL;
+    if (ldPreloadSize > 0)
+    {
+        newLdPreload = (char *)(newenvp + newNum + 1);
+        if (removeFromLdPreload)
+        {
+            scrub_ld_preload(ldPreload, ldPreloadPath, newLdPreload);
+        }
+        else
+        {
+            strcpy(newLdPreload, ldPreload ? ldPreload : LD_PRELOAD_ENV_VAR_PREFIX);
+            char *pEnd = newLdPreload + strlen(newLdPreload);
+            if (*(pEnd - 1) != PATH_SEP_CHAR && *(pEnd - 1) != '=')
+            {
+                *pEnd++ = PATH_SEP_CHAR;
+            }
+            strcpy(pEnd, ldPreloadPath);
+        }
+    }
+
+    int n = 0;
+    for (int e = 0; e < envNum; e++)
+    {
+        const char *env = envp[e];
+        int i = env == ldPreload ? -1 : find_in_env_block(block, nameLen, blockNum, env);
+        newenvp[n++] = (char *)(i >= 0 ? block[i] : (env == ldPreload && newLdPreload ? newLdPreload : env));
+    }
+
+    for (int i = 0; i < blockNum; i++)
+    {
+        if (!found[i]) newenvp[n++] = (char *)block[i];
+    }
+
+    if (ldPreload == NULL && newLdPreload != NULL)
+    {
+        newenvp[n++] = newLdPreload;
+    }
+
+    newenvp[n] = NULL; // Last element of envp[] should be a null pointer.
+    return newenvp;
+}
+
 // ======================= for testing ========================
 
 const bool add_value_to_env_for_test(const char *src, const char *value_to_add, const char *envPrefix, char *buf)
@@ -451,6 +991,13 @@ const bool remove_path_from_LDPRELOAD_for_test(const char *const envp[], char *p
     return result == (char**)envp;
 }
 
+const bool merge_env_block_for_test(const char *const envp[], const char *const block[], const char *ldPreloadPath, bool removeFromLdPreload, char *buf)
+{
+    char **result = merge_env_block(envp, block, ldPreloadPath, removeFromLdPreload);
+    copy_result_to_buf_for_test(result, buf);
+    return result == (char**)envp;
+}
+
 const void scrub_ld_preload_for_test(const char *src, const char *value_to_scrub, char *buf)
 {
     const char *result = scrub_ld_preload(src, value_to_scrub, buf);
@@ -459,3 +1006,59 @@ const void scrub_ld_preload_for_test(const char *src, const char *value_to_scrub
         strcpy(buf, src);
     }
 }
+
+static int clone_thread_for_test(void *arg)
+{
+    // returning makes the clone wrapper of glibc exit just this thread
+    return 0;
+}
+
+static int clone_process_for_test(void *arg)
+{
+    // '_exit' (rather than returning, which exits with a raw system call) lets the sandbox report the exit of this process
+    _exit(0);
+}
+
+const int clone_threads_and_process_for_test(int count)
+{
+    // the flags pthread_create uses, except for setting up thread-local storage, which the threads created here don't use
+    const int threadFlags = CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM | CLONE_CHILD_CLEARTID;
+    const size_t stackSize = 64 * 1024;
+
+    char *stack = (char *)malloc(stackSize);
+    if (stack == NULL)
+    {
+        return ENOMEM;
+    }
+
+    // Because of CLONE_CHILD_CLEARTID the kernel zeroes 'tid' when a thread exits, after which
+    // its stack can be reused by the next thread.
+    volatile pid_t tid;
+    int error = 0;
+    for (int i = 0; i < count && error == 0; i++)
+    {
+        tid = -1;
+        if (clone(clone_thread_for_test, stack + stackSize, threadFlags, NULL, NULL, NULL, (pid_t *)&tid) == -1)
+        {
+            error = errno;
+            break;
+        }
+
+        while (tid != 0)
+        {
+            sched_yield();
+        }
+    }
+
+    if (error == 0)
+    {
+        pid_t pid = clone(clone_process_for_test, stack + stackSize, SIGCHLD, NULL);
+        if (pid == -1 || waitpid(pid, NULL, 0) == -1)
+        {
+            error = errno;
+        }
+    }
+
+    free(stack);
+    return error;
+}
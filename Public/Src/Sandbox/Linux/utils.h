@@ -1,6 +1,8 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT License.
 
+#pragma once
+
 #ifdef __cplusplus
 #define DLL_EXPORT extern "C"
 #else
@@ -85,11 +87,135 @@ DLL_EXPORT const char* scrub_ld_preload(const char *src, const char *value_to_sc
  */
 DLL_EXPORT char** remove_path_from_LDPRELOAD(const char *const envp[], const char *path);
 
+/**
+ * Maximum number of variables 'merge_env_block' accepts in a block (the rest are ignored).
+ */
+#define MAX_ENV_BLOCK_SIZE 16
+
+/**
+ * Merges the "NAME=value" strings in 'block' (a NULL-terminated array) into 'envp':
+ *   - every variable of 'envp' named in 'block' gets the value it has in 'block',
+ *   - the variables from 'block' that are not in 'envp' are appended to it, and
+ *   - when 'ldPreloadPath' is not empty, it is added to (or, if 'removeFromLdPreload', removed from)
+ *     the colon-separated values of "LD_PRELOAD" (which must not be in 'block').
+ *
+ * 'envp' is inspected in a single pass.  If nothing needs to change, 'envp' is returned.  Otherwise a new
+ * array of 'char*' pointers is returned; that array and the new "LD_PRELOAD" value (if any) are allocated
+ * in a single block, while the strings from 'envp' and 'block' are referenced rather than copied.
+ *
+ * Whenever the returned pointer is different from 'envp', the caller is responsible for freeing it.
+ */
+DLL_EXPORT char** merge_env_block(const char *const envp[], const char *const block[], const char *ldPreloadPath, bool removeFromLdPreload);
+
+/**
+ * Computes the VSO hash (HashType.Vso0, the default content hash of the engine) of 'len' bytes starting at 'buf':
+ * the 32 bytes of its algorithm result (i.e., without the trailing algorithm id) are written to 'hash'.
+ *
+ * Used by the sandbox to hash the content of output files when they are closed
+ * (see FileAccessPolicy_ReportContentHashOnClose), so that the engine does not have to hash them again.
+ */
+DLL_EXPORT void hash_content_vso0(const void *buf, size_t len, unsigned char hash[32]);
+
+/**
+ * Returns the current time of CLOCK_MONOTONIC, in nanoseconds.
+ *
+ * The sandbox stamps the creation and enqueue times of access reports (see AccessReportStatistics) with this
+ * clock, which is shared by all processes; the engine stamps the dequeue time with it too, so that the time
+ * a report took to get from the sandbox to the engine can be measured.
+ */
+DLL_EXPORT uint64_t monotonic_time_ns();
+
+/**
+ * A report parsed by 'parse_reports': the numeric fields of a message written by BxlObserver::SendReport, and where
+ * its path (and digest, if any) were copied to in the arena passed to 'parse_reports'.
+ *
+ * CODESYNC: Public/Src/Engine/Processes/SandboxConnectionLinuxDetours.cs (ParsedReport)
+ */
+typedef struct
+{
+    uint32_t pid;
+    uint32_t requested_access;
+    uint32_t status;
+    uint32_t report_explicitly;
+    uint32_t error;
+    uint32_t operation;
+    uint64_t creation_time;
+    uint64_t enqueue_time;
+    int32_t path_offset;
+    int32_t path_length;
+    int32_t digest_offset;
+    int32_t digest_length;
+    uint32_t flags;
+    uint32_t reserved;
+} parsed_report;
+
+/** The message has a trailing digest (see BxlObserver::SendReport). */
+#define PARSED_REPORT_HAS_DIGEST 0x1
+
+/** The message could not be parsed; its whole text is where the path would be. */
+#define PARSED_REPORT_MALFORMED  0x2
+
+/**
+ * The message announces reports that were spilled to a file (see REPORTS_SPILL_ANNOUNCEMENT): the path is the one of
+ * that file, and 'creation_time' and 'enqueue_time' are the offset and the length of the reports in it.
+ */
+#define PARSED_REPORT_SPILL      0x4
+
+/**
+ * The message carries the statistics of a process (see REPORTS_STATISTICS): only 'pid' is set, and the statistics
+ * are where the path would be.
+ */
+#define PARSED_REPORT_STATISTICS 0x8
+
+/**
+ * Set in the length prefix of a message that announces reports spilled to a file rather than written to the FIFO
+ * (see ReportWriter in bxl_reports.hpp).  The message is "<pid>|<offset>|<length>|<path>\n": the reports are the
+ * 'length' bytes at 'offset' in the file at 'path', length-prefixed as they would have been in the FIFO.
+ */
+#define REPORTS_SPILL_ANNOUNCEMENT 0x80000000u
+
+/**
+ * Set in the length prefix of a message that carries the statistics of a sandboxed process (see BxlObserver::SendStatistics)
+ * rather than an access.  The message is "<pid>|<statistics>\n", where the statistics are as SandboxStats::Format writes
+ * them; a process sends it once, right before its exit report, when the manifest asks for statistics.
+ */
+#define REPORTS_STATISTICS 0x40000000u
+
+/** The bits of a length prefix that tell what kind of message follows rather than how long it is. */
+#define REPORTS_MESSAGE_KIND_MASK (REPORTS_SPILL_ANNOUNCEMENT | REPORTS_STATISTICS)
+
+/**
+ * Parses the length-prefixed messages BxlObserver::SendReport writes to the reports FIFO, starting at 'buf + offset'
+ * and going on for at most 'len' bytes, so that a whole buffer read from the FIFO is handled with a single call.
+ *
+ * Every complete message gets a 'parsed_report' in 'reports'; its path and digest are copied (not 0-terminated) into
+ * 'arena', which is 'arena_size' bytes long.  Parsing stops at the first message that is incomplete, or once
+ * 'max_reports' reports were parsed, or when the arena cannot hold the next message.  '*num_reports' and '*arena_used'
+ * are set to how many reports and arena bytes were used.  An announcement of spilled reports gets a 'parsed_report'
+ * flagged with PARSED_REPORT_SPILL; the caller parses the reports it announces with another call.  The statistics of
+ * a process get one flagged with PARSED_REPORT_STATISTICS.
+ *
+ * Returns how many bytes (from 'buf + offset') were consumed; the rest, if any, is the beginning of a message the
+ * caller must pass again, followed by what it reads next.  An arena of PIPE_BUF bytes always fits a message.
+ */
+DLL_EXPORT int parse_reports(const char *buf, int offset, int len, parsed_report *reports, int max_reports,
+                             char *arena, int arena_size, int *num_reports, int *arena_used);
+
 // Test wrappers to make p-invoke easier.
 
 DLL_EXPORT const bool add_value_to_env_for_test(const char *src, const char *value_to_add, const char *envPrefix, char *buf);
 DLL_EXPORT const bool ensure_env_value_for_test(const char *const envp[], char const *envName, const char *envValue, char *buf);
 DLL_EXPORT const bool ensure_2_paths_included_in_env_for_test(const char *const envp[], char const *envPrefix, const char *path0, const char *path1, char *buf);
 DLL_EXPORT const bool ensure_1_path_included_in_env_for_test(const char *const envp[], char const *envPrefix, const char *path, char *buf);
+DLL_EXPORT const bool merge_env_block_for_test(const char *const envp[], const char *const block[], const char *ldPreloadPath, bool removeFromLdPreload, char *buf);
 DLL_EXPORT const void scrub_ld_preload_for_test(const char *src, const char *value_to_scrub, char *buf);
-DLL_EXPORT const bool remove_path_from_LDPRELOAD_for_test(const char *const envp[], char *path, char *buf0, char *buf1, char *buf2);
\ No newline at end of file
+DLL_EXPORT const bool remove_path_from_LDPRELOAD_for_test(const char *const envp[], char *path, char *buf0, char *buf1, char *buf2);
+
+/**
+ * Creates 'count' threads, one at a time, and then a child process, all by calling 'clone'; waits for all of them to exit.
+ * Returns 0, or the errno of the first call that failed.
+ *
+ * Unlike a p-invoke of 'clone' (which binds to libc directly), the calls made from this library go through the interposed
+ * 'clone' when the sandbox is preloaded into the calling process.
+ */
+DLL_EXPORT const int clone_threads_and_process_for_test(int count);
\ No newline at end of file
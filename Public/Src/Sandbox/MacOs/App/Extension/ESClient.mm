@@ -71,15 +71,11 @@ ESClient::ESClient(dispatch_queue_t event_queue, pid_t host_pid, xpc_endpoint_t
         }
 
         IOEvent event(message);
-        size_t msg_length = IOEvent::max_size();
-        char msg[msg_length];
-
-        omemorystream oms(msg, sizeof(msg));
-        oms << event;
+        char msg[IOEvent::max_size()];
+        size_t msg_length = event.Serialize(msg, sizeof(msg));
 
         xpc_object_t xpc_payload = xpc_dictionary_create(NULL, NULL, 0);
-        xpc_dictionary_set_string(xpc_payload, IOEventKey, msg);
-        xpc_dictionary_set_uint64(xpc_payload, IOEventLengthKey, event.Size());
+        xpc_dictionary_set_data(xpc_payload, IOEventKey, msg, msg_length);
 
         xpc_connection_send_message_with_reply(build_host_, xpc_payload, eventQueue_, ^(xpc_object_t response)
         {
@@ -132,15 +132,11 @@ inline void send_to_sandbox(IOEvent &event, es_event_type_t type = ES_EVENT_TYPE
         event.SetEventPath(dst_resolved, DST_PATH);
     }
 
-    size_t msg_length = IOEvent::max_size();
-    char msg[msg_length];
-
-    omemorystream oms(msg, sizeof(msg));
-    oms << event;
+    char msg[IOEvent::max_size()];
+    size_t msg_length = event.Serialize(msg, sizeof(msg));
 
     xpc_object_t xpc_payload = xpc_dictionary_create(NULL, NULL, 0);
-    xpc_dictionary_set_string(xpc_payload, IOEventKey, msg);
-    xpc_dictionary_set_uint64(xpc_payload, IOEventLengthKey, event.Size());
+    xpc_dictionary_set_data(xpc_payload, IOEventKey, msg, msg_length);
 
     xpc_object_t response = xpc_connection_send_message_with_reply_sync(bxl_connection, xpc_payload);
     xpc_type_t xpc_type = xpc_get_type(response);
@@ -15,6 +15,52 @@ typedef enum {
     GenericSandbox
 } ConnectionType;
 
+/*!
+ * A file access report as the handlers produce it: the header of 'AccessReport', and a view of the path the access
+ * was checked against (already normalized), instead of a copy of it in a MAXPATHLEN buffer.  The path only lives as
+ * long as the 'AccessReportViewCallback' call the report is passed to.
+ */
+struct AccessReportView
+{
+    FileOperation operation;
+    pid_t pid;
+    pid_t rootPid;
+    DWORD requestedAccess;
+    DWORD status;
+    uint reportExplicitly;
+    DWORD error;
+    pipid_t pipId;
+    AccessReportStatistics stats;
+    const char *path;
+    size_t pathLength;
+
+    /*!
+     * The fixed-size report the managed interop expects ('AccessReportCallback'); paths that do not fit are truncated.
+     */
+    AccessReport ToAccessReport() const
+    {
+        AccessReport report =
+        {
+            .operation          = operation,
+            .pid                = pid,
+            .rootPid            = rootPid,
+            .requestedAccess    = requestedAccess,
+            .status             = status,
+            .reportExplicitly   = reportExplicitly,
+            .error              = error,
+            .pipId              = pipId,
+            .path               = {0},
+            .stats              = stats
+        };
+
+        size_t length = pathLength < sizeof(report.path) ? pathLength : sizeof(report.path) - 1;
+        memcpy(report.path, path, length);
+        return report;
+    }
+};
+
+typedef void (*AccessReportViewCallback)(const AccessReportView &report, int status);
+
 extern "C"
 {
     void SetLogger(os_log_t newLogger);
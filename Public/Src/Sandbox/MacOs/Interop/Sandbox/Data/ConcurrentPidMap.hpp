@@ -0,0 +1,421 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef ConcurrentPidMap_hpp
+#define ConcurrentPidMap_hpp
+
+#include "Trie.hpp"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+/*!
+ * A dictionary from process ids to shared pointers, meant for looking up tracked processes.
+ *
+ * Entries live in a single open-addressing table (linear probing, power-of-two capacity), so a lookup costs one
+ * hash and, typically, one cache miss.  The API mirrors that of a uint 'Trie' (including its 'TrieResult' codes).
+ *
+ * Lookups ('get', 'forEach', and the lookup part of 'getOrAdd') are lock-free: they never wait for one another nor
+ * for a writer.  Mutations ('insert', 'replace', 'remove', and adding in 'getOrAdd') happen once or twice per process
+ * lifetime, so they are serialized by a spinlock; a writer that finds the table too full (removed entries leave
+ * tombstones behind) replaces it with a fresh one holding only the live entries.
+ *
+ * Memory is reclaimed without blocking readers: values and tables that a reader may still be looking at are
+ * retired rather than deleted, and deleted by a later writer once no lookup is in progress.
+ *
+ * Thread-safe.
+ */
+template <typename T>
+class ConcurrentPidMap final
+{
+public:
+
+    typedef void (*for_each_fn)(void *data, uint64_t key, const std::shared_ptr<T> value);
+
+private:
+
+    static constexpr int64_t kEmpty     = -1;
+    static constexpr int64_t kTombstone = -2;
+
+    static constexpr uint32_t kMinCapacity = 16;
+
+    typedef struct
+    {
+        /*! A key, kEmpty (never used, ends a probe sequence), or kTombstone (removed, does not end a probe sequence) */
+        std::atomic<int64_t> key;
+
+        /*! Heap-allocated, so that a reader can copy it while a writer swaps it out */
+        std::atomic<std::shared_ptr<T>*> value;
+    } Slot;
+
+    typedef struct
+    {
+        uint32_t capacity;
+        uint32_t mask;
+
+        /*! Number of slots that are not empty (i.e., live entries plus tombstones); only accessed by writers */
+        uint32_t used;
+        Slot *slots;
+    } Table;
+
+    std::atomic<Table*> table_;
+
+    /*! The number of live entries */
+    std::atomic<uint> size_;
+
+    /*! The number of lookups in progress; retired memory is only deleted when there are none */
+    std::atomic<int> readers_;
+
+    /*! The fork generation (see 'forkGeneration') in which a thread holds the writer lock, or 0 */
+    std::atomic<uint32_t> writer_;
+
+    /*! Memory no longer reachable from 'table_' that lookups in progress may still be using (only accessed by writers) */
+    std::vector<Table*> retiredTables_;
+    std::vector<std::shared_ptr<T>*> retiredValues_;
+
+    static inline uint32_t hash(uint64_t key, uint32_t mask)
+    {
+        // Fibonacci hashing: consecutive pids end up far apart
+        return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    }
+
+    static Table* createTable(uint32_t capacity)
+    {
+        Table *table = new Table;
+        table->capacity = capacity;
+        table->mask = capacity - 1;
+        table->used = 0;
+        table->slots = new Slot[capacity];
+        for (uint32_t i = 0; i < capacity; i++)
+        {
+            table->slots[i].key.store(kEmpty, std::memory_order_relaxed);
+            table->slots[i].value.store(nullptr, std::memory_order_relaxed);
+        }
+
+        return table;
+    }
+
+    static void deleteTable(Table *table)
+    {
+        delete[] table->slots;
+        delete table;
+    }
+
+    /*! Marks the calling thread as a reader for as long as it is in scope */
+    class ReadScope final
+    {
+        std::atomic<int> &readers_;
+    public:
+        ReadScope(std::atomic<int> &readers) : readers_(readers) { readers_++; }
+        ~ReadScope() { readers_--; }
+    };
+
+    /*!
+     * Identifies the copy of the address space a thread runs in: bumped in every child created by 'fork', so
+     * that a lock taken before the fork can be told apart from a lock taken by another thread of the same process
+     * (without calling getpid, which glibc does not cache).
+     */
+    static std::atomic<uint32_t>& forkGeneration()
+    {
+        static std::atomic<uint32_t> generation(1);
+        static int registered = pthread_atfork(nullptr, nullptr, []()
+        {
+            if (++generation == 0) generation = 1;
+        });
+        (void)registered;
+
+        return generation;
+    }
+
+    /*!
+     * Holds the writer lock for as long as it is in scope.
+     *
+     * A lock found held in an older fork generation can only have been inherited through 'fork' from a thread that
+     * no longer exists in this process, so it is taken over.
+     */
+    class WriteScope final
+    {
+        ConcurrentPidMap *map_;
+    public:
+        WriteScope(ConcurrentPidMap *map) : map_(map)
+        {
+            uint32_t self = forkGeneration().load(std::memory_order_relaxed);
+            uint32_t holder = 0;
+            while (!map_->writer_.compare_exchange_weak(holder, self))
+            {
+                if (holder != 0 && holder != self && map_->writer_.compare_exchange_strong(holder, self))
+                {
+                    break;
+                }
+
+                holder = 0;
+                sched_yield();
+            }
+        }
+
+        ~WriteScope()
+        {
+            map_->reclaim();
+            map_->writer_.store(0);
+        }
+    };
+
+    /*! Returns the slot holding 'key' in 'table' or nullptr; readers must check that the key did not change after reading the value. */
+    static Slot* find(Table *table, uint64_t key)
+    {
+        uint32_t idx = hash(key, table->mask);
+        for (uint32_t probes = 0; probes < table->capacity; probes++, idx = (idx + 1) & table->mask)
+        {
+            int64_t slotKey = table->slots[idx].key.load(std::memory_order_acquire);
+            if (slotKey == (int64_t)key)
+            {
+                return &table->slots[idx];
+            }
+
+            if (slotKey == kEmpty)
+            {
+                return nullptr;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /*! Lock-free lookup; must be called within a 'ReadScope' */
+    std::shared_ptr<T> lookup(uint64_t key)
+    {
+        while (true)
+        {
+            Slot *slot = find(table_.load(std::memory_order_acquire), key);
+            if (slot == nullptr)
+            {
+                return nullptr;
+            }
+
+            std::shared_ptr<T> *value = slot->value.load(std::memory_order_acquire);
+            std::shared_ptr<T> result = value != nullptr ? *value : nullptr;
+
+            // the slot may have been reused for another key in the meantime (see 'add'): look again
+            if (slot->key.load(std::memory_order_acquire) == (int64_t)key)
+            {
+                return result;
+            }
+        }
+    }
+
+    /*! Adds a new entry; must be called with the writer lock held, and only when 'key' is not in the map */
+    void add(uint64_t key, const std::shared_ptr<T> &value)
+    {
+        Table *table = table_.load(std::memory_order_relaxed);
+        if ((table->used + 1) * 4 > table->capacity * 3)
+        {
+            table = rehash(table);
+        }
+
+        uint32_t idx = hash(key, table->mask);
+        while (true)
+        {
+            int64_t slotKey = table->slots[idx].key.load(std::memory_order_relaxed);
+            if (slotKey == kEmpty || slotKey == kTombstone)
+            {
+                if (slotKey == kEmpty) table->used++;
+                break;
+            }
+
+            idx = (idx + 1) & table->mask;
+        }
+
+        // publish the value before the key, so that a reader that finds the key also finds its value
+        table->slots[idx].value.store(new std::shared_ptr<T>(value), std::memory_order_release);
+        table->slots[idx].key.store((int64_t)key, std::memory_order_release);
+        size_++;
+    }
+
+    /*! Replaces 'table' with a table holding only its live entries; must be called with the writer lock held */
+    Table* rehash(Table *table)
+    {
+        // grow when live entries would fill half of the table; otherwise the same capacity is enough to get rid of
+        // the tombstones (shrinking would only make a table that processes keep coming and going grow back)
+        uint32_t capacity = table->capacity;
+        while (capacity < (size_ + 1) * 2)
+        {
+            capacity <<= 1;
+        }
+
+        Table *newTable = createTable(capacity);
+        for (uint32_t i = 0; i < table->capacity; i++)
+        {
+            int64_t key = table->slots[i].key.load(std::memory_order_relaxed);
+            if (key < 0)
+            {
+                continue;
+            }
+
+            uint32_t idx = hash((uint64_t)key, newTable->mask);
+            while (newTable->slots[idx].key.load(std::memory_order_relaxed) != kEmpty)
+            {
+                idx = (idx + 1) & newTable->mask;
+            }
+
+            // the value is shared by both tables until the old one is deleted (which leaves values alone)
+            newTable->slots[idx].value.store(table->slots[i].value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            newTable->slots[idx].key.store(key, std::memory_order_relaxed);
+            newTable->used++;
+        }
+
+        table_.store(newTable, std::memory_order_release);
+        retiredTables_.push_back(table);
+        return newTable;
+    }
+
+    /*! Deletes retired memory if no lookup is in progress; must be called with the writer lock held */
+    void reclaim()
+    {
+        if ((retiredTables_.empty() && retiredValues_.empty()) || readers_.load() != 0)
+        {
+            return;
+        }
+
+        for (Table *table : retiredTables_) deleteTable(table);
+        for (std::shared_ptr<T> *value : retiredValues_) delete value;
+        retiredTables_.clear();
+        retiredValues_.clear();
+    }
+
+public:
+
+    ConcurrentPidMap() : table_(createTable(kMinCapacity)), size_(0), readers_(0), writer_(0) { }
+
+    ~ConcurrentPidMap()
+    {
+        Table *table = table_.load();
+        for (uint32_t i = 0; i < table->capacity; i++)
+        {
+            delete table->slots[i].value.load();
+        }
+
+        deleteTable(table);
+        for (Table *retired : retiredTables_) deleteTable(retired);
+        for (std::shared_ptr<T> *value : retiredValues_) delete value;
+    }
+
+    ConcurrentPidMap(const ConcurrentPidMap&) = delete;
+    ConcurrentPidMap& operator=(const ConcurrentPidMap&) = delete;
+
+    /*! Returns the number of values stored. */
+    inline uint getCount() const { return size_; }
+
+    /*! Returns the value associated with 'key', or nullptr. */
+    std::shared_ptr<T> get(uint64_t key)
+    {
+        ReadScope scope(readers_);
+        return lookup(key);
+    }
+
+    /*!
+     * Returns the value already associated with 'key' (setting 'result' to kTrieResultAlreadyExists) or, if there is
+     * none, associates 'record' with it and returns it (setting 'result' to kTrieResultInserted).
+     */
+    std::shared_ptr<T> getOrAdd(uint64_t key, std::shared_ptr<T> record, TrieResult *result = nullptr)
+    {
+        std::shared_ptr<T> existing = get(key);
+        if (existing == nullptr && record != nullptr)
+        {
+            WriteScope lock(this);
+            existing = lookup(key);
+            if (existing == nullptr)
+            {
+                add(key, record);
+                if (result) *result = kTrieResultInserted;
+                return record;
+            }
+        }
+
+        if (result) *result = existing != nullptr ? kTrieResultAlreadyExists : kTrieResultFailure;
+        return existing;
+    }
+
+    /*! Associates 'value' with 'key' only if no value is associated with it yet: kTrieResultInserted, kTrieResultAlreadyExists, or kTrieResultFailure */
+    TrieResult insert(uint64_t key, const std::shared_ptr<T> value)
+    {
+        if (value == nullptr)
+        {
+            return kTrieResultFailure;
+        }
+
+        WriteScope lock(this);
+        if (find(table_.load(std::memory_order_relaxed), key) != nullptr)
+        {
+            return kTrieResultAlreadyExists;
+        }
+
+        add(key, value);
+        return kTrieResultInserted;
+    }
+
+    /*! Associates 'value' with 'key', replacing any previous value: kTrieResultInserted, kTrieResultReplaced, or kTrieResultFailure */
+    TrieResult replace(uint64_t key, const std::shared_ptr<T> value)
+    {
+        if (value == nullptr)
+        {
+            return kTrieResultFailure;
+        }
+
+        WriteScope lock(this);
+        Slot *slot = find(table_.load(std::memory_order_relaxed), key);
+        if (slot == nullptr)
+        {
+            add(key, value);
+            return kTrieResultInserted;
+        }
+
+        retiredValues_.push_back(slot->value.exchange(new std::shared_ptr<T>(value), std::memory_order_acq_rel));
+        return kTrieResultReplaced;
+    }
+
+    /*! Removes the value associated with 'key': kTrieResultRemoved or kTrieResultAlreadyEmpty */
+    TrieResult remove(uint64_t key)
+    {
+        WriteScope lock(this);
+        Slot *slot = find(table_.load(std::memory_order_relaxed), key);
+        if (slot == nullptr)
+        {
+            return kTrieResultAlreadyEmpty;
+        }
+
+        // unpublish the key before the value (the reverse of 'add')
+        slot->key.store(kTombstone, std::memory_order_release);
+        retiredValues_.push_back(slot->value.exchange(nullptr, std::memory_order_acq_rel));
+        size_--;
+        return kTrieResultRemoved;
+    }
+
+    /*!
+     * Invokes 'callback' for every entry.  Entries added or removed while this runs may or may not be visited.
+     */
+    void forEach(void *callbackArgs, for_each_fn callback)
+    {
+        ReadScope scope(readers_);
+        Table *table = table_.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < table->capacity; i++)
+        {
+            int64_t key = table->slots[i].key.load(std::memory_order_acquire);
+            if (key < 0)
+            {
+                continue;
+            }
+
+            std::shared_ptr<T> *value = table->slots[i].value.load(std::memory_order_acquire);
+            if (value != nullptr && table->slots[i].key.load(std::memory_order_acquire) == key)
+            {
+                callback(callbackArgs, (uint64_t)key, *value);
+            }
+        }
+    }
+};
+
+#endif /* ConcurrentPidMap_hpp */
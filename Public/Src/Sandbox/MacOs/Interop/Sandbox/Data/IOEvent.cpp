@@ -224,6 +224,19 @@ IOEvent::IOEvent(const es_message_t *msg)
 }
 #endif
 
+IOEvent::IOEvent(const IOEventView &view)
+    : pid_(view.pid), cpid_(view.cpid), ppid_(view.ppid), eventType_(view.eventType), actionType_(view.actionType),
+      mode_(view.mode), modified_(view.modified),
+      executable_(view.executable.data, view.executable.length),
+      src_path_(view.srcPath.data, view.srcPath.length),
+      dst_path_(view.dstPath.data, view.dstPath.length),
+      oppid_(view.oppid)
+{
+#if __APPLE__
+    auditToken_ = view.auditToken;
+#endif
+}
+
 // When inserting the detours library dynamically, interposed executables automatically search for the default Info.plist
 // file in the executable directory, we are ignoring these events because they are triggered by the interposing and normally don't happen!
 const bool IOEvent::IsPlistEvent() const
@@ -252,80 +265,116 @@ const bool IOEvent::IsDirectorySpecialCharacterEvent() const
 
 const size_t IOEvent::Size() const
 {
-    return
-        std::to_string(pid_).length() +
-        std::to_string(cpid_).length() +
-        std::to_string(ppid_).length() +
-        std::to_string(eventType_).length() +
-        std::to_string(actionType_).length() +
-        std::to_string(mode_).length() +
-        std::to_string(modified_).length() +
-        executable_.length() + (executable_.length() > 0 ? 1 : 0) +
-        src_path_.length() + (src_path_.length() > 0 ? 1 : 0) +
-        dst_path_.length() + (dst_path_.length() > 0 ? 1 : 0) +
-        7; // 7 delimiters + 1 per string (if string is present)
+    return kSerializedFixedSize + 3 * sizeof(uint32_t) + executable_.length() + src_path_.length() + dst_path_.length();
 }
 
-omemorystream& operator<<(omemorystream &os, const IOEvent &event)
+template <typename T>
+static inline char* WriteValue(char *cursor, T value)
 {
-    os
-    << event.pid_        << "|"
-    << event.cpid_       << "|"
-    << event.ppid_       << "|"
-    << event.eventType_  << "|"
-    << event.actionType_ << "|"
-    << event.mode_       << "|"
-    << event.modified_   << "|"
-    ;
+    memcpy(cursor, &value, sizeof(T));
+    return cursor + sizeof(T);
+}
 
-    if (event.executable_.size() > 0)
-    {
-        os << event.executable_ << "|";
-    }
+static inline char* WriteString(char *cursor, const std::string &str)
+{
+    cursor = WriteValue<uint32_t>(cursor, (uint32_t)str.length());
+    memcpy(cursor, str.data(), str.length());
+    return cursor + str.length();
+}
 
-    if (event.src_path_.size() > 0)
+template <typename T>
+static inline bool ReadValue(const char *&cursor, const char *end, T &value)
+{
+    if ((size_t)(end - cursor) < sizeof(T))
     {
-        os << event.src_path_ << "|";
+        return false;
     }
 
-    if (event.dst_path_.size() > 0)
+    memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return true;
+}
+
+static inline bool ReadString(const char *&cursor, const char *end, IOEventView::String &str)
+{
+    uint32_t length;
+    if (!ReadValue(cursor, end, length) || (size_t)(end - cursor) < length)
     {
-        os << event.dst_path_ << "|";
+        return false;
     }
 
-    return os;
+    str.data = cursor;
+    str.length = length;
+    cursor += length;
+    return true;
 }
 
-std::istream& operator>>(std::istream &is, es_event_type_t &t)
+size_t IOEvent::Serialize(char *buffer, size_t size) const
 {
-    unsigned int value = 0;
-    is >> value;
-    t = (es_event_type_t) value;
-    return is;
-}
+    size_t length = Size();
+    if (size < length)
+    {
+        return 0;
+    }
 
-std::istream& operator>>(std::istream &is, es_action_type_t &t)
-{
-    unsigned int value = 0;
-    is >> value;
-    t = (es_action_type_t) value;
-    return is;
+    char *cursor = buffer;
+    cursor = WriteValue<int32_t>(cursor, pid_);
+    cursor = WriteValue<int32_t>(cursor, cpid_);
+    cursor = WriteValue<int32_t>(cursor, ppid_);
+    cursor = WriteValue<int32_t>(cursor, oppid_);
+    cursor = WriteValue<uint32_t>(cursor, eventType_);
+    cursor = WriteValue<uint32_t>(cursor, actionType_);
+    cursor = WriteValue<uint32_t>(cursor, mode_);
+    cursor = WriteValue<uint8_t>(cursor, modified_);
+#if __APPLE__
+    cursor = WriteValue<audit_token_t>(cursor, auditToken_);
+#endif
+    cursor = WriteString(cursor, executable_);
+    cursor = WriteString(cursor, src_path_);
+    cursor = WriteString(cursor, dst_path_);
+
+    assert(cursor == buffer + length);
+    return length;
 }
 
-imemorystream& operator>>(imemorystream &is, IOEvent &event)
+bool IOEvent::Deserialize(const char *buffer, size_t size, IOEventView &view)
 {
-    is
-    >> event.pid_
-    >> event.cpid_
-    >> event.ppid_
-    >> event.eventType_
-    >> event.actionType_
-    >> event.mode_
-    >> event.modified_
-    >> event.executable_
-    >> event.src_path_
-    >> event.dst_path_
-    ;
+    const char *cursor = buffer;
+    const char *end = buffer + size;
+
+    int32_t pid, cpid, ppid, oppid;
+    uint32_t type, action, mode;
+    uint8_t modified;
+
+    bool success =
+        ReadValue(cursor, end, pid) &&
+        ReadValue(cursor, end, cpid) &&
+        ReadValue(cursor, end, ppid) &&
+        ReadValue(cursor, end, oppid) &&
+        ReadValue(cursor, end, type) &&
+        ReadValue(cursor, end, action) &&
+        ReadValue(cursor, end, mode) &&
+        ReadValue(cursor, end, modified) &&
+#if __APPLE__
+        ReadValue(cursor, end, view.auditToken) &&
+#endif
+        ReadString(cursor, end, view.executable) &&
+        ReadString(cursor, end, view.srcPath) &&
+        ReadString(cursor, end, view.dstPath) &&
+        cursor == end;
+
+    if (!success)
+    {
+        return false;
+    }
 
-    return is;
+    view.pid = pid;
+    view.cpid = cpid;
+    view.ppid = ppid;
+    view.oppid = oppid;
+    view.eventType = (es_event_type_t) type;
+    view.actionType = (es_action_type_t) action;
+    view.mode = (mode_t) mode;
+    view.modified = modified != 0;
+    return true;
 }
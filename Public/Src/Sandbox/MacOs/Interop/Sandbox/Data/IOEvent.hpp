@@ -6,8 +6,7 @@
 
 #include "stdafx.h"
 
-#include <iostream>
-#include <istream>
+#include <string>
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -16,8 +15,6 @@
 #include <bsm/libbsm.h>
 #endif
 
-#include "MemoryStreams.hpp"
-
 #define SRC_PATH 0
 #define DST_PATH 1
 
@@ -49,15 +46,50 @@ enum class ProcessCallbackResult
 };
 
 #define IOEventKey "IOEvent"
-#define IOEventLengthKey "IOEvent::Length"
 
-struct IOEvent final
+/*!
+ * An event as read by 'IOEvent::Deserialize': the paths are not copied, they point into the deserialized buffer (and
+ * are not NUL-terminated), so a view is only valid for as long as that buffer is.
+ */
+struct IOEventView final
 {
-    friend omemorystream& operator<<(omemorystream &os, const IOEvent &event);
-    friend imemorystream& operator>>(imemorystream &is, IOEvent &event);
+    struct String
+    {
+        const char *data;
+        size_t length;
+    };
+
+    pid_t pid;
+    pid_t cpid;
+    pid_t ppid;
+    pid_t oppid;
+    es_event_type_t eventType;
+    es_action_type_t actionType;
+    mode_t mode;
+    bool modified;
+#if __APPLE__
+    audit_token_t auditToken;
+#endif
 
+    String executable;
+    String srcPath;
+    String dstPath;
+};
+
+struct IOEvent final
+{
 private:
 
+    /*! Serialized size of the fields other than the paths (see 'Serialize') */
+    static const size_t kSerializedFixedSize =
+        4 * sizeof(int32_t) +       // Pid, child pid, parent pid, original parent pid
+        3 * sizeof(uint32_t) +      // Type, action, mode
+        sizeof(uint8_t)             // Modified
+#if __APPLE__
+        + sizeof(audit_token_t)     // Only macOS has audit tokens
+#endif
+        ;
+
     pid_t pid_;
     pid_t cpid_;
     pid_t ppid_;
@@ -72,7 +104,9 @@ private:
 
     // Only used when the IOEvent is backed by an EndpointSecurity message
     pid_t oppid_;
-    audit_token_t auditToken_;
+#if __APPLE__
+    audit_token_t auditToken_ = {};
+#endif
 
 public:
 
@@ -82,6 +116,9 @@ public:
     IOEvent(const es_message_t *msg);
 #endif
 
+    /*! Copies the event 'view' points to (see 'Deserialize') */
+    explicit IOEvent(const IOEventView &view);
+
     IOEvent(pid_t pid,
             pid_t cpid,
             pid_t ppid,
@@ -139,7 +176,9 @@ public:
     inline const pid_t GetOriginalParentPid() const { return oppid_; }
     inline const char* GetExecutablePath() const { return executable_.c_str(); }
 
+#if __APPLE__
     inline const audit_token_t* GetProcessAuditToken() const { return &auditToken_; }
+#endif
     inline const es_event_type_t GetEventType() const { return eventType_; }
     inline const es_action_type_t GetActionType() const { return actionType_; }
 
@@ -166,16 +205,30 @@ public:
     const bool IsPlistEvent() const;
     const bool IsDirectorySpecialCharacterEvent() const;
 
+    /*! The number of bytes 'Serialize' writes for this event */
     const size_t Size() const;
 
+    /*!
+     * Writes this event into 'buffer', in the binary format read by 'Deserialize': the fixed-size fields (in host byte
+     * order, both ends run on the same machine) followed by the executable, source, and destination paths, each
+     * prefixed by its length.  Paths are written as is, so they may contain any character.
+     *
+     * @result The number of bytes written (i.e., 'Size()'), or 0 if 'size' is too small.
+     */
+    size_t Serialize(char *buffer, size_t size) const;
+
+    /*!
+     * Reads an event written by 'Serialize' into 'view', without copying anything out of 'buffer': the paths of
+     * 'view' point into it.  Use 'IOEvent(view)' to keep the event beyond the lifetime of 'buffer'.
+     *
+     * @result False if the 'size' bytes of 'buffer' do not hold exactly one well-formed event.
+     */
+    static bool Deserialize(const char *buffer, size_t size, IOEventView &view);
+
+    /*! An upper bound of 'Size()' for events whose paths are at most PATH_MAX long */
     static inline const size_t max_size()
     {
-        // IMPORTANT: Keep this in sync with the de- and serialization logic in the implementation file (IOEvent.cpp), especially Size()!
-        return (3 * std::to_string(PID_MAX).length()) +   // Pids
-               (3 * std::to_string(USHRT_MAX).length()) + // Type + Action + Mode
-               std::to_string(true).length() +            // Modified
-               (3 * PATH_MAX) +                           // Executable, src and dst paths
-               10;                                        // Delimiters
+        return kSerializedFixedSize + 3 * (sizeof(uint32_t) + PATH_MAX);
     }
 };
 
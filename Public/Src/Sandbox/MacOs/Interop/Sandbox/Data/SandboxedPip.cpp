@@ -27,6 +27,7 @@ SandboxedPip::SandboxedPip(pid_t pid, const char *payload, size_t length)
 
     processId_ = pid;
     processTreeCount_ = 1;
+    sharedProcessTreeCount_ = nullptr;
 }
 
 SandboxedPip::~SandboxedPip()
@@ -35,6 +35,9 @@ private:
     /*! Number of processses in this pip's process tree */
     std::atomic<int> processTreeCount_;
 
+    /*! When set, the size of the process tree is maintained outside of this object (see 'UseSharedProcessTreeCount') */
+    std::atomic<int> *sharedProcessTreeCount_;
+
 public:
 
     SandboxedPip() = delete;
@@ -64,11 +67,14 @@ public:
     inline const char* GetReportsPath(int *length) const              { return fam_.GetReportsPath(length); }
 
     /*! Number of currently active processes in this pip's process tree */
-    inline const int GetTreeSize() const                              { return processTreeCount_; }
+    inline const int GetTreeSize() const                              { return sharedProcessTreeCount_ != nullptr ? sharedProcessTreeCount_->load() : processTreeCount_.load(); }
 
     /*! When this returns true, child processes should not be tracked. */
     bool AllowChildProcessesToBreakAway() const                       { return fam_.AllowChildProcessesToBreakAway(); }
 
+    /*! The ('from', 'to') path translations of the manifest, to be applied to the reported paths. */
+    void GetTranslatePaths(std::vector<std::pair<std::string, std::string>> &translations) const { fam_.GetTranslatePaths(translations); }
+
 
 #pragma mark Process Tree Tracking
 
@@ -77,6 +83,12 @@ public:
 
     /*! Atomically dencrements this pip's process tree size and returns the size before decrement. */
     inline const int DecrementProcessTreeCount() { return --processTreeCount_; }
+
+    /*!
+     * Makes 'GetTreeSize' return a count that is maintained by the processes of the tree themselves
+     * (e.g., on Linux, where every process has its own instance of this object).
+     */
+    inline void UseSharedProcessTreeCount(std::atomic<int> *count) { sharedProcessTreeCount_ = count; }
 };
 
 #endif /* SandboxedPip_hpp */
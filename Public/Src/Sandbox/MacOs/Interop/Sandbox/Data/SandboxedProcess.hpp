@@ -51,8 +51,16 @@ public:
     /*! 0-terminated full path to the executable file of this process */
     inline const char* GetPath() const                           { return path_; }
 
+    /*! The length of 'GetPath()' */
+    inline size_t GetPathLength() const                          { return pathLength_; }
+
     /*! Copies the 0-terminated string in 'path' to its own path buffer. */
-    inline void SetPath(const char *path) { strlcpy(path_, path, PATH_MAX); }
+    inline void SetPath(const char *path)
+    {
+        strlcpy(path_, path, PATH_MAX);
+        path_[PATH_MAX - 1] = '\0';
+        pathLength_ = (int)strlen(path_);
+    }
 };
 
 #endif /* SandboxedProcess_hpp */
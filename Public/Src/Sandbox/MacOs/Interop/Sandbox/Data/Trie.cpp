@@ -4,6 +4,10 @@
 #include "BuildXLException.hpp"
 #include "Trie.hpp"
 
+#include <new>
+#include <sched.h>
+#include <string.h>
+
 template <typename T>
 std::atomic<uint> Node<T>::s_numUintNodes(0);
 
@@ -11,52 +15,95 @@ template <typename T>
 std::atomic<uint> Node<T>::s_numPathNodes(0);
 
 template <typename T>
-Node<T>::Node(uint numChildren)
+std::atomic<uint64_t> Node<T>::s_uintNodeBytes(0);
+
+template <typename T>
+std::atomic<uint64_t> Node<T>::s_pathNodeBytes(0);
+
+template <typename T>
+const uint Node<T>::s_childrenCapacities[3] = { 1, 4, 16 };
+
+template <typename T>
+Node<T>::Node(uint numChildren, const uint8_t *keys, uint depth, bool ownsKeys)
 {
     if (numChildren == s_uintNodeChildrenCount) ++s_numUintNodes;
     else if (numChildren == s_pathNodeChildrenCount) ++s_numPathNodes;
 
     record_ = nullptr;
-    childrenLength_ = numChildren;
+    keys_ = keys;
+    depth_ = depth;
+    ownsKeys_ = ownsKeys;
+    maxKey_ = numChildren;
+    children_ = nullptr;
 
-    children_ = (Node **) malloc(numChildren * sizeof(Node *));
-    if (children_)
-    {
-        for (int i = 0; i < childrenLength_; i++)
-        {
-            children_[i] = nullptr;
-        }
-    }
+    bytesCounter() += sizeof(Node) + (ownsKeys_ ? depth_ : 0);
 }
 
 template <typename T>
 Node<T>::~Node()
 {
-    if (children_)
-    {
-        for (int i = 0; i < childrenLength_; i++)
-        {
-            children_[i] = nullptr;
-        }
-
-        free(children_);
-        children_ = nullptr;
-    }
+    deleteChildren(children_.load());
+    children_ = nullptr;
 
     if (record_ != nullptr) record_.reset();
 
+    if (ownsKeys_) free(const_cast<uint8_t*>(keys_));
+    bytesCounter() -= sizeof(Node) + (ownsKeys_ ? depth_ : 0);
+
     if (length() == s_uintNodeChildrenCount) --s_numUintNodes;
     else if (length() == s_pathNodeChildrenCount) --s_numPathNodes;
 }
 
+template <typename T>
+typename Node<T>::Children* Node<T>::createChildren(uint capacity) const
+{
+    bool dense = capacity >= length();
+    size_t size = Children::sizeOf(capacity, dense);
+
+    void *memory = malloc(size);
+    if (memory == nullptr)
+    {
+        return nullptr;
+    }
+
+    Children *children = new (memory) Children();
+    children->nextRetired = nullptr;
+    children->capacity = capacity;
+    children->dense = dense;
+    for (uint i = 0; i < capacity; i++)
+    {
+        new (&children->slots()[i]) std::atomic<Node*>(nullptr);
+        if (!dense) new (&children->keys()[i]) std::atomic<uint8_t>(0);
+    }
+
+    bytesCounter() += size;
+    return children;
+}
+
+template <typename T>
+void Node<T>::deleteChildren(Children *children) const
+{
+    if (children == nullptr)
+    {
+        return;
+    }
+
+    bytesCounter() -= Children::sizeOf(children->capacity, children->dense);
+    free(children);
+}
+
 // ================================== class Trie ==================================
 
 template <typename T>
 Trie<T>::Trie(TrieKind kind)
 {
     kind_ = kind;
-    root_ = createNode();
-    if (root_->children_ == nullptr)
+    size_ = 0;
+    onChangeCallback_ = nullptr;
+    onChangeData_ = nullptr;
+    retired_ = nullptr;
+    root_ = createNode(/*keys*/ nullptr, /*depth*/ 0, /*ownsKeys*/ false);
+    if (root_ == nullptr)
     {
         throw BuildXLException("Trie creation failed as no root node could be allocated!");
     }
@@ -65,6 +112,14 @@ Trie<T>::Trie(TrieKind kind)
 template <typename T>
 Trie<T>::~Trie()
 {
+    typename Node<T>::Children *retired = retired_.exchange(nullptr);
+    while (retired != nullptr)
+    {
+        typename Node<T>::Children *next = retired->nextRetired;
+        root_->deleteChildren(retired);
+        retired = next;
+    }
+
     traverse(/*computeKey*/ false, /*callbackArgs*/ nullptr, [](Trie<T>*, void*, uint64_t, Node<T> *node)
     {
         delete node;
@@ -75,65 +130,282 @@ Trie<T>::~Trie()
 }
 
 template <typename T>
-bool Trie<T>::findChildNode(Node<T> *node, int idx, bool createIfMissing)
+Node<T>* Trie<T>::waitForSlot(typename Node<T>::Children *children, uint i)
 {
-    if (idx < 0 || idx >= node->length())
+    Node<T> *child;
+    while ((child = children->slots()[i].load(std::memory_order_acquire)) == nullptr)
     {
-        return false;
+        sched_yield();
     }
 
-    bool childNodeExists = node->children()[idx] != nullptr;
+    return Node<T>::Children::unfrozen(child);
+}
 
-    if (childNodeExists)
+template <typename T>
+Node<T>* Trie<T>::freezeSlot(typename Node<T>::Children *children, uint i)
+{
+    while (true)
     {
-        return true;
+        Node<T> *child = waitForSlot(children, i);
+        Node<T> *frozen = reinterpret_cast<Node<T>*>(reinterpret_cast<uintptr_t>(child) | Node<T>::Children::Frozen);
+
+        // fails if the slot is already frozen (by another thread growing the same array) or a split just changed it
+        Node<T> *expected = child;
+        if (children->slots()[i].compare_exchange_strong(expected, frozen, std::memory_order_acq_rel) || expected == frozen)
+        {
+            return child;
+        }
     }
+}
 
-    // child is missing
-    if (!createIfMissing)
+template <typename T>
+Node<T>* Trie<T>::findInChildren(typename Node<T>::Children *children, int idx, bool *full, uint *slot)
+{
+    *full = children == nullptr;
+    if (children == nullptr)
     {
-        return false;
+        return nullptr;
     }
 
-    Node<T>* newNode = createNode();
+    if (children->dense)
+    {
+        *slot = idx;
+        return children->slots()[idx].load(std::memory_order_acquire);
+    }
 
-    // This should never happen except if we run out of memory.
-    if (newNode == nullptr)
+    uint8_t key = idx + 1;
+    for (uint i = 0; i < children->capacity; i++)
     {
-        return false;
+        uint8_t slotKey = children->keys()[i].load(std::memory_order_acquire);
+        if (slotKey == 0)
+        {
+            return nullptr;
+        }
+
+        if (slotKey == key)
+        {
+            // null for as long as the child is being added
+            *slot = i;
+            return Node<T>::Children::unfrozen(children->slots()[i].load(std::memory_order_acquire));
+        }
     }
 
-    // TODO: Make thread safe!
-    node->children()[idx] = newNode;
+    *full = true;
+    return nullptr;
+}
 
-    return true;
+template <typename T>
+template <typename Key>
+Node<T>* Trie<T>::findNode(const Key &key, bool createIfMissing)
+{
+    Node<T> *node = root_;
+    uint depth = 0;
+    while (depth < key.length)
+    {
+        int idx = key[depth];
+        if (idx < 0 || idx >= node->length())
+        {
+            return nullptr;
+        }
+
+        bool full;
+        uint slot;
+        typename Node<T>::Children *children = node->children_.load(std::memory_order_acquire);
+        Node<T> *child = findInChildren(children, idx, &full, &slot);
+        if (child == nullptr)
+        {
+            if (!createIfMissing)
+            {
+                return nullptr;
+            }
+
+            // a leaf for the whole key
+            uint8_t *keys = (uint8_t*)malloc(key.length);
+            Node<T> *leaf = keys != nullptr ? createNode(keys, key.length, /*ownsKeys*/ true) : nullptr;
+            if (leaf == nullptr)
+            {
+                free(keys);
+                return nullptr;
+            }
+
+            for (uint i = 0; i < key.length; i++)
+            {
+                keys[i] = key[i];
+            }
+
+            child = addChildNode(node, idx, leaf);
+            if (child == leaf)
+            {
+                return leaf;
+            }
+
+            // some other thread added a child with this key first: match the key against that child
+            delete leaf;
+            if (child == nullptr)
+            {
+                return nullptr;
+            }
+
+            continue;
+        }
+
+        // the edge to 'child' is labeled with 'child->keys_[depth..child->depth_)', of which the first key is 'idx'
+        uint end = child->depth_ < key.length ? child->depth_ : key.length;
+        uint match = depth + 1;
+        while (match < end && child->keys_[match] == key[match])
+        {
+            match++;
+        }
+
+        if (match == child->depth_)
+        {
+            node = child;
+            depth = match;
+            continue;
+        }
+
+        if (!createIfMissing)
+        {
+            return nullptr;
+        }
+
+        // split the edge at 'match' with a node that has 'child' as its only child
+        Node<T> *middle = createNode(child->keys_, match, /*ownsKeys*/ false);
+        typename Node<T>::Children *middleChildren = middle != nullptr ? middle->createChildren(1) : nullptr;
+        if (middleChildren == nullptr)
+        {
+            delete middle;
+            return nullptr;
+        }
+
+        middleChildren->keys()[0].store(child->keys_[match] + 1, std::memory_order_relaxed);
+        middleChildren->slots()[0].store(child, std::memory_order_relaxed);
+        middle->children_.store(middleChildren, std::memory_order_relaxed);
+
+        Node<T> *expected = child;
+        if (!children->slots()[slot].compare_exchange_strong(expected, middle, std::memory_order_acq_rel))
+        {
+            // some other thread split this edge first, or is replacing the array (see 'freezeSlot'): start over from 'node'
+            delete middle;
+            continue;
+        }
+
+        node = middle;
+        depth = match;
+    }
+
+    return node;
 }
 
 template <typename T>
-TrieResult Trie<T>::makeSentinel(Node<T> *node, std::shared_ptr<T> record)
+Node<T>* Trie<T>::addChildNode(Node<T> *node, int idx, Node<T> *child)
 {
-    // if this is a sentinel node --> nothing to do
-    if (node->record_ != nullptr)
+    uint8_t key = idx + 1;
+    while (true)
     {
-        return kTrieResultAlreadyExists;
+        typename Node<T>::Children *children = node->children_.load(std::memory_order_acquire);
+        uint capacity = children != nullptr ? children->capacity : 0;
+
+        if (children != nullptr && children->dense)
+        {
+            Node<T> *existing = nullptr;
+            return children->slots()[idx].compare_exchange_strong(existing, child, std::memory_order_acq_rel)
+                ? child
+                : existing;
+        }
+
+        // sparse: claim the first free slot, unless some slot already holds (or is about to hold) this key
+        for (uint i = 0; i < capacity; i++)
+        {
+            uint8_t slotKey = children->keys()[i].load(std::memory_order_acquire);
+            if (slotKey == 0 && children->keys()[i].compare_exchange_strong(slotKey, key, std::memory_order_acq_rel))
+            {
+                children->slots()[i].store(child, std::memory_order_release);
+                return child;
+            }
+
+            if (slotKey == key)
+            {
+                return waitForSlot(children, i);
+            }
+        }
+
+        // full (or no children yet): replace the array with a bigger copy that also holds 'child'
+        uint newCapacity = node->length();
+        for (uint c : Node<T>::s_childrenCapacities)
+        {
+            if (c > capacity && c < node->length())
+            {
+                newCapacity = c;
+                break;
+            }
+        }
+
+        typename Node<T>::Children *bigger = node->createChildren(newCapacity);
+        if (bigger == nullptr)
+        {
+            return nullptr;
+        }
+
+        for (uint i = 0; i <= capacity; i++)
+        {
+            Node<T> *c = i < capacity ? freezeSlot(children, i) : child;
+            uint8_t k = i < capacity ? children->keys()[i].load(std::memory_order_relaxed) : key;
+            if (bigger->dense)
+            {
+                bigger->slots()[k - 1].store(c, std::memory_order_relaxed);
+            }
+            else
+            {
+                bigger->keys()[i].store(k, std::memory_order_relaxed);
+                bigger->slots()[i].store(c, std::memory_order_relaxed);
+            }
+        }
+
+        if (node->children_.compare_exchange_strong(children, bigger, std::memory_order_acq_rel))
+        {
+            retire(children);
+            return child;
+        }
+
+        // some other thread replaced the array first: start over with that one
+        node->deleteChildren(bigger);
+    }
+}
+
+template <typename T>
+void Trie<T>::retire(typename Node<T>::Children *children)
+{
+    if (children == nullptr)
+    {
+        return;
     }
 
-    std::shared_ptr<T> newRecord = record;
-    if (newRecord == nullptr)
+    typename Node<T>::Children *head = retired_.load();
+    do
+    {
+        children->nextRetired = head;
+    } while (!retired_.compare_exchange_weak(head, children));
+}
+
+template <typename T>
+TrieResult Trie<T>::makeSentinel(Node<T> *node, std::shared_ptr<T> record)
+{
+    // if this is a sentinel node --> nothing to do
+    if (std::atomic_load(&node->record_) != nullptr || record == nullptr)
     {
         return kTrieResultAlreadyExists;
     }
 
-    if (node->record_ != nullptr)
+    std::shared_ptr<T> expected = nullptr;
+    if (!std::atomic_compare_exchange_strong(&node->record_, &expected, record))
     {
-        newRecord.reset();
+        // somebody else made it sentinel first
         return kTrieResultAlreadyExists;
     }
 
-    // TODO: Make thread safe!
-    node->record_ = newRecord;
-    int oldCount = (++size_);
-    triggerOnChange(oldCount, oldCount + 1);
+    uint newCount = ++size_;
+    triggerOnChange(newCount - 1, newCount);
 
     return kTrieResultInserted;
 }
@@ -141,7 +413,7 @@ TrieResult Trie<T>::makeSentinel(Node<T> *node, std::shared_ptr<T> record)
 template <typename T>
 std::shared_ptr<T> Trie<T>::get(Node<T> *node)
 {
-    return node != nullptr ? node->record_ : nullptr;
+    return node != nullptr ? std::atomic_load(&node->record_) : nullptr;
 }
 
 template <typename T>
@@ -151,7 +423,7 @@ std::shared_ptr<T> Trie<T>::getOrAdd(Node<T> *node, std::shared_ptr<T> record, T
     auto sentinelResult = makeSentinel(node, record);
     if (result) *result = sentinelResult;
 
-    return node->record_;
+    return std::atomic_load(&node->record_);
 }
 
 template <typename T>
@@ -162,24 +434,21 @@ TrieResult Trie<T>::replace(Node<T> *node, const std::shared_ptr<T> value)
         return kTrieResultFailure;
     }
 
-    std::shared_ptr<T> previousValue = node->record_;
+    std::shared_ptr<T> previousValue = std::atomic_load(&node->record_);
+    if (!std::atomic_compare_exchange_strong(&node->record_, &previousValue, value))
+    {
+        return kTrieResultRace;
+    }
 
     if (previousValue != nullptr)
     {
-        node->record_ = value;
-        previousValue.reset();
-
         return kTrieResultReplaced;
     }
-    else
-    {
-        node->record_ = value;
 
-        int oldCount = (++size_);
-        triggerOnChange(oldCount, oldCount + 1);
+    uint newCount = ++size_;
+    triggerOnChange(newCount - 1, newCount);
 
-        return kTrieResultInserted;
-    }
+    return kTrieResultInserted;
 }
 
 template <typename T>
@@ -190,11 +459,14 @@ TrieResult Trie<T>::insert(Node<T> *node, const std::shared_ptr<T> value)
         return kTrieResultFailure;
     }
 
-    if (node->record_ != nullptr) return kTrieResultAlreadyExists;
+    std::shared_ptr<T> expected = nullptr;
+    if (!std::atomic_compare_exchange_strong(&node->record_, &expected, value))
+    {
+        return kTrieResultAlreadyExists;
+    }
 
-    node->record_ = value;
-    int oldCount = (++size_);
-    triggerOnChange(oldCount, oldCount + 1);
+    uint newCount = ++size_;
+    triggerOnChange(newCount - 1, newCount);
 
     return kTrieResultInserted;
 }
@@ -202,23 +474,21 @@ TrieResult Trie<T>::insert(Node<T> *node, const std::shared_ptr<T> value)
 template <typename T>
 TrieResult Trie<T>::remove(Node<T> *node)
 {
-    if (node == nullptr || node->record_ == nullptr)
+    std::shared_ptr<T> previousValue = node != nullptr ? std::atomic_load(&node->record_) : nullptr;
+    if (previousValue == nullptr)
     {
         return kTrieResultAlreadyEmpty;
     }
 
-
-    if (node->record_ != nullptr)
+    if (!std::atomic_compare_exchange_strong(&node->record_, &previousValue, std::shared_ptr<T>(nullptr)))
     {
-        node->record_.reset();
-
-        int oldCount = (--size_);
-        triggerOnChange(oldCount, oldCount - 1);
-
-        return kTrieResultRemoved;
+        return kTrieResultRace;
     }
 
-    return kTrieResultFailure;
+    uint newCount = --size_;
+    triggerOnChange(newCount + 1, newCount);
+
+    return kTrieResultRemoved;
 }
 
 /*
@@ -528,51 +798,46 @@ static uint64_t pow10(int exp)
     return result;
 }
 
+/*! The keys of a path: the indices (see 's_char2idx') of its characters */
 template <typename T>
-Node<T>* Trie<T>::findPathNode(const char *path, bool createIfMissing)
+struct PathKey
 {
-    Node<T> *currNode = root_;
-    unsigned char ch;
-    while ((ch = *path++) != '\0')
-    {
-        int idx = s_char2idx<T>[ch];
-        if (!findChildNode(currNode, idx, createIfMissing))
-        {
-            return nullptr;
-        }
-        currNode = currNode->children()[idx];
-    }
+    const char *path;
+    uint length;
 
-    return currNode;
+    int operator[](uint i) const { return s_char2idx<T>[(unsigned char)path[i]]; }
+};
+
+/*! The keys of a uint: its decimal digits, least significant first */
+struct UintKey
+{
+    uint8_t digits[20];
+    uint length;
+
+    int operator[](uint i) const { return digits[i]; }
+};
+
+template <typename T>
+Node<T>* Trie<T>::findPathNode(const char *path, bool createIfMissing)
+{
+    assert(root_->length() == Node<T>::s_pathNodeChildrenCount);
+    return findNode(PathKey<T> { path, (uint)strlen(path) }, createIfMissing);
 }
 
 template <typename T>
 Node<T>* Trie<T>::findUintNode(uint64_t key, bool createIfMissing)
 {
-    Node<T> *currNode = root_;
+    assert(root_->length() == Node<T>::s_uintNodeChildrenCount);
 
-    while (true)
+    UintKey digits;
+    digits.length = 0;
+    do
     {
-        assert(currNode->length() == 10);
-
-        int lsd = key % 10;
-
-        if (!findChildNode(currNode, lsd, createIfMissing))
-        {
-            return nullptr;
-        }
-
-        currNode = currNode->children()[lsd];
-
-        if (key < 10)
-        {
-            break;
-        }
-
+        digits.digits[digits.length++] = key % 10;
         key = key / 10;
-    }
+    } while (key > 0);
 
-    return currNode;
+    return findNode(digits, createIfMissing);
 }
 
 template <typename T>
@@ -588,8 +853,6 @@ bool Trie<T>::onChange(void *callbackArgs, on_change_fn callback)
 template <typename T>
 void Trie<T>::triggerOnChange(int oldCount, int newCount) const
 {
-    if (onChangeCallback_) return;
-
     if (onChangeCallback_ && oldCount != newCount)
     {
         onChangeCallback_(onChangeData_, oldCount, newCount);
@@ -604,7 +867,7 @@ void Trie<T>::forEach(void *callbackArgs, for_each_fn callback)
     traverse(/*computeKey*/ kind_ == kUintTrie, /*callbackArgs*/ &state, [](Trie<T> *me, void *s, uint64_t key, Node<T> *node)
     {
         State *state = (State*)s;
-        std::shared_ptr<T> record = node->record_;
+        std::shared_ptr<T> record = std::atomic_load(&node->record_);
         if (record)
         {
             state->callback(state->args, key, record);
@@ -620,7 +883,7 @@ void Trie<T>::removeMatching(void *filterArgs, filter_fn filter)
     traverse(/*computeKey*/ false, /*callbackArgs*/ &state, [](Trie<T> *me, void *s, uint64_t, Node<T> *node)
     {
         State *state = (State*)s;
-        std::shared_ptr<T> record = node->record_;
+        std::shared_ptr<T> record = std::atomic_load(&node->record_);
         if (record)
         {
             if (state->filter(state->args, record))
@@ -635,12 +898,11 @@ template <typename T>
 struct Stack {
     Node<T> *node;
     Stack *next;
-    uint32_t depth;
     uint64_t key;
 };
 
 template <typename T>
-static void push(Stack<T> **stack, Node<T> *node, uint64_t path, uint32_t depth)
+static void push(Stack<T> **stack, Node<T> *node, uint64_t path)
 {
     if (node == nullptr) return;
 
@@ -648,7 +910,6 @@ static void push(Stack<T> **stack, Node<T> *node, uint64_t path, uint32_t depth)
     top->node  = node;
     top->next  = *stack;
     top->key   = path;
-    top->depth = depth;
 
     *stack = top;
 }
@@ -667,16 +928,30 @@ template <typename T>
 void Trie<T>::traverse(bool computeKey, void *callbackArgs, traverse_fn callback)
 {
     Stack<T> *stack = nullptr;
-    push(&stack, root_, /*key*/ 0, /*depth*/ 0);
+    push(&stack, root_, /*key*/ 0);
     while (stack != nullptr)
     {
         uint64_t key = stack->key;
-        uint32_t depth = stack->depth;
 
         Node<T> *curr = pop(&stack);
-        for (int i = 0; i < curr->length(); ++i)
+        typename Node<T>::Children *children = curr->children_.load(std::memory_order_acquire);
+        for (uint i = 0; children != nullptr && i < children->capacity; ++i)
         {
-            push(&stack, curr->children()[i], computeKey ? (i * pow10<T>(depth) + key) : 0, depth + 1);
+            // the slots of a sparse array are filled in order (a claimed slot may still be null for an instant)
+            if (!children->dense && children->keys()[i].load(std::memory_order_acquire) == 0) break;
+
+            Node<T> *child = Node<T>::Children::unfrozen(children->slots()[i].load(std::memory_order_acquire));
+            if (child != nullptr)
+            {
+                // the digits on the edge to 'child', least significant first
+                uint64_t childKey = key;
+                for (uint d = curr->depth_; computeKey && d < child->depth_; d++)
+                {
+                    childKey += child->keys_[d] * pow10<T>(d);
+                }
+
+                push(&stack, child, computeKey ? childKey : 0);
+            }
         }
 
         // the callback may deallocate 'curr' node, hence this must be the last statement in this loop
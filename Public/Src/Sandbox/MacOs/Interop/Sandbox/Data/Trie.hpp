@@ -16,6 +16,10 @@ template <typename T> class Trie;
 /*!
  * A node in a Trie.
  * Only accessible to its friend class Trie.
+ *
+ * The trie is path-compressed: a node stands for the whole key from the root to it ('keys_[0..depth_)'), and the
+ * edge from its parent is labeled with the keys between the depth of the parent and its own; chains of nodes with
+ * a single child and no value are not materialized.
  */
 template <typename T>
 class Node final
@@ -27,6 +31,10 @@ private:
     static std::atomic<uint> s_numUintNodes;
     static std::atomic<uint> s_numPathNodes;
 
+    /*! Memory taken by all uint/path nodes, including their children arrays */
+    static std::atomic<uint64_t> s_uintNodeBytes;
+    static std::atomic<uint64_t> s_pathNodeBytes;
+
     /*!
      * The value 65 is chosen so that all ASCII characters between 32 (' ') and 122 ('z')
      * get a unique entry in the 'children_' array.  The formula for mapping a character
@@ -39,25 +47,78 @@ private:
     /*! For 10 digits */
     static const uint s_uintNodeChildrenCount = 10;
 
-    /*! Arbitrary value */
+    /*!
+     * Capacities a children array goes through as children are added, as long as they are smaller than the number
+     * of possible children; past them, the array has a slot for every possible child.
+     */
+    static const uint s_childrenCapacities[3];
+
+    /*!
+     * The children of a node, in one of two layouts:
+     *   - sparse: up to 'capacity' children, stored in the order they were added; 'keys()[i]' is the
+     *             (1-based) key of the child in 'slots()[i]', or 0 if slot 'i' hasn't been claimed yet
+     *   - dense:  'slots()[key]' is the child with key 'key' ('capacity' is the number of possible children)
+     *
+     * Children are never removed, so the only change a full sparse array still goes through is a slot switching
+     * to a node that splits the edge to its child (see 'Trie::findNode').  Before replacing the array with a bigger
+     * copy, 'Trie::addChildNode' freezes every slot by setting the 'Frozen' bit of its pointer, after which a split
+     * fails to update the slot and starts over with the bigger array.
+     */
+    struct Children
+    {
+        static const uintptr_t Frozen = 1;
+
+        static Node* unfrozen(Node *node)  { return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(node) & ~Frozen); }
+
+        /*! Next array in the list of arrays a trie no longer uses (see 'Trie::retired_') */
+        Children *nextRetired;
+
+        uint capacity;
+        bool dense;
+
+        std::atomic<Node*>* slots()         { return reinterpret_cast<std::atomic<Node*>*>(this + 1); }
+        std::atomic<uint8_t>* keys()        { return reinterpret_cast<std::atomic<uint8_t>*>(slots() + capacity); }
+
+        static size_t sizeOf(uint capacity, bool dense)
+        {
+            return sizeof(Children) + capacity * sizeof(std::atomic<Node*>) + (dense ? 0 : capacity * sizeof(std::atomic<uint8_t>));
+        }
+    };
+
+    /*! Arbitrary value; only accessed through the atomic 'shared_ptr' functions (std::atomic_load etc.) */
     std::shared_ptr<T> record_;
 
-    /*! The length of the 'children_' array (i.e., the the number of allocated nodes) */
-    uint childrenLength_;
+    /*!
+     * The key of this node, from the root; never changes.  A node that splits an edge shares the keys of the node
+     * at the end of that edge (nodes are only deleted along with the trie), other nodes own theirs.
+     */
+    const uint8_t *keys_;
+
+    /*! The number of keys in 'keys_'; the parent of this node finds it by its key 'keys_[parent.depth_]' */
+    uint depth_;
+
+    bool ownsKeys_;
 
-    /*! Pre-allocated pointers to all possible children nodes. */
-    Node **children_;
+    /*! The number of possible children (i.e., the number of distinct keys) */
+    uint8_t maxKey_;
 
-    uint length()     const { return childrenLength_; }
-    Node** children() const { return children_; }
+    /*! Children of this node; null until the first child is added. */
+    std::atomic<Children*> children_;
 
-    static Node* createUintNode() { return new Node(s_uintNodeChildrenCount); }
-    static Node* createPathNode() { return new Node(s_pathNodeChildrenCount); }
+    uint length() const { return maxKey_; }
+
+    std::atomic<uint64_t>& bytesCounter() const { return maxKey_ == s_uintNodeChildrenCount ? s_uintNodeBytes : s_pathNodeBytes; }
+
+    /*! Allocates an empty children array that can hold 'capacity' children (returns null if out of memory) */
+    Children* createChildren(uint capacity) const;
+
+    /*! Frees an array returned by 'createChildren' */
+    void deleteChildren(Children *children) const;
 
 public:
 
     Node() = delete;
-    Node(uint numChildren);
+    Node(uint numChildren, const uint8_t *keys, uint depth, bool ownsKeys);
     ~Node();
 };
 
@@ -98,22 +159,22 @@ public:
 
     static void getUintNodeCounts(uint *count, double *sizeMB)
     {
-        getNodeCounts(Node<T>::s_numUintNodes, Node<T>::s_uintNodeChildrenCount, count, sizeMB);
+        getNodeCounts(Node<T>::s_numUintNodes, Node<T>::s_uintNodeBytes, count, sizeMB);
     }
 
     static void getPathNodeCounts(uint *count, double *sizeMB)
     {
-        getNodeCounts(Node<T>::s_numPathNodes, Node<T>::s_pathNodeChildrenCount, count, sizeMB);
+        getNodeCounts(Node<T>::s_numPathNodes, Node<T>::s_pathNodeBytes, count, sizeMB);
     }
 
 private:
 
     static const uint BytesInAMegabyte = 1 << 20;
 
-    inline static void getNodeCounts(uint count, uint numChildren, uint *outCount, double *outSizeMB)
+    inline static void getNodeCounts(uint count, uint64_t bytes, uint *outCount, double *outSizeMB)
     {
         *outCount = count;
-        *outSizeMB = (1.0 * count * (sizeof(Node<T>) + numChildren * sizeof(Node<T>*))) / BytesInAMegabyte;
+        *outSizeMB = (1.0 * bytes) / BytesInAMegabyte;
     }
 
     typedef enum { kUintTrie, kPathTrie } TrieKind;
@@ -134,20 +195,51 @@ private:
     /*! Payload for the 'onChangeCallback_' function */
     void *onChangeData_;
 
+    /*!
+     * Children arrays replaced by bigger ones.  A lookup running concurrently with the replacement may still be
+     * reading the old array, so they are only freed along with the trie (their total size is bounded by that of
+     * the arrays in use, since capacities at least quadruple).
+     */
+    std::atomic<typename Node<T>::Children*> retired_;
+
     /*! Invokes the 'onChangeCallback_' if it's set and 'newCount' is different from 'oldCount' */
     void triggerOnChange(int oldCount, int newCount) const;
 
     /*!
-     * Checks if a child node of 'node' exists at position 'idx'.
-     * If no such child node exists and 'createIfMissing' is true,
-     * a new child node is created and saved at position 'idx'.
+     * Returns the node for 'key', a sequence of 'key.length' keys between 0 (inclusive) and the number of possible
+     * children (exclusive) obtained through 'key[i]'.
+     * If no such node exists and 'createIfMissing' is true, it is created: either as a new leaf, or by splitting
+     * the edge that goes through it.
+     *
+     * Lock-free: concurrent calls creating the same node agree on a single node.
      *
-     * @param node The parent node.  Must not be null.
-     * @param idx Must be between 0 (inclusive) and 'node.length()' (exclusive); otherwise this method returns false.
-     * @param createIfMissing When true, this method creates a new child node at position 'idx' if one doesn't already exist.
-     * @result True IFF 'node' contains a child node at position 'idx' after this method returns.
+     * @result The node for 'key', or null if there is none (and it wasn't created) or the system is out of memory.
+     */
+    template <typename Key>
+    Node<T>* findNode(const Key &key, bool createIfMissing);
+
+    /*!
+     * Looks up the child with key 'idx' in 'children'; sets 'full' when 'children' has no room for it either, and
+     * 'slot' to the index of the slot the child is in.
      */
-    bool findChildNode(Node<T> *node, int idx, bool createIfMissing);
+    static Node<T>* findInChildren(typename Node<T>::Children *children, int idx, bool *full, uint *slot);
+
+    /*!
+     * Makes 'child' the child of 'node' with key 'idx' unless 'node' already has a child with that key.
+     *
+     * @result The child of 'node' with that key after this method returns: either 'child' or the node that won the race
+     *         (null if out of memory).
+     */
+    Node<T>* addChildNode(Node<T> *node, int idx, Node<T> *child);
+
+    /*! Returns the child in slot 'i' of a sparse children array, waiting for it if the slot is claimed but not yet filled */
+    static Node<T>* waitForSlot(typename Node<T>::Children *children, uint i);
+
+    /*! Like 'waitForSlot', and also freezes the slot (see 'Node::Children') */
+    static Node<T>* freezeSlot(typename Node<T>::Children *children, uint i);
+
+    /*! Adds 'children' to 'retired_' */
+    void retire(typename Node<T>::Children *children);
 
     /*!
      * Ensures that 'node' has its 'record_' field set to a non-null value.
@@ -255,11 +347,14 @@ private:
     /*! Calls 'findPathNode' with 'createIfMissing' set to false. */
     inline Node<T>* findExistingNodeForPath(const char *key) { return findPathNode(key, false); }
 
-    /*! Creates either a Uint or a Path node, based on the kind of this trie. */
-    inline Node<T>* createNode()
+    /*!
+     * Creates either a Uint or a Path node, based on the kind of this trie, for the key 'keys[0..depth)'.
+     * The node takes ownership of 'keys' when 'ownsKeys' is true.
+     */
+    inline Node<T>* createNode(const uint8_t *keys, uint depth, bool ownsKeys)
     {
-        return kind_ == kUintTrie ? Node<T>::createUintNode() :
-               kind_ == kPathTrie ? Node<T>::createPathNode() :
+        return kind_ == kUintTrie ? new Node<T>(Node<T>::s_uintNodeChildrenCount, keys, depth, ownsKeys) :
+               kind_ == kPathTrie ? new Node<T>(Node<T>::s_pathNodeChildrenCount, keys, depth, ownsKeys) :
                nullptr;
     }
 
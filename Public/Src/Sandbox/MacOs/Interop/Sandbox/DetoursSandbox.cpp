@@ -32,15 +32,21 @@ DetoursSandbox::DetoursSandbox(pid_t host_pid, process_callback callback, void *
                 xpc_type_t type = xpc_get_type(message);
                 if (type == XPC_TYPE_DICTIONARY)
                 {
-                    const char *msg = xpc_dictionary_get_string(message, IOEventKey);
-                    const uint64_t msg_length = xpc_dictionary_get_uint64(message, IOEventLengthKey);
+                    size_t msg_length = 0;
+                    const char *msg = (const char *) xpc_dictionary_get_data(message, IOEventKey, &msg_length);
 
-                    imemorystream ims(msg, msg_length);
-                    ims.imbue(std::locale(ims.getloc(), new PipeDelimiter));
-                    IOEvent event;
-                    ims >> event;
+                    IOEventView event;
+                    if (msg == nullptr || !IOEvent::Deserialize(msg, msg_length, event))
+                    {
+                        log_error("Dropping malformed IOEvent message of %zu bytes", msg_length);
+                        xpc_object_t reply = xpc_dictionary_create_reply(message);
+                        xpc_dictionary_set_uint64(reply, "response", xpc_response_error);
+                        xpc_connection_send_message((xpc_connection_t) peer, reply);
+                        return;
+                    }
 
-                    eventCallback_(sandbox, const_cast<const IOEvent &>(event), hostPid_, IOEventBacking::Interposing);
+                    // the paths of 'event' point into 'message', so they are copied (once) into the event the callback gets
+                    eventCallback_(sandbox, IOEvent(event), hostPid_, IOEventBacking::Interposing);
 
                     xpc_object_t reply = xpc_dictionary_create_reply(message);
                     xpc_dictionary_set_uint64(reply, "response", xpc_response_success);
@@ -26,12 +26,6 @@ static ProcessCallbackResult _process_event(Sandbox *sandbox, const IOEvent &eve
     bool ppid_found = sandbox->GetAllowlistedPidMap().find(event.GetParentPid()) != sandbox->GetAllowlistedPidMap().end();
     bool original_ppid_found = sandbox->GetAllowlistedPidMap().find(event.GetOriginalParentPid()) != sandbox->GetAllowlistedPidMap().end();
 
-    size_t msg_length = IOEvent::max_size();
-    char msg[msg_length];
-
-    omemorystream oms(msg, sizeof(msg));
-    oms << event;
-
     if (isInterposedEvent || (ppid_found || original_ppid_found))
     {
         IOHandler handler = IOHandler(sandbox);
@@ -105,12 +99,8 @@ static ProcessCallbackResult _process_event(Sandbox *sandbox, const IOEvent &eve
         else
         {
             // TODO: Delete
-            size_t msg_length = IOEvent::max_size();
-            char msg[msg_length];
-
-            omemorystream oms(msg, sizeof(msg));
-            oms << event;
-            log_debug("Not tracked: %{public}.*s",(int) event.Size(), msg);
+            log_debug("Not tracked: PID(%d) PPID(%d) type(%d) path: %{public}s",
+                      event.GetPid(), event.GetParentPid(), event.GetEventType(), event.GetEventPath());
         }
 
         if (event.GetActionType() == ES_ACTION_TYPE_AUTH)
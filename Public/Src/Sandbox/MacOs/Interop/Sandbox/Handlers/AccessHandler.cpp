@@ -24,17 +24,18 @@ PolicySearchCursor AccessHandler::FindManifestRecord(const char *absolutePath, s
     return FindFileAccessPolicyInTreeEx(GetPip()->GetManifestRecord(), pathWithoutRootSentinel, len);
 }
 
-void AccessHandler::SetProcessPath(AccessReport *report)
+void AccessHandler::SetProcessPath(AccessReportView *report)
 {
-    strlcpy(report->path, process_->GetPath(), sizeof(report->path));
+    report->path       = process_->GetPath();
+    report->pathLength = process_->GetPathLength();
 }
 
 ReportResult AccessHandler::ReportFileOpAccess(FileOperation operation,
-                                               PolicyResult policyResult,
+                                               const PolicyResult &policyResult,
                                                AccessCheckResult checkResult,
                                                pid_t processID)
 {
-    AccessReport report =
+    AccessReportView report =
     {
         .operation          = operation,
         .pid                = processID,
@@ -44,12 +45,12 @@ ReportResult AccessHandler::ReportFileOpAccess(FileOperation operation,
         .reportExplicitly   = checkResult.Level == ReportLevel::ReportExplicit,
         .error              = 0,
         .pipId              = GetPipId(),
-        .path               = {0},
-        .stats              = {0}
+        .stats              = { .creationTime = creationTimestamp_ },
+        .path               = policyResult.Path(),
+        .pathLength         = strlen(policyResult.Path())
     };
 
-    assert(strlen(policyResult.Path()) > 0);
-    strlcpy(report.path, policyResult.Path(), sizeof(report.path));
+    assert(report.pathLength > 0);
     sandbox_->SendAccessReport(report, GetPip());
 
     return kReported;
@@ -57,7 +58,7 @@ ReportResult AccessHandler::ReportFileOpAccess(FileOperation operation,
 
 bool AccessHandler::ReportProcessTreeCompleted(pid_t processId)
 {
-    AccessReport report =
+    AccessReportView report =
     {
         .operation        = kOpProcessTreeCompleted,
         .pid              = processId,
@@ -67,8 +68,9 @@ bool AccessHandler::ReportProcessTreeCompleted(pid_t processId)
         .reportExplicitly = 0,
         .error            = 0,
         .pipId            = GetPipId(),
-        .path             = {0},
-        .stats            = {0}
+        .stats            = { .creationTime = creationTimestamp_ },
+        .path             = nullptr,
+        .pathLength       = 0
     };
 
     SetProcessPath(&report);
@@ -79,7 +81,7 @@ bool AccessHandler::ReportProcessTreeCompleted(pid_t processId)
 
 bool AccessHandler::ReportProcessExited(pid_t childPid)
 {
-    AccessReport report =
+    AccessReportView report =
     {
         .operation        = kOpProcessExit,
         .pid              = childPid,
@@ -89,8 +91,9 @@ bool AccessHandler::ReportProcessExited(pid_t childPid)
         .reportExplicitly = 0,
         .error            = 0,
         .pipId            = GetPipId(),
-        .path             = {0},
-        .stats            = {0}
+        .stats            = { .creationTime = creationTimestamp_ },
+        .path             = nullptr,
+        .pathLength       = 0
     };
 
     SetProcessPath(&report);
@@ -101,7 +104,7 @@ bool AccessHandler::ReportProcessExited(pid_t childPid)
 
 bool AccessHandler::ReportChildProcessSpawned(pid_t childPid)
 {
-    AccessReport report =
+    AccessReportView report =
     {
         .operation          = kOpProcessStart,
         .pid                = childPid,
@@ -111,12 +114,13 @@ bool AccessHandler::ReportChildProcessSpawned(pid_t childPid)
         .reportExplicitly   = 0,
         .error              = 0,
         .pipId              = GetPipId(),
-        .path               = {0},
-        .stats              = {0}
+        .stats              = { .creationTime = creationTimestamp_ },
+        .path               = nullptr,
+        .pathLength         = 0
     };
 
     SetProcessPath(&report);
-    assert(strlen(report.path) > 0);
+    assert(report.pathLength > 0);
     sandbox_->SendAccessReport(report, GetPip());
 
     return kReported;
@@ -133,6 +137,8 @@ PolicyResult AccessHandler::PolicyForPath(const char *absolutePath)
     return PolicyResult(GetPip()->GetFamFlags(), GetPip()->GetFamExtraFlags(), absolutePath, cursor);
 }
 
+#if __APPLE__
+
 static bool is_prefix(const char *s1, const char *s2)
 {
     int c;
@@ -158,22 +164,4 @@ const char* AccessHandler::IgnoreDataPartitionPrefix(const char* path)
     return marker;
 }
 
-AccessCheckResult AccessHandler::CheckAndReportInternal(FileOperation operation,
-                                                        const char *path,
-                                                        CheckFunc checker,
-                                                        const pid_t pid,
-                                                        bool isDir)
-{
-    PolicyResult policy = PolicyForPath(IgnoreDataPartitionPrefix(path));
-    AccessCheckResult result = AccessCheckResult::Invalid();
-    checker(policy, isDir, &result);
-
-    if (!result.ShouldReport())
-    {
-        return result;
-    }
-
-    ReportFileOpAccess(operation, policy, result, pid);
-
-    return result;
-}
+#endif
@@ -22,16 +22,23 @@ struct AccessHandler
 
 private:
 
+#if __APPLE__
     const char *IgnoreDataPartitionPrefix(const char* path);
     const char *kDataPartitionPrefix = "/System/Volumes/Data/";
     const size_t kAdjustedPrefixLength = strlen("/System/Volumes/Data");
+#else
+    // only macOS mounts the data partition under '/System/Volumes/Data'
+    inline const char *IgnoreDataPartitionPrefix(const char* path) { return path; }
+#endif
 
     Sandbox *sandbox_;
 
     std::shared_ptr<SandboxedProcess> process_;
 
+    uint64_t creationTimestamp_;
+
     ReportResult ReportFileOpAccess(FileOperation operation,
-                                    PolicyResult policy,
+                                    const PolicyResult &policy,
                                     AccessCheckResult accessCheckResult,
                                     pid_t processID);
 
@@ -44,35 +51,37 @@ protected:
     PolicySearchCursor FindManifestRecord(const char *absolutePath, size_t pathLength = -1);
 
     /*!
-     * Copies 'process_->getPath()' into 'report->path'.
+     * Points 'report->path' at 'process_->GetPath()'.
      */
-    void SetProcessPath(AccessReport *report);
+    void SetProcessPath(AccessReportView *report);
 
     /*!
      * Template for checking and reporting file accesses.
      *
-     * The key used for looking up if the operation was already reported is "<operation>,<path>".
+     * The checker is a template argument (rather than a 'CheckFunc' argument) so that it gets inlined at every call
+     * site; callers that pick a checker at run time branch between the instantiations they need.
      *
+     * @param Checker Checker function to apply to policy
      * @param operation Operation to be executed
      * @param path Absolute path against which the operation is to be executed
-     * @param checker Checker function to apply to policy
      * @param pid The id of the process belonging to this I/O obsevation
      * @param isDir Indicates if the report is being generated for a directory or file
      */
-    AccessCheckResult CheckAndReportInternal(FileOperation operation,
-                                     const char *path,
-                                     CheckFunc checker,
-                                     const pid_t pid,
-                                     bool isDir);
-
-    inline AccessCheckResult CheckAndReport(FileOperation operation, const char *path, CheckFunc checker, const pid_t pid)
+    template <CheckFunc Checker>
+    inline AccessCheckResult CheckAndReport(FileOperation operation, const char *path, const pid_t pid, bool isDir = false)
     {
-        return CheckAndReportInternal(operation, path, checker, pid, false);
-    }
+        PolicyResult policy = PolicyForPath(IgnoreDataPartitionPrefix(path));
+        AccessCheckResult result = AccessCheckResult::Invalid();
+        Checker(policy, isDir, &result);
 
-    inline AccessCheckResult CheckAndReport(FileOperation operation, const char *path, CheckFunc checker, const pid_t pid, bool isDir)
-    {
-        return CheckAndReportInternal(operation, path, checker, pid, isDir);
+        if (!result.ShouldReport())
+        {
+            return result;
+        }
+
+        ReportFileOpAccess(operation, policy, result, pid);
+
+        return result;
     }
 
 public:
@@ -83,6 +92,7 @@ public:
     {
         sandbox_           = sandbox;
         process_           = nullptr;
+        creationTimestamp_ = 0;
     }
 
     ~AccessHandler()
@@ -105,6 +115,11 @@ public:
 
     inline void SetProcess(std::shared_ptr<SandboxedProcess> process) { process_ = process; }
 
+    /*!
+     * Sets the creation time of the reports sent by this handler (see AccessReportStatistics), which otherwise is 0.
+     */
+    inline void SetCreationTimestamp(uint64_t timestamp) { creationTimestamp_ = timestamp; }
+
     inline bool HasTrackedProcess()             const { return process_ != nullptr; }
     inline pid_t GetProcessId()                 const { return GetPip()->GetProcessId(); }
     inline pipid_t GetPipId()                   const { return GetPip()->GetPipId(); }
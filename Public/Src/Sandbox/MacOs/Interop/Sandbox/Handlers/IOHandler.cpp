@@ -53,7 +53,7 @@ AccessCheckResult IOHandler::HandleProcessUntracked(const pid_t pid)
 
 AccessCheckResult IOHandler::HandleLookup(const IOEvent &event)
 {
-    return CheckAndReport(kOpMacLookup, event.GetEventPath(SRC_PATH), Checkers::CheckLookup, event.GetPid(), /*isDir*/ false);
+    return CheckAndReport<Checkers::CheckLookup>(kOpMacLookup, event.GetEventPath(SRC_PATH), event.GetPid(), /*isDir*/ false);
 }
 
 AccessCheckResult IOHandler::HandleOpen(const IOEvent &event)
@@ -68,97 +68,104 @@ AccessCheckResult IOHandler::HandleOpen(const IOEvent &event)
         {
             bool isDir = S_ISDIR(sb.st_mode);
 
-            CheckFunc checker = isDir ? Checkers::CheckEnumerateDir : Checkers::CheckRead;
-            FileOperation op  = isDir ? kOpKAuthOpenDir : kOpKAuthReadFile;
-
-            return CheckAndReport(op, event.GetEventPath(SRC_PATH), checker, event.GetPid(), isDir);
+            return isDir
+                ? CheckAndReport<Checkers::CheckEnumerateDir>(kOpKAuthOpenDir, event.GetEventPath(SRC_PATH), event.GetPid(), isDir)
+                : CheckAndReport<Checkers::CheckRead>(kOpKAuthReadFile, event.GetEventPath(SRC_PATH), event.GetPid(), isDir);
         }
 
         return AccessCheckResult::Invalid();
         // Fallback
-        return CheckAndReport(kOpMacLookup, event.GetEventPath(SRC_PATH), Checkers::CheckLookup, event.GetPid(), false);
+        return CheckAndReport<Checkers::CheckLookup>(kOpMacLookup, event.GetEventPath(SRC_PATH), event.GetPid(), false);
     }
 
     bool isDir = S_ISDIR(event.GetMode());
 
-    CheckFunc checker = isDir ? Checkers::CheckEnumerateDir : Checkers::CheckRead;
-    FileOperation op  = isDir ? kOpKAuthOpenDir : kOpKAuthReadFile;
-
-    return CheckAndReport(op, event.GetEventPath(SRC_PATH), checker, event.GetPid(), isDir);
+    return isDir
+        ? CheckAndReport<Checkers::CheckEnumerateDir>(kOpKAuthOpenDir, event.GetEventPath(SRC_PATH), event.GetPid(), isDir)
+        : CheckAndReport<Checkers::CheckRead>(kOpKAuthReadFile, event.GetEventPath(SRC_PATH), event.GetPid(), isDir);
 }
 
 AccessCheckResult IOHandler::HandleClose(const IOEvent &event)
 {
     if (event.FSEntryModified())
     {
-        return CheckAndReport(kOpKAuthCloseModified, event.GetEventPath(SRC_PATH), Checkers::CheckWrite, event.GetPid());
+        return CheckAndReport<Checkers::CheckCloseModified>(kOpKAuthCloseModified, event.GetEventPath(SRC_PATH), event.GetPid());
     }
 
     bool isDir = S_ISDIR(event.GetMode());
-    return CheckAndReport(kOpKAuthClose, event.GetEventPath(SRC_PATH), Checkers::CheckRead, event.GetPid(), isDir);
+    return CheckAndReport<Checkers::CheckRead>(kOpKAuthClose, event.GetEventPath(SRC_PATH), event.GetPid(), isDir);
 }
 
 AccessCheckResult IOHandler::HandleLink(const IOEvent &event)
 {
     return AccessCheckResult::Combine(
-        CheckAndReport(kOpKAuthCreateHardlinkSource, event.GetEventPath(SRC_PATH), Checkers::CheckRead, event.GetPid()),
-        CheckAndReport(kOpKAuthCreateHardlinkDest, event.GetEventPath(DST_PATH), Checkers::CheckWrite, event.GetPid()));
+        CheckAndReport<Checkers::CheckRead>(kOpKAuthCreateHardlinkSource, event.GetEventPath(SRC_PATH), event.GetPid()),
+        CheckAndReport<Checkers::CheckWrite>(kOpKAuthCreateHardlinkDest, event.GetEventPath(DST_PATH), event.GetPid()));
 }
 
 AccessCheckResult IOHandler::HandleUnlink(const IOEvent &event)
 {
     bool isDir = S_ISDIR(event.GetMode());
     FileOperation operation = isDir ? kOpKAuthDeleteDir : kOpKAuthDeleteFile;
-    return CheckAndReport(operation, event.GetEventPath(SRC_PATH), Checkers::CheckWrite, event.GetPid());
+    return CheckAndReport<Checkers::CheckWrite>(operation, event.GetEventPath(SRC_PATH), event.GetPid());
 }
 
 AccessCheckResult IOHandler::HandleReadlink(const IOEvent &event)
 {
-    return CheckAndReport(kOpMacReadlink, event.GetEventPath(SRC_PATH), Checkers::CheckRead, event.GetPid(), false);
+    return CheckAndReport<Checkers::CheckRead>(kOpMacReadlink, event.GetEventPath(SRC_PATH), event.GetPid(), false);
 }
 
 AccessCheckResult IOHandler::HandleRename(const IOEvent &event)
 {
     return AccessCheckResult::Combine(
-        CheckAndReport(kOpKAuthMoveSource, event.GetEventPath(SRC_PATH), Checkers::CheckRead, event.GetPid()),
-        CheckAndReport(kOpKAuthMoveDest, event.GetEventPath(DST_PATH), Checkers::CheckWrite, event.GetPid()));
+        CheckAndReport<Checkers::CheckRead>(kOpKAuthMoveSource, event.GetEventPath(SRC_PATH), event.GetPid()),
+        CheckAndReport<Checkers::CheckWrite>(kOpKAuthMoveDest, event.GetEventPath(DST_PATH), event.GetPid()));
 }
 
 AccessCheckResult IOHandler::HandleClone(const IOEvent &event)
 {
     return AccessCheckResult::Combine(
-        CheckAndReport(kOpMacVNodeCloneSource, event.GetEventPath(SRC_PATH), Checkers::CheckReadWrite, event.GetPid()),
-        CheckAndReport(kOpMacVNodeCloneDest, event.GetEventPath(DST_PATH), Checkers::CheckReadWrite, event.GetPid()));
+        CheckAndReport<Checkers::CheckReadWrite>(kOpMacVNodeCloneSource, event.GetEventPath(SRC_PATH), event.GetPid()),
+        CheckAndReport<Checkers::CheckReadWrite>(kOpMacVNodeCloneDest, event.GetEventPath(DST_PATH), event.GetPid()));
 }
 
 AccessCheckResult IOHandler::HandleExchange(const IOEvent &event)
 {
     return AccessCheckResult::Combine(
-        CheckAndReport(kOpKAuthCopySource, event.GetEventPath(SRC_PATH), Checkers::CheckReadWrite, event.GetPid()),
-        CheckAndReport(kOpKAuthCopyDest, event.GetEventPath(DST_PATH), Checkers::CheckReadWrite, event.GetPid()));
+        CheckAndReport<Checkers::CheckReadWrite>(kOpKAuthCopySource, event.GetEventPath(SRC_PATH), event.GetPid()),
+        CheckAndReport<Checkers::CheckReadWrite>(kOpKAuthCopyDest, event.GetEventPath(DST_PATH), event.GetPid()));
 }
 
 AccessCheckResult IOHandler::HandleCreate(const IOEvent &event)
 {
-    CheckFunc checker = Checkers::CheckWrite;
-    bool isDir = false;
+    const char *path = event.GetEventPath(SRC_PATH);
 
-    if (event.EventPathExists())
+    if (!event.EventPathExists())
     {
-        mode_t mode = event.GetMode();
-        bool enforceDirectoryCreation = CheckDirectoryCreationAccessEnforcement(GetFamFlags());
-        isDir = S_ISDIR(mode);
-
-        checker =
-            S_ISLNK(mode) ? Checkers::CheckCreateSymlink
-                          : S_ISREG(mode)
-                            ? Checkers::CheckWrite
-                            : enforceDirectoryCreation
-                                ? Checkers::CheckCreateDirectory
-                                : Checkers::CheckCreateDirectoryNoEnforcement;
+        return CheckAndReport<Checkers::CheckWrite>(kOpMacVNodeCreate, path, event.GetPid());
     }
 
-    return CheckAndReport(isDir ? kOpKAuthCreateDir : kOpMacVNodeCreate, event.GetEventPath(SRC_PATH), checker, event.GetPid(), isDir);
+    mode_t mode = event.GetMode();
+    bool enforceDirectoryCreation = CheckDirectoryCreationAccessEnforcement(GetFamFlags());
+    bool isDir = S_ISDIR(mode);
+    FileOperation operation = isDir ? kOpKAuthCreateDir : kOpMacVNodeCreate;
+
+    if (S_ISLNK(mode))
+    {
+        return CheckAndReport<Checkers::CheckCreateSymlink>(operation, path, event.GetPid(), isDir);
+    }
+    else if (S_ISREG(mode))
+    {
+        return CheckAndReport<Checkers::CheckWrite>(operation, path, event.GetPid(), isDir);
+    }
+    else if (enforceDirectoryCreation)
+    {
+        return CheckAndReport<Checkers::CheckCreateDirectory>(operation, path, event.GetPid(), isDir);
+    }
+    else
+    {
+        return CheckAndReport<Checkers::CheckCreateDirectoryNoEnforcement>(operation, path, event.GetPid(), isDir);
+    }
 }
 
 AccessCheckResult IOHandler::HandleGenericWrite(const IOEvent &event)
@@ -167,7 +174,7 @@ AccessCheckResult IOHandler::HandleGenericWrite(const IOEvent &event)
     mode_t mode = event.GetMode();
     bool isDir = S_ISDIR(mode);
 
-    return CheckAndReport(kOpKAuthVNodeWrite, path, Checkers::CheckWrite, event.GetPid(), isDir);
+    return CheckAndReport<Checkers::CheckWrite>(kOpKAuthVNodeWrite, path, event.GetPid(), isDir);
 }
 
 AccessCheckResult IOHandler::HandleGenericRead(const IOEvent &event)
@@ -178,11 +185,11 @@ AccessCheckResult IOHandler::HandleGenericRead(const IOEvent &event)
 
     if (!event.EventPathExists())
     {
-        return CheckAndReport(kOpMacLookup, path, Checkers::CheckLookup, event.GetPid(), false);
+        return CheckAndReport<Checkers::CheckLookup>(kOpMacLookup, path, event.GetPid(), false);
     }
     else
     {
-        return CheckAndReport(kOpKAuthVNodeRead, path, Checkers::CheckRead, event.GetPid(), isDir);
+        return CheckAndReport<Checkers::CheckRead>(kOpKAuthVNodeRead, path, event.GetPid(), isDir);
     }
 }
 
@@ -193,11 +200,11 @@ AccessCheckResult IOHandler::HandleGenericProbe(const IOEvent &event)
 
     if (!event.EventPathExists())
     {
-        return CheckAndReport(kOpMacLookup, path, Checkers::CheckLookup, event.GetPid(), false);
+        return CheckAndReport<Checkers::CheckLookup>(kOpMacLookup, path, event.GetPid(), false);
     }
     else
     {
-        return CheckAndReport(kOpKAuthVNodeProbe, path, Checkers::CheckProbe, event.GetPid(), isDir);
+        return CheckAndReport<Checkers::CheckProbe>(kOpKAuthVNodeProbe, path, event.GetPid(), isDir);
     }
 }
 
@@ -7,6 +7,14 @@
 
 static Sandbox* sandbox;
 
+// The callback of the managed interop, which takes reports in the fixed-size 'AccessReport' layout
+static AccessReportCallback s_managedAccessReportCallback;
+
+static void ForwardAccessReportToManagedCallback(const AccessReportView &report, int status)
+{
+    s_managedAccessReportCallback(report.ToAccessReport(), status);
+}
+
 extern "C"
 {
 #pragma mark Exported interop methods
@@ -46,7 +54,8 @@ extern "C"
             return;
         }
 
-        sandbox->SetAccessReportCallback(callback);
+        s_managedAccessReportCallback = callback;
+        sandbox->SetAccessReportCallback(ForwardAccessReportToManagedCallback);
 
         log_debug("Listening for observation reports for build host with pid (%d)...", getpid());
     }
@@ -98,10 +107,10 @@ Sandbox::Sandbox(pid_t host_pid, Configuration config)
 
     accessReportCallback_ = nullptr;
 
-    trackedProcesses_ = Trie<SandboxedProcess>::createUintTrie();
+    trackedProcesses_ = new ConcurrentPidMap<SandboxedProcess>();
     if (!trackedProcesses_)
     {
-        throw BuildXLException("Could not create Trie for process tracking!");
+        throw BuildXLException("Could not create map for process tracking!");
     }
 
 #if __APPLE__
@@ -310,11 +319,11 @@ bool Sandbox::UntrackProcess(pid_t pid, std::shared_ptr<SandboxedProcess> proces
     return removedExisting;
 }
 
-void const Sandbox::SendAccessReport(AccessReport &report, std::shared_ptr<SandboxedPip> pip)
+void const Sandbox::SendAccessReport(const AccessReportView &report, std::shared_ptr<SandboxedPip> pip)
 {
-    assert(strlen(report.path) > 0);
+    assert(report.pathLength > 0);
     accessReportCallback_(report, REPORT_QUEUE_SUCCESS);
 
-    log_debug("Enqueued PID(%d), Root PID(%d), PIP(%#llX), Operation: %{public}s, Path: %{public}s, Status: %d",
-              report.pid, report.rootPid, report.pipId, OpNames[report.operation], report.path, report.status);
+    log_debug("Enqueued PID(%d), Root PID(%d), PIP(%#llX), Operation: %{public}s, Path: %{public}.*s, Status: %d",
+              report.pid, report.rootPid, report.pipId, OpNames[report.operation], (int)report.pathLength, report.path, report.status);
 }
@@ -6,12 +6,12 @@
 
 #include "BuildXLException.hpp"
 #include "Common.hpp"
+#include "ConcurrentPidMap.hpp"
 #include "DetoursSandbox.hpp"
 #include "EndpointSecuritySandbox.hpp"
 #include "IOEvent.hpp"
 #include "SandboxedPip.hpp"
 #include "SandboxedProcess.hpp"
-#include "Trie.hpp"
 
 #include <signal.h>
 #include <map>
@@ -59,8 +59,8 @@ private:
     std::map<pid_t, pid_t> allowlistedPids_;
     std::map<pid_t, pid_t> forceForkedPids_;
     
-    Trie<SandboxedProcess> *trackedProcesses_ = nullptr;
-    AccessReportCallback accessReportCallback_ = nullptr;
+    ConcurrentPidMap<SandboxedProcess> *trackedProcesses_ = nullptr;
+    AccessReportViewCallback accessReportCallback_ = nullptr;
     
     DetoursSandbox* detours_ = nullptr;
     EndpointSecuritySandbox* es_ = nullptr;
@@ -104,14 +104,14 @@ public:
         return false;
     }
     
-    inline const void SetAccessReportCallback(AccessReportCallback callback) { accessReportCallback_ = callback; }
+    inline const void SetAccessReportCallback(AccessReportViewCallback callback) { accessReportCallback_ = callback; }
     
     std::shared_ptr<SandboxedProcess> FindTrackedProcess(pid_t pid);
     bool TrackRootProcess(std::shared_ptr<SandboxedPip> pip);
     bool TrackChildProcess(pid_t childPid, const char* childExecutable, std::shared_ptr<SandboxedProcess> parentProcess);
     bool UntrackProcess(pid_t pid, std::shared_ptr<SandboxedProcess> process);
     
-    void const SendAccessReport(AccessReport &report, std::shared_ptr<SandboxedPip> pip);
+    void const SendAccessReport(const AccessReportView &report, std::shared_ptr<SandboxedPip> pip);
 };
 
 #endif /* Sandbox_h */
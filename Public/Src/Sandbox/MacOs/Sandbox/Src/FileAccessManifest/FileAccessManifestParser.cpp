@@ -63,6 +63,52 @@ inline uint32_t ParseUint32(const BYTE *&cursor)
     return i;
 }
 
+// Appends the string to 'str', converted from UTF-16 (how C# writes chars) to UTF-8.
+void ParseCharArray(const BYTE *&cursor, std::string &str)
+{
+    uint32_t len = ParseUint32(cursor);
+    const uint8_t *chars = (const uint8_t *)cursor; // (BYTE is signed here)
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t c = chars[2 * i] | (chars[2 * i + 1] << 8);
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < len)
+        {
+            // high surrogate: the code point takes two chars
+            uint32_t low = chars[2 * (i + 1)] | (chars[2 * (i + 1) + 1] << 8);
+            if (low >= 0xDC00 && low < 0xE000)
+            {
+                c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+
+        if (c < 0x80)
+        {
+            str.push_back((char)c);
+        }
+        else if (c < 0x800)
+        {
+            str.push_back((char)(0xC0 | (c >> 6)));
+            str.push_back((char)(0x80 | (c & 0x3F)));
+        }
+        else if (c < 0x10000)
+        {
+            str.push_back((char)(0xE0 | (c >> 12)));
+            str.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            str.push_back((char)(0x80 | (c & 0x3F)));
+        }
+        else
+        {
+            str.push_back((char)(0xF0 | (c >> 18)));
+            str.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+            str.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+            str.push_back((char)(0x80 | (c & 0x3F)));
+        }
+    }
+
+    cursor += sizeof(char16_t) * len;
+}
+
 const char *CheckValidUnixManifestTreeRoot(PCManifestRecord node)
 {
     // empty manifest is ok
@@ -114,6 +160,8 @@ bool FileAccessManifestParseResult::init(const BYTE *payload, size_t payloadSize
         manifestTranslatePathsStrings_ = ParseAndAdvancePointer<PManifestTranslatePathsStrings>(payloadCursor);
         if (HasErrors()) continue;
 
+        // parsed on demand (see GetTranslatePaths)
+        translatePaths_ = payloadCursor;
         for (uint32_t i = 0; i < manifestTranslatePathsStrings_->Count; i++)
         {
             SkipOverCharArray(payloadCursor); // 'from' path
@@ -165,6 +213,18 @@ bool FileAccessManifestParseResult::init(const BYTE *payload, size_t payloadSize
     return !HasErrors();
 }
 
+void FileAccessManifestParseResult::GetTranslatePaths(std::vector<std::pair<std::string, std::string>> &translations) const
+{
+    const BYTE *cursor = translatePaths_;
+    for (uint32_t i = 0; i < manifestTranslatePathsStrings_->Count; i++)
+    {
+        std::pair<std::string, std::string> translation;
+        ParseCharArray(cursor, translation.first);
+        ParseCharArray(cursor, translation.second);
+        translations.push_back(std::move(translation));
+    }
+}
+
 // Debugging helper
 void FileAccessManifestParseResult::PrintManifestTree(PCManifestRecord node,
                                                       const int indent,
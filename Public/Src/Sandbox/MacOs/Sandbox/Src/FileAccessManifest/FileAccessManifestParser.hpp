@@ -4,6 +4,9 @@
 #ifndef FileAccessManifestParser_hpp
 #define FileAccessManifestParser_hpp
 
+#include <string>
+#include <utility>
+#include <vector>
 #include "FileAccessHelpers.h"
 
 struct FileAccessManifestParseResult
@@ -15,6 +18,7 @@ private:
     PCManifestInjectionTimeout injectionTimeoutFlag_;
     PManifestChildProcessesToBreakAwayFromJob manifestChildProcessesToBreakAwayFromJob_;
     PManifestTranslatePathsStrings manifestTranslatePathsStrings_;
+    const BYTE *translatePaths_;
     PCManifestFlags flags_;
     PCManifestExtraFlags extraFlags_;
     PCManifestPipId pipId_;
@@ -60,6 +64,9 @@ public:
     }
     inline const char* GetProcessPath(int *length) const { return GetReportsPath(length); }
 
+    // Appends the ('from', 'to') path translations of the manifest, in its order, as UTF-8
+    void GetTranslatePaths(std::vector<std::pair<std::string, std::string>> &translations) const;
+
     // Debugging helper
     static void PrintManifestTree(PCManifestRecord node, const int indent = 0, const int index = 0);
 };
@@ -6,24 +6,107 @@
 
 #include "PolicyResult.h"
 
-typedef void (*CheckFunc)(PolicyResult policy, bool isDirectory, AccessCheckResult *result);
+typedef void (*CheckFunc)(const PolicyResult &policy, bool isDirectory, AccessCheckResult *result);
 
+/*!
+ * The checkers are defined here, rather than in a translation unit of their own, so that callers that know which
+ * checker to apply at compile time (e.g., 'AccessHandler::CheckAndReport<Checkers::CheckRead>') get it inlined.
+ * Each of them still converts to a 'CheckFunc' for the callers that pick a checker at run time.
+ */
 class Checkers
 {
 private:
     Checkers() {}
-    
+
 public:
-    static CheckFunc CheckExecute;
-    static CheckFunc CheckRead;
-    static CheckFunc CheckLookup;
-    static CheckFunc CheckWrite;
-    static CheckFunc CheckProbe;
-    static CheckFunc CheckReadWrite;
-    static CheckFunc CheckEnumerateDir;
-    static CheckFunc CheckCreateSymlink;
-    static CheckFunc CheckCreateDirectory;
-    static CheckFunc CheckCreateDirectoryNoEnforcement;
+    static void CheckExecute(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        RequestedReadAccess requestedAccess = isDir
+            ? RequestedReadAccess::Probe
+            : RequestedReadAccess::Read;
+
+        *checkResult = policy.CheckReadAccess(requestedAccess, FileReadContext(FileExistence::Existent, isDir));
+    }
+
+    static void CheckProbe(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        *checkResult = policy.CheckReadAccess(RequestedReadAccess::Probe, FileReadContext(FileExistence::Existent, isDir));
+    }
+
+    static void CheckRead(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        if (isDir)
+        {
+            CheckEnumerateDir(policy, isDir, checkResult);
+        }
+        else
+        {
+            *checkResult = policy.CheckReadAccess(RequestedReadAccess::Read, FileReadContext(FileExistence::Existent, isDir));
+        }
+    }
+
+    static void CheckLookup(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        *checkResult = policy.CheckReadAccess(RequestedReadAccess::Probe, FileReadContext(FileExistence::Nonexistent));
+        checkResult->Access = RequestedAccess::Lookup;
+    }
+
+    static void CheckEnumerateDir(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        *checkResult = AccessCheckResult(
+            RequestedAccess::Enumerate,
+            ResultAction::Allow,
+            policy.ReportDirectoryEnumeration() ? ReportLevel::ReportExplicit : ReportLevel::Ignore);
+    }
+
+    static void CheckWrite(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        *checkResult = isDir
+            ? policy.CheckReadAccess(RequestedReadAccess::Probe, FileReadContext(FileExistence::Existent, isDir))
+            : policy.CheckWriteAccess();
+    }
+
+    static void CheckReadWrite(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        AccessCheckResult readResult = AccessCheckResult::Invalid();
+        CheckRead(policy, isDir, &readResult);
+
+        AccessCheckResult writeResult = AccessCheckResult::Invalid();
+        CheckRead(policy, isDir, &writeResult);
+
+        *checkResult = AccessCheckResult::Combine(readResult, writeResult);
+    }
+
+    static void CheckCreateSymlink(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        *checkResult = policy.CheckSymlinkCreationAccess();
+    }
+
+    static void CheckCreateDirectory(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        *checkResult = policy.CheckCreateDirectoryAccess();
+    }
+
+    static void CheckCreateDirectoryNoEnforcement(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        // CODESYNC: CreateDirectoryW in DetouredFunctions.cpp
+        *checkResult = policy.CheckCreateDirectoryAccess();
+        if (checkResult->ShouldDenyAccess())
+        {
+            CheckProbe(policy, isDir, checkResult);
+        }
+    }
+
+    static void CheckCloseModified(const PolicyResult &policy, bool isDir, AccessCheckResult *checkResult)
+    {
+        CheckWrite(policy, isDir, checkResult);
+
+        // a content hash computed by the sandbox is useless unless it makes it to the engine
+        if (policy.ReportContentHashOnClose() && !checkResult->ShouldReport())
+        {
+            checkResult->Level = ReportLevel::Report;
+        }
+    }
 };
 
 #endif /* Checkers_hpp */
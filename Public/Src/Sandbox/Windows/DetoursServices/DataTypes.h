@@ -92,7 +92,8 @@ inline bool CheckReportAnyAccess(FileAccessManifestFlag flags, bool accessDenied
 //
 #define FOR_ALL_FAM_EXTRA_FLAGS(m) \
     m(NoneExtra,                          0x0) \
-    m(ExplicitlyReportDirectoryProbes,    0x1)
+    m(ExplicitlyReportDirectoryProbes,    0x1) \
+    m(ReportSandboxStatistics,            0x2)
 
 enum class FileAccessManifestExtraFlag {
     FOR_ALL_FAM_EXTRA_FLAGS(GEN_FAM_FLAG_ENUM_NAME_VALUE)
@@ -155,6 +156,10 @@ enum FileAccessPolicy
     // If set, full reparse point tracking should be done for this path/file
     FileAccessPolicy_EnableFullReparsePointParsing = 0x1000,
 
+    // If set, the sandbox hashes the content of files under this scope that were opened for writing when they are closed,
+    // and attaches the digest to the close report. Currently only honored by the Linux sandbox.
+    FileAccessPolicy_ReportContentHashOnClose = 0x2000,
+
     // If set, then we will report all attempts to access files under this scope (whether existent or not).
     // BuildXL uses this information to discover dynamic dependencies, such as #include-ed files.
     FileAccessPolicy_ReportAccess = FileAccessPolicy_ReportAccessIfNonExistent | FileAccessPolicy_ReportAccessIfExistent,
@@ -699,6 +704,14 @@ typedef struct ManifestRecord_t
         __in  PCPathChar target,
         __in  size_t targetLength,
         __out PCManifestRecord& child) const;
+
+    // Same as above, for a target whose HashPath is already known.
+    __success(return)
+    bool FindChild(
+        __in  PCPathChar target,
+        __in  size_t targetLength,
+        __in  DWORD hash,
+        __out PCManifestRecord& child) const;
 } ManifestRecord;
 typedef const ManifestRecord * PCManifestRecord; // duplicated for use in scopes outside of the struct
 
@@ -184,7 +184,11 @@ DEFINE_ENUM_FLAG_OPERATORS(RequestedAccess)
 class AccessCheckResult 
 {
 private:
-    AccessCheckResult() {}
+    // Invalid results are those of accesses that were not checked: nothing is reported nor denied for them
+    AccessCheckResult() :
+        Access(RequestedAccess::None), Result(ResultAction::Allow), Level(ReportLevel::Ignore), Validity(PathValidity::Valid)
+    {
+    }
 
 public:
     static inline AccessCheckResult Invalid() { return AccessCheckResult(); }
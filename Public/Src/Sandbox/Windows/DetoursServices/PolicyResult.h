@@ -176,6 +176,7 @@ public:
     bool IndicateUntracked() const { return ((m_policy & FileAccessPolicy_AllowAll) == FileAccessPolicy_AllowAll) && ((m_policy & FileAccessPolicy_ReportAccess) == 0); }
     bool TreatDirectorySymlinkAsDirectory() const { return (m_policy & FileAccessPolicy_TreatDirectorySymlinkAsDirectory) != 0; }
     bool EnableFullReparsePointParsing() const { return (m_policy & FileAccessPolicy_EnableFullReparsePointParsing) != 0; }
+    bool ReportContentHashOnClose() const { return (m_policy & FileAccessPolicy_ReportContentHashOnClose) != 0; }
     DWORD GetPathId() const { return m_policySearchCursor.IsValid() ? m_policySearchCursor.Record->GetPathId() : 0; }
     FileAccessPolicy GetPolicy() const { return m_policy; }
     USN GetExpectedUsn() const { return m_policySearchCursor.GetExpectedUsn(); }
@@ -203,17 +204,12 @@ public:
                 first_level = Level();
             }
 
-            PolicySearchCursor::PPolicySearchCursor parent = m_policySearchCursor.Parent;
-            while (parent != nullptr)
+            size_t ancestorLevel;
+            if (m_policySearchCursor.Ancestors.FindTopmostLevelWithConePolicy(fileAccessPolicy, ancestorLevel))
             {
-                if ((parent->Record->GetConePolicy() & fileAccessPolicy) != 0)
-                {
-                    // Level of a policy search cursor refers to the level of the remainder of the path after this policyresult.
-                    // To find the level including this policy result, we subtract 1
-                    first_level = parent->Level - 1;
-                }
-
-                parent = parent->Parent;
+                // Level of a policy search cursor refers to the level of the remainder of the path after this policyresult.
+                // To find the level including this policy result, we subtract 1
+                first_level = ancestorLevel - 1;
             }
         }
 
@@ -53,10 +53,23 @@ static size_t GetPartialPathAndRemainder(
     return found;
 }
 
-PolicySearchCursor FindFileAccessPolicyInTreeEx(
+#if _WIN32
+#define PrefetchRecord(record) PreFetchCacheLine(PF_TEMPORAL_LEVEL_1, (record))
+#else
+#define PrefetchRecord(record) __builtin_prefetch((record))
+#endif
+
+/// SearchPolicyTree
+///
+/// Walks down the policy tree from 'cursor' along the components of absolutePath (see FindFileAccessPolicyInTreeEx),
+/// calling onDescend(childCursor, remainder) every time it moves to a child record, where remainder is what is left
+/// of absolutePath below that child.
+template <typename OnDescend>
+static PolicySearchCursor SearchPolicyTree(
     __in  PolicySearchCursor const& cursor,
     __in  PCPathChar absolutePath,
-    __in  size_t absolutePathLength)
+    __in  size_t absolutePathLength,
+    __in  OnDescend onDescend)
 {
     assert(absolutePath);
     assert(absolutePathLength == pathlen(absolutePath));
@@ -72,40 +85,146 @@ PolicySearchCursor FindFileAccessPolicyInTreeEx(
         return cursor;
     }
 
-    // Terminal cases: Maybe we can't walk further down the tree, or maybe we've matched all of the path.
-    ManifestRecord::BucketCountType numBuckets = cursor.Record->BucketCount;
-    bool isLeaf = numBuckets == 0; // we found a leaf, even if there is more path, we have gone as far as we can
-    bool endOfPath = absolutePath[0] == 0; // no more path to search, wherever we ended up is the node to consider
-    if (isLeaf || endOfPath)
-    {
-        return PolicySearchCursor(cursor.Record, cursor.Level, cursor.Parent, /*searchWasTruncated*/ !endOfPath);
-    }
+    // The cursor moves down in place; its ancestors are only ever appended to.
+    PolicySearchCursor result(cursor);
+
+    // The path component to look up among the children of result.Record, once tokenized (hashed == true).
+    PCPathChar remainder = absolutePath;
+    size_t remainderLength = absolutePathLength;
+    PCPathChar component = nullptr;
+    size_t componentLength = 0;
+    DWORD hash = 0;
+    bool hashed = false;
 
-    // We're now committed to tokenizing a further path component, and trying to find a matching child.
+    for (;;) {
+        // Terminal cases: Maybe we can't walk further down the tree, or maybe we've matched all of the path.
+        ManifestRecord::BucketCountType numBuckets = result.Record->BucketCount;
+        bool isLeaf = numBuckets == 0; // we found a leaf, even if there is more path, we have gone as far as we can
+        bool endOfPath = !hashed && remainder[0] == 0; // no more path to search, wherever we ended up is the node to consider
+        if (isLeaf || endOfPath)
+        {
+            result.SearchWasTruncated = !endOfPath;
+            return result;
+        }
 
-    PCPathChar remainder = NULL;
-    size_t partialPathLength = GetPartialPathAndRemainder(absolutePath, absolutePathLength, /*out*/ remainder);
-    assert(absolutePath + partialPathLength <= remainder);
-    assert(remainder >= absolutePath);
-    assert(remainder <= absolutePath + absolutePathLength);
+        // We're now committed to tokenizing a further path component, and trying to find a matching child.
+        if (!hashed) {
+            component = remainder;
+            componentLength = GetPartialPathAndRemainder(component, remainderLength, /*out*/ remainder);
+            remainderLength -= remainder - component;
+            hash = HashPath(component, componentLength);
+        }
 
-    PCManifestRecord childRecord = NULL;
-    bool childFound = cursor.Record->FindChild(absolutePath, partialPathLength, /*out*/ childRecord);
-    if (!childFound || childRecord == NULL)
-    {
-        // There was path to consume, and a chance of finding a child record, but that didn't work.
-        // So, this is a third terminal case (but we had to do a bit of work to determine so).
-        return PolicySearchCursor(cursor.Record, cursor.Level, cursor.Parent, /*searchWasTruncated*/ true);
+        assert(remainderLength == pathlen(remainder));
+
+        // Start loading the child the component hashes to, and tokenize and hash the next component meanwhile.
+        PCManifestRecord candidate = result.Record->GetChildRecord(hash % numBuckets);
+        if (candidate != nullptr) {
+            PrefetchRecord(candidate);
+        }
+
+        PCPathChar nextComponent = remainder;
+        PCPathChar nextRemainder = remainder;
+        size_t nextComponentLength = 0;
+        DWORD nextHash = 0;
+        hashed = remainder[0] != 0;
+        if (hashed) {
+            nextComponentLength = GetPartialPathAndRemainder(nextComponent, remainderLength, /*out*/ nextRemainder);
+            nextHash = HashPath(nextComponent, nextComponentLength);
+        }
+
+        PCManifestRecord childRecord = nullptr;
+        bool childFound = result.Record->FindChild(component, componentLength, hash, /*out*/ childRecord);
+        if (!childFound || childRecord == nullptr)
+        {
+            // There was path to consume, and a chance of finding a child record, but that didn't work.
+            // So, this is a third terminal case (but we had to do a bit of work to determine so).
+            result.SearchWasTruncated = true;
+            return result;
+        }
+
+        // childRecord's partialPath is a prefix of what was left of the path: consume some more of it, if any.
+        result.Ancestors.Push(result.Record, result.Level);
+        result.Record = childRecord;
+        result.Level++;
+        onDescend(result, remainder);
+
+        if (hashed) {
+            component = nextComponent;
+            componentLength = nextComponentLength;
+            hash = nextHash;
+            remainderLength -= nextRemainder - remainder;
+            remainder = nextRemainder;
+        }
+    }
+}
+
+PolicySearchCursor FindFileAccessPolicyInTreeEx(
+    __in  PolicySearchCursor const& cursor,
+    __in  PCPathChar absolutePath,
+    __in  size_t absolutePathLength)
+{
+    return SearchPolicyTree(cursor, absolutePath, absolutePathLength, [](PolicySearchCursor const&, PCPathChar) { });
+}
+
+#if !MAC_OS_SANDBOX
+void FindFileAccessPolicies(
+    __in                    PolicySearchCursor const& startCursor,
+    __in_ecount(count)      PCPathChar const* paths,
+    __in                    size_t count,
+    __out_ecount(count)     PolicySearchCursor* results)
+{
+    // Look the paths up in (ordinal) order, so that paths sharing leading components come one after another.
+    std::vector<size_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
     }
 
-    assert(childRecord != NULL);
+    std::sort(order.begin(), order.end(), [paths](size_t left, size_t right) {
+        PCPathChar l = paths[left];
+        PCPathChar r = paths[right];
+        for (; *l != 0 && *l == *r; l++, r++);
+        return *l < *r;
+    });
+
+    // For the previous path: the cursors reached after each of its leading components, and the length of the
+    // prefix of that path these components (and the separator that follows them) make up.
+    std::vector<PolicySearchCursor> prefixCursors(1, startCursor);
+    std::vector<size_t> prefixLengths(1, 0);
+    PCPathChar previousPath = nullptr;
+
+    for (size_t index : order) {
+        PCPathChar path = paths[index];
+        size_t pathLength = pathlen(path);
+
+        // Resume from the deepest cursor of the previous path whose prefix this path shares
+        size_t shared = 0;
+        if (previousPath != nullptr) {
+            size_t commonLength = 0;
+            for (; path[commonLength] != 0 && path[commonLength] == previousPath[commonLength]; commonLength++);
+            while (shared + 1 < prefixLengths.size() && prefixLengths[shared + 1] <= commonLength) {
+                shared++;
+            }
+        }
+
+        prefixCursors.resize(shared + 1, startCursor);
+        prefixLengths.resize(shared + 1);
+
+        size_t resumeAt = prefixLengths[shared];
+        results[index] = SearchPolicyTree(prefixCursors[shared], path + resumeAt, pathLength - resumeAt,
+            [&prefixCursors, &prefixLengths, path](PolicySearchCursor const& cursor, PCPathChar remainder) {
+                // Only components followed by a separator can be shared: 'a/b' does not share 'b' with 'a/bc'
+                size_t length = remainder - path;
+                if (remainder[0] != 0 || IsDirectorySeparator(path[length - 1])) {
+                    prefixCursors.push_back(cursor);
+                    prefixLengths.push_back(length);
+                }
+            });
 
-    // childRecord's partialPath is a prefix of remainder.
-    size_t remainderLength = absolutePathLength - (remainder - absolutePath);
-    assert(remainderLength == pathlen(remainder));
-    // Recursive step: Consume some more of the path, if any. Note that we always recurse with a non-truncated cursor due to the terminal cases above.
-    return FindFileAccessPolicyInTreeEx(PolicySearchCursor(childRecord, cursor.Level + 1, MakePPolicySearchCursor(cursor)), remainder, remainderLength);
+        previousPath = path;
+    }
 }
+#endif // !MAC_OS_SANDBOX
 
 #ifdef BUILDXL_NATIVES_LIBRARY
 BOOL WINAPI FindFileAccessPolicyInTree(
@@ -121,7 +240,7 @@ BOOL WINAPI FindFileAccessPolicyInTree(
         return false;
     }
 
-    PolicySearchCursor newCursor = FindFileAccessPolicyInTreeEx(PolicySearchCursor(record, 0, 0), absolutePath, absolutePathLength);
+    PolicySearchCursor newCursor = FindFileAccessPolicyInTreeEx(PolicySearchCursor(record), absolutePath, absolutePathLength);
 	conePolicy = newCursor.Record->GetConePolicy();
 	nodePolicy = newCursor.Record->GetNodePolicy();
     expectedUsn = newCursor.GetExpectedUsn();
@@ -140,7 +259,17 @@ __in  PCPathChar target,
 __in  size_t targetLength,
 __out PCManifestRecord& child) const
 {
-    DWORD hash = HashPath(target, targetLength);
+    return FindChild(target, targetLength, HashPath(target, targetLength), child);
+}
+
+__success(return)
+bool ManifestRecord::FindChild(
+__in  PCPathChar target,
+__in  size_t targetLength,
+__in  DWORD hash,
+__out PCManifestRecord& child) const
+{
+    assert(hash == HashPath(target, targetLength));
     ManifestRecord::BucketCountType numBuckets = this->BucketCount;
 
     // We are searching a hash-table that has been constructed in FileAccessManifest.cs
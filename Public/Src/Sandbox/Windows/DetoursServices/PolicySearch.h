@@ -10,44 +10,124 @@
 // Manifest policy tree search
 // ----------------------------------------------------------------------------
 
+// The records a search for a policy went through before reaching the record of its cursor (i.e., the ancestors of
+// that record), topmost first. They are kept inline so that descending the policy tree never allocates: a cursor is
+// copied at every level of a search, on every platform (including the kernel extension, where the STL is not
+// available). Manifests are rarely more than MaxRecords levels deep; for the ancestors beyond that, only the level of
+// the topmost one with each cone policy flag is kept, which is all FindTopmostLevelWithConePolicy needs.
+class PolicySearchAncestors {
+public:
+    static const size_t MaxRecords = 16;
+
+    PolicySearchAncestors()
+        : m_count(0), m_topLevel(0), m_overflowPolicy(0)
+    {
+    }
+
+    // Number of ancestors, including those beyond MaxRecords
+    size_t Count() const {
+        return m_count;
+    }
+
+    // Appends 'record', which is at 'level', right below the last appended record
+    void Push(ManifestRecord const* record, size_t level) {
+        assert(record != nullptr);
+        assert(m_count == 0 || level == m_topLevel + m_count);
+
+        if (m_count == 0) {
+            m_topLevel = level;
+        }
+
+        if (m_count < MaxRecords) {
+            m_records[m_count] = record;
+        }
+        else {
+            ManifestRecord::PolicyType newFlags = record->ConePolicy & ~m_overflowPolicy;
+            for (size_t flag = 0; newFlags != 0; flag++, newFlags >>= 1) {
+                if ((newFlags & 1) != 0) {
+                    m_overflowLevels[flag] = static_cast<WORD>(level);
+                }
+            }
+
+            m_overflowPolicy |= record->ConePolicy;
+        }
+
+        m_count++;
+    }
+
+    // Finds the level of the topmost ancestor whose cone policy has any of the flags of 'policy'.
+    __success(return)
+    bool FindTopmostLevelWithConePolicy(FileAccessPolicy policy, __out size_t& level) const {
+        size_t kept = m_count < MaxRecords ? m_count : MaxRecords;
+        for (size_t i = 0; i < kept; i++) {
+            if ((m_records[i]->GetConePolicy() & policy) != 0) {
+                level = m_topLevel + i;
+                return true;
+            }
+        }
+
+        ManifestRecord::PolicyType flags = m_overflowPolicy & policy;
+        if (flags == 0) {
+            return false;
+        }
+
+        level = m_topLevel + m_count;
+        for (size_t flag = 0; flags != 0; flag++, flags >>= 1) {
+            if ((flags & 1) != 0 && m_overflowLevels[flag] < level) {
+                level = m_overflowLevels[flag];
+            }
+        }
+
+        return true;
+    }
+
+private:
+    size_t m_count;
+    size_t m_topLevel;
+    ManifestRecord const* m_records[MaxRecords];
+
+    // Union of the cone policies of the ancestors beyond MaxRecords, and the level of the topmost of them with each flag
+    ManifestRecord::PolicyType m_overflowPolicy;
+    WORD m_overflowLevels[sizeof(ManifestRecord::PolicyType) * 8];
+};
+
 // Represents the continuation state of a search for a policy (via FindFileAccessPolicyInTree).
 // When a search completes, the resulting cursor allows a subsequent search rooted beneath the
 // already-found policy - i.e., Find(<root cursor>, "C:\foo") -> Cursor ; Find(Cursor, "bar") is
 // equivalent to Find("C:\foo\bar"); but repeated work is saved and the original path is not needed.
 struct PolicySearchCursor {
-#if _WIN32
-    typedef std::shared_ptr<PolicySearchCursor> PPolicySearchCursor;
-#define MakePPolicySearchCursor(cursor) std::make_shared<PolicySearchCursor>(cursor)
-#else
-    typedef PolicySearchCursor* PPolicySearchCursor;
-#define MakePPolicySearchCursor(cursor) nullptr
-#endif
-
     PolicySearchCursor()
-        : Record(nullptr), Level(0), Parent(nullptr), SearchWasTruncated(true)
+        : Record(nullptr), Level(0), Ancestors(), SearchWasTruncated(true)
     {
         assert(!IsValid());
     };
 
     // Implicit conversion constructor to start a search from a manifest record.
     PolicySearchCursor(ManifestRecord const* record)
-        : Record(record), Level(0), Parent(nullptr), SearchWasTruncated(false)
+        : Record(record), Level(0), Ancestors(), SearchWasTruncated(false)
     {
         assert(record != nullptr);
     }
 
-    PolicySearchCursor(ManifestRecord const* record, size_t level, PPolicySearchCursor parent)
-        : Record(record), Level(level), Parent(parent), SearchWasTruncated(false)
+    PolicySearchCursor(ManifestRecord const* record, size_t level, PolicySearchAncestors const& ancestors)
+        : Record(record), Level(level), Ancestors(ancestors), SearchWasTruncated(false)
     { 
         assert(record != nullptr);
     }
 
-    PolicySearchCursor(ManifestRecord const* record, size_t level, PPolicySearchCursor parent, bool searchWasTruncated)
-        : Record(record), Level(level), Parent(parent), SearchWasTruncated(searchWasTruncated)
+    PolicySearchCursor(ManifestRecord const* record, size_t level, PolicySearchAncestors const& ancestors, bool searchWasTruncated)
+        : Record(record), Level(level), Ancestors(ancestors), SearchWasTruncated(searchWasTruncated)
     { 
         assert(record != nullptr);
     }
 
+    // Gets a cursor for 'child', a child record of the record of this cursor.
+    PolicySearchCursor GetChildCursor(ManifestRecord const* child) const {
+        PolicySearchCursor childCursor(child, Level + 1, Ancestors);
+        childCursor.Ancestors.Push(Record, Level);
+        return childCursor;
+    }
+
     // Gets the expected USN corresponding to this match. Returns -1 if this match was not for the complete
     // path (and so a USN is not known) or if the cursor is invalid.
     USN GetExpectedUsn() const {
@@ -70,7 +150,8 @@ struct PolicySearchCursor {
     // d: is level 1, d:\a is level 2, d:\a\b is level 3, etc...
     size_t Level;
 
-    PPolicySearchCursor Parent;
+    // The records above Record, down from the record the search started from (the levels of which are Level - Ancestors.Count(), ..., Level - 1).
+    PolicySearchAncestors Ancestors;
 
     // Indicates if the search generating this cursor was truncated due to reaching the bottom of the tree.
     // A search for "C:\foo\A" in a tree containing only the leaf C:\foo\B will point to the C:\foo record, but will
@@ -87,6 +168,17 @@ PolicySearchCursor FindFileAccessPolicyInTreeEx(
     __in  PCPathChar absolutePath,
     __in  size_t absolutePathLength);
 
+#if !MAC_OS_SANDBOX
+// Looks up count paths at once: results[i] is what FindFileAccessPolicyInTreeEx(startCursor, paths[i], ...) returns.
+// The paths are looked up in sorted order, so that the leading components they share are only searched once; this is
+// meant for consumers evaluating many paths at a time (analyzers, aggregators).
+void FindFileAccessPolicies(
+    __in                    PolicySearchCursor const& startCursor,
+    __in_ecount(count)      PCPathChar const* paths,
+    __in                    size_t count,
+    __out_ecount(count)     PolicySearchCursor* results);
+#endif // !MAC_OS_SANDBOX
+
 // This is equivalent to FindFileAccessPolicyInTreeEx, but taking just a start record
 // rather than a full cursor, and returning only the matched record details rather than a cursor.
 // This is a simplified variant for easier C#-side testing.
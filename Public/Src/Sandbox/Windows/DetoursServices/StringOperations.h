@@ -30,6 +30,8 @@ typedef char PathChar;
 
 #endif
 
+#include <stdint.h>
+
 #if MAC_OS_LIBRARY || MAC_OS_SANDBOX
 #include "utf8proc.h"
 #endif // MAC_OS_LIBRARY || MAC_OS_SANDBOX
@@ -96,6 +98,33 @@ inline bool IsPathCharEqual(PathChar c1, PathChar c2)
         NormalizePathChar(c1) == NormalizePathChar(c2);
 }
 
+/// AsciiBlockToUpper
+///
+/// Upper-cases a block of sizeof(uint64_t) / sizeof(TChar) characters at once, provided they are all ASCII; this is
+/// what NormalizePathChar does to ASCII characters on the platforms where it is not the identity.
+/// Returns false, leaving 'block' as is, if any of the characters is not ASCII; the caller then has to normalize
+/// them one by one.
+template <typename TChar>
+inline bool AsciiBlockToUpper(uint64_t& block)
+{
+    static_assert(sizeof(TChar) == 1 || sizeof(TChar) == 2, "only 8-bit and 16-bit characters are supported");
+
+    // One set bit at the bottom of every character of the block, and the bits a non-ASCII character has set
+    const uint64_t ones = ~0ull / ((1ull << (8 * sizeof(TChar))) - 1);
+    const uint64_t nonAscii = ones * (((1ull << (8 * sizeof(TChar))) - 1) & ~0x7Full);
+
+    if ((block & nonAscii) != 0) {
+        return false;
+    }
+
+    // Every character is below 0x80, so adding these never carries into the next character: bit 7 of a character
+    // ends up set if it is >= 'a' (resp. > 'z'), and 0x80 >> 2 is the distance between the two cases
+    uint64_t geA = block + ones * (0x80 - 'a');
+    uint64_t gtZ = block + ones * (0x80 - 'z' - 1);
+    block ^= ((geA ^ gtZ) & (ones * 0x80)) >> 2;
+    return true;
+}
+
 /// IsDirectorySeparator
 ///
 /// Checks whether the given character is a directory separator (checking against all platforms).
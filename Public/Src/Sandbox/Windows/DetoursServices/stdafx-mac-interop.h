@@ -13,3 +13,6 @@
 #include <bsm/libbsm.h>
 #include <dispatch/dispatch.h>
 #include <EndpointSecurity/EndpointSecurity.h>
+
+#include <algorithm>
+#include <vector>
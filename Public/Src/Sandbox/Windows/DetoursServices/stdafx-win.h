@@ -37,6 +37,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <detours.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <memory>
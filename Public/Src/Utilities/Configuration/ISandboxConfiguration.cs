@@ -285,5 +285,17 @@ namespace BuildXL.Utilities.Configuration
         /// This is an experimental feature, enabling this option may result in more DFAs on a build.
         /// </remarks>
         public bool ExplicitlyReportDirectoryProbes { get; }
+
+        /// <summary>
+        /// Linux-specific: have the sandbox collect per-process statistics (per interposed function call counts and latency histograms,
+        /// cache hits/misses, report counts/sizes), which are aggregated per pip and logged when the pip completes.
+        /// </summary>
+        public bool ReportSandboxStatistics { get; }
+
+        /// <summary>
+        /// Linux-specific: have the sandbox hash output files when the processes that write them close them. The engine uses such a hash for an output
+        /// it tracks without storing it to the cache, once it checked the hash against the output (only when the content hash type is the default, VSO hash).
+        /// </summary>
+        public bool HashOutputsOnClose { get; }
     }
 }
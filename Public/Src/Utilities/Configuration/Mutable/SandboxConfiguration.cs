@@ -54,6 +54,8 @@ namespace BuildXL.Utilities.Configuration.Mutable
             VmConcurrencyLimit = 0;
             DirectoriesToEnableFullReparsePointParsing = new List<AbsolutePath>();
             ExplicitlyReportDirectoryProbes = false;
+            ReportSandboxStatistics = false;
+            HashOutputsOnClose = false;
         }
 
         /// <nodoc />
@@ -105,6 +107,8 @@ namespace BuildXL.Utilities.Configuration.Mutable
             VmConcurrencyLimit = template.VmConcurrencyLimit;
             DirectoriesToEnableFullReparsePointParsing = pathRemapper.Remap(template.DirectoriesToEnableFullReparsePointParsing);
             ExplicitlyReportDirectoryProbes = template.ExplicitlyReportDirectoryProbes;
+            ReportSandboxStatistics = template.ReportSandboxStatistics;
+            HashOutputsOnClose = template.HashOutputsOnClose;
         }
 
         /// <inheritdoc />
@@ -275,5 +279,11 @@ namespace BuildXL.Utilities.Configuration.Mutable
 
         /// <inheritdoc />
         public bool ExplicitlyReportDirectoryProbes { get; set; }
+
+        /// <inheritdoc />
+        public bool ReportSandboxStatistics { get; set; }
+
+        /// <inheritdoc />
+        public bool HashOutputsOnClose { get; set; }
     }
 }
@@ -52,5 +52,10 @@ namespace BuildXL.Utilities.Configuration
         /// Linux-specific: using LD_PRELOAD interposing
         /// </summary>
         LinuxDetours,
+
+        /// <summary>
+        /// Linux-specific: using a seccomp user-notification supervisor (also sees static and non-glibc binaries, but only observes accesses: it never blocks them)
+        /// </summary>
+        LinuxSeccomp,
     }
 }
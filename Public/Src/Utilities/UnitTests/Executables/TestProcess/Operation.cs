@@ -248,6 +248,11 @@ namespace Test.BuildXL.Executables.TestProcess
             /// Invokes some native code that crashes hard (by segfaulting or something)
             /// </summary>
             CrashHardNative,
+
+            /// <summary>
+            /// Creates threads and then a child process by calling 'clone' from libBxlUtils (Linux only)
+            /// </summary>
+            CloneThreads,
         }
 
         /// <summary>
@@ -285,6 +290,9 @@ namespace Test.BuildXL.Executables.TestProcess
         [return: MarshalAs(UnmanagedType.Bool)]
         private static extern bool ExternWinCreateDirectory(string lpPathName, IntPtr lpSecurityAttributes);
 
+        [DllImport("libBxlUtils", EntryPoint = "clone_threads_and_process_for_test")]
+        private static extern int ExternLinuxCloneThreadsAndProcess(int count);
+
         /*** STATE FOR BUILDXL TESTING ***/
 
         /// <summary>
@@ -513,6 +521,9 @@ namespace Test.BuildXL.Executables.TestProcess
                     case Type.CrashHardNative:
                         DoCrashHardNative();
                         return;
+                    case Type.CloneThreads:
+                        DoCloneThreads();
+                        return;
                     case Type.WriteFileIfInputEqual:
                         DoWriteFileIfInputEqual();
                         return;
@@ -940,6 +951,20 @@ namespace Test.BuildXL.Executables.TestProcess
             return new Operation(Type.CrashHardNative);
         }
 
+        /// <summary>
+        /// Creates <paramref name="count"/> threads, one at a time, and then a child process, all by calling 'clone'
+        /// (rather than pthread_create, which doesn't go through the exported 'clone' function).
+        /// </summary>
+        /// <remarks>
+        /// The calls are made by native code in libBxlUtils, which is linked against libc like any other program, so they go
+        /// through the interposed 'clone' when the process runs in the Linux sandbox (a p-invoke of 'clone' would bind to libc directly).
+        /// Linux only.
+        /// </remarks>
+        public static Operation CloneThreads(int count)
+        {
+            return new Operation(Type.CloneThreads, content: count.ToString());
+        }
+
         /// <summary>
         /// Process that fails on the first invocations and succeeds on the last.
         /// </summary>
@@ -1500,6 +1525,15 @@ namespace Test.BuildXL.Executables.TestProcess
             global::BuildXL.Interop.Dispatch.ForceQuit();
         }
 
+        private void DoCloneThreads()
+        {
+            int error = ExternLinuxCloneThreadsAndProcess(int.Parse(Content));
+            if (error != 0)
+            {
+                throw new InvalidOperationException($"clone failed with errno {error}");
+            }
+        }
+
         private void DoSucceedOnRetry()
         {
             // Use this state file to differentiate between the first and subsequent runs. The file contains the number of retries left to succeed